@@ -0,0 +1,82 @@
+# Shared build configuration for arch and the applications that link it.
+# Set ARCH_DIR to the root of arch before including this file, after which
+# the objects link against $(ARCH_LIB) with $(ARCH_LDFLAGS).
+
+# User defined parameters
+ARCH_DIR         ?= .
+KERNELS          ?= omp3
+COMPILER         ?= GCC
+MPI              ?= no
+LTO              ?= no
+PGO              ?= no
+PGO_DIR          ?= $(ARCH_DIR)/pgo/$(KERNELS)
+ARCH_COMPILER_CC ?= gcc
+ARCH_COMPILER_CPP?= g++
+ARCH_AR          ?= ar
+RAJA_PATH        ?= /usr/local
+
+# Compiler-specific flags
+CFLAGS_INTEL      = -O3 -qopenmp -no-prec-div -std=gnu99 -DINTEL -Wall -xhost
+CFLAGS_GCC        = -O3 -std=gnu99 -fopenmp -march=native -Wall
+CFLAGS_CLANG      = -O3 -std=gnu99 -fopenmp -march=native -Wall
+CFLAGS_CRAY       = -lrt -hlist=a
+CFLAGS_PGI        = -fast -mp
+
+CPPFLAGS_INTEL    = -O3 -qopenmp -no-prec-div -std=c++11 -DINTEL -Wall -xhost
+CPPFLAGS_GCC      = -O3 -std=gnu++11 -fopenmp -march=native -Wall
+CPPFLAGS_CLANG    = -O3 -std=gnu++11 -fopenmp -march=native -Wall
+
+# Link-time optimisation flags
+LTOFLAGS_INTEL    = -ipo
+LTOFLAGS_GCC      = -flto
+LTOFLAGS_CLANG    = -flto
+
+# Profile-guided optimisation flags
+PGO_GEN_INTEL     = -prof-gen -prof-dir=$(PGO_DIR)
+PGO_USE_INTEL     = -prof-use -prof-dir=$(PGO_DIR)
+PGO_GEN_GCC       = -fprofile-generate=$(PGO_DIR)
+PGO_USE_GCC       = -fprofile-use=$(PGO_DIR) -fprofile-correction
+PGO_GEN_CLANG     = -fprofile-instr-generate
+PGO_USE_CLANG     = -fprofile-instr-use=$(PGO_DIR)/default.profdata
+
+# Kernel-specific flags, the offloading models fall back to the host
+KFLAGS_omp3       =
+KFLAGS_omp4_GCC   = -foffload=disable
+KFLAGS_oacc_GCC   = -fopenacc -foffload=disable
+KFLAGS_oacc_PGI   = -acc -ta=host
+KFLAGS_raja       = -I$(RAJA_PATH)/include
+
+ifeq ($(DEBUG), yes)
+  OPTIONS += -O0 -g -DDEBUG
+endif
+
+ifeq ($(MPI), yes)
+  OPTIONS += -DMPI
+endif
+
+ifeq ($(LTO), yes)
+  OPTIONS += $(LTOFLAGS_$(COMPILER))
+  ifeq ($(COMPILER), GCC)
+    ARCH_AR = gcc-ar
+  endif
+  ifeq ($(COMPILER), CLANG)
+    ARCH_AR = llvm-ar
+  endif
+  ifeq ($(COMPILER), INTEL)
+    ARCH_AR = xiar
+  endif
+endif
+
+ifeq ($(PGO), generate)
+  OPTIONS += $(PGO_GEN_$(COMPILER))
+endif
+ifeq ($(PGO), use)
+  OPTIONS += $(PGO_USE_$(COMPILER))
+endif
+
+ARCH_LIB       = $(ARCH_DIR)/libarch_$(KERNELS).a
+ARCH_LDFLAGS   = $(CFLAGS_$(COMPILER)) $(OPTIONS) -lm
+ARCH_FLAGS     = $(CFLAGS_$(COMPILER)) $(KFLAGS_$(KERNELS)) \
+                 $(KFLAGS_$(KERNELS)_$(COMPILER))
+ARCH_CPPFLAGS  = $(CPPFLAGS_$(COMPILER)) $(KFLAGS_$(KERNELS)) \
+                 $(KFLAGS_$(KERNELS)_$(COMPILER))
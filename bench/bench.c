@@ -0,0 +1,699 @@
+#include "../colour.h"
+#include "../comms.h"
+#include "../geometry.h"
+#include "../mesh.h"
+#include "../shared.h"
+#include "../snapshot.h"
+#include "../tiling.h"
+#include "../umesh.h"
+#include "sweeps.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ *    BENCHMARK HARNESS FOR THE ARCHITECTURAL PRIMITIVES
+ *    Each benchmark is warmed up and then repeated, reporting the median and
+ *    percentiles of the repetitions for every thread count in the sweep.
+ */
+
+#define MAX_THREAD_COUNTS 16
+#define MAX_RESULTS 256
+#define NREDUCTIONS 1000 // Reductions performed per repetition
+#define VISIT_PREFIX "arch_bench_visit"
+#define SHUFFLE_SEED 88172645463325252ULL // Seeds the mesh shuffles
+
+// The configuration of a benchmark run
+typedef struct {
+  int nwarmups;
+  int nreps;
+  int nx;
+  int ny;
+  int nz;
+  int pad;
+  int decomp_nranks;
+  int nthread_counts;
+  int thread_counts[MAX_THREAD_COUNTS];
+  const char* json_filename;
+
+  int rank;
+  int nranks;
+} BenchConfig;
+
+// The statistics gathered for a single benchmark
+typedef struct {
+  char name[MAX_STR_LEN];
+  int nthreads;
+  int nreps;
+  double min;
+  double p10;
+  double median;
+  double p90;
+  double max;
+  double mean;
+} BenchResult;
+
+// The state shared by all of the benchmarks
+typedef struct {
+  Mesh mesh_2d;
+  Mesh mesh_3d;
+  double* arr_2d;
+  double* arr_3d;
+  int pack;
+  size_t alloc_len;
+  int decomp_nranks;
+  UnstructuredMesh* umesh; // The mesh gathered over by the current benchmark
+  UnstructuredColouring* colouring; // The colouring of the current scatter
+  UnstructuredTiling* tiling;       // The tiles of the current tiled sweep
+} BenchState;
+
+typedef void (*bench_kernel)(BenchState* state);
+
+static struct Profile bench_profile;
+
+// Sorts the repetition times in ascending order
+static int compare_doubles(const void* a, const void* b) {
+  const double da = *(const double*)a;
+  const double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+// Fetches a percentile from a sorted list of times
+static double percentile(const double* sorted, const int n, const double pc) {
+  const double pos = pc * (n - 1);
+  const int lo = (int)pos;
+  const int hi = (lo + 1 < n) ? lo + 1 : lo;
+  return sorted[lo] + (pos - lo) * (sorted[hi] - sorted[lo]);
+}
+
+// Warms up and times a kernel, recording the statistics of the repetitions
+static void run_benchmark(BenchConfig* config, BenchState* state,
+                          const char* name, const int nthreads,
+                          bench_kernel kernel, BenchResult* results,
+                          int* nresults) {
+  if (*nresults >= MAX_RESULTS) {
+    TERMINATE("Exceeded the maximum number of benchmark results %d.\n",
+              MAX_RESULTS);
+  }
+
+  for (int ww = 0; ww < config->nwarmups; ++ww) {
+    kernel(state);
+  }
+
+  double* times = (double*)malloc(sizeof(double) * config->nreps);
+  if (!times) {
+    TERMINATE("Could not allocate benchmark timings.\n");
+  }
+
+  for (int rr = 0; rr < config->nreps; ++rr) {
+    barrier();
+    const uint64_t t0 = profiler_read_ticks();
+    kernel(state);
+    barrier();
+    const uint64_t t1 = profiler_read_ticks();
+    times[rr] = (double)(t1 - t0) * bench_profile.seconds_per_tick;
+  }
+
+  qsort(times, config->nreps, sizeof(double), compare_doubles);
+
+  BenchResult* result = &results[(*nresults)++];
+  strncpy(result->name, name, MAX_STR_LEN - 1);
+  result->name[MAX_STR_LEN - 1] = '\0';
+  result->nthreads = nthreads;
+  result->nreps = config->nreps;
+  result->min = times[0];
+  result->max = times[config->nreps - 1];
+  result->p10 = percentile(times, config->nreps, 0.1);
+  result->median = percentile(times, config->nreps, 0.5);
+  result->p90 = percentile(times, config->nreps, 0.9);
+  result->mean = 0.0;
+  for (int rr = 0; rr < config->nreps; ++rr) {
+    result->mean += times[rr] / config->nreps;
+  }
+
+  if (config->rank == MASTER) {
+    printf("%-40s%8d%14.3e%14.3e%14.3e\n", name, nthreads, result->median,
+           result->p10, result->p90);
+  }
+
+  free(times);
+}
+
+// Allocates and zeroes a double array
+static void bench_allocate_data(BenchState* state) {
+  double* buf;
+  allocate_data(&buf, state->alloc_len);
+  deallocate_data(buf);
+}
+
+// Exchanges and reflects the halo of a 2d field
+static void bench_handle_boundary_2d(BenchState* state) {
+  handle_boundary_2d(state->mesh_2d.local_nx, state->mesh_2d.local_ny,
+                     &state->mesh_2d, state->arr_2d, NO_INVERT, state->pack);
+}
+
+// Exchanges and reflects the halo of a 3d field
+static void bench_handle_boundary_3d(BenchState* state) {
+  handle_boundary_3d(state->mesh_3d.local_nx, state->mesh_3d.local_ny,
+                     state->mesh_3d.local_nz, &state->mesh_3d, state->arr_3d,
+                     NO_INVERT, state->pack);
+}
+
+// Builds the full unstructured connectivity of the 3d mesh
+static void bench_convert_mesh_to_umesh_3d(BenchState* state) {
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, &state->mesh_3d);
+  finalise_unstructured_mesh(&umesh);
+}
+
+// Gathers the node positions of every cell of the unstructured mesh
+static void bench_gather_cells_to_nodes(BenchState* state) {
+  gather_cells_to_nodes(state->umesh);
+}
+
+// Gathers the node positions of every cell through the connectivity
+// accessors, which compute the nodes of an implicit mesh
+static void bench_gather_cells_to_nodes_accessor(BenchState* state) {
+  gather_cells_to_nodes_accessor(state->umesh);
+}
+
+// Scatters the volume of every cell evenly to its nodes with atomics
+static void bench_scatter_cells_to_nodes_atomic(BenchState* state) {
+  scatter_cells_to_nodes_atomic(state->umesh);
+}
+
+// Scatters the volume of every cell evenly to its nodes one colour at a
+// time, where no two cells of a colour share a node
+static void bench_scatter_cells_to_nodes_coloured(BenchState* state) {
+  scatter_cells_to_nodes_coloured(state->umesh, state->colouring);
+}
+
+// Scatters the area of every face into and out of its cells with atomics
+static void bench_scatter_faces_to_cells_atomic(BenchState* state) {
+  scatter_faces_to_cells_atomic(state->umesh);
+}
+
+// Scatters the area of every face into and out of its cells one colour at a
+// time, where no two faces of a colour share a cell
+static void bench_scatter_faces_to_cells_coloured(BenchState* state) {
+  scatter_faces_to_cells_coloured(state->umesh, state->colouring);
+}
+
+// Gathers the node positions of each tile into a buffer once, and then
+// gathers the positions of its cells from the buffer
+static void bench_gather_cells_to_nodes_tiled(BenchState* state) {
+  gather_cells_to_nodes_tiled(state->umesh, state->tiling);
+}
+
+// Scatters the volume of every cell evenly to its nodes in a buffer for each
+// tile, and then adds the buffer to the nodes with atomics, as the nodes on
+// the edges of the tiles are shared
+static void bench_scatter_cells_to_nodes_tiled(BenchState* state) {
+  scatter_cells_to_nodes_tiled(state->umesh, state->tiling);
+}
+
+// Computes the geometry of every face and cell of the unstructured mesh
+static void bench_compute_umesh_geometry(BenchState* state) {
+  compute_umesh_geometry(state->umesh);
+}
+
+// Finds the boundary normals of the unstructured mesh from its faces
+static void bench_find_boundary_normals_3d(BenchState* state) {
+  find_boundary_normals_3d(state->umesh, NULL);
+}
+
+// Decomposes the 2d mesh for every virtual rank
+static void bench_decompose_2d_cartesian(BenchState* state) {
+  const Mesh* mesh = &state->mesh_2d;
+  for (int rr = 0; rr < state->decomp_nranks; ++rr) {
+    int neighbours[NNEIGHBOURS];
+    int local_nx, local_ny, ranks_x, ranks_y, x_off, y_off;
+    decompose_2d_cartesian(rr, state->decomp_nranks, mesh->global_nx,
+                           mesh->global_ny, neighbours, &local_nx, &local_ny,
+                           &ranks_x, &ranks_y, &x_off, &y_off);
+  }
+}
+
+// Decomposes the 3d mesh for every virtual rank
+static void bench_decompose_3d_cartesian(BenchState* state) {
+  const Mesh* mesh = &state->mesh_3d;
+  for (int rr = 0; rr < state->decomp_nranks; ++rr) {
+    int neighbours[NNEIGHBOURS];
+    int local_nx, local_ny, local_nz, ranks_x, ranks_y, ranks_z;
+    int x_off, y_off, z_off;
+    decompose_3d_cartesian(rr, state->decomp_nranks, mesh->global_nx,
+                           mesh->global_ny, mesh->global_nz, neighbours,
+                           &local_nx, &local_ny, &local_nz, &ranks_x, &ranks_y,
+                           &ranks_z, &x_off, &y_off, &z_off);
+  }
+}
+
+// Performs a batch of global sums
+static void bench_reduce_all_sum(BenchState* state) {
+  double val = 1.0;
+  for (int ii = 0; ii < NREDUCTIONS; ++ii) {
+    val = reduce_all_sum(val) / state->mesh_2d.nranks;
+  }
+}
+
+// Performs a batch of global minimums
+static void bench_reduce_all_min(BenchState* state) {
+  double val = (double)state->mesh_2d.rank;
+  for (int ii = 0; ii < NREDUCTIONS; ++ii) {
+    val = reduce_all_min(val);
+  }
+}
+
+// Performs a batch of reductions to the master rank
+static void bench_reduce_to_master(BenchState* state) {
+  double val = 1.0;
+  for (int ii = 0; ii < NREDUCTIONS; ++ii) {
+    reduce_to_master(val);
+  }
+}
+
+// Writes out the local 3d field for visit
+static void bench_write_to_visit_3d(BenchState* state) {
+  char prefix[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", VISIT_PREFIX, state->mesh_3d.rank);
+  write_to_visit_3d(state->mesh_3d.local_nx, state->mesh_3d.local_ny,
+                    state->mesh_3d.local_nz, state->mesh_3d.x_off,
+                    state->mesh_3d.y_off, state->mesh_3d.z_off,
+                    state->arr_3d, prefix, 0, 0.0);
+}
+
+// Writes out the 3d field from all ranks into a single file for visit
+static void bench_write_all_ranks_to_visit_3d(BenchState* state) {
+  const Mesh* mesh = &state->mesh_3d;
+  write_all_ranks_to_visit_3d(
+      mesh->global_nx + 2 * mesh->pad, mesh->global_ny + 2 * mesh->pad,
+      mesh->global_nz + 2 * mesh->pad, mesh->local_nx, mesh->local_ny,
+      mesh->local_nz, mesh->pad, mesh->x_off, mesh->y_off, mesh->z_off,
+      mesh->rank, mesh->nranks, (int*)mesh->neighbours, state->arr_3d,
+      VISIT_PREFIX, 0, 0.0);
+}
+
+// Queues the local 3d field to be written for visit in the background
+static void bench_write_to_visit_3d_async(BenchState* state) {
+  char prefix[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", VISIT_PREFIX, state->mesh_3d.rank);
+  write_to_visit_3d_async(state->mesh_3d.local_nx, state->mesh_3d.local_ny,
+                          state->mesh_3d.local_nz, state->mesh_3d.x_off,
+                          state->mesh_3d.y_off, state->mesh_3d.z_off,
+                          state->arr_3d, prefix, 0, 0.0);
+}
+
+// Writes out the local 3d field as losslessly compressed chunks
+static void bench_write_compressed_3d(BenchState* state) {
+  char prefix[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", VISIT_PREFIX, state->mesh_3d.rank);
+  write_compressed_3d(state->mesh_3d.local_nx, state->mesh_3d.local_ny,
+                      state->mesh_3d.local_nz, state->arr_3d, prefix, 0, 0.0,
+                      0.0);
+}
+
+// Removes the files written by the visit benchmark
+static void remove_visit_files(const int rank) {
+  char filename[MAX_STR_LEN];
+  sprintf(filename, "%s_%d_0.bov", VISIT_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.dat", VISIT_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.chz", VISIT_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.snap", VISIT_PREFIX, rank);
+  remove(filename);
+  if (rank == MASTER) {
+    sprintf(filename, "%s0.bov", VISIT_PREFIX);
+    remove(filename);
+    sprintf(filename, "%s0.dat", VISIT_PREFIX);
+    remove(filename);
+  }
+}
+
+// Fills a random permutation of n entries
+static void random_permutation(const int n, uint64_t* seed, int* perm) {
+  for (int ii = 0; ii < n; ++ii) {
+    perm[ii] = ii;
+  }
+  for (int ii = n - 1; ii > 0; --ii) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    const int jj = (int)(*seed % (uint64_t)(ii + 1));
+    const int tmp = perm[ii];
+    perm[ii] = perm[jj];
+    perm[jj] = tmp;
+  }
+}
+
+// Converts the 3d mesh and numbers its cells and nodes randomly, as a mesh
+// generator without any locality might, returning the permutations if asked
+static void init_shuffled_umesh_3d(Mesh* mesh, UnstructuredMesh* umesh,
+                                   int* cells_old_to_new,
+                                   int* nodes_old_to_new) {
+  memset(umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(umesh, mesh);
+  int* cell_perm = (int*)malloc(sizeof(int) * umesh->ncells);
+  int* node_perm = (int*)malloc(sizeof(int) * umesh->nnodes);
+  if (!cell_perm || !node_perm) {
+    TERMINATE("Could not allocate the mesh shuffle.\n");
+  }
+  uint64_t seed = SHUFFLE_SEED + mesh->rank;
+  random_permutation(umesh->ncells, &seed, cell_perm);
+  random_permutation(umesh->nnodes, &seed, node_perm);
+  permute_unstructured_mesh(umesh, cell_perm, node_perm);
+  if (cells_old_to_new) {
+    memcpy(cells_old_to_new, cell_perm, sizeof(int) * umesh->ncells);
+  }
+  if (nodes_old_to_new) {
+    memcpy(nodes_old_to_new, node_perm, sizeof(int) * umesh->nnodes);
+  }
+  free(cell_perm);
+  free(node_perm);
+}
+
+// Decomposes and initialises a mesh in the same manner as initialise_comms
+static void init_bench_mesh(BenchConfig* config, Mesh* mesh, const int ndims) {
+  memset(mesh, 0, sizeof(Mesh));
+  mesh->global_nx = config->nx;
+  mesh->global_ny = config->ny;
+  mesh->global_nz = (ndims == 3) ? config->nz : 1;
+  mesh->pad = config->pad;
+  mesh->width = 1.0;
+  mesh->height = 1.0;
+  mesh->depth = 1.0;
+  mesh->rank = config->rank;
+  mesh->nranks = config->nranks;
+  mesh->ndims = ndims;
+
+  for (int ii = 0; ii < NNEIGHBOURS; ++ii) {
+    mesh->neighbours[ii] = EDGE;
+  }
+
+  if (ndims == 3) {
+    decompose_3d_cartesian(mesh->rank, mesh->nranks, mesh->global_nx,
+                           mesh->global_ny, mesh->global_nz, mesh->neighbours,
+                           &mesh->local_nx, &mesh->local_ny, &mesh->local_nz,
+                           &mesh->ranks_x, &mesh->ranks_y, &mesh->ranks_z,
+                           &mesh->x_off, &mesh->y_off, &mesh->z_off);
+    mesh->local_nx += 2 * mesh->pad;
+    mesh->local_ny += 2 * mesh->pad;
+    mesh->local_nz += 2 * mesh->pad;
+    initialise_mesh_3d(mesh);
+  } else {
+    decompose_2d_cartesian(mesh->rank, mesh->nranks, mesh->global_nx,
+                           mesh->global_ny, mesh->neighbours, &mesh->local_nx,
+                           &mesh->local_ny, &mesh->ranks_x, &mesh->ranks_y,
+                           &mesh->x_off, &mesh->y_off);
+    mesh->local_nx += 2 * mesh->pad;
+    mesh->local_ny += 2 * mesh->pad;
+    mesh->local_nz = 1;
+    initialise_mesh_2d(mesh);
+  }
+}
+
+// Parses a comma separated list of thread counts
+static void parse_thread_counts(BenchConfig* config, char* list) {
+  config->nthread_counts = 0;
+  for (char* tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+    if (config->nthread_counts >= MAX_THREAD_COUNTS) {
+      TERMINATE("At most %d thread counts can be swept.\n", MAX_THREAD_COUNTS);
+    }
+    config->thread_counts[config->nthread_counts++] = atoi(tok);
+  }
+}
+
+// Parses the command line, falling back on defaults
+static void parse_args(BenchConfig* config, int argc, char** argv) {
+  config->nwarmups = 2;
+  config->nreps = 20;
+  config->nx = 512;
+  config->ny = 512;
+  config->nz = 64;
+  config->pad = 2;
+  config->decomp_nranks = 1024;
+  config->json_filename = NULL;
+
+#ifdef _OPENMP
+  config->thread_counts[0] = omp_get_max_threads();
+#else
+  config->thread_counts[0] = 1;
+#endif
+  config->nthread_counts = 1;
+
+  for (int ii = 1; ii < argc; ++ii) {
+    if (strmatch(argv[ii], "-w") && ii + 1 < argc) {
+      config->nwarmups = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-r") && ii + 1 < argc) {
+      config->nreps = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-n") && ii + 3 < argc) {
+      config->nx = atoi(argv[++ii]);
+      config->ny = atoi(argv[++ii]);
+      config->nz = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-p") && ii + 1 < argc) {
+      config->pad = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-d") && ii + 1 < argc) {
+      config->decomp_nranks = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-t") && ii + 1 < argc) {
+      parse_thread_counts(config, argv[++ii]);
+    } else if (strmatch(argv[ii], "-o") && ii + 1 < argc) {
+      config->json_filename = argv[++ii];
+    } else {
+      TERMINATE("Usage: %s [-w warmups] [-r reps] [-n nx ny nz] [-p pad] "
+                "[-d decomposition ranks] [-t threads,...] [-o results.json]\n",
+                argv[0]);
+    }
+  }
+
+  if (config->nreps < 1) {
+    TERMINATE("At least one repetition is required.\n");
+  }
+}
+
+// Sweeps the thread counts for a benchmark over an unstructured mesh
+static void run_umesh_benchmark(BenchConfig* config, BenchState* state,
+                                UnstructuredMesh* umesh, const char* name,
+                                bench_kernel kernel, BenchResult* results,
+                                int* nresults) {
+  state->umesh = umesh;
+  for (int tt = 0; tt < config->nthread_counts; ++tt) {
+#ifdef _OPENMP
+    omp_set_num_threads(config->thread_counts[tt]);
+#endif
+    run_benchmark(config, state, name, config->thread_counts[tt], kernel,
+                  results, nresults);
+  }
+}
+
+// Gathers over differently numbered and stored copies of the unstructured
+// 3d mesh, holding only one copy at a time
+static void run_umesh_benchmarks(BenchConfig* config, BenchState* state,
+                                 BenchResult* results, int* nresults) {
+  // The same randomly numbered mesh is gathered over before and after it is
+  // renumbered, to show the effect of the ordering on locality
+  UnstructuredMesh umesh;
+  init_shuffled_umesh_3d(&state->mesh_3d, &umesh, NULL, NULL);
+  run_umesh_benchmark(config, state, &umesh, "gather_cells_to_nodes_shuffled",
+                      bench_gather_cells_to_nodes, results, nresults);
+  int* cells_old_to_new = (int*)malloc(sizeof(int) * umesh.ncells);
+  int* nodes_old_to_new = (int*)malloc(sizeof(int) * umesh.nnodes);
+  if (!cells_old_to_new || !nodes_old_to_new) {
+    TERMINATE("Could not allocate the mesh renumbering.\n");
+  }
+  renumber_unstructured_mesh(&umesh, cells_old_to_new, nodes_old_to_new);
+  free(cells_old_to_new);
+  free(nodes_old_to_new);
+  run_umesh_benchmark(config, state, &umesh,
+                      "gather_cells_to_nodes_renumbered",
+                      bench_gather_cells_to_nodes, results, nresults);
+  finalise_unstructured_mesh(&umesh);
+
+  // The converted mesh is gathered over with its connectivity stored and
+  // then computed
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, &state->mesh_3d);
+  init_umesh_geometry(&umesh);
+  run_umesh_benchmark(config, state, &umesh, "gather_cells_to_nodes_explicit",
+                      bench_gather_cells_to_nodes_accessor, results, nresults);
+  run_umesh_benchmark(config, state, &umesh, "compute_umesh_geometry_explicit",
+                      bench_compute_umesh_geometry, results, nresults);
+  run_umesh_benchmark(config, state, &umesh, "find_boundary_normals_3d",
+                      bench_find_boundary_normals_3d, results, nresults);
+
+  // The scatters race without atomics unless they run one colour at a time
+  UnstructuredColouring colouring;
+  state->colouring = &colouring;
+  colour_cells_by_nodes(&umesh, &colouring);
+  run_umesh_benchmark(config, state, &umesh, "scatter_cells_to_nodes_atomic",
+                      bench_scatter_cells_to_nodes_atomic, results, nresults);
+  run_umesh_benchmark(config, state, &umesh,
+                      "scatter_cells_to_nodes_coloured",
+                      bench_scatter_cells_to_nodes_coloured, results, nresults);
+  finalise_unstructured_colouring(&colouring);
+  colour_faces_by_cells(&umesh, &colouring);
+  run_umesh_benchmark(config, state, &umesh, "scatter_faces_to_cells_atomic",
+                      bench_scatter_faces_to_cells_atomic, results, nresults);
+  run_umesh_benchmark(config, state, &umesh,
+                      "scatter_faces_to_cells_coloured",
+                      bench_scatter_faces_to_cells_coloured, results, nresults);
+  finalise_unstructured_colouring(&colouring);
+  state->colouring = NULL;
+
+  // Each tile holds a buffered and a global index for each of its nodes
+  UnstructuredTiling tiling;
+  state->tiling = &tiling;
+  init_umesh_tiling(&umesh, &tiling, TILING_L2_BYTES,
+                    sizeof(double) + sizeof(int));
+  run_umesh_benchmark(config, state, &umesh, "gather_cells_to_nodes_tiled",
+                      bench_gather_cells_to_nodes_tiled, results, nresults);
+  run_umesh_benchmark(config, state, &umesh, "scatter_cells_to_nodes_tiled",
+                      bench_scatter_cells_to_nodes_tiled, results, nresults);
+  finalise_umesh_tiling(&tiling);
+  state->tiling = NULL;
+  finalise_unstructured_mesh(&umesh);
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_implicit_umesh_3d(&umesh, &state->mesh_3d);
+  init_umesh_geometry(&umesh);
+  run_umesh_benchmark(config, state, &umesh, "gather_cells_to_nodes_implicit",
+                      bench_gather_cells_to_nodes_accessor, results, nresults);
+  run_umesh_benchmark(config, state, &umesh, "compute_umesh_geometry_implicit",
+                      bench_compute_umesh_geometry, results, nresults);
+  finalise_unstructured_mesh(&umesh);
+}
+
+// Writes the results in JSON so that regressions can be tracked
+static void write_json(BenchConfig* config, BenchResult* results,
+                       const int nresults) {
+  FILE* fp = fopen(config->json_filename, "w");
+  if (!fp) {
+    TERMINATE("Could not open file %s\n", config->json_filename);
+  }
+
+  fprintf(fp, "{\n");
+  fprintf(fp, "  \"nranks\": %d,\n", config->nranks);
+  fprintf(fp, "  \"mesh\": [%d, %d, %d],\n", config->nx, config->ny,
+          config->nz);
+  fprintf(fp, "  \"pad\": %d,\n", config->pad);
+  fprintf(fp, "  \"warmups\": %d,\n", config->nwarmups);
+  fprintf(fp, "  \"decomposition_ranks\": %d,\n", config->decomp_nranks);
+  fprintf(fp, "  \"results\": [\n");
+  for (int ii = 0; ii < nresults; ++ii) {
+    fprintf(fp,
+            "    {\"name\": \"%s\", \"threads\": %d, \"reps\": %d, "
+            "\"min\": %.9e, \"p10\": %.9e, \"median\": %.9e, "
+            "\"p90\": %.9e, \"max\": %.9e, \"mean\": %.9e}%s\n",
+            results[ii].name, results[ii].nthreads, results[ii].nreps,
+            results[ii].min, results[ii].p10, results[ii].median,
+            results[ii].p90, results[ii].max, results[ii].mean,
+            (ii < nresults - 1) ? "," : "");
+  }
+  fprintf(fp, "  ]\n}\n");
+  fclose(fp);
+}
+
+int main(int argc, char** argv) {
+  BenchConfig config;
+  config.rank = MASTER;
+  config.nranks = 1;
+  initialise_mpi(argc, argv, &config.rank, &config.nranks);
+  parse_args(&config, argc, argv);
+
+  initialise_devices(config.rank);
+  profiler_init(&bench_profile);
+
+  BenchState state;
+  init_bench_mesh(&config, &state.mesh_2d, 2);
+  init_bench_mesh(&config, &state.mesh_3d, 3);
+  allocate_data(&state.arr_2d, state.mesh_2d.local_nx * state.mesh_2d.local_ny);
+  allocate_data(&state.arr_3d, state.mesh_3d.local_nx * state.mesh_3d.local_ny *
+                                   state.mesh_3d.local_nz);
+  state.alloc_len = (size_t)state.mesh_3d.local_nx * state.mesh_3d.local_ny *
+                    state.mesh_3d.local_nz;
+  state.decomp_nranks = config.decomp_nranks;
+  state.pack = PACK;
+
+  if (config.rank == MASTER) {
+    printf("Benchmarking %dx%dx%d mesh, pad %d, on %d ranks.\n", config.nx,
+           config.ny, config.nz, config.pad, config.nranks);
+    printf("%d warmups and %d repetitions per benchmark.\n\n",
+           config.nwarmups, config.nreps);
+    printf("%-40s%8s%14s%14s%14s\n", "Benchmark", "Threads", "Median (s)",
+           "P10 (s)", "P90 (s)");
+  }
+
+  BenchResult* results =
+      (BenchResult*)malloc(sizeof(BenchResult) * MAX_RESULTS);
+  if (!results) {
+    TERMINATE("Could not allocate benchmark results.\n");
+  }
+  int nresults = 0;
+
+  for (int tt = 0; tt < config.nthread_counts; ++tt) {
+    const int nthreads = config.thread_counts[tt];
+#ifdef _OPENMP
+    omp_set_num_threads(nthreads);
+#endif
+
+    run_benchmark(&config, &state, "allocate_data", nthreads,
+                  bench_allocate_data, results, &nresults);
+
+    state.pack = NO_PACK;
+    run_benchmark(&config, &state, "handle_boundary_2d", nthreads,
+                  bench_handle_boundary_2d, results, &nresults);
+    run_benchmark(&config, &state, "handle_boundary_3d", nthreads,
+                  bench_handle_boundary_3d, results, &nresults);
+
+#ifdef MPI
+    state.pack = PACK;
+    run_benchmark(&config, &state, "handle_boundary_2d_mpi", nthreads,
+                  bench_handle_boundary_2d, results, &nresults);
+    run_benchmark(&config, &state, "handle_boundary_3d_mpi", nthreads,
+                  bench_handle_boundary_3d, results, &nresults);
+#endif
+
+    run_benchmark(&config, &state, "convert_mesh_to_umesh_3d", nthreads,
+                  bench_convert_mesh_to_umesh_3d, results, &nresults);
+    run_benchmark(&config, &state, "decompose_2d_cartesian", nthreads,
+                  bench_decompose_2d_cartesian, results, &nresults);
+    run_benchmark(&config, &state, "decompose_3d_cartesian", nthreads,
+                  bench_decompose_3d_cartesian, results, &nresults);
+    run_benchmark(&config, &state, "reduce_all_sum", nthreads,
+                  bench_reduce_all_sum, results, &nresults);
+    run_benchmark(&config, &state, "reduce_all_min", nthreads,
+                  bench_reduce_all_min, results, &nresults);
+    run_benchmark(&config, &state, "reduce_to_master", nthreads,
+                  bench_reduce_to_master, results, &nresults);
+    run_benchmark(&config, &state, "write_to_visit_3d", nthreads,
+                  bench_write_to_visit_3d, results, &nresults);
+    run_benchmark(&config, &state, "write_all_ranks_to_visit_3d", nthreads,
+                  bench_write_all_ranks_to_visit_3d, results, &nresults);
+    run_benchmark(&config, &state, "write_to_visit_3d_async", nthreads,
+                  bench_write_to_visit_3d_async, results, &nresults);
+    flush_async_snapshots();
+    run_benchmark(&config, &state, "write_compressed_3d", nthreads,
+                  bench_write_compressed_3d, results, &nresults);
+    remove_visit_files(config.rank);
+  }
+
+  run_umesh_benchmarks(&config, &state, results, &nresults);
+
+  if (config.rank == MASTER && config.json_filename) {
+    write_json(&config, results, nresults);
+    printf("\nWrote results to %s\n", config.json_filename);
+  }
+
+  free(results);
+  finalise_async_snapshots();
+  deallocate_data(state.arr_2d);
+  deallocate_data(state.arr_3d);
+  finalise_mesh(&state.mesh_2d);
+  finalise_mesh(&state.mesh_3d);
+  finalise_comms();
+  return 0;
+}
@@ -0,0 +1,189 @@
+#include "sweeps.h"
+#include "../shared.h"
+
+// Gathers the node positions of every cell of the unstructured mesh
+void gather_cells_to_nodes(UnstructuredMesh* umesh) {
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    double sum = 0.0;
+    for (int nn = umesh->cells_to_nodes_offsets[(cc)];
+         nn < umesh->cells_to_nodes_offsets[(cc + 1)]; ++nn) {
+      sum += umesh->nodes_x0[(umesh->cells_to_nodes[(nn)])];
+    }
+    umesh->cell_centroids_x[(cc)] = sum;
+  }
+}
+
+// Gathers the node positions of every cell through the connectivity
+// accessors, which compute the nodes of an implicit mesh
+void gather_cells_to_nodes_accessor(UnstructuredMesh* umesh) {
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    int nodes[NNODES_BY_CELL];
+    double sum = 0.0;
+    const int nnodes_by_cell = umesh_cell_nodes(umesh, cc, nodes);
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      sum += umesh->nodes_x0[(nodes[nn])];
+    }
+    umesh->cell_centroids_x[(cc)] = sum;
+  }
+}
+
+// Scatters the volume of every cell evenly to its nodes with atomics
+void scatter_cells_to_nodes_atomic(UnstructuredMesh* umesh) {
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->nodes_x1[(nn)] = 0.0;
+  }
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int nodes_off = umesh->cells_to_nodes_offsets[(cc)];
+    const int nnodes_by_cell = umesh->cells_to_nodes_offsets[(cc + 1)] -
+                               nodes_off;
+    const double share = umesh->cell_volume[(cc)] / nnodes_by_cell;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+#pragma omp atomic update
+      umesh->nodes_x1[(umesh->cells_to_nodes[(nodes_off + nn)])] += share;
+    }
+  }
+}
+
+// Scatters the volume of every cell evenly to its nodes one colour at a
+// time, where no two cells of a colour share a node
+void scatter_cells_to_nodes_coloured(UnstructuredMesh* umesh,
+                                     const UnstructuredColouring* colouring) {
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->nodes_x1[(nn)] = 0.0;
+  }
+  for (int colour = 0; colour < colouring->ncolours; ++colour) {
+#pragma omp parallel for
+    for (int ii = colouring->colour_offsets[(colour)];
+         ii < colouring->colour_offsets[(colour + 1)]; ++ii) {
+      const int cc = colouring->colour_list[(ii)];
+      const int nodes_off = umesh->cells_to_nodes_offsets[(cc)];
+      const int nnodes_by_cell = umesh->cells_to_nodes_offsets[(cc + 1)] -
+                                 nodes_off;
+      const double share = umesh->cell_volume[(cc)] / nnodes_by_cell;
+      for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+        umesh->nodes_x1[(umesh->cells_to_nodes[(nodes_off + nn)])] += share;
+      }
+    }
+  }
+}
+
+// Scatters the area of every face into and out of its cells with atomics
+void scatter_faces_to_cells_atomic(UnstructuredMesh* umesh) {
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    umesh->cell_centroids_x[(cc)] = 0.0;
+  }
+#pragma omp parallel for
+  for (int ff = 0; ff < umesh->nfaces; ++ff) {
+    const int cell0 = umesh->faces_to_cells0[(ff)];
+    const int cell1 = umesh->faces_to_cells1[(ff)];
+    if (cell0 != -1) {
+#pragma omp atomic update
+      umesh->cell_centroids_x[(cell0)] -= umesh->face_area[(ff)];
+    }
+    if (cell1 != -1) {
+#pragma omp atomic update
+      umesh->cell_centroids_x[(cell1)] += umesh->face_area[(ff)];
+    }
+  }
+}
+
+// Scatters the area of every face into and out of its cells one colour at a
+// time, where no two faces of a colour share a cell
+void scatter_faces_to_cells_coloured(UnstructuredMesh* umesh,
+                                     const UnstructuredColouring* colouring) {
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    umesh->cell_centroids_x[(cc)] = 0.0;
+  }
+  for (int colour = 0; colour < colouring->ncolours; ++colour) {
+#pragma omp parallel for
+    for (int ii = colouring->colour_offsets[(colour)];
+         ii < colouring->colour_offsets[(colour + 1)]; ++ii) {
+      const int ff = colouring->colour_list[(ii)];
+      const int cell0 = umesh->faces_to_cells0[(ff)];
+      const int cell1 = umesh->faces_to_cells1[(ff)];
+      if (cell0 != -1) {
+        umesh->cell_centroids_x[(cell0)] -= umesh->face_area[(ff)];
+      }
+      if (cell1 != -1) {
+        umesh->cell_centroids_x[(cell1)] += umesh->face_area[(ff)];
+      }
+    }
+  }
+}
+
+// Gathers the node positions of each tile into a buffer once, and then
+// gathers the positions of its cells from the buffer
+void gather_cells_to_nodes_tiled(UnstructuredMesh* umesh,
+                                 const UnstructuredTiling* tiling) {
+#pragma omp parallel
+  {
+    double* buffer;
+    allocate_data(&buffer, tiling->max_tile_nnodes);
+#pragma omp for
+    for (int tt = 0; tt < tiling->ntiles; ++tt) {
+      const int nodes_off = tiling->tiles_to_nodes_offsets[(tt)];
+      const int nnodes = tiling->tiles_to_nodes_offsets[(tt + 1)] - nodes_off;
+      for (int nn = 0; nn < nnodes; ++nn) {
+        buffer[(nn)] =
+            umesh->nodes_x0[(tiling->tiles_to_nodes[(nodes_off + nn)])];
+      }
+      for (int cc = tiling->tiles_to_cells_offsets[(tt)];
+           cc < tiling->tiles_to_cells_offsets[(tt + 1)]; ++cc) {
+        double sum = 0.0;
+        for (int nn = umesh->cells_to_nodes_offsets[(cc)];
+             nn < umesh->cells_to_nodes_offsets[(cc + 1)]; ++nn) {
+          sum += buffer[(tiling->cells_to_local_nodes[(nn)])];
+        }
+        umesh->cell_centroids_x[(cc)] = sum;
+      }
+    }
+    deallocate_data(buffer);
+  }
+}
+
+// Scatters the volume of every cell evenly to its nodes in a buffer for each
+// tile, and then adds the buffer to the nodes with atomics, as the nodes on
+// the edges of the tiles are shared
+void scatter_cells_to_nodes_tiled(UnstructuredMesh* umesh,
+                                  const UnstructuredTiling* tiling) {
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->nodes_x1[(nn)] = 0.0;
+  }
+#pragma omp parallel
+  {
+    double* buffer;
+    allocate_data(&buffer, tiling->max_tile_nnodes);
+#pragma omp for
+    for (int tt = 0; tt < tiling->ntiles; ++tt) {
+      const int nodes_off = tiling->tiles_to_nodes_offsets[(tt)];
+      const int nnodes = tiling->tiles_to_nodes_offsets[(tt + 1)] - nodes_off;
+      for (int nn = 0; nn < nnodes; ++nn) {
+        buffer[(nn)] = 0.0;
+      }
+      for (int cc = tiling->tiles_to_cells_offsets[(tt)];
+           cc < tiling->tiles_to_cells_offsets[(tt + 1)]; ++cc) {
+        const int cell_off = umesh->cells_to_nodes_offsets[(cc)];
+        const int nnodes_by_cell =
+            umesh->cells_to_nodes_offsets[(cc + 1)] - cell_off;
+        const double share = umesh->cell_volume[(cc)] / nnodes_by_cell;
+        for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+          buffer[(tiling->cells_to_local_nodes[(cell_off + nn)])] += share;
+        }
+      }
+      for (int nn = 0; nn < nnodes; ++nn) {
+#pragma omp atomic update
+        umesh->nodes_x1[(tiling->tiles_to_nodes[(nodes_off + nn)])] +=
+            buffer[(nn)];
+      }
+    }
+    deallocate_data(buffer);
+  }
+}
@@ -0,0 +1,57 @@
+#ifndef __SWEEPSHDR
+#define __SWEEPSHDR
+
+#include "../colour.h"
+#include "../tiling.h"
+#include "../umesh.h"
+
+/*
+ *    UNSTRUCTURED SWEEPS
+ *    The gathers and scatters over the unstructured mesh that the harness
+ *    times, shared with the tests that check the colourings and tiles give
+ *    the same results as the atomic sweeps.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gathers the node positions of every cell of the unstructured mesh
+void gather_cells_to_nodes(UnstructuredMesh* umesh);
+
+// Gathers the node positions of every cell through the connectivity
+// accessors, which compute the nodes of an implicit mesh
+void gather_cells_to_nodes_accessor(UnstructuredMesh* umesh);
+
+// Scatters the volume of every cell evenly to its nodes with atomics
+void scatter_cells_to_nodes_atomic(UnstructuredMesh* umesh);
+
+// Scatters the volume of every cell evenly to its nodes one colour at a
+// time, where no two cells of a colour share a node
+void scatter_cells_to_nodes_coloured(UnstructuredMesh* umesh,
+                                     const UnstructuredColouring* colouring);
+
+// Scatters the area of every face into and out of its cells with atomics
+void scatter_faces_to_cells_atomic(UnstructuredMesh* umesh);
+
+// Scatters the area of every face into and out of its cells one colour at a
+// time, where no two faces of a colour share a cell
+void scatter_faces_to_cells_coloured(UnstructuredMesh* umesh,
+                                     const UnstructuredColouring* colouring);
+
+// Gathers the node positions of each tile into a buffer once, and then
+// gathers the positions of its cells from the buffer
+void gather_cells_to_nodes_tiled(UnstructuredMesh* umesh,
+                                 const UnstructuredTiling* tiling);
+
+// Scatters the volume of every cell evenly to its nodes in a buffer for each
+// tile, and then adds the buffer to the nodes with atomics, as the nodes on
+// the edges of the tiles are shared
+void scatter_cells_to_nodes_tiled(UnstructuredMesh* umesh,
+                                  const UnstructuredTiling* tiling);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
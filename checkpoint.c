@@ -0,0 +1,380 @@
+#include "checkpoint.h"
+#include "shared.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC "ARCHCKP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_ALIGN 64      // Alignment of the arrays in the file
+#define CHECKPOINT_MAX_ARRAYS 64 // Most arrays held by a single checkpoint
+#define ENDIAN_MARKER 0x01020304
+
+// The header at the start of each rank's checkpoint
+typedef struct {
+  char magic[8];
+  uint32_t endian;
+  uint32_t version;
+  int32_t rank;
+  int32_t nranks;
+  int32_t step;
+  int32_t narrays;
+  double time;
+
+  // The mesh state that is not held in arrays
+  int32_t local_nx;
+  int32_t local_ny;
+  int32_t local_nz;
+  int32_t x_off;
+  int32_t y_off;
+  int32_t z_off;
+  int32_t niters;
+  int32_t has_umesh;
+  double dt;
+  double dt_h;
+  double max_dt;
+  double sim_end;
+} CheckpointHeader;
+
+// The table entry describing an array and its checksum
+typedef struct {
+  char name[CHECKPOINT_MAX_NAME];
+  uint64_t offset;
+  uint64_t nbytes;
+  uint64_t checksum;
+} CheckpointArray;
+
+// An array of the live state to be saved or restored
+typedef struct {
+  const char* name;
+  void* data;
+  uint64_t nbytes;
+} StateArray;
+
+// Hashes a buffer a word at a time, mixing the tail bytes in last
+static uint64_t checksum(const void* data, const uint64_t nbytes) {
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t hash = 0x9e3779b97f4a7c15ULL ^ nbytes;
+  uint64_t ii = 0;
+  for (; ii + sizeof(uint64_t) <= nbytes; ii += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, &bytes[ii], sizeof(uint64_t));
+    hash = (hash ^ word) * 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 32;
+  }
+  for (; ii < nbytes; ++ii) {
+    hash = (hash ^ bytes[ii]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Adds an array to the state if it has been allocated
+static void add_state_array(StateArray* arrays, int* narrays, const char* name,
+                            void* data, const uint64_t nbytes) {
+  if (!data || !nbytes) {
+    return;
+  }
+
+  // Arrays that share storage are only saved once
+  for (int aa = 0; aa < *narrays; ++aa) {
+    if (arrays[aa].data == data) {
+      return;
+    }
+  }
+  if (*narrays >= CHECKPOINT_MAX_ARRAYS) {
+    TERMINATE("Exceeded the maximum number of checkpointed arrays %d.\n",
+              CHECKPOINT_MAX_ARRAYS);
+  }
+  arrays[*narrays].name = name;
+  arrays[*narrays].data = data;
+  arrays[*narrays].nbytes = nbytes;
+  (*narrays)++;
+}
+
+// Adds an offsets array and the connectivity that it indexes
+static void add_connectivity(StateArray* arrays, int* narrays,
+                             const char* offsets_name, int* offsets,
+                             const char* name, int* data, const int n) {
+  if (!offsets) {
+    return;
+  }
+  add_state_array(arrays, narrays, offsets_name, offsets,
+                  sizeof(int) * (n + 1));
+  add_state_array(arrays, narrays, name, data, sizeof(int) * offsets[n]);
+}
+
+// Lists the arrays that make up the state of a rank
+static int list_state_arrays(Mesh* mesh, SharedData* shared_data,
+                             UnstructuredMesh* umesh, StateArray* arrays) {
+  int narrays = 0;
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int nz = (mesh->ndims == 3) ? mesh->local_nz : 1;
+  const uint64_t ncells = (uint64_t)nx * ny * nz;
+  const uint64_t nnodes = (mesh->ndims == 3)
+                              ? (uint64_t)(nx + 1) * (ny + 1) * (nz + 1)
+                              : (uint64_t)(nx + 1) * (ny + 1);
+  const uint64_t d = sizeof(double);
+
+  add_state_array(arrays, &narrays, "edgex", mesh->edgex, d * (nx + 1));
+  add_state_array(arrays, &narrays, "edgey", mesh->edgey, d * (ny + 1));
+  add_state_array(arrays, &narrays, "edgedx", mesh->edgedx, d * (nx + 1));
+  add_state_array(arrays, &narrays, "edgedy", mesh->edgedy, d * (ny + 1));
+  add_state_array(arrays, &narrays, "celldx", mesh->celldx, d * nx);
+  add_state_array(arrays, &narrays, "celldy", mesh->celldy, d * ny);
+  if (mesh->ndims == 3) {
+    add_state_array(arrays, &narrays, "edgez", mesh->edgez, d * (nz + 1));
+    add_state_array(arrays, &narrays, "edgedz", mesh->edgedz, d * (nz + 1));
+    add_state_array(arrays, &narrays, "celldz", mesh->celldz, d * nz);
+  }
+
+  if (shared_data) {
+    add_state_array(arrays, &narrays, "density", shared_data->density,
+                    d * ncells);
+    add_state_array(arrays, &narrays, "energy", shared_data->energy,
+                    d * ncells);
+    add_state_array(arrays, &narrays, "density_old", shared_data->density_old,
+                    d * ncells);
+    add_state_array(arrays, &narrays, "r", shared_data->r, d * ncells);
+    add_state_array(arrays, &narrays, "s_x", shared_data->s_x, d * nnodes);
+    add_state_array(arrays, &narrays, "s_y", shared_data->s_y, d * nnodes);
+    add_state_array(arrays, &narrays, "temperature", shared_data->temperature,
+                    d * nnodes);
+
+    // Only 3d meshes have s_z, and the 3d pressure is allocated separately at
+    // the size of the nodes, taking the place of the conjugate vector
+    if (mesh->ndims == 3) {
+      add_state_array(arrays, &narrays, "s_z", shared_data->s_z, d * nnodes);
+      add_state_array(arrays, &narrays, "pressure", shared_data->pressure,
+                      d * nnodes);
+    } else {
+      add_state_array(arrays, &narrays, "p", shared_data->p, d * nnodes);
+    }
+  }
+
+  if (umesh) {
+    const uint64_t nn = umesh->nnodes;
+    const uint64_t nc = umesh->ncells;
+    const uint64_t nf = umesh->nfaces;
+    const uint64_t nb = umesh->nboundary_nodes;
+    add_state_array(arrays, &narrays, "nodes_x0", umesh->nodes_x0, d * nn);
+    add_state_array(arrays, &narrays, "nodes_y0", umesh->nodes_y0, d * nn);
+    add_state_array(arrays, &narrays, "nodes_z0", umesh->nodes_z0, d * nn);
+    add_state_array(arrays, &narrays, "nodes_x1", umesh->nodes_x1, d * nn);
+    add_state_array(arrays, &narrays, "nodes_y1", umesh->nodes_y1, d * nn);
+    add_state_array(arrays, &narrays, "nodes_z1", umesh->nodes_z1, d * nn);
+    add_state_array(arrays, &narrays, "cell_centroids_x",
+                    umesh->cell_centroids_x, d * nc);
+    add_state_array(arrays, &narrays, "cell_centroids_y",
+                    umesh->cell_centroids_y, d * nc);
+    add_state_array(arrays, &narrays, "cell_centroids_z",
+                    umesh->cell_centroids_z, d * nc);
+    add_state_array(arrays, &narrays, "boundary_index", umesh->boundary_index,
+                    sizeof(int) * nn);
+    add_state_array(arrays, &narrays, "boundary_type", umesh->boundary_type,
+                    sizeof(int) * nb);
+    add_state_array(arrays, &narrays, "boundary_normal_x",
+                    umesh->boundary_normal_x, d * nb);
+    add_state_array(arrays, &narrays, "boundary_normal_y",
+                    umesh->boundary_normal_y, d * nb);
+    add_state_array(arrays, &narrays, "boundary_normal_z",
+                    umesh->boundary_normal_z, d * nb);
+    add_state_array(arrays, &narrays, "faces_to_cells0", umesh->faces_to_cells0,
+                    sizeof(int) * nf);
+    add_state_array(arrays, &narrays, "faces_to_cells1", umesh->faces_to_cells1,
+                    sizeof(int) * nf);
+    add_state_array(arrays, &narrays, "faces_cclockwise_cell",
+                    umesh->faces_cclockwise_cell, sizeof(int) * nf);
+    add_connectivity(arrays, &narrays, "nodes_to_cells_offsets",
+                     umesh->nodes_to_cells_offsets, "nodes_to_cells",
+                     umesh->nodes_to_cells, umesh->nnodes);
+    add_connectivity(arrays, &narrays, "cells_to_nodes_offsets",
+                     umesh->cells_to_nodes_offsets, "cells_to_nodes",
+                     umesh->cells_to_nodes, umesh->ncells);
+    add_connectivity(arrays, &narrays, "nodes_to_nodes_offsets",
+                     umesh->nodes_to_nodes_offsets, "nodes_to_nodes",
+                     umesh->nodes_to_nodes, umesh->nnodes);
+    add_connectivity(arrays, &narrays, "faces_to_nodes_offsets",
+                     umesh->faces_to_nodes_offsets, "faces_to_nodes",
+                     umesh->faces_to_nodes, umesh->nfaces);
+    add_connectivity(arrays, &narrays, "cells_to_faces_offsets",
+                     umesh->cells_to_faces_offsets, "cells_to_faces",
+                     umesh->cells_to_faces, umesh->ncells);
+    add_connectivity(arrays, &narrays, "nodes_to_faces_offsets",
+                     umesh->nodes_to_faces_offsets, "nodes_to_faces",
+                     umesh->nodes_to_faces, umesh->nnodes);
+    add_connectivity(arrays, &narrays, "cells_to_cells_offsets",
+                     umesh->cells_to_cells_offsets, "cells_to_cells",
+                     umesh->cells_to_cells, umesh->ncells);
+  }
+
+  return narrays;
+}
+
+// The name of the checkpoint file belonging to a rank
+static void checkpoint_filename(const char* name, const int rank,
+                                char* filename) {
+  sprintf(filename, "%s.%d.ckpt", name, rank);
+}
+
+// Writes the state of this rank to its own checkpoint file
+void write_checkpoint(const char* name, const int step, const double time,
+                      Mesh* mesh, SharedData* shared_data,
+                      UnstructuredMesh* umesh) {
+  StateArray arrays[CHECKPOINT_MAX_ARRAYS];
+  const int narrays = list_state_arrays(mesh, shared_data, umesh, arrays);
+
+  CheckpointHeader header;
+  memset(&header, 0, sizeof(CheckpointHeader));
+  memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+  header.endian = ENDIAN_MARKER;
+  header.version = CHECKPOINT_VERSION;
+  header.rank = mesh->rank;
+  header.nranks = mesh->nranks;
+  header.step = step;
+  header.narrays = narrays;
+  header.time = time;
+  header.local_nx = mesh->local_nx;
+  header.local_ny = mesh->local_ny;
+  header.local_nz = mesh->local_nz;
+  header.x_off = mesh->x_off;
+  header.y_off = mesh->y_off;
+  header.z_off = mesh->z_off;
+  header.niters = mesh->niters;
+  header.has_umesh = (umesh != NULL);
+  header.dt = mesh->dt;
+  header.dt_h = mesh->dt_h;
+  header.max_dt = mesh->max_dt;
+  header.sim_end = mesh->sim_end;
+
+  // The checksums are independent so are computed in parallel
+  CheckpointArray table[CHECKPOINT_MAX_ARRAYS];
+  memset(table, 0, sizeof(table));
+  uint64_t offset =
+      sizeof(CheckpointHeader) + sizeof(CheckpointArray) * narrays;
+  for (int aa = 0; aa < narrays; ++aa) {
+    strncpy(table[aa].name, arrays[aa].name, CHECKPOINT_MAX_NAME - 1);
+    offset = (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN *
+             CHECKPOINT_ALIGN;
+    table[aa].offset = offset;
+    table[aa].nbytes = arrays[aa].nbytes;
+    offset += arrays[aa].nbytes;
+  }
+#pragma omp parallel for schedule(dynamic)
+  for (int aa = 0; aa < narrays; ++aa) {
+    table[aa].checksum = checksum(arrays[aa].data, arrays[aa].nbytes);
+  }
+
+  // Write to a temporary file so a failure never leaves a partial checkpoint
+  char filename[MAX_STR_LEN];
+  char tmpname[MAX_STR_LEN + 4];
+  checkpoint_filename(name, mesh->rank, filename);
+  sprintf(tmpname, "%s.tmp", filename);
+  FILE* fp = fopen(tmpname, "wb");
+  if (!fp) {
+    TERMINATE("Could not open file %s\n", tmpname);
+  }
+
+  const char zeros[CHECKPOINT_ALIGN] = {0};
+  int failed = fwrite(&header, sizeof(CheckpointHeader), 1, fp) != 1 ||
+               fwrite(table, sizeof(CheckpointArray), narrays, fp) !=
+                   (size_t)narrays;
+  uint64_t pos = sizeof(CheckpointHeader) + sizeof(CheckpointArray) * narrays;
+  for (int aa = 0; aa < narrays && !failed; ++aa) {
+    fwrite(zeros, 1, table[aa].offset - pos, fp);
+    failed = fwrite(arrays[aa].data, 1, arrays[aa].nbytes, fp) !=
+             arrays[aa].nbytes;
+    pos = table[aa].offset + arrays[aa].nbytes;
+  }
+  failed |= fflush(fp) || fsync(fileno(fp));
+  fclose(fp);
+  if (failed || rename(tmpname, filename)) {
+    TERMINATE("Could not write the checkpoint %s\n", filename);
+  }
+}
+
+// Restores the state of this rank from its checkpoint file, terminating if
+// the file does not match the initialised state or fails its checksums
+void read_checkpoint(const char* name, Mesh* mesh, SharedData* shared_data,
+                     UnstructuredMesh* umesh, int* step, double* time) {
+  char filename[MAX_STR_LEN];
+  checkpoint_filename(name, mesh->rank, filename);
+
+  const int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st)) {
+    TERMINATE("Could not open the checkpoint %s\n", filename);
+  }
+  const size_t len = st.st_size;
+  void* map = (len >= sizeof(CheckpointHeader))
+                  ? mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0)
+                  : MAP_FAILED;
+  close(fd);
+  if (map == MAP_FAILED) {
+    TERMINATE("Could not map the checkpoint %s\n", filename);
+  }
+
+  const CheckpointHeader* header = (const CheckpointHeader*)map;
+  if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) ||
+      header->endian != ENDIAN_MARKER ||
+      header->version != CHECKPOINT_VERSION) {
+    TERMINATE("%s is not a compatible checkpoint.\n", filename);
+  }
+
+  // The decomposition must be identical for the state to be restored
+  if (header->rank != mesh->rank || header->nranks != mesh->nranks ||
+      header->local_nx != mesh->local_nx ||
+      header->local_ny != mesh->local_ny ||
+      header->local_nz != mesh->local_nz || header->x_off != mesh->x_off ||
+      header->y_off != mesh->y_off || header->z_off != mesh->z_off ||
+      header->has_umesh != (umesh != NULL)) {
+    TERMINATE("The checkpoint %s was written by a different decomposition.\n",
+              filename);
+  }
+
+  StateArray arrays[CHECKPOINT_MAX_ARRAYS];
+  const int narrays = list_state_arrays(mesh, shared_data, umesh, arrays);
+  const CheckpointArray* table =
+      (const CheckpointArray*)((const char*)map + sizeof(CheckpointHeader));
+  if (header->narrays != narrays ||
+      sizeof(CheckpointHeader) + sizeof(CheckpointArray) * narrays > len) {
+    TERMINATE("The checkpoint %s holds different state.\n", filename);
+  }
+  for (int aa = 0; aa < narrays; ++aa) {
+    if (strncmp(table[aa].name, arrays[aa].name, CHECKPOINT_MAX_NAME) ||
+        table[aa].nbytes != arrays[aa].nbytes ||
+        table[aa].offset + table[aa].nbytes > len) {
+      TERMINATE("The checkpoint %s holds different state for %s.\n", filename,
+                arrays[aa].name);
+    }
+  }
+
+  // Verify and copy the arrays out of the mapping in parallel
+  int nfailed = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+ : nfailed)
+  for (int aa = 0; aa < narrays; ++aa) {
+    const char* data = (const char*)map + table[aa].offset;
+    if (checksum(data, table[aa].nbytes) != table[aa].checksum) {
+      nfailed++;
+      continue;
+    }
+    memcpy(arrays[aa].data, data, table[aa].nbytes);
+  }
+  if (nfailed) {
+    TERMINATE("%d arrays in the checkpoint %s failed their checksums.\n",
+              nfailed, filename);
+  }
+
+  mesh->niters = header->niters;
+  mesh->dt = header->dt;
+  mesh->dt_h = header->dt_h;
+  mesh->max_dt = header->max_dt;
+  mesh->sim_end = header->sim_end;
+  *step = header->step;
+  *time = header->time;
+  munmap(map, len);
+}
@@ -0,0 +1,37 @@
+#ifndef __CHECKPOINTHDR
+#define __CHECKPOINTHDR
+
+#include "mesh.h"
+#include "shared_data.h"
+#include "umesh.h"
+
+/*
+ *    CHECKPOINT AND RESTART
+ *    Each rank writes its own file holding the mesh, shared data and,
+ *    optionally, unstructured mesh state, with a checksum per array. To
+ *    restart, the run is initialised as normal on the same number of ranks
+ *    and the state is then restored in place from the mapped files. The
+ *    state must be resident on the host.
+ */
+
+#define CHECKPOINT_MAX_NAME 32 // Longest name of a checkpointed array
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Writes the state of this rank to its own checkpoint file
+void write_checkpoint(const char* name, const int step, const double time,
+                      Mesh* mesh, SharedData* shared_data,
+                      UnstructuredMesh* umesh);
+
+// Restores the state of this rank from its checkpoint file, terminating if
+// the file does not match the initialised state or fails its checksums
+void read_checkpoint(const char* name, Mesh* mesh, SharedData* shared_data,
+                     UnstructuredMesh* umesh, int* step, double* time);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
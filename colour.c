@@ -0,0 +1,261 @@
+#include "colour.h"
+#include "shared.h"
+#include <stdint.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define COLOUR_MASK_BITS 64 // Colours tested at once for being taken
+
+// Tests whether an entity beats its uncoloured neighbours, or finds the
+// smallest colour that its neighbours have not taken
+typedef int (*colour_visitor)(const UnstructuredMesh* umesh, const int index,
+                              const int* colours);
+
+// The priority of an entity, with ties broken by index
+static inline uint32_t colour_priority(const uint32_t index) {
+  uint32_t hash = index;
+  hash ^= hash >> 16;
+  hash *= 0x7feb352dU;
+  hash ^= hash >> 15;
+  hash *= 0x846ca68bU;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+// Whether an entity has a higher priority than an uncoloured neighbour
+static inline int beats(const int index, const int neighbour,
+                        const int* colours) {
+  if (neighbour == index || colours[(neighbour)] != -1) {
+    return 1;
+  }
+  const uint32_t priority = colour_priority(index);
+  const uint32_t neighbour_priority = colour_priority(neighbour);
+  return (priority > neighbour_priority) ||
+         (priority == neighbour_priority && index > neighbour);
+}
+
+// Marks the colour of a neighbour in the window of colours from base
+static inline void mark_taken(const int neighbour, const int* colours,
+                              const int base, uint64_t* taken) {
+  const int colour = colours[(neighbour)] - base;
+  if (colour >= 0 && colour < COLOUR_MASK_BITS) {
+    *taken |= (uint64_t)1 << colour;
+  }
+}
+
+// The first colour at or above base that is not taken, or -1 if the window
+// is full
+static inline int first_free(const int base, const uint64_t taken) {
+  for (int bb = 0; bb < COLOUR_MASK_BITS; ++bb) {
+    if (!(taken & ((uint64_t)1 << bb))) {
+      return base + bb;
+    }
+  }
+  return -1;
+}
+
+// Whether a cell beats all of the uncoloured cells sharing its nodes
+static int cell_beats_neighbours(const UnstructuredMesh* umesh,
+                                 const int cc, const int* colours) {
+  for (int nn = 0; nn < umesh_cell_nnodes(umesh, cc); ++nn) {
+    const int node_index = umesh_cell_node(umesh, cc, nn);
+    for (int ll = 0; ll < umesh_node_ncells(umesh, node_index); ++ll) {
+      if (!beats(cc, umesh_node_cell(umesh, node_index, ll), colours)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// The smallest colour not taken by the cells sharing the nodes of a cell
+static int cell_free_colour(const UnstructuredMesh* umesh, const int cc,
+                            const int* colours) {
+  for (int base = 0;; base += COLOUR_MASK_BITS) {
+    uint64_t taken = 0;
+    for (int nn = 0; nn < umesh_cell_nnodes(umesh, cc); ++nn) {
+      const int node_index = umesh_cell_node(umesh, cc, nn);
+      for (int ll = 0; ll < umesh_node_ncells(umesh, node_index); ++ll) {
+        mark_taken(umesh_node_cell(umesh, node_index, ll), colours, base,
+                   &taken);
+      }
+    }
+    const int colour = first_free(base, taken);
+    if (colour != -1) {
+      return colour;
+    }
+  }
+}
+
+// Whether a face beats all of the uncoloured faces sharing its cells
+static int face_beats_neighbours(const UnstructuredMesh* umesh,
+                                 const int ff, const int* colours) {
+  for (int side = 0; side < 2; ++side) {
+    const int cell_index = umesh_face_cell(umesh, ff, side);
+    if (cell_index == -1) {
+      continue;
+    }
+    for (int ll = 0; ll < umesh_cell_nfaces(umesh, cell_index); ++ll) {
+      if (!beats(ff, umesh_cell_face(umesh, cell_index, ll), colours)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+// The smallest colour not taken by the faces sharing the cells of a face
+static int face_free_colour(const UnstructuredMesh* umesh, const int ff,
+                            const int* colours) {
+  for (int base = 0;; base += COLOUR_MASK_BITS) {
+    uint64_t taken = 0;
+    for (int side = 0; side < 2; ++side) {
+      const int cell_index = umesh_face_cell(umesh, ff, side);
+      if (cell_index == -1) {
+        continue;
+      }
+      for (int ll = 0; ll < umesh_cell_nfaces(umesh, cell_index); ++ll) {
+        mark_taken(umesh_cell_face(umesh, cell_index, ll), colours, base,
+                   &taken);
+      }
+    }
+    const int colour = first_free(base, taken);
+    if (colour != -1) {
+      return colour;
+    }
+  }
+}
+
+// Lists the entities by colour with a counting sort over contiguous blocks,
+// so each colour lists its entities in ascending order without sorting
+static void list_by_colour(const int n, UnstructuredColouring* colouring) {
+  const int ncolours = colouring->ncolours;
+  int nblocks = 1;
+#ifdef _OPENMP
+  nblocks = omp_get_max_threads();
+#endif
+  int* block_offsets = (int*)calloc((size_t)nblocks * ncolours, sizeof(int));
+  if (!block_offsets) {
+    TERMINATE("Failed to allocate the colour counts.\n");
+  }
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nblocks; ++bb) {
+    int* counts = &block_offsets[bb * ncolours];
+    for (int ii = (long long)n * bb / nblocks;
+         ii < (long long)n * (bb + 1) / nblocks; ++ii) {
+      counts[(colouring->colours[(ii)])]++;
+    }
+  }
+
+  // Each block starts after the earlier colours and the earlier blocks of
+  // its own colour
+  int offset = 0;
+  for (int colour = 0; colour < ncolours; ++colour) {
+    colouring->colour_offsets[(colour)] = offset;
+    for (int bb = 0; bb < nblocks; ++bb) {
+      const int count = block_offsets[bb * ncolours + colour];
+      block_offsets[bb * ncolours + colour] = offset;
+      offset += count;
+    }
+  }
+  colouring->colour_offsets[(ncolours)] = offset;
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nblocks; ++bb) {
+    int* cursors = &block_offsets[bb * ncolours];
+    for (int ii = (long long)n * bb / nblocks;
+         ii < (long long)n * (bb + 1) / nblocks; ++ii) {
+      colouring->colour_list[(cursors[(colouring->colours[(ii)])]++)] = ii;
+    }
+  }
+
+  free(block_offsets);
+}
+
+// Colours the entities in rounds, where the entities chosen in a round are
+// never neighbours so each reads only the colours of earlier rounds, and
+// then lists them by colour
+static size_t colour_entities(const UnstructuredMesh* umesh, const int n,
+                              colour_visitor beats_neighbours,
+                              colour_visitor free_colour,
+                              UnstructuredColouring* colouring) {
+  colouring->nentities = n;
+  size_t allocated = allocate_int_data(&colouring->colours, n);
+  int* chosen;
+  allocate_int_data(&chosen, n);
+
+#pragma omp parallel for
+  for (int ii = 0; ii < n; ++ii) {
+    colouring->colours[(ii)] = -1;
+  }
+
+  int nremaining = n;
+  while (nremaining > 0) {
+#pragma omp parallel for
+    for (int ii = 0; ii < n; ++ii) {
+      chosen[(ii)] = (colouring->colours[(ii)] == -1) &&
+                     beats_neighbours(umesh, ii, colouring->colours);
+    }
+
+    int ncoloured = 0;
+#pragma omp parallel for reduction(+ : ncoloured)
+    for (int ii = 0; ii < n; ++ii) {
+      if (chosen[(ii)]) {
+        colouring->colours[(ii)] = free_colour(umesh, ii, colouring->colours);
+        ncoloured++;
+      }
+    }
+    nremaining -= ncoloured;
+  }
+
+  int max_colour = -1;
+#pragma omp parallel for reduction(max : max_colour)
+  for (int ii = 0; ii < n; ++ii) {
+    max_colour = max(max_colour, colouring->colours[(ii)]);
+  }
+  colouring->ncolours = max_colour + 1;
+
+  allocated += allocate_int_data(&colouring->colour_offsets,
+                                 colouring->ncolours + 1);
+  allocated += allocate_int_data(&colouring->colour_list, n);
+  list_by_colour(n, colouring);
+
+  deallocate_int_data(chosen);
+  return allocated;
+}
+
+// Colours the cells so that no two cells of a colour share a node,
+// returning the bytes allocated
+size_t colour_cells_by_nodes(const UnstructuredMesh* umesh,
+                             UnstructuredColouring* colouring) {
+  REQUIRE_HOST_DATA();
+
+  if (!umesh->implicit && !umesh->nodes_to_cells_offsets) {
+    TERMINATE("Colouring the cells needs the cells surrounding nodes.\n");
+  }
+  return colour_entities(umesh, umesh->ncells, cell_beats_neighbours,
+                         cell_free_colour, colouring);
+}
+
+// Colours the faces so that no two faces of a colour share a cell,
+// returning the bytes allocated
+size_t colour_faces_by_cells(const UnstructuredMesh* umesh,
+                             UnstructuredColouring* colouring) {
+  REQUIRE_HOST_DATA();
+
+  if (!umesh->implicit && !umesh->cells_to_faces_offsets) {
+    TERMINATE("Colouring the faces needs the faces of the cells.\n");
+  }
+  return colour_entities(umesh, umesh->nfaces, face_beats_neighbours,
+                         face_free_colour, colouring);
+}
+
+// Deallocates the colouring
+void finalise_unstructured_colouring(UnstructuredColouring* colouring) {
+  deallocate_int_data(colouring->colours);
+  deallocate_int_data(colouring->colour_offsets);
+  deallocate_int_data(colouring->colour_list);
+}
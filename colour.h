@@ -0,0 +1,48 @@
+#ifndef __COLOURHDR
+#define __COLOURHDR
+
+#include "umesh.h"
+#include <stdlib.h>
+
+/*
+ *    UNSTRUCTURED MESH COLOURING
+ *    Groups the cells or faces of a mesh into colours, so that the entities
+ *    of one colour can scatter to their nodes or cells in parallel without
+ *    atomics. The colours are found by Jones-Plassmann, where each round
+ *    colours the entities whose hashed priority beats that of all of their
+ *    uncoloured neighbours with the smallest colour that their neighbours
+ *    have not taken. The result does not depend on the number of threads.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The entities of a mesh listed by colour, where no two entities of a colour
+// conflict
+typedef struct {
+  int nentities;
+  int ncolours;
+  int* colours;        // The colour of each entity
+  int* colour_offsets; // Offsets into the list by colour
+  int* colour_list;    // The entities of each colour in ascending order
+} UnstructuredColouring;
+
+// Colours the cells so that no two cells of a colour share a node,
+// returning the bytes allocated
+size_t colour_cells_by_nodes(const UnstructuredMesh* umesh,
+                             UnstructuredColouring* colouring);
+
+// Colours the faces so that no two faces of a colour share a cell,
+// returning the bytes allocated
+size_t colour_faces_by_cells(const UnstructuredMesh* umesh,
+                             UnstructuredColouring* colouring);
+
+// Deallocates the colouring
+void finalise_unstructured_colouring(UnstructuredColouring* colouring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #include "comms.h"
 #include "shared.h"
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -184,6 +185,29 @@ void wait_on_messages(const int nmessages) {
 #endif
 }
 
+// Determines the bytes moved by packing, unpacking and reflecting the halos
+double halo_traffic_2d(const int nx, const int ny, Mesh* mesh, const int pack) {
+  const int pad = mesh->pad;
+  const double ns_face = (double)(nx - 2 * pad) * pad;
+  const double ew_face = (double)(ny - 2 * pad) * pad;
+
+  double nelements = 0.0;
+  for (int ii = NORTH; ii <= WEST; ++ii) {
+    const double face = (ii == NORTH || ii == SOUTH) ? ns_face : ew_face;
+    if (mesh->neighbours[ii] == EDGE) {
+      // Reflection reads and writes every halo element
+      nelements += 2.0 * face;
+    } else if (pack) {
+#ifdef MPI
+      // Packing and unpacking each read and write every halo element
+      nelements += 4.0 * face;
+#endif
+    }
+  }
+
+  return nelements * sizeof(double);
+}
+
 // Decomposes the ranks, potentially load balancing and minimising the
 // ratio of perimeter to area
 void decompose_2d_cartesian(const int rank, const int nranks,
@@ -294,38 +318,31 @@ void decompose_3d_cartesian(const int rank, const int nranks,
                             int* z_off) {
   float min_sa_to_vol = 0.0f;
 
-  // Determine decomposition that minimises surface area to volume ratio
-  for (int split_z = 1; split_z <= cbrt((double)nranks); ++split_z) {
-    for (int split_y = 1; split_y <= cbrt((double)nranks); ++split_y) {
-      for (int split_x = 1; split_x <= nranks; ++split_x) {
-        // Factorise the number of ranks
-        if (nranks % split_x || (nranks / split_x) % split_y ||
-            (nranks % (split_x * split_y)))
-          continue;
-
-        // Calculate the surface are to volume ratio of the rank split
-        const float sa_to_vol = (2.0 * (split_x + split_y + split_z)) /
-                                (float)(split_x * split_y * split_z);
-
-        // TODO: MINIMISE THE RATIO OF EACH EDGE PAIR ON THE RANKS AND MESH
-        // TO BETTER DECOMPOSE IRREGULAR PROBLEM SHAPES
-        if (min_sa_to_vol == 0.0f || sa_to_vol < min_sa_to_vol) {
-          min_sa_to_vol = sa_to_vol;
-          // Choose edges so that x > y > z for preferred data access
-          if (split_x >= split_y && split_x >= split_z) {
-            *ranks_x = split_x;
-            *ranks_y = (split_y > split_z) ? split_y : split_z;
-            *ranks_z = (split_y > split_z) ? split_z : split_y;
-          } else if (split_y >= split_x && split_y >= split_z) {
-            *ranks_x = split_y;
-            *ranks_y = (split_x > split_z) ? split_x : split_z;
-            *ranks_z = (split_x > split_z) ? split_z : split_x;
-          } else if (split_z >= split_x && split_z >= split_y) {
-            *ranks_x = split_z;
-            *ranks_y = (split_x > split_y) ? split_x : split_y;
-            *ranks_z = (split_x > split_y) ? split_y : split_x;
-          }
-        }
+  // Determine decomposition that minimises surface area to volume ratio,
+  // enumerating each factorisation split_z <= split_y <= split_x once
+  for (int split_z = 1; split_z * split_z * split_z <= nranks; ++split_z) {
+    if (nranks % split_z) {
+      continue;
+    }
+    for (int split_y = split_z; split_y * split_y <= nranks / split_z;
+         ++split_y) {
+      if ((nranks / split_z) % split_y) {
+        continue;
+      }
+      const int split_x = nranks / (split_z * split_y);
+
+      // Calculate the surface are to volume ratio of the rank split
+      const float sa_to_vol = (2.0 * (split_x + split_y + split_z)) /
+                              (float)(split_x * split_y * split_z);
+
+      // TODO: MINIMISE THE RATIO OF EACH EDGE PAIR ON THE RANKS AND MESH
+      // TO BETTER DECOMPOSE IRREGULAR PROBLEM SHAPES
+      if (min_sa_to_vol == 0.0f || sa_to_vol < min_sa_to_vol) {
+        min_sa_to_vol = sa_to_vol;
+        // Edges are ordered so that x >= y >= z for preferred data access
+        *ranks_x = split_x;
+        *ranks_y = split_y;
+        *ranks_z = split_z;
       }
     }
   }
@@ -377,52 +394,660 @@ void decompose_3d_cartesian(const int rank, const int nranks,
 #endif
 }
 
-// Decompose the unstructured space
-#if 0
-void decompose_unstructured_mesh(
-    const int rank, const int nranks, const int ncells, const int nnodes, 
-    double* cell_centroids_x, double* cell_centroids_y, int* node_neighbours) 
-{
-  const int carry = ncells%nranks;
-
-  // Account for uneven decomposition 
-  int ncells_per_rank = ncells/nranks;
-  if(rank < carry) {
-    ncells_per_rank++;
-  }
-
-  // As with structured algorithm, perform the partitioning for every rank
-  for(int rr = 0; rr < nranks; ++rr) {
-    // This is essentially our chance to make sure that the memory accesses
-    // are correct irrespective of the ordering of the mesh in mesh file
-    for(int cc = 0; cc < ncells; ++cc) {
-      const int nodes_off = cells_to_nodes_off[(cc)];
-      const int nnodes_around_cell = cells_to_nodes_off[(cc+1)]-nodes_off;
-      const double inv_Np = 1.0/(double)nnodes_around_cell;
-
-      double cx = 0.0;
-      double cy = 0.0;
-      for(int nn = 0; nn < nnodes_around_cell; ++nn) {
-        const int node_index = cells_to_nodes[(nodes_off)+(nn)];
-        cx += nodes_x0[(node_index)]*inv_Np;
-        cy += nodes_y0[(node_index)]*inv_Np;
+// Orders cells by a coordinate, breaking ties by index so all ranks agree
+static inline int cell_precedes(const double* coords, const int a,
+                                const int b) {
+  return coords[a] < coords[b] || (coords[a] == coords[b] && a < b);
+}
+
+// Reorders the cells so that the first k have the lowest coordinates
+static void select_lowest_cells(int* cells, int n, const int k,
+                                const double* coords) {
+  int lo = 0;
+  int hi = n - 1;
+  while (lo < hi) {
+    // Partition around the median of three to avoid the sorted worst case
+    const int mid = lo + (hi - lo) / 2;
+    if (cell_precedes(coords, cells[mid], cells[lo])) {
+      iswap(cells[mid], cells[lo]);
+    }
+    if (cell_precedes(coords, cells[hi], cells[lo])) {
+      iswap(cells[hi], cells[lo]);
+    }
+    if (cell_precedes(coords, cells[hi], cells[mid])) {
+      iswap(cells[hi], cells[mid]);
+    }
+    const int pivot = cells[mid];
+    int ii = lo;
+    int jj = hi;
+    while (ii <= jj) {
+      while (cell_precedes(coords, cells[ii], pivot)) {
+        ii++;
+      }
+      while (cell_precedes(coords, pivot, cells[jj])) {
+        jj--;
       }
-      cell_centroids_x[(cc)] = cx;
-      cell_centroids_y[(cc)] = cy;
+      if (ii <= jj) {
+        iswap(cells[ii], cells[jj]);
+        ii++;
+        jj--;
+      }
+    }
+    if (k <= jj) {
+      hi = jj;
+    } else if (k >= ii) {
+      lo = ii;
+    } else {
+      break;
     }
+  }
+}
 
-    // Loop over all of the cell centroids to determine the closest
-    for(int cc = 0; cc < ncells; ++cc) {
+// Recursively bisects the cells across the longest extent of their bounding
+// box, in proportion to the number of ranks on each side
+static void bisect_cells(int* cells, const int ncells, const int rank0,
+                         const int nranks, const double** centroids,
+                         int* cell_owner) {
+  if (nranks == 1) {
+#pragma omp parallel for
+    for (int cc = 0; cc < ncells; ++cc) {
+      cell_owner[(cells[cc])] = rank0;
+    }
+    return;
+  }
 
+  double extent[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    double lo = INFINITY;
+    double hi = -INFINITY;
+#pragma omp parallel for reduction(min : lo) reduction(max : hi)
+    for (int cc = 0; cc < ncells; ++cc) {
+      lo = min(lo, centroids[dd][(cells[cc])]);
+      hi = max(hi, centroids[dd][(cells[cc])]);
     }
+    extent[dd] = hi - lo;
+  }
+  const int axis = (extent[0] >= extent[1] && extent[0] >= extent[2])
+                       ? 0
+                       : ((extent[1] >= extent[2]) ? 1 : 2);
 
-    // Only complete up until our rank
-    if(rank == rr) {
-      break;
+  const int nranks_lo = nranks / 2;
+  const int ncells_lo = (int)((long long)ncells * nranks_lo / nranks);
+  select_lowest_cells(cells, ncells, ncells_lo, centroids[axis]);
+  bisect_cells(cells, ncells_lo, rank0, nranks_lo, centroids, cell_owner);
+  bisect_cells(&cells[ncells_lo], ncells - ncells_lo, rank0 + nranks_lo,
+               nranks - nranks_lo, centroids, cell_owner);
+}
+
+// Numbers the flagged entries, those flagged 2 before those flagged 1, in
+// order of their global index, returning the number numbered
+static int number_local_entries(const int nglobal, const int* flags,
+                                int* global_to_local, int* local_to_global) {
+  int* scan = (int*)malloc(sizeof(int) * (nglobal + 1));
+  if (!scan) {
+    TERMINATE("Failed to allocate the unstructured decomposition.\n");
+  }
+
+  // Each pass scans its flags into the position of each entry in the pass
+  int nlocal = 0;
+  for (int pass = 2; pass >= 1; --pass) {
+#pragma omp parallel for
+    for (int gg = 0; gg < nglobal; ++gg) {
+      scan[gg] = (flags[gg] == pass);
     }
+    const int npass = prefix_sum(nglobal, scan, 0);
+
+#pragma omp parallel for
+    for (int gg = 0; gg < nglobal; ++gg) {
+      if (flags[gg] == pass) {
+        const int local_index = nlocal + scan[gg];
+        global_to_local[(gg)] = local_index;
+        local_to_global[(local_index)] = gg;
+      }
+    }
+    nlocal += npass;
+  }
+
+  free(scan);
+  return nlocal;
+}
+
+// Builds the halo lists, where the ghosts are received from their owners and
+// the owners learn which of their entries to send by exchanging global ids
+static void build_unstructured_halo(const int rank, const int nranks,
+                                    const int nlocal, const int nowned,
+                                    const int* local_to_global,
+                                    const int* global_to_local,
+                                    const int* global_owner,
+                                    UnstructuredHalo* halo) {
+  int* recv_counts = (int*)calloc(nranks, sizeof(int));
+  int* send_counts = (int*)calloc(nranks, sizeof(int));
+  int* rank_offsets = (int*)calloc(nranks + 1, sizeof(int));
+  if (!recv_counts || !send_counts || !rank_offsets) {
+    TERMINATE("Failed to allocate the halo lists.\n");
+  }
+
+  // The ghosts are grouped by owner, staying in order of global index
+  for (int ll = nowned; ll < nlocal; ++ll) {
+    recv_counts[(global_owner[(local_to_global[(ll)])])]++;
+  }
+#ifdef MPI
+  MPI_Alltoall(recv_counts, 1, MPI_INT, send_counts, 1, MPI_INT,
+               MPI_COMM_WORLD);
+#endif
+
+  halo->nneighbours = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    halo->nneighbours += (recv_counts[rr] || send_counts[rr]);
+    rank_offsets[rr + 1] = rank_offsets[rr] + recv_counts[rr];
+  }
+  const int nrecv = nlocal - nowned;
+  halo->neighbour_ranks = (int*)malloc(sizeof(int) * halo->nneighbours);
+  halo->recv_offsets = (int*)malloc(sizeof(int) * (halo->nneighbours + 1));
+  halo->send_offsets = (int*)malloc(sizeof(int) * (halo->nneighbours + 1));
+  if (!halo->neighbour_ranks || !halo->recv_offsets || !halo->send_offsets) {
+    TERMINATE("Failed to allocate the halo lists.\n");
+  }
+  allocate_int_data(&halo->recv_list, nrecv);
+
+  for (int ll = nowned; ll < nlocal; ++ll) {
+    const int owner = global_owner[(local_to_global[(ll)])];
+    halo->recv_list[(rank_offsets[owner]++)] = ll;
+  }
+
+  int nn = 0;
+  halo->recv_offsets[0] = 0;
+  halo->send_offsets[0] = 0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    if (recv_counts[rr] || send_counts[rr]) {
+      halo->neighbour_ranks[nn] = rr;
+      halo->recv_offsets[nn + 1] = halo->recv_offsets[nn] + recv_counts[rr];
+      halo->send_offsets[nn + 1] = halo->send_offsets[nn] + send_counts[rr];
+      nn++;
+    }
+  }
+  const int nsend = halo->send_offsets[halo->nneighbours];
+  allocate_int_data(&halo->send_list, nsend);
+
+#ifdef MPI
+  // Tell each owner the global ids of the ghosts in the order received
+  int* recv_ids = (int*)malloc(sizeof(int) * (nrecv + 1));
+  int* send_ids = (int*)malloc(sizeof(int) * (nsend + 1));
+  MPI_Request* reqs =
+      (MPI_Request*)malloc(sizeof(MPI_Request) * 2 * (halo->nneighbours + 1));
+  if (!recv_ids || !send_ids || !reqs) {
+    TERMINATE("Failed to allocate the halo lists.\n");
+  }
+  for (int ii = 0; ii < nrecv; ++ii) {
+    recv_ids[ii] = local_to_global[(halo->recv_list[(ii)])];
+  }
+  int nreqs = 0;
+  for (int nb = 0; nb < halo->nneighbours; ++nb) {
+    const int nsend_nb = halo->send_offsets[nb + 1] - halo->send_offsets[nb];
+    const int nrecv_nb = halo->recv_offsets[nb + 1] - halo->recv_offsets[nb];
+    if (nsend_nb) {
+      MPI_Irecv(&send_ids[halo->send_offsets[nb]], nsend_nb, MPI_INT,
+                halo->neighbour_ranks[nb], TAG_PARTITION, MPI_COMM_WORLD,
+                &reqs[nreqs++]);
+    }
+    if (nrecv_nb) {
+      MPI_Isend(&recv_ids[halo->recv_offsets[nb]], nrecv_nb, MPI_INT,
+                halo->neighbour_ranks[nb], TAG_PARTITION, MPI_COMM_WORLD,
+                &reqs[nreqs++]);
+    }
+  }
+  MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+
+  for (int ii = 0; ii < nsend; ++ii) {
+    const int local_index = global_to_local[(send_ids[ii])];
+    if (local_index < 0 || local_index >= nowned) {
+      TERMINATE("Rank %d was asked for %d, which it does not own.\n", rank,
+                send_ids[ii]);
+    }
+    halo->send_list[(ii)] = local_index;
+  }
+  free(recv_ids);
+  free(send_ids);
+  free(reqs);
+#endif
+
+  free(recv_counts);
+  free(send_counts);
+  free(rank_offsets);
+}
+
+// Partitions a global unstructured mesh, held by every rank, by recursive
+// coordinate bisection of the cell centroids, and builds the local mesh of
+// this rank with a layer of ghost cells and the lists for its halo exchange.
+size_t decompose_unstructured_mesh(const int rank, const int nranks,
+                                   UnstructuredMesh* global_umesh,
+                                   UnstructuredMesh* umesh,
+                                   UnstructuredPartition* partition) {
+  REQUIRE_HOST_DATA();
+
+  const int nglobal_cells = global_umesh->ncells;
+  const int nglobal_nodes = global_umesh->nnodes;
+  const int* cells_to_nodes = global_umesh->cells_to_nodes;
+  const int* cells_to_nodes_off = global_umesh->cells_to_nodes_offsets;
+  if (nglobal_cells < nranks) {
+    TERMINATE("Cannot partition %d cells across %d ranks.\n", nglobal_cells,
+              nranks);
+  }
+  if (global_umesh->implicit) {
+    TERMINATE("An implicit mesh must be materialised to be partitioned.\n");
+  }
+
+  // The centroids are recomputed as not every mesh source provides them
+  double* centroids[3];
+  int* cells = (int*)malloc(sizeof(int) * nglobal_cells);
+  int* cell_owner = (int*)malloc(sizeof(int) * nglobal_cells);
+  int* node_owner = (int*)malloc(sizeof(int) * nglobal_nodes);
+  int* cell_flags = (int*)calloc(nglobal_cells, sizeof(int));
+  int* node_flags = (int*)calloc(nglobal_nodes, sizeof(int));
+  for (int dd = 0; dd < 3; ++dd) {
+    centroids[dd] = (double*)malloc(sizeof(double) * nglobal_cells);
+  }
+  if (!cells || !cell_owner || !node_owner || !cell_flags || !node_flags ||
+      !centroids[0] || !centroids[1] || !centroids[2]) {
+    TERMINATE("Failed to allocate the unstructured decomposition.\n");
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    const int nodes_off = cells_to_nodes_off[(cc)];
+    const int nnodes_around_cell = cells_to_nodes_off[(cc + 1)] - nodes_off;
+    const double inv_Np = 1.0 / (double)nnodes_around_cell;
+
+    double cx = 0.0;
+    double cy = 0.0;
+    double cz = 0.0;
+    for (int nn = 0; nn < nnodes_around_cell; ++nn) {
+      const int node_index = cells_to_nodes[(nodes_off) + (nn)];
+      cx += global_umesh->nodes_x0[(node_index)] * inv_Np;
+      cy += global_umesh->nodes_y0[(node_index)] * inv_Np;
+      cz += global_umesh->nodes_z0[(node_index)] * inv_Np;
+    }
+    centroids[0][(cc)] = cx;
+    centroids[1][(cc)] = cy;
+    centroids[2][(cc)] = cz;
+    cells[cc] = cc;
+  }
+
+  // Every rank computes the same partition so no communication is needed
+  bisect_cells(cells, nglobal_cells, 0, nranks, (const double**)centroids,
+               cell_owner);
+
+  // A node is owned by the owner of the lowest numbered cell around it, which
+  // leads each of the ascending rows of the transpose
+  int* nodes_to_cells_off = (int*)malloc(sizeof(int) * (nglobal_nodes + 1));
+  int* nodes_to_cells = NULL;
+  if (!nodes_to_cells_off) {
+    TERMINATE("Failed to allocate the unstructured decomposition.\n");
+  }
+  build_csr_transpose(nglobal_cells, cells_to_nodes_off, cells_to_nodes,
+                      nglobal_nodes, nodes_to_cells_off, &nodes_to_cells);
+#pragma omp parallel for
+  for (int nn = 0; nn < nglobal_nodes; ++nn) {
+    node_owner[nn] =
+        (nodes_to_cells_off[(nn + 1)] > nodes_to_cells_off[(nn)])
+            ? cell_owner[(nodes_to_cells[(nodes_to_cells_off[(nn)])])]
+            : -1;
+  }
+  deallocate_int_data(nodes_to_cells);
+  free(nodes_to_cells_off);
+
+  // Flag the nodes of the owned cells, and then the cells that touch them
+#pragma omp parallel for
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    if (cell_owner[(cc)] == rank) {
+      for (int nn = cells_to_nodes_off[(cc)];
+           nn < cells_to_nodes_off[(cc + 1)]; ++nn) {
+#pragma omp atomic write
+        node_flags[(cells_to_nodes[(nn)])] = 1;
+      }
+    }
+  }
+#pragma omp parallel for
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    int touches = 0;
+    for (int nn = cells_to_nodes_off[(cc)]; nn < cells_to_nodes_off[(cc + 1)];
+         ++nn) {
+      int flag;
+#pragma omp atomic read
+      flag = node_flags[(cells_to_nodes[(nn)])];
+      touches |= flag;
+    }
+    cell_flags[(cc)] = (cell_owner[(cc)] == rank) ? 2 : touches;
+  }
+
+  // The local nodes are all of those around the owned and ghost cells
+#pragma omp parallel for
+  for (int nn = 0; nn < nglobal_nodes; ++nn) {
+    node_flags[nn] = 0;
+  }
+#pragma omp parallel for
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    if (cell_flags[(cc)]) {
+      for (int nn = cells_to_nodes_off[(cc)];
+           nn < cells_to_nodes_off[(cc + 1)]; ++nn) {
+        const int node_index = cells_to_nodes[(nn)];
+#pragma omp atomic write
+        node_flags[(node_index)] = (node_owner[(node_index)] == rank) ? 2 : 1;
+      }
+    }
+  }
+
+  // The local entries are counted before their lists are sized
+  int nowned_cells = 0;
+  int nowned_nodes = 0;
+  int nlocal_cells = 0;
+  int nlocal_nodes = 0;
+#pragma omp parallel for reduction(+ : nowned_cells, nlocal_cells)
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    nowned_cells += (cell_flags[cc] == 2);
+    nlocal_cells += (cell_flags[cc] != 0);
+  }
+#pragma omp parallel for reduction(+ : nowned_nodes, nlocal_nodes)
+  for (int nn = 0; nn < nglobal_nodes; ++nn) {
+    nowned_nodes += (node_flags[nn] == 2);
+    nlocal_nodes += (node_flags[nn] != 0);
+  }
+
+  partition->nglobal_cells = nglobal_cells;
+  partition->nglobal_nodes = nglobal_nodes;
+  partition->global_to_local_cells = (int*)malloc(sizeof(int) * nglobal_cells);
+  partition->global_to_local_nodes = (int*)malloc(sizeof(int) * nglobal_nodes);
+  partition->local_to_global_cells =
+      (int*)malloc(sizeof(int) * (nlocal_cells + 1));
+  partition->local_to_global_nodes =
+      (int*)malloc(sizeof(int) * (nlocal_nodes + 1));
+  if (!partition->global_to_local_cells || !partition->global_to_local_nodes ||
+      !partition->local_to_global_cells || !partition->local_to_global_nodes) {
+    TERMINATE("Failed to allocate the unstructured decomposition.\n");
+  }
+#pragma omp parallel for
+  for (int cc = 0; cc < nglobal_cells; ++cc) {
+    partition->global_to_local_cells[cc] = -1;
+  }
+#pragma omp parallel for
+  for (int nn = 0; nn < nglobal_nodes; ++nn) {
+    partition->global_to_local_nodes[nn] = -1;
+  }
+  partition->nowned_cells = nowned_cells;
+  partition->nowned_nodes = nowned_nodes;
+  const int ncells =
+      number_local_entries(nglobal_cells, cell_flags,
+                           partition->global_to_local_cells,
+                           partition->local_to_global_cells);
+  const int nnodes =
+      number_local_entries(nglobal_nodes, node_flags,
+                           partition->global_to_local_nodes,
+                           partition->local_to_global_nodes);
+
+  // Build the local mesh in the local numbering
+  umesh->ncells = ncells;
+  umesh->nnodes = nnodes;
+  umesh->nnodes_by_cell = global_umesh->nnodes_by_cell;
+  umesh->nnodes_by_node = global_umesh->nnodes_by_node;
+  umesh->nregional_variables = global_umesh->nregional_variables;
+  size_t allocated = init_unstructured_mesh(umesh);
+
+  umesh->cells_to_nodes_offsets[(0)] = 0;
+#pragma omp parallel for
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int gc = partition->local_to_global_cells[(cc)];
+    umesh->cells_to_nodes_offsets[(cc + 1)] =
+        cells_to_nodes_off[(gc + 1)] - cells_to_nodes_off[(gc)];
+  }
+  if (prefix_sum(ncells + 1, umesh->cells_to_nodes_offsets, 1) >
+      ncells * umesh->nnodes_by_cell) {
+    TERMINATE("The cells have more than %d nodes.\n", umesh->nnodes_by_cell);
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int gc = partition->local_to_global_cells[(cc)];
+    int off = umesh->cells_to_nodes_offsets[(cc)];
+    for (int nn = cells_to_nodes_off[(gc)]; nn < cells_to_nodes_off[(gc + 1)];
+         ++nn) {
+      umesh->cells_to_nodes[(off++)] =
+          partition->global_to_local_nodes[(cells_to_nodes[(nn)])];
+    }
+    umesh->cell_centroids_x[(cc)] = centroids[0][(gc)];
+    umesh->cell_centroids_y[(cc)] = centroids[1][(gc)];
+    umesh->cell_centroids_z[(cc)] = centroids[2][(gc)];
+  }
+
+#pragma omp parallel for
+  for (int nn = 0; nn < nnodes; ++nn) {
+    const int gn = partition->local_to_global_nodes[(nn)];
+    umesh->nodes_x0[(nn)] = global_umesh->nodes_x0[(gn)];
+    umesh->nodes_y0[(nn)] = global_umesh->nodes_y0[(gn)];
+    umesh->nodes_z0[(nn)] = global_umesh->nodes_z0[(gn)];
+    umesh->nodes_x1[(nn)] = global_umesh->nodes_x0[(gn)];
+    umesh->nodes_y1[(nn)] = global_umesh->nodes_y0[(gn)];
+    umesh->nodes_z1[(nn)] = global_umesh->nodes_z0[(gn)];
+  }
+
+  // Keep the boundary conditions of the global boundary nodes, numbering the
+  // local boundary nodes in order by scanning their flags
+  const int* global_boundary_index = global_umesh->boundary_index;
+#pragma omp parallel for
+  for (int nn = 0; nn < nnodes; ++nn) {
+    const int gn = partition->local_to_global_nodes[(nn)];
+    umesh->boundary_index[(nn)] =
+        global_boundary_index && global_boundary_index[(gn)] != IS_INTERIOR;
+  }
+  umesh->nboundary_nodes = prefix_sum(nnodes, umesh->boundary_index, 0);
+
+#pragma omp parallel for
+  for (int nn = 0; nn < nnodes; ++nn) {
+    const int gn = partition->local_to_global_nodes[(nn)];
+    const int global_index =
+        global_boundary_index ? global_boundary_index[(gn)] : IS_INTERIOR;
+    if (global_index == IS_INTERIOR) {
+      umesh->boundary_index[(nn)] = IS_INTERIOR;
+      continue;
+    }
+    const int index = umesh->boundary_index[(nn)];
+    umesh->boundary_type[(index)] = global_umesh->boundary_type[(global_index)];
+    umesh->boundary_normal_x[(index)] =
+        global_umesh->boundary_normal_x[(global_index)];
+    umesh->boundary_normal_y[(index)] =
+        global_umesh->boundary_normal_y[(global_index)];
+    umesh->boundary_normal_z[(index)] =
+        global_umesh->boundary_normal_z[(global_index)];
+  }
+
+  allocated += fill_nodes_to_cells(umesh);
+
+  build_unstructured_halo(rank, nranks, ncells, nowned_cells,
+                          partition->local_to_global_cells,
+                          partition->global_to_local_cells, cell_owner,
+                          &partition->cell_halo);
+  build_unstructured_halo(rank, nranks, nnodes, nowned_nodes,
+                          partition->local_to_global_nodes,
+                          partition->global_to_local_nodes, node_owner,
+                          &partition->node_halo);
+
+  for (int dd = 0; dd < 3; ++dd) {
+    free(centroids[dd]);
+  }
+  free(cells);
+  free(cell_owner);
+  free(node_owner);
+  free(cell_flags);
+  free(node_flags);
+  return allocated;
+}
+
+// Deallocates the lists of a halo
+static void finalise_unstructured_halo(UnstructuredHalo* halo) {
+  free(halo->neighbour_ranks);
+  free(halo->send_offsets);
+  free(halo->recv_offsets);
+  deallocate_int_data(halo->send_list);
+  deallocate_int_data(halo->recv_list);
+}
+
+// Deallocates the maps and halo lists of a partitioned mesh
+void finalise_unstructured_partition(UnstructuredPartition* partition) {
+  free(partition->local_to_global_cells);
+  free(partition->local_to_global_nodes);
+  free(partition->global_to_local_cells);
+  free(partition->global_to_local_nodes);
+  finalise_unstructured_halo(&partition->cell_halo);
+  finalise_unstructured_halo(&partition->node_halo);
+}
+
+// Prepares the buffers to exchange up to max_fields fields over a halo
+void initialise_unstructured_exchange(const UnstructuredHalo* halo,
+                                      const int max_fields, const int tag,
+                                      UnstructuredExchange* exchange) {
+  exchange->halo = halo;
+  exchange->tag = tag;
+  exchange->max_fields = max_fields;
+  exchange->nfields = 0;
+  exchange->nrequests = 0;
+  allocate_data(&exchange->send_buffer,
+                (size_t)halo->send_offsets[halo->nneighbours] * max_fields);
+  allocate_data(&exchange->recv_buffer,
+                (size_t)halo->recv_offsets[halo->nneighbours] * max_fields);
+#ifdef MPI
+  exchange->requests =
+      malloc(sizeof(MPI_Request) * 2 * (halo->nneighbours + 1));
+  if (!exchange->requests) {
+    TERMINATE("Failed to allocate the exchange requests.\n");
+  }
+#else
+  exchange->requests = NULL;
+#endif
+}
+
+// Posts the messages of an exchange whose send buffer has been filled
+void post_unstructured_messages(UnstructuredExchange* exchange) {
+#ifdef MPI
+  START_PROFILING(&comms_profile);
+  const UnstructuredHalo* halo = exchange->halo;
+  const int nfields = exchange->nfields;
+  MPI_Request* reqs = (MPI_Request*)exchange->requests;
+  exchange->nrequests = 0;
+  for (int nb = 0; nb < halo->nneighbours; ++nb) {
+    const int nrecv = halo->recv_offsets[nb + 1] - halo->recv_offsets[nb];
+    const int nsend = halo->send_offsets[nb + 1] - halo->send_offsets[nb];
+    if (nrecv) {
+      MPI_Irecv(&exchange->recv_buffer[halo->recv_offsets[nb] * nfields],
+                nrecv * nfields, MPI_DOUBLE, halo->neighbour_ranks[nb],
+                exchange->tag, MPI_COMM_WORLD,
+                &reqs[exchange->nrequests++]);
+    }
+    if (nsend) {
+      MPI_Isend(&exchange->send_buffer[halo->send_offsets[nb] * nfields],
+                nsend * nfields, MPI_DOUBLE, halo->neighbour_ranks[nb],
+                exchange->tag, MPI_COMM_WORLD,
+                &reqs[exchange->nrequests++]);
+    }
+  }
+  STOP_PROFILING(&comms_profile, __func__);
+#endif
+}
+
+// Waits on the messages of an exchange
+void wait_on_unstructured_messages(UnstructuredExchange* exchange) {
+#ifdef MPI
+  START_PROFILING(&comms_profile);
+  MPI_Waitall(exchange->nrequests, (MPI_Request*)exchange->requests,
+              MPI_STATUSES_IGNORE);
+  exchange->nrequests = 0;
+  STOP_PROFILING(&comms_profile, __func__);
+#endif
+}
+
+// Exchanges the ghosts of the fields, blocking until complete
+void handle_unstructured_halo(UnstructuredExchange* exchange,
+                              const int nfields, double** fields) {
+  begin_unstructured_exchange(exchange, nfields, fields);
+  end_unstructured_exchange(exchange, fields);
+}
+
+// Deallocates the buffers of an exchange
+void finalise_unstructured_exchange(UnstructuredExchange* exchange) {
+  deallocate_data(exchange->send_buffer);
+  deallocate_data(exchange->recv_buffer);
+  free(exchange->requests);
+}
+
+// Reads the whole of a file on this rank into a null terminated buffer
+char* read_local_file(const char* filename, size_t* len) {
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    return NULL;
+  }
+
+  fseek(fp, 0, SEEK_END);
+  *len = (size_t)ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  char* text = (char*)malloc(*len + 1);
+  if (!text) {
+    TERMINATE("Could not allocate space for the file %s.\n", filename);
+  }
+  if (fread(text, 1, *len, fp) != *len) {
+    TERMINATE("Could not read the file: %s.\n", filename);
+  }
+  text[*len] = '\0';
+  fclose(fp);
+  return text;
+}
+
+// Reads a file on the master and broadcasts its raw bytes to every rank
+char* read_file_on_master(const char* filename, size_t* len) {
+  char* text = NULL;
+
+#ifdef MPI
+  int initialised = 0;
+  int finalised = 0;
+  MPI_Initialized(&initialised);
+  MPI_Finalized(&finalised);
+  if (initialised && !finalised) {
+    int rank;
+    long long nbytes = -1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == MASTER) {
+      text = read_local_file(filename, len);
+      nbytes = text ? (long long)*len : -1;
+    }
+
+    // A failure on the master is broadcast so that every rank terminates
+    MPI_Bcast(&nbytes, 1, MPI_LONG_LONG, MASTER, MPI_COMM_WORLD);
+    if (nbytes < 0) {
+      TERMINATE("Could not open the file: %s.\n", filename);
+    }
+
+    *len = (size_t)nbytes;
+    if (rank != MASTER) {
+      text = (char*)malloc(*len + 1);
+      if (!text) {
+        TERMINATE("Could not allocate space for the file %s.\n", filename);
+      }
+      text[*len] = '\0';
+    }
+
+    // The broadcast count is an int, so large files are sent in chunks
+    for (size_t off = 0; off < *len; off += INT_MAX) {
+      const int chunk = (int)min(*len - off, (size_t)INT_MAX);
+      MPI_Bcast(text + off, chunk, MPI_CHAR, MASTER, MPI_COMM_WORLD);
+    }
+    return text;
+  }
+#endif
+
+  text = read_local_file(filename, len);
+  if (!text) {
+    TERMINATE("Could not open the file: %s.\n", filename);
   }
+  return text;
 }
-#endif // if 0
 
 // Finalise the communications
 void finalise_comms() {
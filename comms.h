@@ -29,6 +29,19 @@ enum {
   INVERT_Z
 }; // Whether an inversion is required
 
+// The state of an exchange of several fields over an unstructured halo,
+// where each message holds every field for one neighbour
+typedef struct {
+  const UnstructuredHalo* halo;
+  int tag; // Distinguishes the messages from other exchanges in flight
+  int max_fields;
+  int nfields;
+  double* send_buffer;
+  double* recv_buffer;
+  void* requests; // The messages in flight
+  int nrequests;
+} UnstructuredExchange;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -53,6 +66,51 @@ void decompose_3d_cartesian(const int rank, const int nranks,
                             int* ranks_y, int* ranks_z, int* x_off, int* y_off,
                             int* z_off);
 
+// Partitions a global unstructured mesh by recursive coordinate bisection of
+// the cell centroids, and builds the local mesh of this rank with a layer of
+// ghost cells and the lists for its halo exchange. This is a replicated-mesh
+// partitioner: every rank must hold the whole global mesh, the global to
+// local maps of the partition are sized by the global mesh, and each rank
+// makes its own threaded passes over the global mesh without communicating.
+// The memory and setup time on each rank therefore grow with the global mesh
+// rather than shrink with the ranks, which suits meshes that fit on a node.
+size_t decompose_unstructured_mesh(const int rank, const int nranks,
+                                   UnstructuredMesh* global_umesh,
+                                   UnstructuredMesh* umesh,
+                                   UnstructuredPartition* partition);
+
+// Prepares the buffers to exchange up to max_fields fields over a halo, with
+// messages sent under tag, which must differ from that of any other exchange
+// that can be in flight at the same time
+void initialise_unstructured_exchange(const UnstructuredHalo* halo,
+                                      const int max_fields, const int tag,
+                                      UnstructuredExchange* exchange);
+
+// Gathers the fields into the send buffer and starts the messages, so that
+// work that does not touch the ghosts can overlap the exchange
+void begin_unstructured_exchange(UnstructuredExchange* exchange,
+                                 const int nfields, double** fields);
+
+// Waits for the messages and scatters the received values into the ghosts
+void end_unstructured_exchange(UnstructuredExchange* exchange,
+                               double** fields);
+
+// Exchanges the ghosts of the fields, blocking until complete
+void handle_unstructured_halo(UnstructuredExchange* exchange,
+                              const int nfields, double** fields);
+
+// Posts the messages of an exchange whose send buffer has been filled
+void post_unstructured_messages(UnstructuredExchange* exchange);
+
+// Waits on the messages of an exchange
+void wait_on_unstructured_messages(UnstructuredExchange* exchange);
+
+// Deallocates the buffers of an exchange
+void finalise_unstructured_exchange(UnstructuredExchange* exchange);
+
+// Deallocates the maps and halo lists of a partitioned mesh
+void finalise_unstructured_partition(UnstructuredPartition* partition);
+
 // Reduces the value across all ranks and returns the sum
 double reduce_all_sum(double local_val);
 
@@ -101,6 +159,9 @@ void handle_boundary_2d(const int nx, const int ny, Mesh* mesh, double* arr,
 void handle_boundary_3d(const int nx, const int ny, const int nz, Mesh* mesh,
                         double* arr, const int invert, const int pack);
 
+// Determines the bytes moved by packing, unpacking and reflecting the halos
+double halo_traffic_2d(const int nx, const int ny, Mesh* mesh, const int pack);
+
 // Reflect the node centered velocities on the boundary
 void handle_unstructured_reflect(const int nnodes, const int* boundary_index,
                                  const int* boundary_type,
@@ -117,6 +178,15 @@ void handle_unstructured_reflect_3d(const int nnodes, const int* boundary_index,
                                     double* velocity_x, double* velocity_y,
                                     double* velocity_z);
 
+// Reads the whole of a file on this rank into a null terminated buffer that
+// the caller frees, returning NULL if the file cannot be opened
+char* read_local_file(const char* filename, size_t* len);
+
+// Reads a file on the master and broadcasts its raw bytes to every rank,
+// returning a null terminated buffer that the caller frees. This is
+// collective once MPI has been initialised.
+char* read_file_on_master(const char* filename, size_t* len);
+
 // Finalise the communications
 void finalise_comms();
 
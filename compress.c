@@ -0,0 +1,244 @@
+#include "compress.h"
+#include <math.h>
+#include <string.h>
+
+#define LZ_LAST_LITERALS 5 // Bytes at the end that are always literals
+#define LZ_MATCH_LIMIT 12  // No match starts within this many bytes of the end
+#define QUANTISE_MAX 2305843009213693952.0 // 2^61 keeps the deltas in range
+
+// Reads four bytes without alignment requirements
+static inline uint32_t read32(const uint8_t* ptr) {
+  uint32_t val;
+  memcpy(&val, ptr, sizeof(uint32_t));
+  return val;
+}
+
+// Multiplicative hash of four bytes
+static inline uint32_t lz_hash(const uint32_t seq) {
+  return (seq * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes the 255-terminated extension of a length that overflowed its nibble
+static inline int write_length(uint8_t* out, size_t* op, const size_t out_len,
+                               size_t len) {
+  while (len >= 255) {
+    if (*op >= out_len) {
+      return 0;
+    }
+    out[(*op)++] = 255;
+    len -= 255;
+  }
+  if (*op >= out_len) {
+    return 0;
+  }
+  out[(*op)++] = (uint8_t)len;
+  return 1;
+}
+
+// Reads the extension of a length that overflowed its nibble
+static inline int read_length(const uint8_t* in, size_t* ip, const size_t len,
+                              size_t* val) {
+  uint8_t byte;
+  do {
+    if (*ip >= len) {
+      return 0;
+    }
+    byte = in[(*ip)++];
+    *val += byte;
+  } while (byte == 255);
+  return 1;
+}
+
+// Emits a sequence of literals followed by an optional match
+static int write_sequence(const uint8_t* literals, const size_t nliterals,
+                          const size_t offset, const size_t match_len,
+                          uint8_t* out, size_t* op, const size_t out_len) {
+  if (*op >= out_len) {
+    return 0;
+  }
+  const size_t token_pos = (*op)++;
+  const size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+  out[token_pos] = (uint8_t)(((nliterals < 15) ? nliterals : 15) << 4 |
+                             ((match_code < 15) ? match_code : 15));
+
+  if (nliterals >= 15 && !write_length(out, op, out_len, nliterals - 15)) {
+    return 0;
+  }
+  if (*op + nliterals > out_len) {
+    return 0;
+  }
+  memcpy(&out[*op], literals, nliterals);
+  *op += nliterals;
+
+  if (match_len) {
+    if (*op + 2 > out_len) {
+      return 0;
+    }
+    out[(*op)++] = (uint8_t)(offset & 0xff);
+    out[(*op)++] = (uint8_t)(offset >> 8);
+    if (match_code >= 15 && !write_length(out, op, out_len, match_code - 15)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// The largest compressed size of len bytes
+size_t lz_compress_bound(const size_t len) { return len + len / 255 + 16; }
+
+// Compresses len bytes, returning the compressed size or 0 if it does not
+// fit in out_len bytes
+size_t lz_compress(const uint8_t* in, const size_t len, uint8_t* out,
+                   const size_t out_len) {
+  int32_t table[1 << LZ_HASH_BITS];
+  for (int ii = 0; ii < (1 << LZ_HASH_BITS); ++ii) {
+    table[ii] = -1;
+  }
+
+  size_t ip = 0;
+  size_t op = 0;
+  size_t anchor = 0;
+
+  // Greedily take the first match found through the hash table
+  if (len > LZ_MATCH_LIMIT) {
+    const size_t match_limit = len - LZ_MATCH_LIMIT;
+    const size_t match_end = len - LZ_LAST_LITERALS;
+    while (ip < match_limit) {
+      const uint32_t seq = read32(&in[ip]);
+      const uint32_t hh = lz_hash(seq);
+      const int32_t ref = table[hh];
+      table[hh] = (int32_t)ip;
+
+      if (ref < 0 || ip - ref > LZ_MAX_OFFSET || read32(&in[ref]) != seq) {
+        ip++;
+        continue;
+      }
+
+      size_t match_len = LZ_MIN_MATCH;
+      while (ip + match_len < match_end &&
+             in[ref + match_len] == in[ip + match_len]) {
+        match_len++;
+      }
+
+      if (!write_sequence(&in[anchor], ip - anchor, ip - ref, match_len, out,
+                          &op, out_len)) {
+        return 0;
+      }
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+
+  // The remaining bytes are a final sequence of literals
+  if (!write_sequence(&in[anchor], len - anchor, 0, 0, out, &op, out_len)) {
+    return 0;
+  }
+  return op;
+}
+
+// Decompresses len bytes, returning the decompressed size or 0 if the input
+// is malformed or does not fit in out_len bytes
+size_t lz_decompress(const uint8_t* in, const size_t len, uint8_t* out,
+                     const size_t out_len) {
+  size_t ip = 0;
+  size_t op = 0;
+  while (ip < len) {
+    const uint8_t token = in[ip++];
+
+    size_t nliterals = token >> 4;
+    if (nliterals == 15 && !read_length(in, &ip, len, &nliterals)) {
+      return 0;
+    }
+    if (ip + nliterals > len || op + nliterals > out_len) {
+      return 0;
+    }
+    memcpy(&out[op], &in[ip], nliterals);
+    ip += nliterals;
+    op += nliterals;
+
+    // The final sequence has no match
+    if (ip == len) {
+      break;
+    }
+
+    if (ip + 2 > len) {
+      return 0;
+    }
+    const size_t offset = in[ip] | ((size_t)in[ip + 1] << 8);
+    ip += 2;
+    size_t match_len = token & 15;
+    if (match_len == 15 && !read_length(in, &ip, len, &match_len)) {
+      return 0;
+    }
+    match_len += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || op + match_len > out_len) {
+      return 0;
+    }
+
+    // Matches can overlap their own output so are copied bytewise
+    for (size_t ii = 0; ii < match_len; ++ii) {
+      out[op + ii] = out[op - offset + ii];
+    }
+    op += match_len;
+  }
+  return op;
+}
+
+// Transposes nelements of elem_size bytes so that equal significance bytes
+// are contiguous
+void shuffle_bytes(const uint8_t* in, const size_t nelements,
+                   const size_t elem_size, uint8_t* out) {
+  for (size_t bb = 0; bb < elem_size; ++bb) {
+    for (size_t ii = 0; ii < nelements; ++ii) {
+      out[bb * nelements + ii] = in[ii * elem_size + bb];
+    }
+  }
+}
+
+// Reverses shuffle_bytes
+void unshuffle_bytes(const uint8_t* in, const size_t nelements,
+                     const size_t elem_size, uint8_t* out) {
+  for (size_t bb = 0; bb < elem_size; ++bb) {
+    for (size_t ii = 0; ii < nelements; ++ii) {
+      out[ii * elem_size + bb] = in[bb * nelements + ii];
+    }
+  }
+}
+
+// Quantises values to within error_bound and delta encodes them, returning 0
+// if any value cannot be represented
+int quantise_doubles(const double* in, const size_t len,
+                     const double error_bound, uint64_t* out) {
+  const double step = 2.0 * error_bound;
+  int64_t prev = 0;
+  for (size_t ii = 0; ii < len; ++ii) {
+    const double scaled = in[ii] / step;
+    if (!isfinite(scaled) || fabs(scaled) >= QUANTISE_MAX) {
+      return 0;
+    }
+
+    // Rounding in the division can rarely push the error over the bound
+    const int64_t quantised = llround(scaled);
+    if (fabs((double)quantised * step - in[ii]) > error_bound) {
+      return 0;
+    }
+
+    // Zigzag encode the delta so that small steps have small magnitudes
+    const int64_t delta = quantised - prev;
+    out[ii] = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    prev = quantised;
+  }
+  return 1;
+}
+
+// Reverses quantise_doubles
+void dequantise_doubles(const uint64_t* in, const size_t len,
+                        const double error_bound, double* out) {
+  const double step = 2.0 * error_bound;
+  int64_t prev = 0;
+  for (size_t ii = 0; ii < len; ++ii) {
+    const int64_t delta = (int64_t)(in[ii] >> 1) ^ -(int64_t)(in[ii] & 1);
+    prev += delta;
+    out[ii] = (double)prev * step;
+  }
+}
@@ -0,0 +1,58 @@
+#ifndef __COMPRESSHDR
+#define __COMPRESSHDR
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ *    FIELD COMPRESSION
+ *    A byte shuffle that groups the bytes of each significance together,
+ *    followed by an LZ77 codec with an LZ4 style sequence format. The
+ *    optional quantiser maps doubles to integers that are within a given
+ *    absolute error, which are delta and zigzag encoded before the shuffle.
+ */
+
+#define LZ_HASH_BITS 14     // Size of the match finder's hash table
+#define LZ_MIN_MATCH 4      // Shortest match that is encoded
+#define LZ_MAX_OFFSET 65535 // Furthest back that a match can refer
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The largest compressed size of len bytes
+size_t lz_compress_bound(const size_t len);
+
+// Compresses len bytes, returning the compressed size or 0 if it does not
+// fit in out_len bytes
+size_t lz_compress(const uint8_t* in, const size_t len, uint8_t* out,
+                   const size_t out_len);
+
+// Decompresses len bytes, returning the decompressed size or 0 if the input
+// is malformed or does not fit in out_len bytes
+size_t lz_decompress(const uint8_t* in, const size_t len, uint8_t* out,
+                     const size_t out_len);
+
+// Transposes nelements of elem_size bytes so that equal significance bytes
+// are contiguous
+void shuffle_bytes(const uint8_t* in, const size_t nelements,
+                   const size_t elem_size, uint8_t* out);
+
+// Reverses shuffle_bytes
+void unshuffle_bytes(const uint8_t* in, const size_t nelements,
+                     const size_t elem_size, uint8_t* out);
+
+// Quantises values to within error_bound and delta encodes them, returning 0
+// if any value cannot be represented
+int quantise_doubles(const double* in, const size_t len,
+                     const double error_bound, uint64_t* out);
+
+// Reverses quantise_doubles
+void dequantise_doubles(const uint64_t* in, const size_t len,
+                        const double error_bound, double* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -7,6 +7,15 @@
 #include "data.k"
 #include <stdlib.h>
 
+// Whether the buffers from allocate_data can be accessed by the host
+int data_on_host(void) {
+#ifdef CUDA_MANAGED_MEM
+  return 1;
+#else
+  return 0;
+#endif
+}
+
 // Allocates some double precision data
 size_t allocate_data(double** buf, const size_t len) {
   if(len == 0) {
@@ -322,13 +331,21 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = h_values[nkeys - 4] * mesh_width;
-    double ypos = h_values[nkeys - 3] * mesh_height;
-    double width = h_values[nkeys - 2] * mesh_width;
-    double height = h_values[nkeys - 1] * mesh_height;
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, h_values, mesh_width,
+                             mesh_height, 0.0, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
 
-    for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
+    for (int kk = 0; kk < nfields; ++kk) {
       const char* key = &keys[kk * MAX_STR_LEN];
       if (strmatch(key, "density")) {
         h_keys[kk] = DENSITY_KEY;
@@ -348,7 +365,7 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
     // Introduce a problem
     const int nblocks = ceil(local_nx * local_ny / (double)NTHREADS);
     initialise_problem_state<<<nblocks, NTHREADS>>>(
-        local_nx, local_ny, nkeys, ndims, xpos, ypos, width, height, edgey,
+        local_nx, local_ny, nfields, xmin, xmax, ymin, ymax, edgey,
         edgex, density, energy, temperature, d_keys, d_values);
     gpu_check(cudaDeviceSynchronize());
   }
@@ -401,15 +418,23 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = h_values[nkeys - 6] * mesh_width;
-    double ypos = h_values[nkeys - 5] * mesh_height;
-    double zpos = h_values[nkeys - 4] * mesh_depth;
-    double width = h_values[nkeys - 3] * mesh_width;
-    double height = h_values[nkeys - 2] * mesh_height;
-    double depth = h_values[nkeys - 1] * mesh_depth;
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, h_values, mesh_width,
+                             mesh_height, mesh_depth, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
+    const double zmin = geometry.bound_z[0];
+    const double zmax = geometry.bound_z[1];
 
-    for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
+    for (int kk = 0; kk < nfields; ++kk) {
       const char* key = &keys[kk * MAX_STR_LEN];
       if (strmatch(key, "density")) {
         h_keys[kk] = DENSITY_KEY;
@@ -428,8 +453,8 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
 
     const int nblocks = ceil((local_nx*local_ny*local_nz)/(double)NTHREADS);
     initialise_problem_state_3d<<<nblocks, NTHREADS>>>(
-        local_nx, local_ny, local_nz, nkeys, ndims, xpos,  ypos,  zpos,  width,
-        height,  depth,  edgex, edgey,  edgez, density, energy, temperature, d_keys, d_values);
+        local_nx, local_ny, local_nz, nfields, xmin,  xmax,  ymin,  ymax,
+        zmin,  zmax,  edgex, edgey,  edgez, density, energy, temperature, d_keys, d_values);
     gpu_check(cudaDeviceSynchronize());
   }
 
@@ -441,3 +466,10 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
 void find_boundary_normals(UnstructuredMesh* umesh, int* boundary_edge_list) {
   TERMINATE("find_boundary_normals needs implementing.");
 }
+
+// Finds the normals for all boundary cells
+void find_boundary_normals_3d(UnstructuredMesh* umesh,
+                              int* boundary_face_list) {
+
+  TERMINATE("%s not yet implemented.", __func__);
+}
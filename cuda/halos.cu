@@ -136,7 +136,8 @@ void handle_boundary_2d(const int nx, const int ny, Mesh* mesh, double* arr,
     int nblocks = ceil(ny * pad / (double)NTHREADS);
     west_boundary<<<nblocks, NTHREADS>>>(nx, ny, pad, x_inversion_coeff, arr);
   }
-  STOP_PROFILING(&comms_profile, __func__);
+  STOP_PROFILING_TRAFFIC(&comms_profile, __func__,
+                         halo_traffic_2d(nx, ny, mesh, prepare), 0.0);
 
   gpu_check(cudaDeviceSynchronize());
 }
@@ -166,3 +167,15 @@ void handle_unstructured_reflect_3d(const int nnodes, const int* boundary_index,
   gpu_check(cudaDeviceSynchronize());
 
 }
+
+// Gathers the fields into the send buffer and starts the messages
+void begin_unstructured_exchange(UnstructuredExchange* exchange,
+                                 const int nfields, double** fields) {
+  TERMINATE("%s not yet implemented.", __func__);
+}
+
+// Waits for the messages and scatters the received values into the ghosts
+void end_unstructured_exchange(UnstructuredExchange* exchange,
+                               double** fields) {
+  TERMINATE("%s not yet implemented.", __func__);
+}
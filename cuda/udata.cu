@@ -41,14 +41,22 @@ void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the connectivity between nodes and faces
-void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
-    UnstructuredMesh* umesh) {
+size_t init_nodes_to_faces_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_faces, umesh->nnodes * NFACES_BY_NODE);
 
   int nblocks = ceil((nx+1)*(ny+1)*(nz+1)/(double)NTHREADS);
   nodes_to_faces_3d<<<nblocks, NTHREADS>>>(
       nx, ny, nz, umesh->nodes_to_faces_offsets, umesh->nodes_to_faces);
 
   gpu_check(cudaDeviceSynchronize());
+
+  return allocated;
 }
 
 // Initialises the cells to nodes connectivity
@@ -64,6 +72,18 @@ void init_cells_to_nodes_3d(const int nx, const int ny, const int nz,
   gpu_check(cudaDeviceSynchronize());
 }
 
+// Initialises the centroids of the cells
+void init_cell_centroids_3d(const int nx, const int ny, const int nz,
+    Mesh* mesh, UnstructuredMesh* umesh) {
+
+  int nblocks = ceil(nx*ny*nz/(double)NTHREADS);
+  cell_centroids_3d<<<nblocks, NTHREADS>>>(
+      nx, ny, nz, mesh->edgex, mesh->edgey, mesh->edgez,
+      umesh->cell_centroids_x, umesh->cell_centroids_y,
+      umesh->cell_centroids_z);
+  gpu_check(cudaDeviceSynchronize());
+}
+
 // Initialises the connectivity between faces and nodes
 void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
     UnstructuredMesh* umesh) {
@@ -86,8 +106,14 @@ void init_cells_to_faces_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the list of nodes to nodes
-void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
-    UnstructuredMesh* umesh) {
+size_t init_nodes_to_nodes_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_nodes, umesh->nnodes * NNODES_BY_NODE);
 
   int nblocks = ceil((umesh->nnodes+1)/(double)NTHREADS);
   nodes_to_nodes_offsets_3d<<<nblocks, NTHREADS>>>(
@@ -96,12 +122,17 @@ void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
   nblocks = ceil((nx+1)*(ny+1)*(nz+1)/(double)NTHREADS);
   nodes_to_nodes_3d<<<nblocks, NTHREADS>>>(nx, ny, nz, umesh->nodes_to_nodes);
   gpu_check(cudaDeviceSynchronize());
+
+  return allocated;
 }
 
 // Initialises the list of nodes to cells
-void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
+size_t init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
     Mesh* mesh, UnstructuredMesh* umesh) {
 
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_cells, umesh->nnodes * NCELLS_BY_NODE);
+
   int nblocks = ceil((nx+1)*(ny+1)*(nz+1)/(double)NTHREADS);
   nodes_3d<<<nblocks, NTHREADS>>>(
       nx, ny, nz, mesh->edgex, mesh->edgey, mesh->edgez, 
@@ -109,6 +140,8 @@ void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
 
   nodes_to_cells_3d<<<nblocks, NTHREADS>>>(nx, ny, nz, umesh->nodes_to_cells);
   gpu_check(cudaDeviceSynchronize());
+
+  return allocated;
 }
 
 // Initialises the boundary normals
@@ -0,0 +1,283 @@
+#include "geometry.h"
+#include "shared.h"
+#include <math.h>
+
+// Whether the mesh lists the faces of its cells
+static inline int has_faces(const UnstructuredMesh* umesh) {
+  return umesh->implicit || umesh->faces_to_nodes_offsets;
+}
+
+// The position of a node in the list of the nodes of its cell
+static inline int find_cell_node(const int nnodes, const int* nodes,
+                                 const int node_index) {
+  for (int nn = 0; nn < nnodes; ++nn) {
+    if (nodes[nn] == node_index) {
+      return nn;
+    }
+  }
+  return 0;
+}
+
+// Computes the centroid, sub-cell volumes and volume of a cell
+static void compute_cell_geometry(UnstructuredMesh* umesh, const int cc) {
+  const double* x = umesh->geometry_nodes_x;
+  const double* y = umesh->geometry_nodes_y;
+  const double* z = umesh->geometry_nodes_z;
+  int cell_nodes[GEOMETRY_MAX_NODES];
+  const int nnodes_by_cell = umesh_cell_nodes(umesh, cc, cell_nodes);
+
+  double c[3] = {0.0, 0.0, 0.0};
+  for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+    c[0] += x[(cell_nodes[nn])];
+    c[1] += y[(cell_nodes[nn])];
+    c[2] += z[(cell_nodes[nn])];
+  }
+  c[0] /= nnodes_by_cell;
+  c[1] /= nnodes_by_cell;
+  c[2] /= nnodes_by_cell;
+  umesh->cell_centroids_x[(cc)] = c[0];
+  umesh->cell_centroids_y[(cc)] = c[1];
+  umesh->cell_centroids_z[(cc)] = c[2];
+
+  double* sub_cell_volume =
+      &umesh->sub_cell_volume[(umesh_cell_node_offset(umesh, cc))];
+  for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+    sub_cell_volume[(nn)] = 0.0;
+  }
+
+  if (!has_faces(umesh)) {
+    // The triangles about the centroid of a polygon are split at the edge
+    // midpoints, and orientated by the sign of the whole area
+    double area = 0.0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      const int next = (nn + 1) % nnodes_by_cell;
+      const double ax = x[(cell_nodes[nn])] - c[0];
+      const double ay = y[(cell_nodes[nn])] - c[1];
+      const double bx = x[(cell_nodes[next])] - c[0];
+      const double by = y[(cell_nodes[next])] - c[1];
+      const double half_area = 0.25 * (ax * by - ay * bx);
+      sub_cell_volume[(nn)] += half_area;
+      sub_cell_volume[(next)] += half_area;
+      area += 2.0 * half_area;
+    }
+    const double sign = (area < 0.0) ? -1.0 : 1.0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      sub_cell_volume[(nn)] *= sign;
+    }
+    umesh->cell_volume[(cc)] = sign * area;
+    return;
+  }
+
+  double volume = 0.0;
+  const int nfaces_by_cell = umesh_cell_nfaces(umesh, cc);
+  for (int ff = 0; ff < nfaces_by_cell; ++ff) {
+    int face_nodes[GEOMETRY_MAX_NODES];
+    const int face_index = umesh_cell_face(umesh, cc, ff);
+    const int nnodes_by_face = umesh_face_nodes(umesh, face_index, face_nodes);
+    double f[3];
+    double area[3];
+    face_area_vector(umesh->geometry_nodes_x, umesh->geometry_nodes_y,
+                     umesh->geometry_nodes_z, nnodes_by_face, face_nodes, f,
+                     area);
+
+    // The tetrahedra are orientated by whether the face points outwards
+    const double fx = f[0] - c[0];
+    const double fy = f[1] - c[1];
+    const double fz = f[2] - c[2];
+    const double sign =
+        (area[0] * fx + area[1] * fy + area[2] * fz < 0.0) ? -1.0 : 1.0;
+
+    for (int nn = 0; nn < nnodes_by_face; ++nn) {
+      const int node0 = face_nodes[nn];
+      const int node1 = face_nodes[(nn + 1) % nnodes_by_face];
+      const double ax = x[(node0)] - f[0];
+      const double ay = y[(node0)] - f[1];
+      const double az = z[(node0)] - f[2];
+      const double bx = x[(node1)] - f[0];
+      const double by = y[(node1)] - f[1];
+      const double bz = z[(node1)] - f[2];
+
+      // Each half of the tetrahedron on an edge belongs to one of its nodes
+      const double half_volume =
+          sign *
+          (fx * (ay * bz - az * by) + fy * (az * bx - ax * bz) +
+           fz * (ax * by - ay * bx)) /
+          12.0;
+      sub_cell_volume[(find_cell_node(nnodes_by_cell, cell_nodes, node0))] +=
+          half_volume;
+      sub_cell_volume[(find_cell_node(nnodes_by_cell, cell_nodes, node1))] +=
+          half_volume;
+      volume += 2.0 * half_volume;
+    }
+  }
+  umesh->cell_volume[(cc)] = volume;
+}
+
+// Computes the area and unit normal of a face, orientated out of its first
+// cell by the cell centroids
+static void compute_face_geometry(UnstructuredMesh* umesh, const int ff) {
+  int face_nodes[GEOMETRY_MAX_NODES];
+  const int nnodes_by_face = umesh_face_nodes(umesh, ff, face_nodes);
+  double f[3];
+  double area[3];
+  face_area_vector(umesh->geometry_nodes_x, umesh->geometry_nodes_y,
+                     umesh->geometry_nodes_z, nnodes_by_face, face_nodes, f,
+                     area);
+
+  const int cell0 = umesh_face_cell(umesh, ff, 0);
+  const int cell_index = (cell0 != -1) ? cell0 : umesh_face_cell(umesh, ff, 1);
+  const double outwards =
+      area[0] * (f[0] - umesh->cell_centroids_x[(cell_index)]) +
+      area[1] * (f[1] - umesh->cell_centroids_y[(cell_index)]) +
+      area[2] * (f[2] - umesh->cell_centroids_z[(cell_index)]);
+  const double sign = ((outwards < 0.0) == (cell0 != -1)) ? -1.0 : 1.0;
+
+  const double face_area =
+      sqrt(area[0] * area[0] + area[1] * area[1] + area[2] * area[2]);
+  const double scale = (face_area > 0.0) ? sign / face_area : 0.0;
+  umesh->face_area[(ff)] = face_area;
+  umesh->face_normal_x[(ff)] = area[0] * scale;
+  umesh->face_normal_y[(ff)] = area[1] * scale;
+  umesh->face_normal_z[(ff)] = area[2] * scale;
+}
+
+// Allocates the geometry of the mesh and computes it at the nodes_*0
+// positions, returning the bytes allocated
+size_t init_umesh_geometry(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  // Without faces the cells can only be polygons in the xy plane
+  if (!has_faces(umesh)) {
+    double zmin = umesh->nodes_z0[(0)];
+    double zmax = umesh->nodes_z0[(0)];
+#pragma omp parallel for reduction(min : zmin) reduction(max : zmax)
+    for (int nn = 0; nn < umesh->nnodes; ++nn) {
+      zmin = min(zmin, umesh->nodes_z0[(nn)]);
+      zmax = max(zmax, umesh->nodes_z0[(nn)]);
+    }
+    if (zmin != zmax) {
+      TERMINATE("The geometry of a 3d mesh needs the faces of its cells.\n");
+    }
+  }
+
+  // The fixed size lists of the nodes of a cell and face must fit them all
+  int max_nodes = 0;
+#pragma omp parallel for reduction(max : max_nodes)
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    max_nodes = max(max_nodes, umesh_cell_nnodes(umesh, cc));
+  }
+  if (has_faces(umesh)) {
+#pragma omp parallel for reduction(max : max_nodes)
+    for (int ff = 0; ff < umesh->nfaces; ++ff) {
+      max_nodes = max(max_nodes, umesh_face_nnodes(umesh, ff));
+    }
+  }
+  if (max_nodes > GEOMETRY_MAX_NODES) {
+    TERMINATE("The mesh has %d nodes on a cell or face, the limit is %d.\n",
+              max_nodes, GEOMETRY_MAX_NODES);
+  }
+
+  size_t allocated = 0;
+  if (!umesh->cell_centroids_x) {
+    allocated += allocate_data(&umesh->cell_centroids_x, umesh->ncells);
+    allocated += allocate_data(&umesh->cell_centroids_y, umesh->ncells);
+    allocated += allocate_data(&umesh->cell_centroids_z, umesh->ncells);
+  }
+  allocated += allocate_data(&umesh->sub_cell_volume,
+                             umesh_cell_node_offset(umesh, umesh->ncells));
+  allocated += allocate_data(&umesh->cell_volume, umesh->ncells);
+  if (has_faces(umesh)) {
+    allocated += allocate_data(&umesh->face_area, umesh->nfaces);
+    allocated += allocate_data(&umesh->face_normal_x, umesh->nfaces);
+    allocated += allocate_data(&umesh->face_normal_y, umesh->nfaces);
+    allocated += allocate_data(&umesh->face_normal_z, umesh->nfaces);
+  }
+  allocated += allocate_data(&umesh->geometry_nodes_x, umesh->nnodes);
+  allocated += allocate_data(&umesh->geometry_nodes_y, umesh->nnodes);
+  allocated += allocate_data(&umesh->geometry_nodes_z, umesh->nnodes);
+
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->geometry_nodes_x[(nn)] = umesh->nodes_x0[(nn)];
+    umesh->geometry_nodes_y[(nn)] = umesh->nodes_y0[(nn)];
+    umesh->geometry_nodes_z[(nn)] = umesh->nodes_z0[(nn)];
+  }
+
+  compute_umesh_geometry(umesh);
+  return allocated;
+}
+
+// Recomputes all of the geometry at the positions it was last computed at
+void compute_umesh_geometry(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  // The face normals are orientated by the centroids of the cells
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    compute_cell_geometry(umesh, cc);
+  }
+  if (has_faces(umesh)) {
+#pragma omp parallel for
+    for (int ff = 0; ff < umesh->nfaces; ++ff) {
+      compute_face_geometry(umesh, ff);
+    }
+  }
+}
+
+// Recomputes the geometry of the faces and cells that touch a node whose
+// nodes_*1 position differs from the position the geometry was last computed
+// at, returning the number of nodes that moved
+int update_umesh_geometry(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  char* moved = (char*)malloc(sizeof(char) * umesh->nnodes);
+  if (!moved) {
+    TERMINATE("Could not allocate the moved nodes.\n");
+  }
+
+  int nmoved = 0;
+#pragma omp parallel for reduction(+ : nmoved)
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    moved[(nn)] = (umesh->nodes_x1[(nn)] != umesh->geometry_nodes_x[(nn)] ||
+                   umesh->nodes_y1[(nn)] != umesh->geometry_nodes_y[(nn)] ||
+                   umesh->nodes_z1[(nn)] != umesh->geometry_nodes_z[(nn)]);
+    if (moved[(nn)]) {
+      umesh->geometry_nodes_x[(nn)] = umesh->nodes_x1[(nn)];
+      umesh->geometry_nodes_y[(nn)] = umesh->nodes_y1[(nn)];
+      umesh->geometry_nodes_z[(nn)] = umesh->nodes_z1[(nn)];
+      nmoved++;
+    }
+  }
+
+  if (nmoved) {
+#pragma omp parallel for
+    for (int cc = 0; cc < umesh->ncells; ++cc) {
+      int cell_nodes[GEOMETRY_MAX_NODES];
+      const int nnodes_by_cell = umesh_cell_nodes(umesh, cc, cell_nodes);
+      int touched = 0;
+      for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+        touched |= moved[(cell_nodes[nn])];
+      }
+      if (touched) {
+        compute_cell_geometry(umesh, cc);
+      }
+    }
+  }
+  if (nmoved && has_faces(umesh)) {
+#pragma omp parallel for
+    for (int ff = 0; ff < umesh->nfaces; ++ff) {
+      int face_nodes[GEOMETRY_MAX_NODES];
+      const int nnodes_by_face = umesh_face_nodes(umesh, ff, face_nodes);
+      int touched = 0;
+      for (int nn = 0; nn < nnodes_by_face; ++nn) {
+        touched |= moved[(face_nodes[nn])];
+      }
+      if (touched) {
+        compute_face_geometry(umesh, ff);
+      }
+    }
+  }
+
+  free(moved);
+  return nmoved;
+}
@@ -0,0 +1,77 @@
+#ifndef __GEOMETRYHDR
+#define __GEOMETRYHDR
+
+#include "umesh.h"
+#include <stdlib.h>
+
+/*
+ *    UNSTRUCTURED MESH GEOMETRY
+ *    The face areas and normals, cell volumes, centroids and sub-cell volumes
+ *    are computed together and cached on the mesh. Each face is split into
+ *    triangles about its centre, and each cell into the tetrahedra that
+ *    those triangles make with its centroid. A sub-cell holds the halves of
+ *    the tetrahedra either side of the edge midpoints around its node, so
+ *    the sub-cell volumes of a cell sum to its volume. Meshes without faces
+ *    are treated as polygons in the xy plane, whose volume is their area.
+ */
+
+#define GEOMETRY_MAX_NODES 32 // Most nodes of a cell or face
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The centre and area vector of a face, whose nodes run around it, at the
+// node positions given
+static inline void face_area_vector(const double* x, const double* y,
+                                    const double* z, const int nnodes,
+                                    const int* nodes, double* centre,
+                                    double* area) {
+  centre[0] = 0.0;
+  centre[1] = 0.0;
+  centre[2] = 0.0;
+  for (int nn = 0; nn < nnodes; ++nn) {
+    centre[0] += x[(nodes[nn])];
+    centre[1] += y[(nodes[nn])];
+    centre[2] += z[(nodes[nn])];
+  }
+  centre[0] /= nnodes;
+  centre[1] /= nnodes;
+  centre[2] /= nnodes;
+
+  // Sums the area vectors of the triangles about the centre
+  area[0] = 0.0;
+  area[1] = 0.0;
+  area[2] = 0.0;
+  for (int nn = 0; nn < nnodes; ++nn) {
+    const int node0 = nodes[nn];
+    const int node1 = nodes[(nn + 1) % nnodes];
+    const double ax = x[(node0)] - centre[0];
+    const double ay = y[(node0)] - centre[1];
+    const double az = z[(node0)] - centre[2];
+    const double bx = x[(node1)] - centre[0];
+    const double by = y[(node1)] - centre[1];
+    const double bz = z[(node1)] - centre[2];
+    area[0] += 0.5 * (ay * bz - az * by);
+    area[1] += 0.5 * (az * bx - ax * bz);
+    area[2] += 0.5 * (ax * by - ay * bx);
+  }
+}
+
+// Allocates the geometry of the mesh and computes it at the nodes_*0
+// positions, returning the bytes allocated
+size_t init_umesh_geometry(UnstructuredMesh* umesh);
+
+// Recomputes all of the geometry at the positions it was last computed at
+void compute_umesh_geometry(UnstructuredMesh* umesh);
+
+// Recomputes the geometry of the faces and cells that touch a node whose
+// nodes_*1 position differs from the position the geometry was last computed
+// at, returning the number of nodes that moved
+int update_umesh_geometry(UnstructuredMesh* umesh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
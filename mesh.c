@@ -4,6 +4,17 @@
 #include <assert.h>
 #include <stdlib.h>
 
+// The edge, edge width and cell width arrays written along one dimension, with
+// the edge widths read back to position the edges
+static inline double mesh_data_init_bytes(const int n) {
+  return (double)(4 * (n + 1) + n) * sizeof(double);
+}
+
+// A division for each edge and cell width, and a multiply for each edge
+static inline double mesh_data_init_flops(const int n) {
+  return (double)(2 * (n + 1) + n);
+}
+
 // Initialise the mesh describing variables
 void initialise_mesh_2d(Mesh* mesh) {
   allocate_data(&mesh->edgex, (mesh->local_nx + 1));
@@ -13,10 +24,16 @@ void initialise_mesh_2d(Mesh* mesh) {
   allocate_data(&mesh->celldx, (mesh->local_nx + 1));
   allocate_data(&mesh->celldy, (mesh->local_ny + 1));
 
+  START_PROFILING(&compute_profile);
   mesh_data_init_2d(mesh->local_nx, mesh->local_ny, mesh->global_nx,
                     mesh->global_ny, mesh->pad, mesh->x_off, mesh->y_off,
                     mesh->width, mesh->height, mesh->edgex, mesh->edgey,
                     mesh->edgedx, mesh->edgedy, mesh->celldx, mesh->celldy);
+  STOP_PROFILING_TRAFFIC(&compute_profile, "mesh_data_init_2d",
+                         mesh_data_init_bytes(mesh->local_nx) +
+                             mesh_data_init_bytes(mesh->local_ny),
+                         mesh_data_init_flops(mesh->local_nx) +
+                             mesh_data_init_flops(mesh->local_ny));
 
   allocate_data(&mesh->north_buffer_out, (mesh->local_nx + 1) * mesh->pad);
   allocate_data(&mesh->east_buffer_out, (mesh->local_ny + 1) * mesh->pad);
@@ -55,12 +72,20 @@ void initialise_mesh_3d(Mesh* mesh) {
   allocate_data(&mesh->celldy, (mesh->local_ny + 1));
   allocate_data(&mesh->celldz, (mesh->local_nz + 1));
 
+  START_PROFILING(&compute_profile);
   mesh_data_init_3d(mesh->local_nx, mesh->local_ny, mesh->local_nz,
                     mesh->global_nx, mesh->global_ny, mesh->local_nz, mesh->pad,
                     mesh->x_off, mesh->y_off, mesh->z_off, mesh->width,
                     mesh->height, mesh->depth, mesh->edgex, mesh->edgey,
                     mesh->edgez, mesh->edgedx, mesh->edgedy, mesh->edgedz,
                     mesh->celldx, mesh->celldy, mesh->celldz);
+  STOP_PROFILING_TRAFFIC(&compute_profile, "mesh_data_init_3d",
+                         mesh_data_init_bytes(mesh->local_nx) +
+                             mesh_data_init_bytes(mesh->local_ny) +
+                             mesh_data_init_bytes(mesh->local_nz),
+                         mesh_data_init_flops(mesh->local_nx) +
+                             mesh_data_init_flops(mesh->local_ny) +
+                             mesh_data_init_flops(mesh->local_nz));
 
   allocate_data(&mesh->north_buffer_out,
                 (mesh->local_nx + 1) * (mesh->local_nz + 1) * mesh->pad);
@@ -227,7 +227,8 @@ void handle_boundary_2d(const int nx, const int ny, Mesh* mesh, double* arr,
       }
     }
   }
-  STOP_PROFILING(&comms_profile, __func__);
+  STOP_PROFILING_TRAFFIC(&comms_profile, __func__,
+                         halo_traffic_2d(nx, ny, mesh, pack), 0.0);
 }
 
 // Reflect the node centered velocities on the boundary
@@ -307,3 +308,15 @@ void handle_unstructured_reflect_3d(const int nnodes, const int* boundary_index,
     }
   }
 }
+
+// Gathers the fields into the send buffer and starts the messages
+void begin_unstructured_exchange(UnstructuredExchange* exchange,
+                                 const int nfields, double** fields) {
+  TERMINATE("%s not yet implemented.", __func__);
+}
+
+// Waits for the messages and scatters the received values into the ghosts
+void end_unstructured_exchange(UnstructuredExchange* exchange,
+                               double** fields) {
+  TERMINATE("%s not yet implemented.", __func__);
+}
@@ -1,3 +1,4 @@
+#include "../geometry.h"
 #include "../mesh.h"
 #include "../params.h"
 #include "../shared.h"
@@ -5,6 +6,9 @@
 #include <math.h>
 #include <stdlib.h>
 
+// Whether the buffers from allocate_data can be accessed by the host
+int data_on_host(void) { return 1; }
+
 // Allocates a double precision array
 size_t allocate_data(double** buf, size_t len) {
 #ifdef INTEL
@@ -251,6 +255,98 @@ void mesh_data_init_3d(const int local_nx, const int local_ny,
   }
 }
 
+// Finds the first cell in [lo, hi) whose edge is not below pos, relying on
+// the edges being monotonic
+static int find_edge_index(const double* edges, int lo, int hi,
+                           const double pos) {
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (edges[mid] < pos) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Resolves the keys of a problem entry to the fields that they set
+static void resolve_problem_keys(const int nkeys, const char* keys,
+                                 const char* problem_def_filename, double* rho,
+                                 double* e, double* x, double** fields) {
+  for (int kk = 0; kk < nkeys; ++kk) {
+    const char* key = &keys[kk * MAX_STR_LEN];
+    if (strmatch(key, "density")) {
+      fields[kk] = rho;
+    } else if (strmatch(key, "energy")) {
+      fields[kk] = e;
+    } else if (strmatch(key, "temperature")) {
+      fields[kk] = x;
+    } else {
+      TERMINATE("Found unrecognised key in %s : %s.\n", problem_def_filename,
+                key);
+    }
+  }
+}
+
+// Sets the cells of a row whose centres lie inside a curved region or behind
+// a plane, with the type hoisted so that each inside test vectorises
+static void set_geometry_row(const ProblemGeometry* geometry, const int x0,
+                             const int x1, const double* edgex,
+                             const double ypos, const double zpos,
+                             const double value, double* field) {
+  const double* centre = geometry->centre;
+  const double* normal = geometry->normal;
+  const double dy = ypos - centre[1];
+  const double dz = zpos - centre[2];
+  const double r2 = geometry->radius * geometry->radius;
+
+  if (geometry->type == SPHERE_GEOMETRY) {
+#pragma omp simd
+    for (int kk = x0; kk < x1; ++kk) {
+      const double dx = 0.5 * (edgex[kk] + edgex[kk + 1]) - centre[0];
+      field[kk] = (dx * dx + dy * dy + dz * dz < r2) ? value : field[kk];
+    }
+  } else if (geometry->type == CYLINDER_GEOMETRY) {
+    // Split the offsets into radial and axial components
+    const int axis = geometry->axis;
+    const double dyz2 = (axis == 0) ? dy * dy + dz * dz
+                                    : ((axis == 1) ? dz * dz : dy * dy);
+    const double dyz = (axis == 1) ? dy : ((axis == 2) ? dz : 0.0);
+    const double wx = (axis == 0) ? 0.0 : 1.0;
+    const double half_length = geometry->half_length;
+#pragma omp simd
+    for (int kk = x0; kk < x1; ++kk) {
+      const double dx = 0.5 * (edgex[kk] + edgex[kk + 1]) - centre[0];
+      const double da = (1.0 - wx) * dx + dyz;
+      field[kk] = (wx * dx * dx + dyz2 < r2 && fabs(da) <= half_length)
+                      ? value
+                      : field[kk];
+    }
+  } else if (geometry->type == PLANE_GEOMETRY) {
+    const double dyz = dy * normal[1] + dz * normal[2];
+#pragma omp simd
+    for (int kk = x0; kk < x1; ++kk) {
+      const double dx = 0.5 * (edgex[kk] + edgex[kk + 1]) - centre[0];
+      field[kk] = (dx * normal[0] + dyz <= 0.0) ? value : field[kk];
+    }
+  }
+}
+
+// Converts the bounds of a region into the range of cells that it covers
+static void find_geometry_range(const double* edges, const int n,
+                                const int pad, const int type,
+                                const double* bounds, int* c0, int* c1) {
+  *c0 = find_edge_index(edges, pad, n - pad, bounds[0]);
+  *c1 = find_edge_index(edges, *c0, n - pad, bounds[1]);
+
+  // Curved regions are tested at the cell centres so include the cell that
+  // straddles the lower bound
+  if (type != BOX_GEOMETRY && *c0 > pad) {
+    (*c0)--;
+  }
+}
+
 // Initialise state data in device specific manner
 void set_problem_2d(const int local_nx, const int local_ny, const int pad,
                     const double mesh_width, const double mesh_height,
@@ -259,6 +355,7 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
                     double* x) {
   char* keys = (char*)malloc(sizeof(char) * MAX_KEYS * MAX_STR_LEN);
   double* values = (double*)malloc(sizeof(double) * MAX_KEYS);
+  double* fields[MAX_KEYS];
 
   int nentries = 0;
   while (1) {
@@ -271,35 +368,36 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = values[nkeys - 4] * mesh_width;
-    double ypos = values[nkeys - 3] * mesh_height;
-    double width = values[nkeys - 2] * mesh_width;
-    double height = values[nkeys - 1] * mesh_height;
-
-    // Loop through the mesh and set the problem
-    for (int ii = pad; ii < local_ny - pad; ++ii) {
-      for (int jj = pad; jj < local_nx - pad; ++jj) {
-        double global_xpos = edgex[jj];
-        double global_ypos = edgey[ii];
-
-        // Check we are in bounds of the problem entry
-        if (global_xpos >= xpos && global_ypos >= ypos &&
-            global_xpos < xpos + width && global_ypos < ypos + height) {
-          // The upper bound excludes the bounding box for the entry
-          for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
-            const char* key = &keys[kk * MAX_STR_LEN];
-            if (strmatch(key, "density")) {
-              rho[ii * local_nx + jj] = values[kk];
-            } else if (strmatch(key, "energy")) {
-              e[ii * local_nx + jj] = values[kk];
-            } else if (strmatch(key, "temperature")) {
-              x[ii * local_nx + jj] = values[kk];
-            } else {
-              TERMINATE("Found unrecognised key in %s : %s.\n",
-                        problem_def_filename, key);
-            }
+    // Either the last four keys bound a box or the keys describe a shape
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, values, mesh_width,
+                             mesh_height, 0.0, &geometry);
+    resolve_problem_keys(nfields, keys, problem_def_filename, rho, e, x,
+                         fields);
+
+    // Convert the bounds into the range of cells that they cover
+    int x0, x1, y0, y1;
+    find_geometry_range(edgex, local_nx, pad, geometry.type, geometry.bound_x,
+                        &x0, &x1);
+    find_geometry_range(edgey, local_ny, pad, geometry.type, geometry.bound_y,
+                        &y0, &y1);
+
+    // Only the covered cells are set
+    for (int ff = 0; ff < nfields; ++ff) {
+      double* field = fields[ff];
+      const double value = values[ff];
+#pragma omp parallel for
+      for (int ii = y0; ii < y1; ++ii) {
+        if (geometry.type == BOX_GEOMETRY) {
+#pragma omp simd
+          for (int jj = x0; jj < x1; ++jj) {
+            field[ii * local_nx + jj] = value;
           }
+        } else {
+          const double ypos = 0.5 * (edgey[ii] + edgey[ii + 1]);
+          set_geometry_row(&geometry, x0, x1, edgex, ypos, 0.0, value,
+                           &field[ii * local_nx]);
         }
       }
     }
@@ -319,6 +417,7 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
                     double* x) {
   char* keys = (char*)malloc(sizeof(char) * MAX_KEYS * MAX_STR_LEN);
   double* values = (double*)malloc(sizeof(double) * MAX_KEYS);
+  double* fields[MAX_KEYS];
 
   int nentries = 0;
   while (1) {
@@ -331,42 +430,41 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = values[nkeys - 6] * mesh_width;
-    double ypos = values[nkeys - 5] * mesh_height;
-    double zpos = values[nkeys - 4] * mesh_depth;
-    double width = values[nkeys - 3] * mesh_width;
-    double height = values[nkeys - 2] * mesh_height;
-    double depth = values[nkeys - 1] * mesh_depth;
-
-    // Loop through the mesh and set the problem
-    for (int ii = pad; ii < local_nz - pad; ++ii) {
-      for (int jj = pad; jj < local_ny - pad; ++jj) {
-        for (int kk = pad; kk < local_nx - pad; ++kk) {
-          double global_xpos = edgex[kk];
-          double global_ypos = edgey[jj];
-          double global_zpos = edgez[ii];
-
-          // Check we are in bounds of the problem entry
-          if (global_xpos >= xpos && global_ypos >= ypos &&
-              global_zpos >= zpos && global_xpos < xpos + width &&
-              global_ypos < ypos + height && global_zpos < zpos + depth) {
-            // The upper bound excludes the bounding box for the entry
-            for (int ee = 0; ee < nkeys - (2 * ndims); ++ee) {
-              const int index =
-                  (ii * local_nx * local_ny) + (jj * local_nx) + (kk);
-              const char* key = &keys[ee * MAX_STR_LEN];
-              if (strmatch(key, "density")) {
-                rho[(index)] = values[ee];
-              } else if (strmatch(key, "energy")) {
-                e[(index)] = values[ee];
-              } else if (strmatch(key, "temperature")) {
-                x[(index)] = values[ee];
-              } else {
-                TERMINATE("Found unrecognised key in %s : %s.\n",
-                          problem_def_filename, key);
-              }
+    // Either the last six keys bound a box or the keys describe a shape
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, values, mesh_width,
+                             mesh_height, mesh_depth, &geometry);
+    resolve_problem_keys(nfields, keys, problem_def_filename, rho, e, x,
+                         fields);
+
+    // Convert the bounds into the range of cells that they cover
+    int x0, x1, y0, y1, z0, z1;
+    find_geometry_range(edgex, local_nx, pad, geometry.type, geometry.bound_x,
+                        &x0, &x1);
+    find_geometry_range(edgey, local_ny, pad, geometry.type, geometry.bound_y,
+                        &y0, &y1);
+    find_geometry_range(edgez, local_nz, pad, geometry.type, geometry.bound_z,
+                        &z0, &z1);
+
+    // Only the covered cells are set
+    for (int ff = 0; ff < nfields; ++ff) {
+      double* field = fields[ff];
+      const double value = values[ff];
+#pragma omp parallel for
+      for (int ii = z0; ii < z1; ++ii) {
+        for (int jj = y0; jj < y1; ++jj) {
+          const int row = (ii * local_nx * local_ny) + (jj * local_nx);
+          if (geometry.type == BOX_GEOMETRY) {
+#pragma omp simd
+            for (int kk = x0; kk < x1; ++kk) {
+              field[row + kk] = value;
             }
+          } else {
+            const double ypos = 0.5 * (edgey[jj] + edgey[jj + 1]);
+            const double zpos = 0.5 * (edgez[ii] + edgez[ii + 1]);
+            set_geometry_row(&geometry, x0, x1, edgex, ypos, zpos, value,
+                             &field[row]);
           }
         }
       }
@@ -377,9 +475,118 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
   free(values);
 }
 
+#define BOUNDARY_MAX_CLUSTERS 3 // Distinct normals that make a corner
+
+// Adds an area weighted normal to the group of normals around a boundary
+// node that it points along, or starts a new group, returning the number of
+// groups
+static int cluster_boundary_normal(const double* normal, const int nclusters,
+                                   double clusters[][3]) {
+  const double mag = sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                          normal[2] * normal[2]);
+  if (mag == 0.0) {
+    return nclusters;
+  }
+  for (int cc = 0; cc < min(nclusters, BOUNDARY_MAX_CLUSTERS); ++cc) {
+    const double cluster_mag =
+        sqrt(clusters[cc][0] * clusters[cc][0] +
+             clusters[cc][1] * clusters[cc][1] +
+             clusters[cc][2] * clusters[cc][2]);
+    const double dot = normal[0] * clusters[cc][0] +
+                       normal[1] * clusters[cc][1] +
+                       normal[2] * clusters[cc][2];
+    if (dot >= BOUNDARY_CREASE_COS * mag * cluster_mag) {
+      clusters[cc][0] += normal[0];
+      clusters[cc][1] += normal[1];
+      clusters[cc][2] += normal[2];
+      return nclusters;
+    }
+  }
+  if (nclusters < BOUNDARY_MAX_CLUSTERS) {
+    clusters[nclusters][0] = normal[0];
+    clusters[nclusters][1] = normal[1];
+    clusters[nclusters][2] = normal[2];
+  }
+  return nclusters + 1;
+}
+
+// Sets the type and normal of a boundary node from the groups of normals
+// around it. A 3d node between two groups is on an edge, and its normal is
+// the direction along the edge with its largest component positive.
+static void classify_boundary_node(UnstructuredMesh* umesh, const int index,
+                                   const int ndims, const int nclusters,
+                                   double clusters[][3]) {
+  double normal[3] = {0.0, 0.0, 0.0};
+  if (ndims == 3 && nclusters == 2) {
+    umesh->boundary_type[(index)] = IS_EDGE;
+    normal[0] =
+        clusters[0][1] * clusters[1][2] - clusters[0][2] * clusters[1][1];
+    normal[1] =
+        clusters[0][2] * clusters[1][0] - clusters[0][0] * clusters[1][2];
+    normal[2] =
+        clusters[0][0] * clusters[1][1] - clusters[0][1] * clusters[1][0];
+    int largest = 0;
+    for (int dd = 1; dd < 3; ++dd) {
+      largest = (fabs(normal[dd]) > fabs(normal[largest])) ? dd : largest;
+    }
+    if (normal[largest] < 0.0) {
+      normal[0] = -normal[0];
+      normal[1] = -normal[1];
+      normal[2] = -normal[2];
+    }
+  } else if (ndims == 3 && nclusters > 2) {
+    umesh->boundary_type[(index)] = IS_CORNER;
+  } else {
+    // In 2d the corners keep the average of their normals
+    umesh->boundary_type[(index)] = (nclusters > 1) ? IS_CORNER : IS_BOUNDARY;
+    for (int cc = 0; cc < min(nclusters, BOUNDARY_MAX_CLUSTERS); ++cc) {
+      normal[0] += clusters[cc][0];
+      normal[1] += clusters[cc][1];
+      normal[2] += clusters[cc][2];
+    }
+  }
+
+  const double normal_mag = sqrt(normal[0] * normal[0] +
+                                 normal[1] * normal[1] + normal[2] * normal[2]);
+  const double scale = (normal_mag > 0.0) ? 1.0 / normal_mag : 0.0;
+  umesh->boundary_normal_x[(index)] = normal[0] * scale;
+  umesh->boundary_normal_y[(index)] = normal[1] * scale;
+  if (ndims == 3) {
+    umesh->boundary_normal_z[(index)] = normal[2] * scale;
+  }
+}
+
 // Finds the normals for all boundary cells
 void find_boundary_normals(UnstructuredMesh* umesh, int* boundary_face_list) {
-// Loop through all of the boundary cells and find their normals
+  // A closed boundary has as many edges as nodes, and the edges around each
+  // node are the transpose of the list of edges
+  const int nboundary_edges = umesh->nboundary_nodes;
+  int* edge_offsets;
+  int* node_edge_offsets;
+  int* node_edges = NULL;
+  double* edge_normals;
+  allocate_int_data(&edge_offsets, nboundary_edges + 1);
+  allocate_int_data(&node_edge_offsets, umesh->nnodes + 1);
+  allocate_data(&edge_normals, 2 * nboundary_edges);
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nboundary_edges + 1; ++bb) {
+    edge_offsets[(bb)] = 2 * bb;
+  }
+  build_csr_transpose(nboundary_edges, edge_offsets, boundary_face_list,
+                      umesh->nnodes, node_edge_offsets, &node_edges);
+
+  // The normals point to the left of each edge, weighted by its length
+#pragma omp parallel for
+  for (int bb = 0; bb < nboundary_edges; ++bb) {
+    const int node0 = boundary_face_list[(bb * 2)];
+    const int node1 = boundary_face_list[(bb * 2 + 1)];
+    edge_normals[(bb * 2)] =
+        umesh->nodes_y0[(node0)] - umesh->nodes_y0[(node1)];
+    edge_normals[(bb * 2 + 1)] =
+        -(umesh->nodes_x0[(node0)] - umesh->nodes_x0[(node1)]);
+  }
+
 #pragma omp parallel for
   for (int nn = 0; nn < umesh->nnodes; ++nn) {
     const int boundary_index = umesh->boundary_index[(nn)];
@@ -387,81 +594,122 @@ void find_boundary_normals(UnstructuredMesh* umesh, int* boundary_face_list) {
       continue;
     }
 
-    double normal_x = 0.0;
-    double normal_y = 0.0;
-
-    for (int bb1 = 0; bb1 < umesh->nboundary_nodes; ++bb1) {
-      const int node0 = boundary_face_list[bb1 * 2];
-      const int node1 = boundary_face_list[bb1 * 2 + 1];
-
-      if (node0 == nn || node1 == nn) {
-        const double node0_x = umesh->nodes_x0[(node0)];
-        const double node0_y = umesh->nodes_y0[(node0)];
-        const double node1_x = umesh->nodes_x0[(node1)];
-        const double node1_y = umesh->nodes_y0[(node1)];
-
-        normal_x += node0_y - node1_y;
-        normal_y += -(node0_x - node1_x);
-      }
-    }
-
-    // We are fixed if we are one of the four corners
-    if ((umesh->nodes_x0[(nn)] == 0.0 || umesh->nodes_x0[(nn)] == 1.0) &&
-        (umesh->nodes_y0[(nn)] == 0.0 || umesh->nodes_y0[(nn)] == 1.0)) {
-      umesh->boundary_type[(boundary_index)] = IS_CORNER;
-    } else {
-      umesh->boundary_type[(boundary_index)] = IS_BOUNDARY;
+    double clusters[BOUNDARY_MAX_CLUSTERS][3];
+    int nclusters = 0;
+    for (int ee = node_edge_offsets[(nn)]; ee < node_edge_offsets[(nn + 1)];
+         ++ee) {
+      const int edge_index = node_edges[(ee)];
+      const double normal[3] = {edge_normals[(edge_index * 2)],
+                                edge_normals[(edge_index * 2 + 1)], 0.0};
+      nclusters = cluster_boundary_normal(normal, nclusters, clusters);
     }
-
-    const double normal_mag = sqrt(normal_x * normal_x + normal_y * normal_y);
-    umesh->boundary_normal_x[(boundary_index)] = normal_x / normal_mag;
-    umesh->boundary_normal_y[(boundary_index)] = normal_y / normal_mag;
+    classify_boundary_node(umesh, boundary_index, 2, nclusters, clusters);
   }
+
+  deallocate_int_data(edge_offsets);
+  deallocate_int_data(node_edge_offsets);
+  deallocate_int_data(node_edges);
+  deallocate_data(edge_normals);
 }
 
 // Finds the normals for all boundary cells
 void find_boundary_normals_3d(UnstructuredMesh* umesh,
                               int* boundary_face_list) {
+  if (!umesh->implicit && !umesh->faces_to_nodes_offsets) {
+    TERMINATE("The boundary normals of a 3d mesh need its faces.\n");
+  }
+
+  const int nrows =
+      boundary_face_list ? umesh->nboundary_faces : umesh->nfaces;
 
-  TERMINATE("%s not yet implemented.", __func__);
-#if 0
-// Loop through all of the boundary cells and find their normals
+  // The faces are listed with the stride of the largest face, padded with
+  // entries that the transpose skips
+  int stride = 0;
+#pragma omp parallel for reduction(max : stride)
+  for (int rr = 0; rr < nrows; ++rr) {
+    const int face_index = boundary_face_list ? boundary_face_list[(rr)] : rr;
+    stride = max(stride, umesh_face_nnodes(umesh, face_index));
+  }
+
+  int* face_offsets;
+  int* face_nodes;
+  int* node_face_offsets;
+  int* node_faces = NULL;
+  double* face_normals;
+  allocate_int_data(&face_offsets, nrows + 1);
+  allocate_int_data(&face_nodes, (size_t)nrows * stride);
+  allocate_int_data(&node_face_offsets, umesh->nnodes + 1);
+  allocate_data(&face_normals, 3 * nrows);
+
+  // The area weighted normal of each face points away from its cell
 #pragma omp parallel for
-  for (int nn = 0; nn < umesh->nnodes; ++nn) {
-    const int boundary_index = umesh->boundary_index[(nn)];
-    if (boundary_index == IS_INTERIOR) {
+  for (int rr = 0; rr < nrows + 1; ++rr) {
+    face_offsets[(rr)] = rr * stride;
+  }
+#pragma omp parallel for
+  for (int rr = 0; rr < nrows; ++rr) {
+    const int face_index = boundary_face_list ? boundary_face_list[(rr)] : rr;
+    const int cell0 = umesh_face_cell(umesh, face_index, 0);
+    const int cell1 = umesh_face_cell(umesh, face_index, 1);
+    int* nodes = &face_nodes[(rr * stride)];
+    for (int nn = 0; nn < stride; ++nn) {
+      nodes[(nn)] = -1;
+    }
+    if (!boundary_face_list && cell0 != -1 && cell1 != -1) {
       continue;
     }
+    const int nnodes_by_face = umesh_face_nodes(umesh, face_index, nodes);
+
+    double f[3];
+    double area[3];
+    face_area_vector(umesh->nodes_x0, umesh->nodes_y0, umesh->nodes_z0,
+                     nnodes_by_face, nodes, f, area);
+
+    const int cell_index = (cell0 != -1) ? cell0 : cell1;
+    const int nnodes_by_cell = umesh_cell_nnodes(umesh, cell_index);
+    double outwards = 0.0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      const int node_index = umesh_cell_node(umesh, cell_index, nn);
+      outwards += area[0] * (f[0] - umesh->nodes_x0[(node_index)]) +
+                  area[1] * (f[1] - umesh->nodes_y0[(node_index)]) +
+                  area[2] * (f[2] - umesh->nodes_z0[(node_index)]);
+    }
+    const double sign = (outwards < 0.0) ? -1.0 : 1.0;
+    face_normals[(rr * 3)] = sign * area[0];
+    face_normals[(rr * 3 + 1)] = sign * area[1];
+    face_normals[(rr * 3 + 2)] = sign * area[2];
+  }
+  build_csr_transpose(nrows, face_offsets, face_nodes, umesh->nnodes,
+                      node_face_offsets, &node_faces);
 
-    double normal_x = 0.0;
-    double normal_y = 0.0;
-
-    for (int bb1 = 0; bb1 < umesh->nboundary_faces; ++bb1) {
-      const int node0 = boundary_face_list[bb1 * 2];
-      const int node1 = boundary_face_list[bb1 * 2 + 1];
-
-      if (node0 == nn || node1 == nn) {
-        const double node0_x = umesh->nodes_x0[(node0)];
-        const double node0_y = umesh->nodes_y0[(node0)];
-        const double node1_x = umesh->nodes_x0[(node1)];
-        const double node1_y = umesh->nodes_y0[(node1)];
+  // The nodes on a boundary face are renumbered as the boundary nodes
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->boundary_type[(nn)] =
+        (node_face_offsets[(nn + 1)] > node_face_offsets[(nn)]);
+  }
+  umesh->nboundary_nodes = enumerate_boundary_nodes(umesh);
 
-        normal_x += node0_y - node1_y;
-        normal_y += -(node0_x - node1_x);
-      }
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    const int boundary_index = umesh->boundary_index[(nn)];
+    if (boundary_index == IS_INTERIOR) {
+      continue;
     }
 
-    // We are fixed if we are one of the four corners
-    if ((umesh->nodes_x0[(nn)] == 0.0 || umesh->nodes_x0[(nn)] == 1.0) &&
-        (umesh->nodes_y0[(nn)] == 0.0 || umesh->nodes_y0[(nn)] == 1.0)) {
-      umesh->boundary_type[(boundary_index)] = IS_CORNER;
-    } else {
-      umesh->boundary_type[(boundary_index)] = IS_BOUNDARY;
+    double clusters[BOUNDARY_MAX_CLUSTERS][3];
+    int nclusters = 0;
+    for (int ff = node_face_offsets[(nn)]; ff < node_face_offsets[(nn + 1)];
+         ++ff) {
+      nclusters = cluster_boundary_normal(&face_normals[(node_faces[(ff)] * 3)],
+                                          nclusters, clusters);
     }
-
-    const double normal_mag = sqrt(normal_x * normal_x + normal_y * normal_y);
-    umesh->boundary_normal_x[(boundary_index)] = normal_x / normal_mag;
-    umesh->boundary_normal_y[(boundary_index)] = normal_y / normal_mag;
+    classify_boundary_node(umesh, boundary_index, 3, nclusters, clusters);
   }
-#endif // if 0
+
+  deallocate_int_data(face_offsets);
+  deallocate_int_data(face_nodes);
+  deallocate_int_data(node_face_offsets);
+  deallocate_int_data(node_faces);
+  deallocate_data(face_normals);
 }
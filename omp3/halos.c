@@ -166,15 +166,16 @@ void handle_boundary_2d(const int nx, const int ny, Mesh* mesh, double* arr,
       }
     }
   }
-  STOP_PROFILING(&comms_profile, __func__);
+  STOP_PROFILING_TRAFFIC(&comms_profile, __func__,
+                         halo_traffic_2d(nx, ny, mesh, pack), 0.0);
 }
 
 // Enforce reflective boundary conditions on the problem state
 void handle_boundary_3d(const int nx, const int ny, const int nz, Mesh* mesh,
                         double* arr, const int invert, const int pack) {
-#if 0
   START_PROFILING(&comms_profile);
 
+  const int pad = mesh->pad;
   int* neighbours = mesh->neighbours;
 
 #ifdef MPI
@@ -449,7 +450,6 @@ void handle_boundary_3d(const int nx, const int ny, const int nz, Mesh* mesh,
   }
 
   STOP_PROFILING(&comms_profile, __func__);
-#endif // if 0
 }
 
 // Reflect the node centered velocities on the boundary
@@ -521,3 +521,63 @@ void handle_unstructured_reflect_3d(const int nnodes, const int* boundary_index,
     }
   }
 }
+
+// Gathers the fields into the send buffer and starts the messages, so that
+// work that does not touch the ghosts can overlap the exchange
+void begin_unstructured_exchange(UnstructuredExchange* exchange,
+                                 const int nfields, double** fields) {
+  START_PROFILING(&comms_profile);
+
+  const UnstructuredHalo* halo = exchange->halo;
+  if (nfields > exchange->max_fields) {
+    TERMINATE("The exchange was prepared for at most %d fields.\n",
+              exchange->max_fields);
+  }
+  exchange->nfields = nfields;
+
+  // Each neighbour's message holds its entries for every field in turn, and
+  // the send lists ascend so the gathers stream through the fields
+#pragma omp parallel
+  for (int nb = 0; nb < halo->nneighbours; ++nb) {
+    const int off = halo->send_offsets[nb];
+    const int nsend = halo->send_offsets[nb + 1] - off;
+    for (int ff = 0; ff < nfields; ++ff) {
+      const double* field = fields[ff];
+      const int* send_list = &halo->send_list[off];
+      double* buffer = &exchange->send_buffer[off * nfields + ff * nsend];
+#pragma omp for nowait
+      for (int ii = 0; ii < nsend; ++ii) {
+        buffer[ii] = field[(send_list[ii])];
+      }
+    }
+  }
+
+  STOP_PROFILING(&comms_profile, __func__);
+  post_unstructured_messages(exchange);
+}
+
+// Waits for the messages and scatters the received values into the ghosts
+void end_unstructured_exchange(UnstructuredExchange* exchange,
+                               double** fields) {
+  wait_on_unstructured_messages(exchange);
+  START_PROFILING(&comms_profile);
+
+  const UnstructuredHalo* halo = exchange->halo;
+  const int nfields = exchange->nfields;
+#pragma omp parallel
+  for (int nb = 0; nb < halo->nneighbours; ++nb) {
+    const int off = halo->recv_offsets[nb];
+    const int nrecv = halo->recv_offsets[nb + 1] - off;
+    for (int ff = 0; ff < nfields; ++ff) {
+      double* field = fields[ff];
+      const int* recv_list = &halo->recv_list[off];
+      const double* buffer = &exchange->recv_buffer[off * nfields + ff * nrecv];
+#pragma omp for nowait
+      for (int ii = 0; ii < nrecv; ++ii) {
+        field[(recv_list[ii])] = buffer[ii];
+      }
+    }
+  }
+
+  STOP_PROFILING(&comms_profile, __func__);
+}
@@ -84,57 +84,13 @@ void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the connectivity between nodes and faces
-void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
-
-// Determine the connectivity of nodes to faces
-#pragma omp parallel for
-  for (int ii = 0; ii < (nz + 1); ++ii) {
-    for (int jj = 0; jj < (ny + 1); ++jj) {
-      for (int kk = 0; kk < (nx + 1); ++kk) {
-        const int node_index =
-            (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-        const int node_to_faces_off =
-            umesh->nodes_to_faces_offsets[(node_index)];
-
-        umesh->nodes_to_faces[(node_to_faces_off + 0)] =
-            (ii < nz && kk < nx) ? XZPLANE_FACE_INDEX(ii, jj, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 1)] =
-            (jj < ny && kk < nx) ? XYPLANE_FACE_INDEX(ii, jj, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 2)] =
-            (ii < nz && jj < ny) ? YZPLANE_FACE_INDEX(ii, jj, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 3)] =
-            (ii < nz && kk > 0) ? XZPLANE_FACE_INDEX(ii, jj, kk - 1) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 4)] =
-            (jj < ny && kk > 0) ? XYPLANE_FACE_INDEX(ii, jj, kk - 1) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 5)] =
-            (ii > 0 && kk < nx) ? XZPLANE_FACE_INDEX(ii - 1, jj, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 6)] =
-            (ii > 0 && jj < ny) ? YZPLANE_FACE_INDEX(ii - 1, jj, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 7)] =
-            (ii > 0 && kk > 0) ? XZPLANE_FACE_INDEX(ii - 1, jj, kk - 1) : -1;
+size_t init_nodes_to_faces_3d(UnstructuredMesh* umesh) {
 
-        umesh->nodes_to_faces[(node_to_faces_off + 8)] =
-            (jj > 0 && kk < nx) ? XYPLANE_FACE_INDEX(ii, jj - 1, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 9)] =
-            (jj > 0 && kk > 0) ? XYPLANE_FACE_INDEX(ii, jj - 1, kk - 1) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 10)] =
-            (ii > 0 && jj > 0) ? YZPLANE_FACE_INDEX(ii - 1, jj - 1, kk) : -1;
-
-        umesh->nodes_to_faces[(node_to_faces_off + 11)] =
-            (ii < nz && jj > 0) ? YZPLANE_FACE_INDEX(ii, jj - 1, kk) : -1;
-      }
-    }
-  }
+  // The faces surrounding each node are the transpose of the faces to nodes
+  return build_csr_transpose(umesh->nfaces, umesh->faces_to_nodes_offsets,
+                             umesh->faces_to_nodes, umesh->nnodes,
+                             umesh->nodes_to_faces_offsets,
+                             &umesh->nodes_to_faces);
 }
 
 // Initialises the cells to nodes connectivity
@@ -181,6 +137,26 @@ void init_cells_to_nodes_3d(const int nx, const int ny, const int nz,
   }
 }
 
+// Initialises the centroids of the cells
+void init_cell_centroids_3d(const int nx, const int ny, const int nz,
+                            Mesh* mesh, UnstructuredMesh* umesh) {
+
+#pragma omp parallel for
+  for (int ii = 0; ii < nz; ++ii) {
+    for (int jj = 0; jj < ny; ++jj) {
+      for (int kk = 0; kk < nx; ++kk) {
+        const int cell_index = (ii * nx * ny) + (jj * nx) + (kk);
+        umesh->cell_centroids_x[(cell_index)] =
+            0.5 * (mesh->edgex[(kk)] + mesh->edgex[(kk + 1)]);
+        umesh->cell_centroids_y[(cell_index)] =
+            0.5 * (mesh->edgey[(jj)] + mesh->edgey[(jj + 1)]);
+        umesh->cell_centroids_z[(cell_index)] =
+            0.5 * (mesh->edgez[(ii)] + mesh->edgez[(ii + 1)]);
+      }
+    }
+  }
+}
+
 // Initialises the connectivity between faces and nodes
 void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
                             UnstructuredMesh* umesh) {
@@ -209,7 +185,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
         umesh->faces_to_nodes[(face_to_node_off + 3)] =
             (ii * (nx + 1) * (ny + 1)) + ((jj + 1) * (nx + 1)) + (kk);
 
-        if (ii < nz + 1) {
+        if (ii < nz) {
           umesh->faces_cclockwise_cell[(face_index)] =
               (ii * nx * ny) + (jj * nx) + (kk);
         }
@@ -237,7 +213,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             umesh->faces_to_nodes[(face_to_node_off + 3)] =
                 ((ii + 1) * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
 
-            if (kk < nx + 1) {
+            if (kk < nx) {
               umesh->faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -261,7 +237,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             umesh->faces_to_nodes[(face_to_node_off + 3)] =
                 (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk + 1);
 
-            if (jj < ny + 1) {
+            if (jj < ny) {
               umesh->faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -307,62 +283,15 @@ void init_cells_to_faces_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the list of nodes to nodes
-void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
-
-// Prefix sum to convert the counts to offsets
-#pragma omp parallel for
-  for (int nn = 0; nn < umesh->nnodes + 1; ++nn) {
-    umesh->nodes_to_nodes_offsets[(nn)] = nn * NNODES_BY_NODE;
-  }
-
-// Initialise the offsets and list of nodes to cells, counter-clockwise order
-#pragma omp parallel for
-  for (int ii = 0; ii < (nz + 1); ++ii) {
-    for (int jj = 0; jj < (ny + 1); ++jj) {
-      for (int kk = 0; kk < (nx + 1); ++kk) {
-        const int node_index =
-            (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-
-        int off = umesh->nodes_to_nodes_offsets[(node_index)];
-
-        // Initialise all to boundary
-        for (int nn = 0; nn < NNODES_BY_NODE; ++nn) {
-          umesh->nodes_to_nodes[(off + nn)] = -1;
-        }
+size_t init_nodes_to_nodes_3d(UnstructuredMesh* umesh) {
 
-        if (kk < nx) {
-          umesh->nodes_to_nodes[(off++)] =
-              (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk + 1);
-        }
-        if (kk > 0) {
-          umesh->nodes_to_nodes[(off++)] =
-              (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk - 1);
-        }
-        if (jj < ny) {
-          umesh->nodes_to_nodes[(off++)] =
-              (ii * (nx + 1) * (ny + 1)) + ((jj + 1) * (nx + 1)) + (kk);
-        }
-        if (jj > 0) {
-          umesh->nodes_to_nodes[(off++)] =
-              (ii * (nx + 1) * (ny + 1)) + ((jj - 1) * (nx + 1)) + (kk);
-        }
-        if (ii < nz) {
-          umesh->nodes_to_nodes[(off++)] =
-              ((ii + 1) * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-        }
-        if (ii > 0) {
-          umesh->nodes_to_nodes[(off++)] =
-              ((ii - 1) * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-        }
-      }
-    }
-  }
+  // The neighbouring nodes are those along the edges of the faces
+  return fill_nodes_to_nodes(umesh);
 }
 
 // Initialises the list of nodes to cells
-void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
-                            Mesh* mesh, UnstructuredMesh* umesh) {
+size_t init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
+                              Mesh* mesh, UnstructuredMesh* umesh) {
 
 #pragma omp parallel for
   for (int ii = 0; ii < (nz + 1); ++ii) {
@@ -378,138 +307,43 @@ void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
     }
   }
 
-// Override the original initialisation of the nodes_to_cells layout
-#pragma omp parallel for
-  for (int ii = 0; ii < (nz + 1); ++ii) {
-    for (int jj = 0; jj < (ny + 1); ++jj) {
-      for (int kk = 0; kk < (nx + 1); ++kk) {
-        const int node_index =
-            (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
+  // The cells surrounding each node are the transpose of the cells to nodes
+  return fill_nodes_to_cells(umesh);
+}
 
-        // Fill in all of the cells that surround a node
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 0] =
-            (ii > 0 && jj > 0 && kk > 0)
-                ? ((ii - 1) * nx * ny) + ((jj - 1) * nx) + (kk - 1)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 1] =
-            (ii > 0 && jj > 0 && kk < nx)
-                ? ((ii - 1) * nx * ny) + ((jj - 1) * nx) + (kk)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 2] =
-            (ii > 0 && jj < ny && kk > 0)
-                ? ((ii - 1) * nx * ny) + (jj * nx) + (kk - 1)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 3] =
-            (ii > 0 && jj < ny && kk < nx)
-                ? ((ii - 1) * nx * ny) + (jj * nx) + (kk)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 4] =
-            (ii < nz && jj > 0 && kk > 0)
-                ? (ii * nx * ny) + ((jj - 1) * nx) + (kk - 1)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 5] =
-            (ii < nz && jj > 0 && kk < nx)
-                ? (ii * nx * ny) + ((jj - 1) * nx) + (kk)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 6] =
-            (ii < nz && jj < ny && kk > 0)
-                ? (ii * nx * ny) + (jj * nx) + (kk - 1)
-                : -1;
-        umesh->nodes_to_cells[node_index * NCELLS_BY_NODE + 7] =
-            (ii < nz && jj < ny && kk < nx) ? (ii * nx * ny) + (jj * nx) + (kk)
-                                            : -1;
-      }
-    }
+// The number of boundary nodes before a boundary node of the structured mesh.
+// Every node of the bottom and top layers is on the boundary, and the other
+// layers only have the rings of nodes around their edges.
+static inline int boundary_node_index(const int nx, const int ny, const int nz,
+                                      const int ii, const int jj,
+                                      const int kk) {
+  const int layer = (nx + 1) * (ny + 1);
+  const int ring = 2 * (nx + 1) + 2 * (ny - 1);
+  if (ii == 0) {
+    return (jj * (nx + 1)) + kk;
   }
-
-#if 0
-// Determine the count of cells by nodes
-#pragma omp parallel for
-  for (int ii = 0; ii < (nz + 1); ++ii) {
-    for (int jj = 0; jj < (ny + 1); ++jj) {
-      for (int kk = 0; kk < (nx + 1); ++kk) {
-        int off = 0;
-        off += (ii > 0 && jj > 0 && kk > 0);
-        off += (ii > 0 && jj > 0 && kk < nx);
-        off += (ii > 0 && jj < ny && kk > 0);
-        off += (ii > 0 && jj < ny && kk < nx);
-        off += (ii < nz && jj > 0 && kk > 0);
-        off += (ii < nz && jj > 0 && kk < nx);
-        off += (ii < nz && jj < ny && kk > 0);
-        off += (ii < nz && jj < ny && kk < nx);
-
-        const int node_index =
-            (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-        umesh->nodes_to_cells_offsets[(node_index + 1)] = off;
-      }
-    }
+  if (ii == nz) {
+    return layer + (nz - 1) * ring + (jj * (nx + 1)) + kk;
   }
-
-  // Perform prefix sum of the counts to get offsets (in serial for now)
-  for (int nn = 0; nn < umesh->nnodes; ++nn) {
-    umesh->nodes_to_cells_offsets[(nn + 1)] +=
-        umesh->nodes_to_cells_offsets[(nn)];
+  const int base = layer + (ii - 1) * ring;
+  if (jj == 0) {
+    return base + kk;
   }
-
-// Initialise the offsets and list of nodes to cells, counter-clockwise order
-#pragma omp parallel for
-  for (int ii = 0; ii < (nz + 1); ++ii) {
-    for (int jj = 0; jj < (ny + 1); ++jj) {
-      for (int kk = 0; kk < (nx + 1); ++kk) {
-        const int node_index =
-            (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
-
-        umesh->nodes_z0[(node_index)] = mesh->edgez[(ii)];
-        umesh->nodes_y0[(node_index)] = mesh->edgey[(jj)];
-        umesh->nodes_x0[(node_index)] = mesh->edgex[(kk)];
-
-        int off = umesh->nodes_to_cells_offsets[(node_index)];
-
-        // Fill in all of the cells that surround a node
-        // NOTE: The order of the statements is important for data layout
-        if (ii > 0 && jj > 0 && kk > 0) {
-          umesh->nodes_to_cells[(off++)] =
-              ((ii - 1) * nx * ny) + ((jj - 1) * nx) + (kk - 1);
-        }
-        if (ii > 0 && jj > 0 && kk < nx) {
-          umesh->nodes_to_cells[(off++)] =
-              ((ii - 1) * nx * ny) + ((jj - 1) * nx) + (kk);
-        }
-        if (ii > 0 && jj < ny && kk > 0) {
-          umesh->nodes_to_cells[(off++)] =
-              ((ii - 1) * nx * ny) + (jj * nx) + (kk - 1);
-        }
-        if (ii > 0 && jj < ny && kk < nx) {
-          umesh->nodes_to_cells[(off++)] =
-              ((ii - 1) * nx * ny) + (jj * nx) + (kk);
-        }
-        if (ii < nz && jj > 0 && kk > 0) {
-          umesh->nodes_to_cells[(off++)] =
-              (ii * nx * ny) + ((jj - 1) * nx) + (kk - 1);
-        }
-        if (ii < nz && jj > 0 && kk < nx) {
-          umesh->nodes_to_cells[(off++)] =
-              (ii * nx * ny) + ((jj - 1) * nx) + (kk);
-        }
-        if (ii < nz && jj < ny && kk > 0) {
-          umesh->nodes_to_cells[(off++)] =
-              (ii * nx * ny) + (jj * nx) + (kk - 1);
-        }
-        if (ii < nz && jj < ny && kk < nx) {
-          umesh->nodes_to_cells[(off++)] = (ii * nx * ny) + (jj * nx) + (kk);
-        }
-      }
-    }
+  if (jj == ny) {
+    return base + (nx + 1) + 2 * (ny - 1) + kk;
   }
-#endif // if 0
+  return base + (nx + 1) + 2 * (jj - 1) + (kk == nx);
 }
 
 // Initialises the boundary normals
 void init_boundary_normals_3d(const int nx, const int ny, const int nz,
                               UnstructuredMesh* umesh) {
 
-  // Determine all of the boundary edges
-  int nboundary_nodes = 0;
+  // The boundary nodes are numbered in closed form so the layers are
+  // independent
+  umesh->nboundary_nodes = converted_nboundary_nodes(nx, ny, nz);
+
+#pragma omp parallel for
   for (int ii = 0; ii < (nz + 1); ++ii) {
     for (int jj = 0; jj < (ny + 1); ++jj) {
       for (int kk = 0; kk < (nx + 1); ++kk) {
@@ -522,7 +356,7 @@ void init_boundary_normals_3d(const int nx, const int ny, const int nz,
 
         // Check if we are on the edge
         if (boundary_count > 0) {
-          int index = nboundary_nodes++;
+          const int index = boundary_node_index(nx, ny, nz, ii, jj, kk);
           umesh->boundary_index[(node_index)] = index;
 
           if (boundary_count == 3) {
@@ -584,4 +418,31 @@ void init_boundary_normals_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  // The boundary faces of each layer follow those of the layers below, and
+  // are listed in ascending order
+  umesh->nboundary_faces = 2 * (nx * ny + ny * nz + nx * nz);
+#pragma omp parallel for
+  for (int ii = 0; ii < (nz + 1); ++ii) {
+    int bb = (ii > 0) * nx * ny + 2 * (nx + ny) * ii;
+    if (ii == 0 || ii == nz) {
+      for (int jj = 0; jj < ny; ++jj) {
+        for (int kk = 0; kk < nx; ++kk) {
+          umesh->boundary_faces[(bb++)] = XYPLANE_FACE_INDEX(ii, jj, kk);
+        }
+      }
+    }
+    if (ii < nz) {
+      for (int jj = 0; jj < ny; ++jj) {
+        umesh->boundary_faces[(bb++)] = YZPLANE_FACE_INDEX(ii, jj, 0);
+        for (int kk = 0; kk < nx && jj == 0; ++kk) {
+          umesh->boundary_faces[(bb++)] = XZPLANE_FACE_INDEX(ii, jj, kk);
+        }
+        umesh->boundary_faces[(bb++)] = YZPLANE_FACE_INDEX(ii, jj, nx);
+      }
+      for (int kk = 0; kk < nx; ++kk) {
+        umesh->boundary_faces[(bb++)] = XZPLANE_FACE_INDEX(ii, ny, kk);
+      }
+    }
+  }
 }
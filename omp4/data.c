@@ -18,6 +18,9 @@ int device_strmatch(const char* str1, const char* str2) {
 }
 #pragma omp end declare target
 
+// Whether the buffers from allocate_data can be accessed by the host
+int data_on_host(void) { return 0; }
+
 // Allocates some double precision data
 size_t allocate_data(double** buf, size_t len) {
   if(!len) {
@@ -231,14 +234,22 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
       break;
     }
 
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, values, mesh_width,
+                             mesh_height, 0.0, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
     copy_buffer(MAX_KEYS, &values, &values, SEND);
 #pragma omp target update to(keys[ : MAX_KEYS* MAX_STR_LEN])
 
-    // The last four keys are the bound specification
-    double xpos = values[nkeys - 4] * mesh_width;
-    double ypos = values[nkeys - 3] * mesh_height;
-    double width = values[nkeys - 2] * mesh_width;
-    double height = values[nkeys - 1] * mesh_height;
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
 
     int failed = 0;
 
@@ -251,10 +262,10 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
         double global_ypos = edgey[ii];
 
         // Check we are in bounds of the problem entry
-        if (global_xpos >= xpos && global_ypos >= ypos &&
-            global_xpos < xpos + width && global_ypos < ypos + height) {
+        if (global_xpos >= xmin && global_ypos >= ymin &&
+            global_xpos < xmax && global_ypos < ymax) {
           // The upper bound excludes the bounding box for the entry
-          for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
+          for (int kk = 0; kk < nfields; ++kk) {
             const char* key = &keys[kk * MAX_STR_LEN];
             if (device_strmatch(key, "density")) {
               rho[ii * local_nx + jj] = values[kk];
@@ -305,16 +316,24 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
       break;
     }
 
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, values, mesh_width,
+                             mesh_height, mesh_depth, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
     copy_buffer(MAX_KEYS, &values, &values, SEND);
 #pragma omp target update to(keys[ : MAX_KEYS* MAX_STR_LEN])
 
-    // The last four keys are the bound specification
-    double xpos = values[nkeys - 6] * mesh_width;
-    double ypos = values[nkeys - 5] * mesh_height;
-    double zpos = values[nkeys - 4] * mesh_depth;
-    double width = values[nkeys - 3] * mesh_width;
-    double height = values[nkeys - 2] * mesh_height;
-    double depth = values[nkeys - 1] * mesh_depth;
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
+    const double zmin = geometry.bound_z[0];
+    const double zmax = geometry.bound_z[1];
 
     int failed = 0;
 
@@ -329,11 +348,11 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
           double global_zpos = edgez[ii];
 
           // Check we are in bounds of the problem entry
-          if (global_xpos >= xpos && global_ypos >= ypos &&
-              global_zpos >= zpos && global_xpos < xpos + width &&
-              global_ypos < ypos + height && global_zpos < zpos + depth) {
+          if (global_xpos >= xmin && global_ypos >= ymin &&
+              global_zpos >= zmin && global_xpos < xmax &&
+              global_ypos < ymax && global_zpos < zmax) {
             // The upper bound excludes the bounding box for the entry
-            for (int ee = 0; ee < nkeys - (2 * ndims); ++ee) {
+            for (int ee = 0; ee < nfields; ++ee) {
               const int index =
                 (ii * local_nx * local_ny) + (jj * local_nx) + (kk);
               const char* key = &keys[ee * MAX_STR_LEN];
@@ -412,3 +431,10 @@ void find_boundary_normals(UnstructuredMesh* umesh, int* boundary_edge_list) {
     boundary_normal_y[(bi)] = normal_y / normal_mag;
   }
 }
+
+// Finds the normals for all boundary cells
+void find_boundary_normals_3d(UnstructuredMesh* umesh,
+                              int* boundary_face_list) {
+
+  TERMINATE("%s not yet implemented.", __func__);
+}
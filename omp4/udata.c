@@ -97,8 +97,14 @@ void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the connectivity between nodes and faces
-void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
+size_t init_nodes_to_faces_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_faces, umesh->nnodes * NFACES_BY_NODE);
 
   int* nodes_to_faces_offsets = umesh->nodes_to_faces_offsets;
   int* nodes_to_faces = umesh->nodes_to_faces;
@@ -151,6 +157,8 @@ void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  return allocated;
 }
 
 // Initialises the cells to nodes connectivity
@@ -201,6 +209,30 @@ void init_cells_to_nodes_3d(const int nx, const int ny, const int nz,
   }
 }
 
+// Initialises the centroids of the cells
+void init_cell_centroids_3d(const int nx, const int ny, const int nz,
+                            Mesh* mesh, UnstructuredMesh* umesh) {
+
+  double* cell_centroids_x = umesh->cell_centroids_x;
+  double* cell_centroids_y = umesh->cell_centroids_y;
+  double* cell_centroids_z = umesh->cell_centroids_z;
+  double* edgex = mesh->edgex;
+  double* edgey = mesh->edgey;
+  double* edgez = mesh->edgez;
+
+#pragma omp target teams distribute parallel for
+  for (int ii = 0; ii < nz; ++ii) {
+    for (int jj = 0; jj < ny; ++jj) {
+      for (int kk = 0; kk < nx; ++kk) {
+        const int cell_index = (ii * nx * ny) + (jj * nx) + (kk);
+        cell_centroids_x[(cell_index)] = 0.5 * (edgex[(kk)] + edgex[(kk + 1)]);
+        cell_centroids_y[(cell_index)] = 0.5 * (edgey[(jj)] + edgey[(jj + 1)]);
+        cell_centroids_z[(cell_index)] = 0.5 * (edgez[(ii)] + edgez[(ii + 1)]);
+      }
+    }
+  }
+}
+
 // Initialises the connectivity between faces and nodes
 void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
                             UnstructuredMesh* umesh) {
@@ -233,7 +265,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
         faces_to_nodes[(face_to_node_off + 3)] =
             (ii * (nx + 1) * (ny + 1)) + ((jj + 1) * (nx + 1)) + (kk);
 
-        if (ii < nz + 1) {
+        if (ii < nz) {
           faces_cclockwise_cell[(face_index)] =
               (ii * nx * ny) + (jj * nx) + (kk);
         }
@@ -261,7 +293,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             faces_to_nodes[(face_to_node_off + 3)] =
                 ((ii + 1) * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
 
-            if (kk < nx + 1) {
+            if (kk < nx) {
               faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -285,7 +317,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             faces_to_nodes[(face_to_node_off + 3)] =
                 (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk + 1);
 
-            if (jj < ny + 1) {
+            if (jj < ny) {
               faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -334,8 +366,14 @@ void init_cells_to_faces_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the list of nodes to nodes
-void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
+size_t init_nodes_to_nodes_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_nodes, umesh->nnodes * NNODES_BY_NODE);
 
   const int nnodes = umesh->nnodes;
   int* nodes_to_nodes_offsets = umesh->nodes_to_nodes_offsets;
@@ -389,11 +427,16 @@ void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  return allocated;
 }
 
 // Initialises the list of nodes to cells
-void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
-                            Mesh* mesh, UnstructuredMesh* umesh) {
+size_t init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
+                              Mesh* mesh, UnstructuredMesh* umesh) {
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_cells, umesh->nnodes * NCELLS_BY_NODE);
 
   int* nodes_to_cells = umesh->nodes_to_cells;
   double* nodes_x0 = umesh->nodes_x0;
@@ -542,6 +585,8 @@ void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
     }
   }
 #endif // if 0
+
+  return allocated;
 }
 
 // Initialises the boundary normals
@@ -1,13 +1,156 @@
 #include "params.h"
+#include "comms.h"
 #include "shared.h"
 #include <assert.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#define PARAM_TABLE_MIN 64 // The smallest hash table in the store
+
+// A key and the remainder of its line, both pointing into the file text
+struct ParamEntry {
+  uint64_t hash;
+  const char* key;
+  const char* value;
+};
+
+// A parameter file that has been parsed once into an open addressed table
+struct ParamFile {
+  char* filename;
+  char* text;
+  size_t capacity;
+  struct ParamEntry* entries;
+  struct ParamFile* next;
+};
+
+// Every parameter file that has been read so far
+static struct ParamFile* param_files = NULL;
+
 int get_parameter_line(const char* param_name, const char* filename,
                        char** param_line);
 
+// FNV-1a hash of a parameter name
+static inline uint64_t hash_parameter(const char* key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char* cc = key; *cc; ++cc) {
+    hash = (hash ^ (uint64_t)(unsigned char)*cc) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+// Finds a file in the store, returning NULL if it has not been loaded
+static struct ParamFile* find_parameter_file(const char* filename) {
+  for (struct ParamFile* file = param_files; file; file = file->next) {
+    if (strmatch(file->filename, filename)) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
+// Looks up the value for a key in a parsed file
+static const char* lookup_parameter(struct ParamFile* file, const char* key) {
+  const uint64_t hash = hash_parameter(key);
+  const size_t mask = file->capacity - 1;
+  for (size_t ii = hash & mask; file->entries[ii].key; ii = (ii + 1) & mask) {
+    if (file->entries[ii].hash == hash && strmatch(file->entries[ii].key, key)) {
+      return file->entries[ii].value;
+    }
+  }
+  return NULL;
+}
+
+// Inserts a key, keeping the first occurrence as a linear scan would
+static void insert_parameter(struct ParamFile* file, const char* key,
+                             const char* value) {
+  const uint64_t hash = hash_parameter(key);
+  const size_t mask = file->capacity - 1;
+  size_t ii = hash & mask;
+  for (; file->entries[ii].key; ii = (ii + 1) & mask) {
+    if (file->entries[ii].hash == hash && strmatch(file->entries[ii].key, key)) {
+      return;
+    }
+  }
+  file->entries[ii].hash = hash;
+  file->entries[ii].key = key;
+  file->entries[ii].value = value;
+}
+
+// Splits the text into lines of the form 'key value' and hashes each key
+static void parse_parameter_text(struct ParamFile* file, const size_t len) {
+  size_t nlines = 1;
+  for (size_t cc = 0; cc < len; ++cc) {
+    nlines += (file->text[cc] == '\n');
+  }
+
+  // Keep the table at most half full so that probe sequences stay short
+  file->capacity = PARAM_TABLE_MIN;
+  while (file->capacity < 2 * nlines) {
+    file->capacity *= 2;
+  }
+  file->entries =
+      (struct ParamEntry*)calloc(file->capacity, sizeof(struct ParamEntry));
+  if (!file->entries) {
+    TERMINATE("Could not allocate the parameter table for %s.\n",
+              file->filename);
+  }
+
+  char* line = file->text;
+  while (line < file->text + len) {
+    char* eol = strchr(line, '\n');
+    char* next = eol ? eol + 1 : file->text + len;
+    if (eol) {
+      *eol = '\0';
+    }
+
+    skip_whitespace(&line);
+    if (*line != '\0') {
+      char* key = line;
+      while (*line != '\0' && !isspace(*line)) {
+        line++;
+      }
+      if (*line != '\0') {
+        *line++ = '\0';
+        skip_whitespace(&line);
+      }
+      insert_parameter(file, key, line);
+    }
+
+    line = next;
+  }
+}
+
+// Parses a parameter file once into the store, either reading it on the
+// master and sharing it with every rank or reading it on this rank alone
+static struct ParamFile* load_parameter_store(const char* filename,
+                                              const int collective) {
+  struct ParamFile* file = (struct ParamFile*)malloc(sizeof(struct ParamFile));
+  if (!file) {
+    TERMINATE("Could not allocate space for the parameter store.");
+  }
+  file->filename = (char*)malloc(strlen(filename) + 1);
+  if (!file->filename) {
+    TERMINATE("Could not allocate space for the parameter store.");
+  }
+  strcpy(file->filename, filename);
+
+  size_t len = 0;
+  if (collective) {
+    file->text = read_file_on_master(filename, &len);
+  } else {
+    file->text = read_local_file(filename, &len);
+    if (!file->text) {
+      TERMINATE("Could not open the file: %s.\n", filename);
+    }
+  }
+  parse_parameter_text(file, len);
+
+  file->next = param_files;
+  param_files = file;
+  return file;
+}
+
 // Fetches a string parameter from the file
 char* get_parameter(const char* param_name, const char* filename) {
   char* parameter = (char*)malloc(sizeof(char) * MAX_STR_LEN);
@@ -102,30 +245,174 @@ int get_key_value_parameter(const char* specifier, const char* filename,
   return 1;
 }
 
+// Finds a geometry key in a problem entry, returning its index or -1
+static int find_geometry_key(const int nkeys, const char* keys,
+                             const char* name) {
+  for (int kk = 0; kk < nkeys; ++kk) {
+    if (strmatch(&keys[kk * MAX_STR_LEN], name)) {
+      return kk;
+    }
+  }
+  return -1;
+}
+
+// Whether a key describes the geometry rather than a field
+static int is_geometry_key(const char* key) {
+  return strmatch(key, "centre_x") || strmatch(key, "centre_y") ||
+         strmatch(key, "centre_z") || strmatch(key, "radius") ||
+         strmatch(key, "axis") || strmatch(key, "length") ||
+         strmatch(key, "point_x") || strmatch(key, "point_y") ||
+         strmatch(key, "point_z") || strmatch(key, "normal_x") ||
+         strmatch(key, "normal_y") || strmatch(key, "normal_z");
+}
+
+// Fetches a required geometry value from a problem entry
+static double get_geometry_value(const int nkeys, const char* keys,
+                                 const double* values, const char* name) {
+  const int index = find_geometry_key(nkeys, keys, name);
+  if (index < 0) {
+    TERMINATE("Problem geometry is missing the key %s.\n", name);
+  }
+  return values[index];
+}
+
+// Separates the geometry of a problem entry from the fields that it sets,
+// moving the field keys to the front and returning how many there are
+int get_problem_geometry(const int ndims, const int nkeys, char* keys,
+                         double* values, const double mesh_width,
+                         const double mesh_height, const double mesh_depth,
+                         ProblemGeometry* geometry) {
+  const double extent[3] = {mesh_width, mesh_height,
+                            (ndims == 3) ? mesh_depth : 0.0};
+  const char* dims[3] = {"x", "y", "z"};
+  memset(geometry, 0, sizeof(ProblemGeometry));
+
+  int nfields = 0;
+  for (int kk = 0; kk < nkeys; ++kk) {
+    nfields += !is_geometry_key(&keys[kk * MAX_STR_LEN]);
+  }
+
+  // Entries without geometry keys end with the bounds of a box
+  if (nfields == nkeys) {
+    nfields = nkeys - (2 * ndims);
+    if (nfields < 0) {
+      TERMINATE("Problem entry requires %d bounds.\n", 2 * ndims);
+    }
+    geometry->type = BOX_GEOMETRY;
+    double* bounds[3] = {geometry->bound_x, geometry->bound_y,
+                         geometry->bound_z};
+    for (int dd = 0; dd < ndims; ++dd) {
+      bounds[dd][0] = values[nfields + dd] * extent[dd];
+      bounds[dd][1] = bounds[dd][0] + values[nfields + ndims + dd] * extent[dd];
+    }
+    return nfields;
+  }
+
+  if (find_geometry_key(nkeys, keys, "normal_x") >= 0) {
+    // The half-space behind a plane through a point
+    geometry->type = PLANE_GEOMETRY;
+    for (int dd = 0; dd < ndims; ++dd) {
+      char name[MAX_STR_LEN];
+      sprintf(name, "point_%s", dims[dd]);
+      geometry->centre[dd] =
+          get_geometry_value(nkeys, keys, values, name) * extent[dd];
+      sprintf(name, "normal_%s", dims[dd]);
+      geometry->normal[dd] = get_geometry_value(nkeys, keys, values, name);
+    }
+  } else {
+    for (int dd = 0; dd < ndims; ++dd) {
+      char name[MAX_STR_LEN];
+      sprintf(name, "centre_%s", dims[dd]);
+      geometry->centre[dd] =
+          get_geometry_value(nkeys, keys, values, name) * extent[dd];
+    }
+    geometry->radius =
+        get_geometry_value(nkeys, keys, values, "radius") * mesh_width;
+
+    if (find_geometry_key(nkeys, keys, "axis") >= 0) {
+      // A cylinder of finite length centred on its axis
+      geometry->type = CYLINDER_GEOMETRY;
+      geometry->axis = (int)get_geometry_value(nkeys, keys, values, "axis");
+      if (ndims != 3 || geometry->axis < 0 || geometry->axis > 2) {
+        TERMINATE("Cylinders require three dimensions and an axis of 0-2.\n");
+      }
+      geometry->half_length =
+          0.5 * get_geometry_value(nkeys, keys, values, "length") *
+          extent[geometry->axis];
+    } else {
+      geometry->type = SPHERE_GEOMETRY;
+    }
+  }
+
+  // The bounding box limits the cells that need an inside test
+  double* bounds[3] = {geometry->bound_x, geometry->bound_y,
+                       geometry->bound_z};
+  for (int dd = 0; dd < ndims; ++dd) {
+    if (geometry->type == PLANE_GEOMETRY) {
+      bounds[dd][0] = 0.0;
+      bounds[dd][1] = extent[dd];
+    } else {
+      const double half_width = (geometry->type == CYLINDER_GEOMETRY &&
+                                 dd == geometry->axis)
+                                    ? geometry->half_length
+                                    : geometry->radius;
+      bounds[dd][0] = geometry->centre[dd] - half_width;
+      bounds[dd][1] = geometry->centre[dd] + half_width;
+    }
+  }
+
+  // Move the field keys to the front, preserving their order
+  int ff = 0;
+  for (int kk = 0; kk < nkeys; ++kk) {
+    if (!is_geometry_key(&keys[kk * MAX_STR_LEN])) {
+      if (ff != kk) {
+        strcpy(&keys[ff * MAX_STR_LEN], &keys[kk * MAX_STR_LEN]);
+        values[ff] = values[kk];
+      }
+      ff++;
+    }
+  }
+  return nfields;
+}
+
 // Fetches a line from a parameter file with corresponding token
 int get_parameter_line(const char* param_name, const char* filename,
                        char** param_line) {
-  FILE* fp = fopen(filename, "r");
-  if (!fp) {
-    TERMINATE("Could not open the parameter file: %s.\n", filename);
+  // A file that was not loaded up front is read by this rank alone, so that
+  // lookups never enter a collective
+  struct ParamFile* file = find_parameter_file(filename);
+  if (!file) {
+    file = load_parameter_store(filename, 0);
   }
 
-  char tok[MAX_STR_LEN];
-  while (fgets(*param_line, MAX_STR_LEN, fp)) {
-    skip_whitespace(param_line);
+  const char* value = lookup_parameter(file, param_name);
+  if (!value) {
+    return 0;
+  }
 
-    // Read in the parameter name
-    sscanf(*param_line, "%s", tok);
-    if (strmatch(tok, param_name)) {
-      *param_line += strlen(tok);
-      skip_whitespace(param_line);
-      fclose(fp);
-      return 1;
-    }
+  // Copy into the caller's line so that it can be tokenised in place
+  strncpy(*param_line, value, MAX_STR_LEN - 1);
+  (*param_line)[MAX_STR_LEN - 1] = '\0';
+  return 1;
+}
+
+// Reads a parameter file on the master and shares it with every rank
+void load_parameter_file(const char* filename) {
+  if (!find_parameter_file(filename)) {
+    load_parameter_store(filename, 1);
   }
+}
 
-  fclose(fp);
-  return 0;
+// Releases all of the parameter files held in the store
+void finalise_parameters() {
+  while (param_files) {
+    struct ParamFile* next = param_files->next;
+    free(param_files->filename);
+    free(param_files->text);
+    free(param_files->entries);
+    free(param_files);
+    param_files = next;
+  }
 }
 
 // Skips any leading whitespace
@@ -1,6 +1,25 @@
 #pragma once
 
 enum { ENERGY_KEY, DENSITY_KEY, TEMPERATURE_KEY };
+enum {
+  BOX_GEOMETRY,
+  SPHERE_GEOMETRY,
+  CYLINDER_GEOMETRY,
+  PLANE_GEOMETRY
+}; // The shape of the region covered by a problem entry
+
+// The region covered by a problem entry, scaled to the mesh
+typedef struct {
+  int type;
+  int axis;           // The axis of a cylinder
+  double radius;      // The radius of a sphere or cylinder
+  double half_length; // Half of the length of a cylinder along its axis
+  double centre[3];   // Centre of a sphere or cylinder, or a point on a plane
+  double normal[3];   // The normal of a plane, pointing away from the region
+  double bound_x[2];  // The bounding box of the region
+  double bound_y[2];
+  double bound_z[2];
+} ProblemGeometry;
 
 // Fetches a string parameter from the file
 char* get_parameter(const char* param_name, const char* filename);
@@ -11,6 +30,15 @@ int get_int_parameter(const char* param_name, const char* filename);
 // Returns a parameter from the parameter file of type double
 double get_double_parameter(const char* param_name, const char* filename);
 
+// Reads a parameter file on the master and shares it with every rank, so
+// that later lookups do not touch the filesystem. This is collective and
+// should be called at initialisation. Lookups of a file that was not loaded
+// read it on each rank that asks.
+void load_parameter_file(const char* filename);
+
+// Releases all of the parameter files held in the store
+void finalise_parameters();
+
 // Skips any leading whitespace
 void skip_whitespace(char** line);
 
@@ -25,6 +53,13 @@ extern "C" {
 int get_key_value_parameter(const char* specifier, const char* filename,
                             char* keys, double* values, int* nkeys);
 
+// Separates the geometry of a problem entry from the fields that it sets,
+// moving the field keys to the front and returning how many there are
+int get_problem_geometry(const int ndims, const int nkeys, char* keys,
+                         double* values, const double mesh_width,
+                         const double mesh_height, const double mesh_depth,
+                         ProblemGeometry* geometry);
+
 #ifdef __cplusplus
 }
 #endif
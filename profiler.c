@@ -5,28 +5,82 @@
 #include <string.h>
 #include <time.h>
 
-// Internally start the profiling timer
-void profiler_start_timer(struct Profile* profile) {
-#ifndef TIME_UTC
-  clock_gettime(CLOCK_MONOTONIC, &profile->profiler_start);
+#if defined(PROFILER_USE_TSC) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILER_TSC
+#include <x86intrin.h>
+#endif
+
+// Reads the monotonic clock in nanoseconds
+static inline uint64_t read_monotonic_ns(void) {
+#ifdef __APPLE__
+  static mach_timebase_info_data_t timebase;
+  if (timebase.denom == 0) {
+    mach_timebase_info(&timebase);
+  }
+  return mach_absolute_time() * timebase.numer / timebase.denom;
 #else
-  timespec_get(&profile->profiler_start, TIME_UTC);
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
 #endif
 }
 
-// Internally end the profiling timer and store results
-void profiler_end_timer(struct Profile* profile, const char* entry_name) {
-#ifndef TIME_UTC
-  clock_gettime(CLOCK_MONOTONIC, &profile->profiler_end);
+// Reads the raw clock in ticks
+uint64_t profiler_read_ticks(void) {
+#ifdef PROFILER_TSC
+  return __rdtsc();
 #else
-  timespec_get(&profile->profiler_end, TIME_UTC);
+  return read_monotonic_ns();
 #endif
+}
 
-  // Check if an entry exists
-  int ii;
-  for (ii = 0; ii < profile->profiler_entry_count; ++ii) {
-    if (strmatch(profile->profiler_entries[ii].name, entry_name)) {
-      break;
+#ifdef PROFILER_TSC
+// The length of a TSC tick, calibrated once before main so that no timed
+// region pays for the calibration
+static double tick_seconds = 0.0;
+
+// Determines the length of a TSC tick by spinning against CLOCK_MONOTONIC
+__attribute__((constructor)) static void calibrate_seconds_per_tick(void) {
+  const uint64_t ns0 = read_monotonic_ns();
+  const uint64_t tsc0 = __rdtsc();
+  uint64_t ns1;
+  do {
+    ns1 = read_monotonic_ns();
+  } while (ns1 - ns0 < PROFILER_CALIBRATION_NS);
+  const uint64_t tsc1 = __rdtsc();
+  tick_seconds = (double)(ns1 - ns0) * 1.0e-9 / (double)(tsc1 - tsc0);
+}
+#else
+// The monotonic clock ticks in nanoseconds
+static const double tick_seconds = 1.0e-9;
+#endif
+
+// Internally start the profiling timer
+void profiler_start_timer(struct Profile* profile) {
+  profile->profiler_start = profiler_read_ticks();
+}
+
+// Internally end the profiling timer and store results
+void profiler_end_timer(struct Profile* profile, const char* entry_name) {
+  profiler_end_timer_traffic(profile, entry_name, 0.0, 0.0);
+}
+
+// Internally end the profiling timer and store results, including the bytes
+// moved and flops performed by the region
+void profiler_end_timer_traffic(struct Profile* profile,
+                                const char* entry_name, const double bytes,
+                                const double flops) {
+  profile->profiler_end = profiler_read_ticks();
+
+  // Regions are usually closed in the same order, so try the last entry first
+  int ii = profile->last_entry;
+  if (ii >= profile->profiler_entry_count ||
+      !strmatch(profile->profiler_entries[ii].name, entry_name)) {
+    // Check if an entry exists
+    for (ii = 0; ii < profile->profiler_entry_count; ++ii) {
+      if (strmatch(profile->profiler_entries[ii].name, entry_name)) {
+        break;
+      }
     }
   }
 
@@ -41,16 +95,19 @@ void profiler_end_timer(struct Profile* profile, const char* entry_name) {
     profile->profiler_entry_count++;
     strcpy(profile->profiler_entries[ii].name, entry_name);
     profile->profiler_entries[ii].time = 0.0;
+    profile->profiler_entries[ii].bytes = 0.0;
+    profile->profiler_entries[ii].flops = 0.0;
   }
 
-// Update number of calls and time
-  double elapsed =
-      (profile->profiler_end.tv_sec - profile->profiler_start.tv_sec) +
-      (profile->profiler_end.tv_nsec - profile->profiler_start.tv_nsec) *
-          1.0E-9;
+  // Update number of calls and time
+  const double elapsed =
+      (double)(profile->profiler_end - profile->profiler_start) * tick_seconds;
 
   profile->profiler_entries[ii].time += elapsed;
+  profile->profiler_entries[ii].bytes += bytes;
+  profile->profiler_entries[ii].flops += flops;
   profile->profiler_entries[ii].calls++;
+  profile->last_entry = ii;
 }
 
 // Print the profiling results to output
@@ -59,8 +116,10 @@ void profiler_print_full_profile(struct Profile* profile) {
   printf("\nProfiling Results:\n\n");
   printf("%-39s%8s%28s\n", "Kernel Name", "Calls", "Runtime (s)");
 
+  int total_calls = 0;
   double total_elapsed_time = 0.0;
   for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
+    total_calls += profile->profiler_entries[ii].calls;
     total_elapsed_time += profile->profiler_entries[ii].time;
     printf("%-39s%8d%28.9F\n", profile->profiler_entries[ii].name,
            profile->profiler_entries[ii].calls,
@@ -69,6 +128,46 @@ void profiler_print_full_profile(struct Profile* profile) {
 
   printf("\nTotal elapsed time: %.9Fs, entries * are excluded.\n",
          total_elapsed_time);
+#ifdef PROFILER_TSC
+  printf("Clock source: rdtsc, calibrated at %.3fGHz\n",
+         1.0e-9 / tick_seconds);
+#else
+  printf("Clock source: monotonic\n");
+#endif
+  printf("Profiler overhead: %.1fns per region, %.9Fs over %d calls.\n",
+         profile->overhead * 1.0e9, profile->overhead * total_calls,
+         total_calls);
+
+  // Report achieved bandwidth and flop rate for annotated regions
+  int has_traffic = 0;
+  for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
+    has_traffic |= (profile->profiler_entries[ii].bytes > 0.0 ||
+                    profile->profiler_entries[ii].flops > 0.0);
+  }
+  if (has_traffic) {
+    printf("\nRoofline:\n\n");
+    if (profile->peak_bandwidth > 0.0) {
+      printf("Peak STREAM triad bandwidth: %.2fGB/s\n\n",
+             profile->peak_bandwidth * 1.0e-9);
+    }
+    printf("%-39s%12s%12s%12s\n", "Kernel Name", "GB/s", "GFLOP/s",
+           "% Peak BW");
+    for (int ii = 0; ii < profile->profiler_entry_count; ++ii) {
+      const struct ProfileEntry* entry = &profile->profiler_entries[ii];
+      if (entry->time <= 0.0 ||
+          (entry->bytes <= 0.0 && entry->flops <= 0.0)) {
+        continue;
+      }
+      const double bandwidth = entry->bytes / entry->time;
+      printf("%-39s%12.3f%12.3f", entry->name, bandwidth * 1.0e-9,
+             entry->flops / entry->time * 1.0e-9);
+      if (profile->peak_bandwidth > 0.0) {
+        printf("%12.1f\n", 100.0 * bandwidth / profile->peak_bandwidth);
+      } else {
+        printf("%12s\n", "-");
+      }
+    }
+  }
   printf("\n-------------------------------------------------------------\n\n");
 }
 
@@ -107,7 +206,78 @@ double profiler_get_time(struct Profile* profile, const char* entry_name) {
 }
 
 void profiler_init(struct Profile* profile) {
-  for(int i = 0; i < PROFILER_MAX_ENTRIES; ++i) {
+  for (int i = 0; i < PROFILER_MAX_ENTRIES; ++i) {
     profile->profiler_entries[i].time = 0.0;
+    profile->profiler_entries[i].calls = 0;
+    profile->profiler_entries[i].bytes = 0.0;
+    profile->profiler_entries[i].flops = 0.0;
+  }
+  profile->profiler_entry_count = 0;
+  profile->last_entry = 0;
+  profile->seconds_per_tick = tick_seconds;
+
+  // Measure the cost of a start/stop pair using a scratch profile
+  struct Profile* scratch = (struct Profile*)malloc(sizeof(struct Profile));
+  if (!scratch) {
+    TERMINATE("Could not allocate the profiler scratch space.\n");
+  }
+  scratch->profiler_entry_count = 0;
+  scratch->last_entry = 0;
+  scratch->seconds_per_tick = profile->seconds_per_tick;
+
+  const uint64_t t0 = profiler_read_ticks();
+  for (int i = 0; i < PROFILER_OVERHEAD_SAMPLES; ++i) {
+    profiler_start_timer(scratch);
+    profiler_end_timer(scratch, "profiler_overhead");
+  }
+  const uint64_t t1 = profiler_read_ticks();
+
+  profile->overhead = (double)(t1 - t0) * tick_seconds /
+                      PROFILER_OVERHEAD_SAMPLES;
+  free(scratch);
+}
+
+// Measures the achievable memory bandwidth with a STREAM triad, keeping the
+// best of several repetitions as the peak
+void profiler_calibrate_bandwidth(struct Profile* profile) {
+  profile->seconds_per_tick = tick_seconds;
+
+  const size_t len = PROFILER_STREAM_LEN;
+  double* a = (double*)malloc(sizeof(double) * len);
+  double* b = (double*)malloc(sizeof(double) * len);
+  double* c = (double*)malloc(sizeof(double) * len);
+  if (!a || !b || !c) {
+    TERMINATE("Could not allocate the STREAM calibration arrays.\n");
+  }
+
+// Perform first-touch
+#pragma omp parallel for
+  for (size_t ii = 0; ii < len; ++ii) {
+    a[ii] = 0.0;
+    b[ii] = 1.0;
+    c[ii] = 2.0;
+  }
+
+  const double scalar = 3.0;
+  double best_time = 0.0;
+  for (int rr = 0; rr < PROFILER_STREAM_REPS; ++rr) {
+    const uint64_t t0 = profiler_read_ticks();
+#pragma omp parallel for
+    for (size_t ii = 0; ii < len; ++ii) {
+      a[ii] = b[ii] + scalar * c[ii];
+    }
+    const uint64_t t1 = profiler_read_ticks();
+
+    const double elapsed = (double)(t1 - t0) * tick_seconds;
+    if (rr == 0 || elapsed < best_time) {
+      best_time = elapsed;
+    }
   }
+
+  // The triad reads two arrays and writes one
+  profile->peak_bandwidth = 3.0 * sizeof(double) * len / best_time;
+
+  free(a);
+  free(b);
+  free(c);
 }
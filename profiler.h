@@ -1,6 +1,8 @@
 #ifndef __PROFILERH
 #define __PROFILERH
 
+#include <stdint.h>
+
 #ifdef __APPLE__
 #include <mach/mach.h>
 #include <mach/mach_time.h>
@@ -11,10 +13,18 @@
 /*
  *		PROFILING TOOL
  *		Not thread safe.
+ *
+ *    Timestamps are taken from a monotonic clock by default. Compiling with
+ *    -DPROFILER_USE_TSC on x86 selects the rdtsc fast path, which is
+ *    calibrated against CLOCK_MONOTONIC once at program start.
  */
 
 #define PROFILER_MAX_NAME 128
 #define PROFILER_MAX_ENTRIES 1024
+#define PROFILER_CALIBRATION_NS 20000000 // Time spent calibrating the TSC
+#define PROFILER_OVERHEAD_SAMPLES 10000  // Timer pairs used to find overhead
+#define PROFILER_STREAM_LEN (1 << 22)    // Elements per STREAM triad array
+#define PROFILER_STREAM_REPS 10          // Repetitions of the STREAM triad
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,17 +33,20 @@ extern "C" {
 struct ProfileEntry {
   int calls;
   double time;
+  double bytes; // Bytes moved by the region, as annotated by the caller
+  double flops; // Floating point operations performed by the region
   char name[PROFILER_MAX_NAME];
 };
 
 struct Profile {
-#ifdef __APPLE__
+  // Raw timestamps in clock ticks
   uint64_t profiler_start;
   uint64_t profiler_end;
-#else
-  struct timespec profiler_start;
-  struct timespec profiler_end;
-#endif
+
+  double seconds_per_tick; // Conversion from clock ticks to seconds
+  double overhead;         // Measured cost of one start/stop pair in seconds
+  double peak_bandwidth;   // Measured STREAM triad bandwidth in bytes/s
+  int last_entry;          // The most recently updated entry
 
   int profiler_entry_count;
   struct ProfileEntry profiler_entries[PROFILER_MAX_ENTRIES];
@@ -41,6 +54,9 @@ struct Profile {
 
 void profiler_start_timer(struct Profile* profile);
 void profiler_end_timer(struct Profile* profile, const char* entry_name);
+void profiler_end_timer_traffic(struct Profile* profile,
+                                const char* entry_name, const double bytes,
+                                const double flops);
 void profiler_print_simple_profile(struct Profile* profile);
 void profiler_print_full_profile(struct Profile* profile);
 struct ProfileEntry profiler_get_profile_entry(struct Profile* profile,
@@ -48,6 +64,12 @@ struct ProfileEntry profiler_get_profile_entry(struct Profile* profile,
 double profiler_get_time(struct Profile* profile, const char* entry_name);
 void profiler_init(struct Profile* profile);
 
+// Measures the achievable memory bandwidth with a STREAM triad
+void profiler_calibrate_bandwidth(struct Profile* profile);
+
+// Reads the raw clock in ticks
+uint64_t profiler_read_ticks(void);
+
 // Allows compile-time optimised conditional profiling
 #ifdef ENABLE_PROFILING
 
@@ -55,6 +77,9 @@ void profiler_init(struct Profile* profile);
 
 #define STOP_PROFILING(profile, name) profiler_end_timer(profile, name)
 
+#define STOP_PROFILING_TRAFFIC(profile, name, bytes, flops)                    \
+  profiler_end_timer_traffic(profile, name, bytes, flops)
+
 #define PRINT_PROFILING_RESULTS(profile) profiler_print_full_profile(profile)
 
 #else
@@ -63,6 +88,8 @@ void profiler_init(struct Profile* profile);
 
 #define STOP_PROFILING(profile, name) ;
 
+#define STOP_PROFILING_TRAFFIC(profile, name, bytes, flops) ;
+
 #define PRINT_PROFILING_RESULTS(profile) ;
 
 #endif
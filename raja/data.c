@@ -7,6 +7,15 @@
 #include <math.h>
 #include <stdlib.h>
 
+// Whether the buffers from allocate_data can be accessed by the host
+int data_on_host(void) {
+#if defined(RAJA_USE_CUDA) && !defined(CUDA_MANAGED_MEM)
+  return 0;
+#else
+  return 1;
+#endif
+}
+
 // Allocates a double precision array
 size_t allocate_data(double** buf, size_t len) {
   if(len == 0) {
@@ -436,13 +445,21 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = h_values[nkeys - 4] * mesh_width;
-    double ypos = h_values[nkeys - 3] * mesh_height;
-    double width = h_values[nkeys - 2] * mesh_width;
-    double height = h_values[nkeys - 1] * mesh_height;
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, h_values, mesh_width,
+                             mesh_height, 0.0, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
 
-    for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
+    for (int kk = 0; kk < nfields; ++kk) {
       const char* key = &keys[kk * MAX_STR_LEN];
       if (strmatch(key, "density")) {
         h_keys[kk] = DENSITY_KEY;
@@ -466,13 +483,13 @@ void set_problem_2d(const int local_nx, const int local_ny, const int pad,
        double global_ypos = edgey[ii];
 
        // Check we are in bounds of the problem entry
-       if (global_xpos >= xpos && 
-         global_ypos >= ypos && 
-         global_xpos < xpos + width && 
-         global_ypos < ypos + height) {
+       if (global_xpos >= xmin && 
+         global_ypos >= ymin && 
+         global_xpos < xmax && 
+         global_ypos < ymax) {
 
          // The upper bound excludes the bounding box for the entry
-         for (int nn = 0; nn < nkeys - (2 * ndims); ++nn) {
+         for (int nn = 0; nn < nfields; ++nn) {
            const int key = d_keys[nn];
            if (key == DENSITY_KEY) {
              density[i] = d_values[nn];
@@ -520,15 +537,23 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
       break;
     }
 
-    // The last four keys are the bound specification
-    double xpos = h_values[nkeys - 6] * mesh_width;
-    double ypos = h_values[nkeys - 5] * mesh_height;
-    double zpos = h_values[nkeys - 4] * mesh_depth;
-    double width = h_values[nkeys - 3] * mesh_width;
-    double height = h_values[nkeys - 2] * mesh_height;
-    double depth = h_values[nkeys - 1] * mesh_depth;
+    // The device kernels only fill boxes, bounded by the last keys
+    ProblemGeometry geometry;
+    const int nfields =
+        get_problem_geometry(ndims, nkeys, keys, h_values, mesh_width,
+                             mesh_height, mesh_depth, &geometry);
+    if (geometry.type != BOX_GEOMETRY) {
+      TERMINATE("%s only supports box problem geometry.\n", __func__);
+    }
+
+    const double xmin = geometry.bound_x[0];
+    const double xmax = geometry.bound_x[1];
+    const double ymin = geometry.bound_y[0];
+    const double ymax = geometry.bound_y[1];
+    const double zmin = geometry.bound_z[0];
+    const double zmax = geometry.bound_z[1];
 
-    for (int kk = 0; kk < nkeys - (2 * ndims); ++kk) {
+    for (int kk = 0; kk < nfields; ++kk) {
       const char* key = &keys[kk * MAX_STR_LEN];
       if (strmatch(key, "density")) {
         h_keys[kk] = DENSITY_KEY;
@@ -554,15 +579,15 @@ void set_problem_3d(const int local_nx, const int local_ny, const int local_nz,
         double global_zpos = edgez[ii];
 
         // Check we are in bounds of the problem entry
-        if (global_xpos >= xpos && 
-          global_ypos >= ypos && 
-          global_zpos >= zpos &&
-          global_xpos < xpos + width && 
-          global_ypos < ypos + height && 
-          global_zpos < zpos + depth) {
+        if (global_xpos >= xmin && 
+          global_ypos >= ymin && 
+          global_zpos >= zmin &&
+          global_xpos < xmax && 
+          global_ypos < ymax && 
+          global_zpos < zmax) {
 
         // The upper bound excludes the bounding box for the entry
-        for (int nn = 0; nn < nkeys - (2 * ndims); ++nn) {
+        for (int nn = 0; nn < nfields; ++nn) {
         const int key = d_keys[nn];
         if (key == DENSITY_KEY) {
           density[i] = d_values[nn];
@@ -85,8 +85,14 @@ void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the connectivity between nodes and faces
-void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
+size_t init_nodes_to_faces_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_faces, umesh->nnodes * NFACES_BY_NODE);
 
 // Determine the connectivity of nodes to faces
 #pragma omp parallel for
@@ -136,6 +142,8 @@ void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  return allocated;
 }
 
 // Initialises the cells to nodes connectivity
@@ -182,6 +190,26 @@ void init_cells_to_nodes_3d(const int nx, const int ny, const int nz,
   }
 }
 
+// Initialises the centroids of the cells
+void init_cell_centroids_3d(const int nx, const int ny, const int nz,
+                            Mesh* mesh, UnstructuredMesh* umesh) {
+
+#pragma omp parallel for
+  for (int ii = 0; ii < nz; ++ii) {
+    for (int jj = 0; jj < ny; ++jj) {
+      for (int kk = 0; kk < nx; ++kk) {
+        const int cell_index = (ii * nx * ny) + (jj * nx) + (kk);
+        umesh->cell_centroids_x[(cell_index)] =
+            0.5 * (mesh->edgex[(kk)] + mesh->edgex[(kk + 1)]);
+        umesh->cell_centroids_y[(cell_index)] =
+            0.5 * (mesh->edgey[(jj)] + mesh->edgey[(jj + 1)]);
+        umesh->cell_centroids_z[(cell_index)] =
+            0.5 * (mesh->edgez[(ii)] + mesh->edgez[(ii + 1)]);
+      }
+    }
+  }
+}
+
 // Initialises the connectivity between faces and nodes
 void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
                             UnstructuredMesh* umesh) {
@@ -210,7 +238,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
         umesh->faces_to_nodes[(face_to_node_off + 3)] =
             (ii * (nx + 1) * (ny + 1)) + ((jj + 1) * (nx + 1)) + (kk);
 
-        if (ii < nz + 1) {
+        if (ii < nz) {
           umesh->faces_cclockwise_cell[(face_index)] =
               (ii * nx * ny) + (jj * nx) + (kk);
         }
@@ -238,7 +266,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             umesh->faces_to_nodes[(face_to_node_off + 3)] =
                 ((ii + 1) * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk);
 
-            if (kk < nx + 1) {
+            if (kk < nx) {
               umesh->faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -262,7 +290,7 @@ void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
             umesh->faces_to_nodes[(face_to_node_off + 3)] =
                 (ii * (nx + 1) * (ny + 1)) + (jj * (nx + 1)) + (kk + 1);
 
-            if (jj < ny + 1) {
+            if (jj < ny) {
               umesh->faces_cclockwise_cell[(face_index)] =
                   (ii * nx * ny) + (jj * nx) + (kk);
             }
@@ -308,8 +336,14 @@ void init_cells_to_faces_3d(const int nx, const int ny, const int nz,
 }
 
 // Initialises the list of nodes to nodes
-void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh) {
+size_t init_nodes_to_nodes_3d(UnstructuredMesh* umesh) {
+
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_nodes, umesh->nnodes * NNODES_BY_NODE);
 
 // Prefix sum to convert the counts to offsets
 #pragma omp parallel for
@@ -359,11 +393,16 @@ void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  return allocated;
 }
 
 // Initialises the list of nodes to cells
-void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
-                            Mesh* mesh, UnstructuredMesh* umesh) {
+size_t init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
+                              Mesh* mesh, UnstructuredMesh* umesh) {
+
+  const size_t allocated = allocate_int_data(
+      &umesh->nodes_to_cells, umesh->nnodes * NCELLS_BY_NODE);
 
 #pragma omp parallel for
   for (int ii = 0; ii < (nz + 1); ++ii) {
@@ -422,6 +461,8 @@ void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
       }
     }
   }
+
+  return allocated;
 }
 
 // Initialises the boundary normals
@@ -19,16 +19,14 @@ void write_to_visit(const int nx, const int ny, const int x_off,
   write_to_visit_3d(nx, ny, 1, x_off, y_off, 0, data, name, step, time);
 }
 
-// Write out data for visualisation in visit
-void write_to_visit_3d(const int nx, const int ny, const int nz,
-                       const int x_off, const int y_off, const int z_off,
-                       const double* data, const char* name, const int step,
-                       const double time) {
 #ifdef ENABLE_VISIT_DUMPS
-  char bovname[256];
-  char datname[256];
-  sprintf(bovname, "%s%d.bov", name, step);
-  sprintf(datname, "%s%d.dat", name, step);
+// Writes the BOV header describing a brick of double precision data
+static void write_bov_header(const char* bovname, const char* datname,
+                             const char* name, const int nx, const int ny,
+                             const int nz, const int x_off, const int y_off,
+                             const int z_off, const double time) {
+  // The variable is named after the file, excluding any directory
+  const char* variable = strrchr(name, '/') ? strrchr(name, '/') + 1 : name;
 
   FILE* bovfp = fopen(bovname, "w");
   if (!bovfp) {
@@ -39,7 +37,7 @@ void write_to_visit_3d(const int nx, const int ny, const int nz,
   fprintf(bovfp, "DATA_FILE: %s\n", datname);
   fprintf(bovfp, "DATA_SIZE: %d %d %d\n", nx, ny, nz);
   fprintf(bovfp, "DATA_FORMAT: DOUBLE\n");
-  fprintf(bovfp, "VARIABLE: density\n");
+  fprintf(bovfp, "VARIABLE: %s\n", variable);
   fprintf(bovfp, "DATA_ENDIAN: LITTLE\n");
   fprintf(bovfp, "CENTERING: zone\n");
 
@@ -52,6 +50,22 @@ void write_to_visit_3d(const int nx, const int ny, const int nz,
 
   fprintf(bovfp, "BRICK_SIZE: %d %d %d\n", nx, ny, nz);
   fclose(bovfp);
+}
+#endif
+
+// Write out data for visualisation in visit
+void write_to_visit_3d(const int nx, const int ny, const int nz,
+                       const int x_off, const int y_off, const int z_off,
+                       const double* data, const char* name, const int step,
+                       const double time) {
+#ifdef ENABLE_VISIT_DUMPS
+  char bovname[256];
+  char datname[256];
+  sprintf(bovname, "%s%d.bov", name, step);
+  sprintf(datname, "%s%d.dat", name, step);
+
+  write_bov_header(bovname, datname, name, nx, ny, nz, x_off, y_off, z_off,
+                   time);
 
   FILE* datfp = fopen(datname, "wb");
   if (!datfp) {
@@ -63,93 +77,113 @@ void write_to_visit_3d(const int nx, const int ny, const int nz,
 #endif
 }
 
-// TODO: Fix this method - shouldn't be necessary to bring the data back from
-// all of the ranks, this is over the top
-// This is a leaky nasty function, that really doesn't suit any of the style of
-// the rest of the project, so needs immediate revisiting.
+#if defined(MPI) && defined(ENABLE_VISIT_DUMPS)
+// Collectively writes the owned part of each rank's padded local array into
+// its place in the padded global array. The ghost cells are only written on
+// the edges of the global mesh, where no other rank owns them.
+static void write_subarray_collective(const int* global_dims,
+                                      const int* local_dims, const int* offsets,
+                                      const int* lo_ghost, const int* hi_ghost,
+                                      double* local_arr, const char* datname) {
+  // The dimensions are ordered z, y, x for the row major layout
+  int sub_dims[3];
+  int global_starts[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    sub_dims[dd] = local_dims[dd] - lo_ghost[dd] - hi_ghost[dd];
+    global_starts[dd] = offsets[dd] + lo_ghost[dd];
+  }
+
+  MPI_Datatype file_type;
+  MPI_Datatype mem_type;
+  MPI_Type_create_subarray(3, global_dims, sub_dims, global_starts,
+                           MPI_ORDER_C, MPI_DOUBLE, &file_type);
+  MPI_Type_create_subarray(3, local_dims, sub_dims, lo_ghost, MPI_ORDER_C,
+                           MPI_DOUBLE, &mem_type);
+  MPI_Type_commit(&file_type);
+  MPI_Type_commit(&mem_type);
+
+  MPI_File fh;
+  if (MPI_File_open(MPI_COMM_WORLD, (char*)datname,
+                    MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                    &fh) != MPI_SUCCESS) {
+    TERMINATE("Could not open file %s\n", datname);
+  }
+
+  // Truncate any previous dump before the ranks write their subarrays
+  MPI_File_set_size(fh, 0);
+  MPI_File_set_view(fh, 0, MPI_DOUBLE, file_type, "native", MPI_INFO_NULL);
+  MPI_File_write_all(fh, local_arr, 1, mem_type, MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+
+  MPI_Type_free(&file_type);
+  MPI_Type_free(&mem_type);
+}
+#endif
+
+// Writes the data from all ranks into a single file for visit, with each rank
+// writing its own part of the padded global array collectively
 void write_all_ranks_to_visit(const int global_nx, const int global_ny,
                               const int local_nx, const int local_ny,
                               const int pad, const int x_off, const int y_off,
                               const int rank, const int nranks, int* neighbours,
                               double* local_arr, const char* name, const int tt,
                               const double elapsed_sim_time) {
+  write_all_ranks_to_visit_3d(global_nx, global_ny, 1, local_nx, local_ny, 1,
+                              pad, x_off, y_off, 0, rank, nranks, neighbours,
+                              local_arr, name, tt, elapsed_sim_time);
+}
+
+// Writes the data from all ranks into a single file for visit, with each rank
+// writing its own part of the padded global array collectively
+void write_all_ranks_to_visit_3d(
+    const int global_nx, const int global_ny, const int global_nz,
+    const int local_nx, const int local_ny, const int local_nz, const int pad,
+    const int x_off, const int y_off, const int z_off, const int rank,
+    const int nranks, int* neighbours, double* local_arr, const char* name,
+    const int tt, const double elapsed_sim_time) {
 #ifdef DEBUG
   if (rank == MASTER)
     printf("writing results to visit file %s\n", name);
 #endif
 
-// If MPI is enabled need to collect the data from all
-#if defined(MPI)
-  double* global_arr = NULL;
-  double* remote_data = NULL;
-  double* h_local_arr_space = NULL;
-  allocate_host_data(&h_local_arr_space, local_nx * local_ny);
-
-  double* h_local_arr = h_local_arr_space;
-  copy_buffer(local_nx * local_ny, &local_arr, &h_local_arr, RECV);
+#if defined(MPI) && defined(ENABLE_VISIT_DUMPS)
+  char bovname[256];
+  char datname[256];
+  sprintf(bovname, "%s%d.bov", name, tt);
+  sprintf(datname, "%s%d.dat", name, tt);
 
+  // The header describes the whole mesh so only the master writes it
   if (rank == MASTER) {
-    allocate_host_data(&global_arr, global_nx * global_ny);
-    remote_data = h_local_arr;
+    write_bov_header(bovname, datname, name, global_nx, global_ny, global_nz,
+                     0, 0, 0, elapsed_sim_time);
   }
 
-  for (int ii = 0; ii < nranks; ++ii) {
-    int nparams = 8;
-    int dims[nparams];
-    dims[0] = local_nx;
-    dims[1] = local_ny;
-    dims[2] = x_off;
-    dims[3] = y_off;
-    dims[4] = (neighbours[NORTH] == EDGE) ? 0 : pad;
-    dims[5] = (neighbours[EAST] == EDGE) ? 0 : pad;
-    dims[6] = (neighbours[SOUTH] == EDGE) ? 0 : pad;
-    dims[7] = (neighbours[WEST] == EDGE) ? 0 : pad;
-
-    if (rank == MASTER) {
-      if (ii > MASTER) {
-        MPI_Recv(&dims, nparams, MPI_INT, ii, TAG_VISIT0, MPI_COMM_WORLD,
-                 MPI_STATUSES_IGNORE);
-        allocate_host_data(&remote_data, dims[0] * dims[1]);
-        MPI_Recv(remote_data, dims[0] * dims[1], MPI_DOUBLE, ii, TAG_VISIT1,
-                 MPI_COMM_WORLD, MPI_STATUSES_IGNORE);
-      }
-
-      int lnx = dims[0];
-      int lny = dims[1];
-      int lx_off = dims[2];
-      int ly_off = dims[3];
-      int north = dims[4];
-      int east = dims[5];
-      int south = dims[6];
-      int west = dims[7];
-
-      // TODO: fix or remove this horrible piece
-      for (int jj = south; jj < lny - north; ++jj) {
-        for (int kk = west; kk < lnx - east; ++kk) {
-          global_arr[(jj - south + ly_off + south) * global_nx +
-                     (kk - west + lx_off + west)] = remote_data[jj * lnx + kk];
-        }
-      }
-
-      if (ii > MASTER) {
-        deallocate_data(remote_data);
-      }
-    } else if (ii == rank) {
-      MPI_Send(&dims, nparams, MPI_INT, MASTER, TAG_VISIT0, MPI_COMM_WORLD);
-      MPI_Send(h_local_arr, dims[0] * dims[1], MPI_DOUBLE, MASTER, TAG_VISIT1,
-               MPI_COMM_WORLD);
-    }
-    barrier();
-  }
-  if (rank == MASTER) {
-    write_to_visit(global_nx, global_ny, 0, 0, global_arr, name, tt,
-                   elapsed_sim_time);
-  }
-  barrier();
+  double* h_local_arr_space = NULL;
+  const size_t local_len = (size_t)local_nx * local_ny * local_nz;
+  allocate_host_data(&h_local_arr_space, local_len);
+  double* h_local_arr = h_local_arr_space;
+  copy_buffer(local_len, &local_arr, &h_local_arr, RECV);
+
+  // Only the edges of the global mesh keep their ghost cells, and the 2d
+  // meshes have no ghost cells in z
+  const int global_dims[3] = {global_nz, global_ny, global_nx};
+  const int local_dims[3] = {local_nz, local_ny, local_nx};
+  const int offsets[3] = {z_off, y_off, x_off};
+  const int lo_ghost[3] = {
+      (local_nz == 1 || neighbours[FRONT] == EDGE) ? 0 : pad,
+      (neighbours[SOUTH] == EDGE) ? 0 : pad,
+      (neighbours[WEST] == EDGE) ? 0 : pad};
+  const int hi_ghost[3] = {
+      (local_nz == 1 || neighbours[BACK] == EDGE) ? 0 : pad,
+      (neighbours[NORTH] == EDGE) ? 0 : pad,
+      (neighbours[EAST] == EDGE) ? 0 : pad};
+
+  write_subarray_collective(global_dims, local_dims, offsets, lo_ghost,
+                            hi_ghost, h_local_arr, datname);
 
   deallocate_data(h_local_arr_space);
-#else
-  write_to_visit(global_nx, global_ny, 0, 0, local_arr, name, tt,
-                 elapsed_sim_time);
+#elif !defined(MPI)
+  write_to_visit_3d(global_nx, global_ny, global_nz, 0, 0, 0, local_arr, name,
+                    tt, elapsed_sim_time);
 #endif
 }
@@ -13,6 +13,8 @@
 #define VEC_ALIGN 256 // The vector alignment to be used by memory allocators
 #define TAG_VISIT0 1000
 #define TAG_VISIT1 1001
+#define TAG_PARTITION 1002
+#define TAG_UNSTRUCTURED_HALO 1003 // First tag of the unstructured exchanges
 #define MAX_STR_LEN 1024
 #define MAX_KEYS 10
 #define GB ((1024.0) * (1024.0) * (1024.0))
@@ -39,12 +41,26 @@
     a = b;                                                                     \
     b = t;                                                                     \
   }
+#define iswap(a, b)                                                            \
+  {                                                                            \
+    int t = a;                                                                 \
+    a = b;                                                                     \
+    b = t;                                                                     \
+  }
 
 #define TERMINATE(...)                                                         \
   fprintf(stderr, __VA_ARGS__);                                                \
   fprintf(stderr, " %s:%d\n", __FILE__, __LINE__);                             \
   exit(EXIT_FAILURE);
 
+// Stops a routine that works on the host when the backend keeps its data on
+// a device, rather than letting it touch device memory
+#define REQUIRE_HOST_DATA()                                                    \
+  if (!data_on_host()) {                                                       \
+    TERMINATE("%s needs a backend that keeps its data on the host.\n",         \
+              __func__);                                                       \
+  }
+
 enum { RECV = 0, SEND = 1 }; // Whether data is sent to/received from device
 
 // Global profile hooks
@@ -58,6 +74,9 @@ extern "C" {
 // Initialises devices in implementation-specific manner
 void initialise_devices(int rank);
 
+// Whether the buffers from allocate_data can be accessed by the host
+int data_on_host(void);
+
 // Allocation and deallocation routines (these need templating away)
 size_t allocate_data(double** buf, size_t len);
 size_t allocate_float_data(float** buf, size_t len);
@@ -100,14 +119,20 @@ void write_to_visit_3d(const int nx, const int ny, const int nz,
                        const double* data, const char* name, const int step,
                        const double time);
 
-// Collects all of the mesh data from the fleet of ranks and then writes to
-// visit
+// Writes the data from all ranks into a single file for visit, with each rank
+// writing its own part of the padded global array collectively
 void write_all_ranks_to_visit(const int global_nx, const int global_ny,
                               const int local_nx, const int local_ny,
                               const int pad, const int x_off, const int y_off,
                               const int rank, const int nranks, int* neighbours,
                               double* local_arr, const char* name, const int tt,
                               const double elapsed_sim_time);
+void write_all_ranks_to_visit_3d(
+    const int global_nx, const int global_ny, const int global_nz,
+    const int local_nx, const int local_ny, const int local_nz, const int pad,
+    const int x_off, const int y_off, const int z_off, const int rank,
+    const int nranks, int* neighbours, double* local_arr, const char* name,
+    const int tt, const double elapsed_sim_time);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,605 @@
+#include "snapshot.h"
+#include "compress.h"
+#include "shared.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A field waiting in a staging buffer to be written
+typedef struct {
+  double* data;
+  size_t capacity;
+
+  int nx;
+  int ny;
+  int nz;
+  int x_off;
+  int y_off;
+  int z_off;
+  int step;
+  double time;
+  char name[MAX_STR_LEN];
+} SnapshotJob;
+
+#define SNAPSHOT_MAGIC "ARCHSNP"
+#define SNAPSHOT_VERSION 1
+#define COMPRESSED_MAGIC "ARCHCHZ"
+#define COMPRESSED_VERSION 1
+#define ENDIAN_MARKER 0x01020304 // Reads back byte swapped on a foreign host
+
+enum {
+  CHUNK_RAW,         // Stored as written
+  CHUNK_SHUFFLE_LZ,  // Byte shuffled then compressed
+  CHUNK_QUANTISED_LZ // Quantised, delta encoded, byte shuffled then compressed
+};
+
+// The header at the start of a compressed field
+typedef struct {
+  char magic[8];
+  uint32_t endian;
+  uint32_t version;
+  int32_t nx;
+  int32_t ny;
+  int32_t nz;
+  int32_t nchunks;
+  int32_t rows_per_chunk;
+  int32_t reserved;
+  double time;
+  double error_bound;
+} CompressedHeader;
+
+// The index entry describing where a chunk lives and how it was encoded
+typedef struct {
+  uint64_t offset;
+  uint64_t nbytes;
+  int32_t codec;
+  int32_t nrows;
+} CompressedChunk;
+
+// The staging pool and the bounded queue shared with the background writer
+static struct {
+  int initialised;
+  int stop;
+  int nbuffers;
+  int nstalls;
+
+  SnapshotJob* jobs;
+  int* free_jobs; // Stack of the staging buffers that can be filled
+  int nfree;
+  int* queue; // Ring of the staging buffers waiting to be written
+  int head;
+  int nqueued;
+
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t job_ready;
+  pthread_cond_t job_done;
+} snapshots;
+
+// Writes the queued snapshots in order until asked to stop
+static void* snapshot_writer(void* arg) {
+  while (1) {
+    pthread_mutex_lock(&snapshots.lock);
+    while (!snapshots.nqueued && !snapshots.stop) {
+      pthread_cond_wait(&snapshots.job_ready, &snapshots.lock);
+    }
+    if (!snapshots.nqueued) {
+      pthread_mutex_unlock(&snapshots.lock);
+      break;
+    }
+    const int jj = snapshots.queue[snapshots.head];
+    snapshots.head = (snapshots.head + 1) % snapshots.nbuffers;
+    snapshots.nqueued--;
+    pthread_mutex_unlock(&snapshots.lock);
+
+    SnapshotJob* job = &snapshots.jobs[jj];
+    write_to_visit_3d(job->nx, job->ny, job->nz, job->x_off, job->y_off,
+                      job->z_off, job->data, job->name, job->step, job->time);
+
+    // Return the staging buffer to the pool
+    pthread_mutex_lock(&snapshots.lock);
+    snapshots.free_jobs[snapshots.nfree++] = jj;
+    pthread_cond_broadcast(&snapshots.job_done);
+    pthread_mutex_unlock(&snapshots.lock);
+  }
+  return NULL;
+}
+
+// Starts the background writer with a pool of staging buffers, each sized
+// to hold buffer_len doubles
+void initialise_async_snapshots(const int nbuffers, const size_t buffer_len) {
+  if (snapshots.initialised) {
+    finalise_async_snapshots();
+  }
+
+  snapshots.nbuffers = (nbuffers > 0) ? nbuffers : SNAPSHOT_NBUFFERS;
+  snapshots.jobs =
+      (SnapshotJob*)calloc(snapshots.nbuffers, sizeof(SnapshotJob));
+  snapshots.free_jobs = (int*)malloc(sizeof(int) * snapshots.nbuffers);
+  snapshots.queue = (int*)malloc(sizeof(int) * snapshots.nbuffers);
+  if (!snapshots.jobs || !snapshots.free_jobs || !snapshots.queue) {
+    TERMINATE("Could not allocate the snapshot pool.\n");
+  }
+
+  for (int jj = 0; jj < snapshots.nbuffers; ++jj) {
+    snapshots.jobs[jj].data = (double*)malloc(sizeof(double) * buffer_len);
+    if (buffer_len && !snapshots.jobs[jj].data) {
+      TERMINATE("Could not allocate a snapshot staging buffer.\n");
+    }
+    snapshots.jobs[jj].capacity = buffer_len;
+    snapshots.free_jobs[jj] = jj;
+  }
+
+  snapshots.nfree = snapshots.nbuffers;
+  snapshots.head = 0;
+  snapshots.nqueued = 0;
+  snapshots.nstalls = 0;
+  snapshots.stop = 0;
+
+  pthread_mutex_init(&snapshots.lock, NULL);
+  pthread_cond_init(&snapshots.job_ready, NULL);
+  pthread_cond_init(&snapshots.job_done, NULL);
+  if (pthread_create(&snapshots.thread, NULL, snapshot_writer, NULL)) {
+    TERMINATE("Could not start the snapshot writer.\n");
+  }
+  snapshots.initialised = 1;
+}
+
+// Copies a host field into a staging buffer and queues it to be written for
+// visit, returning once the copy is complete
+void write_to_visit_3d_async(const int nx, const int ny, const int nz,
+                             const int x_off, const int y_off, const int z_off,
+                             const double* data, const char* name,
+                             const int step, const double time) {
+  const size_t len = (size_t)nx * ny * nz;
+  if (!snapshots.initialised) {
+    initialise_async_snapshots(SNAPSHOT_NBUFFERS, len);
+  }
+
+  // Wait for a free staging buffer if the writer has fallen behind
+  pthread_mutex_lock(&snapshots.lock);
+  if (!snapshots.nfree) {
+    snapshots.nstalls++;
+  }
+  while (!snapshots.nfree) {
+    pthread_cond_wait(&snapshots.job_done, &snapshots.lock);
+  }
+  const int jj = snapshots.free_jobs[--snapshots.nfree];
+  pthread_mutex_unlock(&snapshots.lock);
+
+  // The buffers only grow, so they are reused for every subsequent dump
+  SnapshotJob* job = &snapshots.jobs[jj];
+  if (job->capacity < len) {
+    free(job->data);
+    job->data = (double*)malloc(sizeof(double) * len);
+    if (!job->data) {
+      TERMINATE("Could not allocate a snapshot staging buffer.\n");
+    }
+    job->capacity = len;
+  }
+
+  double* staging = job->data;
+#pragma omp parallel for
+  for (size_t ii = 0; ii < len; ++ii) {
+    staging[ii] = data[ii];
+  }
+
+  job->nx = nx;
+  job->ny = ny;
+  job->nz = nz;
+  job->x_off = x_off;
+  job->y_off = y_off;
+  job->z_off = z_off;
+  job->step = step;
+  job->time = time;
+  strncpy(job->name, name, MAX_STR_LEN - 1);
+  job->name[MAX_STR_LEN - 1] = '\0';
+
+  pthread_mutex_lock(&snapshots.lock);
+  snapshots.queue[(snapshots.head + snapshots.nqueued) % snapshots.nbuffers] =
+      jj;
+  snapshots.nqueued++;
+  pthread_cond_signal(&snapshots.job_ready);
+  pthread_mutex_unlock(&snapshots.lock);
+}
+
+// Blocks until all of the queued snapshots have been written
+void flush_async_snapshots() {
+  if (!snapshots.initialised) {
+    return;
+  }
+
+  pthread_mutex_lock(&snapshots.lock);
+  while (snapshots.nfree < snapshots.nbuffers) {
+    pthread_cond_wait(&snapshots.job_done, &snapshots.lock);
+  }
+  pthread_mutex_unlock(&snapshots.lock);
+}
+
+// Returns the number of dumps that had to wait for a free staging buffer
+int get_async_snapshot_stalls() { return snapshots.nstalls; }
+
+// Flushes the queue, stops the background writer and releases the pool
+void finalise_async_snapshots() {
+  if (!snapshots.initialised) {
+    return;
+  }
+
+  flush_async_snapshots();
+
+  pthread_mutex_lock(&snapshots.lock);
+  snapshots.stop = 1;
+  pthread_cond_signal(&snapshots.job_ready);
+  pthread_mutex_unlock(&snapshots.lock);
+  pthread_join(snapshots.thread, NULL);
+
+  for (int jj = 0; jj < snapshots.nbuffers; ++jj) {
+    free(snapshots.jobs[jj].data);
+  }
+  free(snapshots.jobs);
+  free(snapshots.free_jobs);
+  free(snapshots.queue);
+  pthread_mutex_destroy(&snapshots.lock);
+  pthread_cond_destroy(&snapshots.job_ready);
+  pthread_cond_destroy(&snapshots.job_done);
+  snapshots.initialised = 0;
+}
+
+// Encodes a chunk of values, falling back on lossless compression if they
+// cannot be quantised and on the raw values if they do not compress
+static uint8_t* compress_chunk(const double* data, const size_t len,
+                               const double error_bound,
+                               CompressedChunk* chunk) {
+  const size_t raw_bytes = sizeof(double) * len;
+  uint8_t* encoded = (uint8_t*)malloc(raw_bytes);
+  uint8_t* shuffled = (uint8_t*)malloc(raw_bytes);
+  uint8_t* out = (uint8_t*)malloc(raw_bytes);
+  if (!encoded || !shuffled || !out) {
+    TERMINATE("Could not allocate space to compress a chunk.\n");
+  }
+
+  chunk->codec = CHUNK_SHUFFLE_LZ;
+  if (error_bound > 0.0 &&
+      quantise_doubles(data, len, error_bound, (uint64_t*)encoded)) {
+    chunk->codec = CHUNK_QUANTISED_LZ;
+    shuffle_bytes(encoded, len, sizeof(uint64_t), shuffled);
+  } else {
+    shuffle_bytes((const uint8_t*)data, len, sizeof(double), shuffled);
+  }
+
+  // Only keep the compressed chunk if it is smaller than the raw values
+  chunk->nbytes = lz_compress(shuffled, raw_bytes, out, raw_bytes - 1);
+  if (!chunk->nbytes) {
+    chunk->codec = CHUNK_RAW;
+    chunk->nbytes = raw_bytes;
+    memcpy(out, data, raw_bytes);
+  }
+
+  free(encoded);
+  free(shuffled);
+  return out;
+}
+
+// Decodes a chunk of values written by compress_chunk
+static void decompress_chunk(const uint8_t* in, const CompressedChunk* chunk,
+                             const size_t len, const double error_bound,
+                             double* out) {
+  const size_t raw_bytes = sizeof(double) * len;
+  if (chunk->codec == CHUNK_RAW) {
+    if (chunk->nbytes != raw_bytes) {
+      TERMINATE("Compressed chunk has an unexpected size.\n");
+    }
+    memcpy(out, in, raw_bytes);
+    return;
+  }
+
+  uint8_t* shuffled = (uint8_t*)malloc(raw_bytes);
+  if (!shuffled) {
+    TERMINATE("Could not allocate space to decompress a chunk.\n");
+  }
+  if (lz_decompress(in, chunk->nbytes, shuffled, raw_bytes) != raw_bytes) {
+    TERMINATE("Compressed chunk is corrupt.\n");
+  }
+
+  if (chunk->codec == CHUNK_QUANTISED_LZ) {
+    uint64_t* quantised = (uint64_t*)malloc(raw_bytes);
+    if (!quantised) {
+      TERMINATE("Could not allocate space to decompress a chunk.\n");
+    }
+    unshuffle_bytes(shuffled, len, sizeof(uint64_t), (uint8_t*)quantised);
+    dequantise_doubles(quantised, len, error_bound, out);
+    free(quantised);
+  } else {
+    unshuffle_bytes(shuffled, len, sizeof(double), (uint8_t*)out);
+  }
+  free(shuffled);
+}
+
+// Writes a field as independently compressed chunks of whole rows, preceded
+// by an index of the chunks. The values are quantised to within error_bound
+// when it is positive, otherwise they are compressed losslessly.
+void write_compressed_3d(const int nx, const int ny, const int nz,
+                         const double* data, const char* name, const int step,
+                         const double time, const double error_bound) {
+  CompressedHeader header;
+  memset(&header, 0, sizeof(CompressedHeader));
+  strcpy(header.magic, COMPRESSED_MAGIC);
+  header.endian = ENDIAN_MARKER;
+  header.version = COMPRESSED_VERSION;
+  header.nx = nx;
+  header.ny = ny;
+  header.nz = nz;
+  header.time = time;
+  header.error_bound = (error_bound > 0.0) ? error_bound : 0.0;
+
+  const int nrows = ny * nz;
+  header.rows_per_chunk =
+      max(1, SNAPSHOT_CHUNK_BYTES / (int)(sizeof(double) * nx));
+  header.nchunks = (nrows + header.rows_per_chunk - 1) / header.rows_per_chunk;
+
+  CompressedChunk* chunks =
+      (CompressedChunk*)malloc(sizeof(CompressedChunk) * header.nchunks);
+  uint8_t** chunk_data = (uint8_t**)malloc(sizeof(uint8_t*) * header.nchunks);
+  if (!chunks || !chunk_data) {
+    TERMINATE("Could not allocate the compressed chunk index.\n");
+  }
+
+  // The chunks are independent so are compressed in parallel
+#pragma omp parallel for schedule(dynamic)
+  for (int cc = 0; cc < header.nchunks; ++cc) {
+    const int row0 = cc * header.rows_per_chunk;
+    chunks[cc].nrows = min(header.rows_per_chunk, nrows - row0);
+    chunk_data[cc] =
+        compress_chunk(&data[(size_t)row0 * nx], (size_t)chunks[cc].nrows * nx,
+                       header.error_bound, &chunks[cc]);
+  }
+
+  uint64_t offset =
+      sizeof(CompressedHeader) + sizeof(CompressedChunk) * header.nchunks;
+  for (int cc = 0; cc < header.nchunks; ++cc) {
+    chunks[cc].offset = offset;
+    offset += chunks[cc].nbytes;
+  }
+
+  char filename[MAX_STR_LEN];
+  sprintf(filename, "%s%d.chz", name, step);
+  FILE* fp = fopen(filename, "wb");
+  if (!fp) {
+    TERMINATE("Could not open file %s\n", filename);
+  }
+  fwrite(&header, sizeof(CompressedHeader), 1, fp);
+  fwrite(chunks, sizeof(CompressedChunk), header.nchunks, fp);
+  for (int cc = 0; cc < header.nchunks; ++cc) {
+    fwrite(chunk_data[cc], 1, chunks[cc].nbytes, fp);
+    free(chunk_data[cc]);
+  }
+  fclose(fp);
+
+  free(chunks);
+  free(chunk_data);
+}
+
+// Opens a compressed field and checks its header
+static FILE* open_compressed(const char* filename, CompressedHeader* header) {
+  FILE* fp = fopen(filename, "rb");
+  if (!fp) {
+    TERMINATE("Could not open file %s\n", filename);
+  }
+  if (fread(header, sizeof(CompressedHeader), 1, fp) != 1 ||
+      memcmp(header->magic, COMPRESSED_MAGIC, sizeof(header->magic)) ||
+      header->version != COMPRESSED_VERSION) {
+    TERMINATE("%s is not a compressed field.\n", filename);
+  }
+  if (header->endian != ENDIAN_MARKER) {
+    TERMINATE("%s was written with a different endianness.\n", filename);
+  }
+  return fp;
+}
+
+// Reads the dimensions of a compressed field
+void read_compressed_dims(const char* filename, int* nx, int* ny, int* nz) {
+  CompressedHeader header;
+  FILE* fp = open_compressed(filename, &header);
+  fclose(fp);
+  *nx = header.nx;
+  *ny = header.ny;
+  *nz = header.nz;
+}
+
+// Reads rows [row0, row0 + nrows) of a compressed field, where each row is
+// nx values and the rows are ordered by y then z, decompressing only the
+// chunks that cover them
+void read_compressed_rows(const char* filename, const int row0,
+                          const int nrows, double* out) {
+  CompressedHeader header;
+  FILE* fp = open_compressed(filename, &header);
+  if (row0 < 0 || row0 + nrows > header.ny * header.nz) {
+    TERMINATE("Rows %d-%d are outside of %s.\n", row0, row0 + nrows,
+              filename);
+  }
+
+  CompressedChunk* chunks =
+      (CompressedChunk*)malloc(sizeof(CompressedChunk) * header.nchunks);
+  if (!chunks || fread(chunks, sizeof(CompressedChunk), header.nchunks, fp) !=
+                     (size_t)header.nchunks) {
+    TERMINATE("Could not read the chunk index of %s.\n", filename);
+  }
+
+  // Read the covering chunks in one pass through the file
+  const int c0 = row0 / header.rows_per_chunk;
+  const int c1 = (row0 + nrows - 1) / header.rows_per_chunk + 1;
+  uint8_t** chunk_data = (uint8_t**)malloc(sizeof(uint8_t*) * (c1 - c0));
+  if (!chunk_data) {
+    TERMINATE("Could not allocate space to read %s.\n", filename);
+  }
+  for (int cc = c0; cc < c1; ++cc) {
+    chunk_data[cc - c0] = (uint8_t*)malloc(chunks[cc].nbytes);
+    if (!chunk_data[cc - c0] ||
+        fseek(fp, (long)chunks[cc].offset, SEEK_SET) ||
+        fread(chunk_data[cc - c0], 1, chunks[cc].nbytes, fp) !=
+            chunks[cc].nbytes) {
+      TERMINATE("Could not read a chunk of %s.\n", filename);
+    }
+  }
+  fclose(fp);
+
+  // Decompress the chunks in parallel and keep the requested rows
+  const size_t nx = header.nx;
+#pragma omp parallel for schedule(dynamic)
+  for (int cc = c0; cc < c1; ++cc) {
+    const int chunk_row0 = cc * header.rows_per_chunk;
+    const size_t len = (size_t)chunks[cc].nrows * nx;
+    double* values = (double*)malloc(sizeof(double) * len);
+    if (!values) {
+      TERMINATE("Could not allocate space to decompress %s.\n", filename);
+    }
+    decompress_chunk(chunk_data[cc - c0], &chunks[cc], len, header.error_bound,
+                     values);
+
+    const int r0 = max(row0, chunk_row0);
+    const int r1 = min(row0 + nrows, chunk_row0 + chunks[cc].nrows);
+    memcpy(&out[(size_t)(r0 - row0) * nx],
+           &values[(size_t)(r0 - chunk_row0) * nx],
+           sizeof(double) * (r1 - r0) * nx);
+    free(values);
+    free(chunk_data[cc - c0]);
+  }
+
+  free(chunk_data);
+  free(chunks);
+}
+
+// Writes several fields of the same mesh and step into a single container
+void write_snapshot_3d(const int nx, const int ny, const int nz,
+                       const int x_off, const int y_off, const int z_off,
+                       const int nvars, const double** data,
+                       const char** var_names, const char* name,
+                       const int step, const double time) {
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(SnapshotHeader));
+  strcpy(header.magic, SNAPSHOT_MAGIC);
+  header.endian = ENDIAN_MARKER;
+  header.version = SNAPSHOT_VERSION;
+  header.nx = nx;
+  header.ny = ny;
+  header.nz = nz;
+  header.x_off = x_off;
+  header.y_off = y_off;
+  header.z_off = z_off;
+  header.step = step;
+  header.nvars = nvars;
+  header.time = time;
+
+  SnapshotVariable* vars =
+      (SnapshotVariable*)calloc(nvars, sizeof(SnapshotVariable));
+  if (!vars) {
+    TERMINATE("Could not allocate the snapshot variable table.\n");
+  }
+
+  // Each field starts on a page boundary after the header and table
+  const uint64_t nbytes = sizeof(double) * (uint64_t)nx * ny * nz;
+  uint64_t offset = sizeof(SnapshotHeader) + sizeof(SnapshotVariable) * nvars;
+  for (int vv = 0; vv < nvars; ++vv) {
+    if (strlen(var_names[vv]) >= SNAPSHOT_MAX_NAME) {
+      TERMINATE("Snapshot variable name %s is too long.\n", var_names[vv]);
+    }
+    strcpy(vars[vv].name, var_names[vv]);
+    offset = (offset + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+    vars[vv].offset = offset;
+    vars[vv].nbytes = nbytes;
+    offset += nbytes;
+  }
+
+  char filename[MAX_STR_LEN];
+  sprintf(filename, "%s%d.snap", name, step);
+  FILE* fp = fopen(filename, "wb");
+  if (!fp) {
+    TERMINATE("Could not open file %s\n", filename);
+  }
+  fwrite(&header, sizeof(SnapshotHeader), 1, fp);
+  fwrite(vars, sizeof(SnapshotVariable), nvars, fp);
+
+  // Pad up to the start of each field
+  const char zeros[SNAPSHOT_ALIGN] = {0};
+  uint64_t pos = sizeof(SnapshotHeader) + sizeof(SnapshotVariable) * nvars;
+  for (int vv = 0; vv < nvars; ++vv) {
+    fwrite(zeros, 1, vars[vv].offset - pos, fp);
+    if (fwrite(data[vv], 1, nbytes, fp) != nbytes) {
+      TERMINATE("Could not write %s to %s\n", var_names[vv], filename);
+    }
+    pos = vars[vv].offset + nbytes;
+  }
+  fclose(fp);
+  free(vars);
+}
+
+// Maps a snapshot container into memory and checks its header, returning 0
+// if the file could not be opened or is not a container
+int open_snapshot(const char* filename, SnapshotFile* snapshot) {
+  memset(snapshot, 0, sizeof(SnapshotFile));
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    return 0;
+  }
+
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return 0;
+  }
+
+  snapshot->map = map;
+  snapshot->len = st.st_size;
+  snapshot->header = (const SnapshotHeader*)map;
+  snapshot->vars =
+      (const SnapshotVariable*)((const char*)map + sizeof(SnapshotHeader));
+
+  // Check that the header and every field lie within the file
+  const SnapshotHeader* header = snapshot->header;
+  int valid = !memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) &&
+              header->endian == ENDIAN_MARKER &&
+              header->version == SNAPSHOT_VERSION && header->nvars >= 0 &&
+              sizeof(SnapshotHeader) +
+                      sizeof(SnapshotVariable) * (size_t)header->nvars <=
+                  snapshot->len;
+  for (int vv = 0; valid && vv < header->nvars; ++vv) {
+    valid = snapshot->vars[vv].offset % sizeof(double) == 0 &&
+            snapshot->vars[vv].offset + snapshot->vars[vv].nbytes <=
+                snapshot->len;
+  }
+  if (!valid) {
+    close_snapshot(snapshot);
+    return 0;
+  }
+  return 1;
+}
+
+// Returns a mapped field of a container, or NULL if it has no such variable
+const double* get_snapshot_variable(const SnapshotFile* snapshot,
+                                    const char* var_name) {
+  for (int vv = 0; vv < snapshot->header->nvars; ++vv) {
+    if (!strncmp(snapshot->vars[vv].name, var_name, SNAPSHOT_MAX_NAME)) {
+      return (const double*)((const char*)snapshot->map +
+                             snapshot->vars[vv].offset);
+    }
+  }
+  return NULL;
+}
+
+// Unmaps a snapshot container
+void close_snapshot(SnapshotFile* snapshot) {
+  if (snapshot->map) {
+    munmap(snapshot->map, snapshot->len);
+  }
+  memset(snapshot, 0, sizeof(SnapshotFile));
+}
@@ -0,0 +1,121 @@
+#ifndef __SNAPSHOTHDR
+#define __SNAPSHOTHDR
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ *    ASYNCHRONOUS SNAPSHOTS
+ *    Dumps are copied into a pool of staging buffers and written by a single
+ *    background thread, so the solver only pays for the copy. When every
+ *    buffer is waiting to be written the next dump blocks until one is free.
+ *
+ *    COMPRESSED SNAPSHOTS
+ *    Fields are split into chunks of whole rows that are compressed
+ *    independently, so that readers can decompress any range of rows.
+ *
+ *    SNAPSHOT CONTAINERS
+ *    All of the fields of a step are written to a single file, after a
+ *    header and a table of variables. Each field starts on a page boundary
+ *    so that readers can map the file and use the fields in place.
+ */
+
+#define SNAPSHOT_NBUFFERS 2 // Default number of staging buffers in the pool
+#define SNAPSHOT_CHUNK_BYTES (1 << 20) // Target size of a compressed chunk
+#define SNAPSHOT_ALIGN 4096            // Alignment of the fields in a container
+#define SNAPSHOT_MAX_NAME 64           // Longest variable name in a container
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The header at the start of a snapshot container
+typedef struct {
+  char magic[8];
+  uint32_t endian; // Reads back byte swapped on a foreign host
+  uint32_t version;
+  int32_t nx;
+  int32_t ny;
+  int32_t nz;
+  int32_t x_off;
+  int32_t y_off;
+  int32_t z_off;
+  int32_t step;
+  int32_t nvars;
+  double time;
+} SnapshotHeader;
+
+// An entry in the variable table that follows the header
+typedef struct {
+  char name[SNAPSHOT_MAX_NAME];
+  uint64_t offset; // Byte offset of the field from the start of the file
+  uint64_t nbytes;
+} SnapshotVariable;
+
+// A snapshot container mapped into memory by the reader
+typedef struct {
+  void* map;
+  size_t len;
+  const SnapshotHeader* header;
+  const SnapshotVariable* vars;
+} SnapshotFile;
+
+// Starts the background writer with a pool of staging buffers, each sized
+// to hold buffer_len doubles
+void initialise_async_snapshots(const int nbuffers, const size_t buffer_len);
+
+// Copies a host field into a staging buffer and queues it to be written for
+// visit, returning once the copy is complete
+void write_to_visit_3d_async(const int nx, const int ny, const int nz,
+                             const int x_off, const int y_off, const int z_off,
+                             const double* data, const char* name,
+                             const int step, const double time);
+
+// Blocks until all of the queued snapshots have been written
+void flush_async_snapshots();
+
+// Returns the number of dumps that had to wait for a free staging buffer
+int get_async_snapshot_stalls();
+
+// Flushes the queue, stops the background writer and releases the pool
+void finalise_async_snapshots();
+
+// Writes a field as independently compressed chunks of whole rows, preceded
+// by an index of the chunks. The values are quantised to within error_bound
+// when it is positive, otherwise they are compressed losslessly.
+void write_compressed_3d(const int nx, const int ny, const int nz,
+                         const double* data, const char* name, const int step,
+                         const double time, const double error_bound);
+
+// Reads the dimensions of a compressed field
+void read_compressed_dims(const char* filename, int* nx, int* ny, int* nz);
+
+// Reads rows [row0, row0 + nrows) of a compressed field, where each row is
+// nx values and the rows are ordered by y then z, decompressing only the
+// chunks that cover them
+void read_compressed_rows(const char* filename, const int row0,
+                          const int nrows, double* out);
+
+// Writes several fields of the same mesh and step into a single container
+void write_snapshot_3d(const int nx, const int ny, const int nz,
+                       const int x_off, const int y_off, const int z_off,
+                       const int nvars, const double** data,
+                       const char** var_names, const char* name,
+                       const int step, const double time);
+
+// Maps a snapshot container into memory and checks its header, returning 0
+// if the file could not be opened or is not a container
+int open_snapshot(const char* filename, SnapshotFile* snapshot);
+
+// Returns a mapped field of a container, or NULL if it has no such variable
+const double* get_snapshot_variable(const SnapshotFile* snapshot,
+                                    const char* var_name);
+
+// Unmaps a snapshot container
+void close_snapshot(SnapshotFile* snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,289 @@
+#include "tests.h"
+#include "../bench/sweeps.h"
+#include "../colour.h"
+#include "../geometry.h"
+#include "../shared.h"
+#include "../tiling.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks that a colouring lists every entity once under its colour, in
+// ascending order within each colour, and uses no more colours than allowed
+static int validate_colour_lists(const UnstructuredColouring* colouring,
+                                 const int n, const int max_colours) {
+  if (colouring->nentities != n || colouring->ncolours < 1 ||
+      colouring->ncolours > max_colours) {
+    return 1;
+  }
+  int nerrors = (colouring->colour_offsets[0] != 0 ||
+                 colouring->colour_offsets[colouring->ncolours] != n);
+  for (int colour = 0; colour < colouring->ncolours && !nerrors; ++colour) {
+    const int start = colouring->colour_offsets[colour];
+    const int end = colouring->colour_offsets[colour + 1];
+    nerrors += (end <= start);
+    nerrors += validate_sorted_list(colouring->colour_list, start, end, n);
+    for (int ii = start; ii < end && !nerrors; ++ii) {
+      nerrors += (colouring->colours[colouring->colour_list[ii]] != colour);
+    }
+  }
+  return nerrors;
+}
+
+// Checks that no two entities listed together in a row of a map, such as the
+// cells around a node, have the same colour
+static int validate_colour_conflicts(const int* colours, const int nrows,
+                                     const int* offsets, const int* list) {
+  int nerrors = 0;
+  for (int rr = 0; rr < nrows; ++rr) {
+    for (int ii = offsets[rr]; ii < offsets[rr + 1]; ++ii) {
+      for (int jj = ii + 1; jj < offsets[rr + 1]; ++jj) {
+        nerrors += (colours[list[ii]] == colours[list[jj]]);
+      }
+    }
+  }
+  return nerrors;
+}
+
+// Colours the cells and faces of the converted 3d mesh, checking that no two
+// cells of a colour share a node and no two faces of a colour share a cell,
+// that the implicit mesh is coloured identically and that the coloured
+// scatters match the atomic scatters
+int validate_unstructured_colouring(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  UnstructuredMesh implicit_umesh;
+  UnstructuredMesh shuffled;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  memset(&implicit_umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  convert_mesh_to_implicit_umesh_3d(&implicit_umesh, mesh);
+  init_shuffled_umesh_3d(mesh, &shuffled, NULL, NULL);
+
+  // A hexahedron shares nodes with at most 26 others, and a face shares
+  // cells with at most 10 others, which greedy colouring never exceeds
+  int nerrors = 0;
+  UnstructuredMesh* umeshes[] = {&umesh, &shuffled};
+  UnstructuredColouring cell_colourings[2];
+  UnstructuredColouring face_colourings[2];
+  for (int mm = 0; mm < 2; ++mm) {
+    UnstructuredMesh* coloured = umeshes[mm];
+    colour_cells_by_nodes(coloured, &cell_colourings[mm]);
+    colour_faces_by_cells(coloured, &face_colourings[mm]);
+    nerrors += validate_colour_lists(&cell_colourings[mm], coloured->ncells,
+                                     27);
+    nerrors +=
+        validate_colour_lists(&face_colourings[mm], coloured->nfaces, 11);
+    nerrors += validate_colour_conflicts(
+        cell_colourings[mm].colours, coloured->nnodes,
+        coloured->nodes_to_cells_offsets, coloured->nodes_to_cells);
+    nerrors += validate_colour_conflicts(
+        face_colourings[mm].colours, coloured->ncells,
+        coloured->cells_to_faces_offsets, coloured->cells_to_faces);
+  }
+
+  // The colours only depend on the connectivity, however it is stored
+  UnstructuredColouring implicit_cells;
+  UnstructuredColouring implicit_faces;
+  colour_cells_by_nodes(&implicit_umesh, &implicit_cells);
+  colour_faces_by_cells(&implicit_umesh, &implicit_faces);
+  nerrors += (implicit_cells.ncolours != cell_colourings[0].ncolours ||
+              implicit_faces.ncolours != face_colourings[0].ncolours);
+  nerrors += (memcmp(implicit_cells.colours, cell_colourings[0].colours,
+                     sizeof(int) * umesh.ncells) != 0);
+  nerrors += (memcmp(implicit_faces.colours, face_colourings[0].colours,
+                     sizeof(int) * umesh.nfaces) != 0);
+  finalise_unstructured_colouring(&implicit_cells);
+  finalise_unstructured_colouring(&implicit_faces);
+
+  // The scatters only differ by the order in which they sum
+  init_umesh_geometry(&umesh);
+  double* node_sums = (double*)malloc(sizeof(double) * umesh.nnodes);
+  double* cell_sums = (double*)malloc(sizeof(double) * umesh.ncells);
+  if (!node_sums || !cell_sums) {
+    TERMINATE("Could not allocate the scatter results.\n");
+  }
+  scatter_cells_to_nodes_atomic(&umesh);
+  memcpy(node_sums, umesh.nodes_x1, sizeof(double) * umesh.nnodes);
+  scatter_cells_to_nodes_coloured(&umesh, &cell_colourings[0]);
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    nerrors += differs(umesh.nodes_x1[nn], node_sums[nn], node_sums[nn]);
+  }
+  scatter_faces_to_cells_atomic(&umesh);
+  memcpy(cell_sums, umesh.cell_centroids_x, sizeof(double) * umesh.ncells);
+  scatter_faces_to_cells_coloured(&umesh, &face_colourings[0]);
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    nerrors += differs(umesh.cell_centroids_x[cc], cell_sums[cc],
+                       umesh.cell_volume[cc]);
+  }
+
+  free(node_sums);
+  free(cell_sums);
+  for (int mm = 0; mm < 2; ++mm) {
+    finalise_unstructured_colouring(&cell_colourings[mm]);
+    finalise_unstructured_colouring(&face_colourings[mm]);
+  }
+  finalise_unstructured_mesh(&umesh);
+  finalise_unstructured_mesh(&implicit_umesh);
+  finalise_unstructured_mesh(&shuffled);
+  return nerrors;
+}
+
+// Sorts indices in ascending order
+static int compare_ints(const void* a, const void* b) {
+  const int ia = *(const int*)a;
+  const int ib = *(const int*)b;
+  return (ia > ib) - (ia < ib);
+}
+
+// Whether a node is among the ascending nodes of a tile
+static int in_tile(const UnstructuredTiling* tiling, const int tt,
+                   const int node_index) {
+  const int nodes_off = tiling->tiles_to_nodes_offsets[tt];
+  return bsearch(&node_index, &tiling->tiles_to_nodes[nodes_off],
+                 tiling->tiles_to_nodes_offsets[tt + 1] - nodes_off,
+                 sizeof(int), compare_ints) != NULL;
+}
+
+// Checks that the tiles cover the cells in order, that each lists exactly the
+// nodes of its cells within the limit, and that each but the last would
+// exceed the limit with the next cell
+static int validate_tiles(const UnstructuredMesh* umesh,
+                          const UnstructuredTiling* tiling,
+                          const int max_nnodes) {
+  int nerrors = (tiling->ntiles < 1 || tiling->tiles_to_cells_offsets[0] != 0 ||
+                 tiling->tiles_to_cells_offsets[tiling->ntiles] !=
+                     umesh->ncells ||
+                 tiling->tiles_to_nodes_offsets[0] != 0);
+  int* used = (int*)calloc(umesh->nnodes, sizeof(int));
+  if (!used) {
+    TERMINATE("Could not allocate the tile validation.\n");
+  }
+  int max_tile_nnodes = 0;
+  for (int tt = 0; tt < tiling->ntiles && !nerrors; ++tt) {
+    const int cell_start = tiling->tiles_to_cells_offsets[tt];
+    const int cell_end = tiling->tiles_to_cells_offsets[tt + 1];
+    const int nodes_off = tiling->tiles_to_nodes_offsets[tt];
+    const int nnodes = tiling->tiles_to_nodes_offsets[tt + 1] - nodes_off;
+    max_tile_nnodes = max(max_tile_nnodes, nnodes);
+    nerrors += (cell_end <= cell_start);
+    nerrors += (nnodes > max_nnodes && cell_end - cell_start > 1);
+    nerrors += validate_sorted_list(tiling->tiles_to_nodes, nodes_off,
+                                    nodes_off + nnodes, umesh->nnodes);
+    if (nerrors) {
+      break;
+    }
+
+    // Every listed node is used by a cell of the tile through its local
+    // index, which stamps the node with the tile
+    for (int cc = cell_start; cc < cell_end; ++cc) {
+      const int cell_off = umesh_cell_node_offset(umesh, cc);
+      for (int nn = 0; nn < umesh_cell_nnodes(umesh, cc); ++nn) {
+        const int local = tiling->cells_to_local_nodes[cell_off + nn];
+        nerrors += (local < 0 || local >= nnodes);
+        if (!nerrors) {
+          const int node_index = tiling->tiles_to_nodes[nodes_off + local];
+          nerrors += (node_index != umesh_cell_node(umesh, cc, nn));
+          used[node_index] = tt + 1;
+        }
+      }
+    }
+    for (int nn = nodes_off; nn < nodes_off + nnodes && !nerrors; ++nn) {
+      nerrors += (used[tiling->tiles_to_nodes[nn]] != tt + 1);
+    }
+
+    if (tt + 1 < tiling->ntiles) {
+      int nnew = 0;
+      for (int nn = 0; nn < umesh_cell_nnodes(umesh, cell_end); ++nn) {
+        nnew += !in_tile(tiling, tt, umesh_cell_node(umesh, cell_end, nn));
+      }
+      nerrors += (nnodes + nnew <= max_nnodes);
+    }
+  }
+  nerrors += (!nerrors && tiling->max_tile_nnodes != max_tile_nnodes);
+  free(used);
+  return nerrors;
+}
+
+// Tiles the converted 3d mesh for several cache sizes, checking the tiles,
+// that the implicit mesh is tiled identically and that the tiled sweeps
+// match the untiled ones
+int validate_umesh_tiling(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  UnstructuredMesh implicit_umesh;
+  UnstructuredMesh shuffled;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  memset(&implicit_umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  convert_mesh_to_implicit_umesh_3d(&implicit_umesh, mesh);
+  init_shuffled_umesh_3d(mesh, &shuffled, NULL, NULL);
+  init_umesh_geometry(&umesh);
+
+  // From a tile for each cell up to tiles that fit in the cache
+  const int tile_nnodes[] = {1, NNODES_BY_CELL + 1, 64,
+                             TILING_L2_BYTES / (int)sizeof(double)};
+  const int ntile_sizes = sizeof(tile_nnodes) / sizeof(tile_nnodes[0]);
+  double* node_sums = (double*)malloc(sizeof(double) * umesh.nnodes);
+  double* cell_sums = (double*)malloc(sizeof(double) * umesh.ncells);
+  if (!node_sums || !cell_sums) {
+    TERMINATE("Could not allocate the tiled sweep results.\n");
+  }
+
+  int nerrors = 0;
+  for (int ss = 0; ss < ntile_sizes; ++ss) {
+    const size_t cache_bytes = sizeof(double) * tile_nnodes[ss];
+    UnstructuredTiling tiling;
+    UnstructuredTiling implicit_tiling;
+    UnstructuredTiling shuffled_tiling;
+    init_umesh_tiling(&umesh, &tiling, cache_bytes, sizeof(double));
+    init_umesh_tiling(&implicit_umesh, &implicit_tiling, cache_bytes,
+                      sizeof(double));
+    init_umesh_tiling(&shuffled, &shuffled_tiling, cache_bytes,
+                      sizeof(double));
+    nerrors += validate_tiles(&umesh, &tiling, tile_nnodes[ss]);
+    nerrors += validate_tiles(&shuffled, &shuffled_tiling, tile_nnodes[ss]);
+    nerrors += (ss == 0 && tiling.ntiles != umesh.ncells);
+
+    nerrors += (implicit_tiling.ntiles != tiling.ntiles);
+    if (!nerrors) {
+      const size_t nentries = umesh.cells_to_nodes_offsets[umesh.ncells];
+      nerrors += (memcmp(implicit_tiling.tiles_to_cells_offsets,
+                         tiling.tiles_to_cells_offsets,
+                         sizeof(int) * (tiling.ntiles + 1)) != 0);
+      nerrors += (memcmp(implicit_tiling.tiles_to_nodes_offsets,
+                         tiling.tiles_to_nodes_offsets,
+                         sizeof(int) * (tiling.ntiles + 1)) != 0);
+      nerrors += (memcmp(implicit_tiling.tiles_to_nodes, tiling.tiles_to_nodes,
+                         sizeof(int) *
+                             tiling.tiles_to_nodes_offsets[tiling.ntiles]) !=
+                  0);
+      nerrors += (memcmp(implicit_tiling.cells_to_local_nodes,
+                         tiling.cells_to_local_nodes,
+                         sizeof(int) * nentries) != 0);
+    }
+
+    // The tiled gather sums in the same order, while the scatter does not
+    gather_cells_to_nodes(&umesh);
+    memcpy(cell_sums, umesh.cell_centroids_x, sizeof(double) * umesh.ncells);
+    gather_cells_to_nodes_tiled(&umesh, &tiling);
+    nerrors += (memcmp(cell_sums, umesh.cell_centroids_x,
+                       sizeof(double) * umesh.ncells) != 0);
+    scatter_cells_to_nodes_atomic(&umesh);
+    memcpy(node_sums, umesh.nodes_x1, sizeof(double) * umesh.nnodes);
+    scatter_cells_to_nodes_tiled(&umesh, &tiling);
+    for (int nn = 0; nn < umesh.nnodes; ++nn) {
+      nerrors += differs(umesh.nodes_x1[nn], node_sums[nn], node_sums[nn]);
+    }
+
+    finalise_umesh_tiling(&tiling);
+    finalise_umesh_tiling(&implicit_tiling);
+    finalise_umesh_tiling(&shuffled_tiling);
+  }
+
+  free(node_sums);
+  free(cell_sums);
+  finalise_unstructured_mesh(&umesh);
+  finalise_unstructured_mesh(&implicit_umesh);
+  finalise_unstructured_mesh(&shuffled);
+  return nerrors;
+}
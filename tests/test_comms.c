@@ -0,0 +1,525 @@
+#include "tests.h"
+#include "../comms.h"
+#include "../shared.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MPI
+#include "mpi.h"
+#endif
+
+// Returns the direction facing the given direction
+static inline int opposite_direction(const int dir) {
+  switch (dir) {
+    case NORTH:
+      return SOUTH;
+    case EAST:
+      return WEST;
+    case SOUTH:
+      return NORTH;
+    case WEST:
+      return EAST;
+    case FRONT:
+      return BACK;
+    default:
+      return FRONT;
+  }
+}
+
+// Checks that the cartesian decomposition of nranks virtual ranks has
+// symmetric neighbours and that the rank offsets exactly cover the global
+// mesh, returning the number of errors found
+int validate_decomposition(const int ndims, const int nranks,
+                           const int global_nx, const int global_ny,
+                           const int global_nz) {
+  const int nneighbours = (ndims == 3) ? NNEIGHBOURS : 4;
+  int* dims = (int*)malloc(sizeof(int) * nranks * 6);
+  int* neighbours = (int*)malloc(sizeof(int) * nranks * NNEIGHBOURS);
+  if (!dims || !neighbours) {
+    TERMINATE("Could not allocate space for decomposition validation.\n");
+  }
+
+  for (int rr = 0; rr < nranks; ++rr) {
+    int* d = &dims[rr * 6];
+    int* n = &neighbours[rr * NNEIGHBOURS];
+    int ranks_x, ranks_y, ranks_z;
+    if (ndims == 3) {
+      decompose_3d_cartesian(rr, nranks, global_nx, global_ny, global_nz, n,
+                             &d[0], &d[1], &d[2], &ranks_x, &ranks_y,
+                             &ranks_z, &d[3], &d[4], &d[5]);
+    } else {
+      decompose_2d_cartesian(rr, nranks, global_nx, global_ny, n, &d[0],
+                             &d[1], &ranks_x, &ranks_y, &d[3], &d[4]);
+      d[2] = 1;
+      d[5] = 0;
+    }
+  }
+
+  const int global_n[3] = {global_nx, global_ny, (ndims == 3) ? global_nz : 1};
+
+  int nerrors = 0;
+  double covered = 0.0;
+  for (int rr = 0; rr < nranks; ++rr) {
+    const int* d = &dims[rr * 6];
+    const int* n = &neighbours[rr * NNEIGHBOURS];
+    covered += (double)d[0] * d[1] * d[2];
+
+    for (int aa = 0; aa < 3; ++aa) {
+      if (d[aa] <= 0 || d[aa + 3] < 0 || d[aa + 3] + d[aa] > global_n[aa]) {
+        printf("Rank %d of %d has extent %d at offset %d outside of %d.\n", rr,
+               nranks, d[aa], d[aa + 3], global_n[aa]);
+        nerrors++;
+      }
+    }
+
+    for (int dir = 0; dir < nneighbours; ++dir) {
+      // The axis and side of the mesh that each direction faces
+      const int axis = (dir == EAST || dir == WEST)
+                           ? 0
+                           : ((dir == NORTH || dir == SOUTH) ? 1 : 2);
+      const int upper = (dir == NORTH || dir == EAST || dir == BACK);
+      const int nb = n[dir];
+
+      if (nb == EDGE) {
+        const int on_edge = upper ? (d[axis + 3] + d[axis] == global_n[axis])
+                                  : (d[axis + 3] == 0);
+        if (!on_edge) {
+          printf("Rank %d of %d has no neighbour in direction %d but is not "
+                 "on the mesh edge.\n",
+                 rr, nranks, dir);
+          nerrors++;
+        }
+        continue;
+      }
+
+      if (nb < 0 || nb >= nranks) {
+        printf("Rank %d of %d has invalid neighbour %d.\n", rr, nranks, nb);
+        nerrors++;
+        continue;
+      }
+
+      const int* nd = &dims[nb * 6];
+      if (neighbours[nb * NNEIGHBOURS + opposite_direction(dir)] != rr) {
+        printf("Rank %d of %d is not the neighbour of its neighbour %d.\n", rr,
+               nranks, nb);
+        nerrors++;
+      }
+
+      // Neighbours abut along the axis and share the extent of the face
+      const int abuts = upper ? (d[axis + 3] + d[axis] == nd[axis + 3])
+                              : (nd[axis + 3] + nd[axis] == d[axis + 3]);
+      int shares_face = 1;
+      for (int aa = 0; aa < 3; ++aa) {
+        if (aa != axis) {
+          shares_face &= (d[aa] == nd[aa] && d[aa + 3] == nd[aa + 3]);
+        }
+      }
+      if (!abuts || !shares_face) {
+        printf("Rank %d of %d does not share a face with neighbour %d.\n", rr,
+               nranks, nb);
+        nerrors++;
+      }
+    }
+  }
+
+  if (covered != (double)global_n[0] * global_n[1] * global_n[2]) {
+    printf("Decomposition of %d ranks covers %.0f of %.0f cells.\n", nranks,
+           covered, (double)global_n[0] * global_n[1] * global_n[2]);
+    nerrors++;
+  }
+
+  free(dims);
+  free(neighbours);
+  return nerrors;
+}
+
+// Checks the ghost cells of the local mesh after a halo exchange, returning
+// the number of incorrect ghost values across all ranks
+int validate_halo_exchange_2d(Mesh* mesh) {
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int pad = mesh->pad;
+
+  // Every interior cell holds its global index
+#define GLOBAL_VALUE(ii, jj)                                                   \
+  ((double)(mesh->y_off + (ii)-pad) * mesh->global_nx +                        \
+   (mesh->x_off + (jj)-pad))
+
+  double* h_arr;
+  double* arr;
+  allocate_host_data(&h_arr, nx * ny);
+  allocate_data(&arr, nx * ny);
+
+  for (int ii = 0; ii < ny; ++ii) {
+    for (int jj = 0; jj < nx; ++jj) {
+      const int interior =
+          (ii >= pad && ii < ny - pad && jj >= pad && jj < nx - pad);
+      h_arr[ii * nx + jj] = interior ? GLOBAL_VALUE(ii, jj) : -1.0;
+    }
+  }
+
+  copy_buffer(nx * ny, &h_arr, &arr, SEND);
+  handle_boundary_2d(nx, ny, mesh, arr, NO_INVERT, PACK);
+  copy_buffer(nx * ny, &arr, &h_arr, RECV);
+
+  int nerrors = 0;
+  for (int ii = 0; ii < ny; ++ii) {
+    for (int jj = 0; jj < nx; ++jj) {
+      const int in_x = (jj >= pad && jj < nx - pad);
+      const int in_y = (ii >= pad && ii < ny - pad);
+
+      // Only the face halos are exchanged, corners are left untouched
+      if (in_x == in_y) {
+        continue;
+      }
+
+      int src_ii = ii;
+      int src_jj = jj;
+      if (!in_y) {
+        const int dir = (ii < pad) ? SOUTH : NORTH;
+        if (mesh->neighbours[dir] == EDGE) {
+          src_ii = (dir == SOUTH) ? 2 * pad - 1 - ii : 2 * (ny - pad) - 1 - ii;
+        }
+      } else {
+        const int dir = (jj < pad) ? WEST : EAST;
+        if (mesh->neighbours[dir] == EDGE) {
+          src_jj = (dir == WEST) ? 2 * pad - 1 - jj : 2 * (nx - pad) - 1 - jj;
+        }
+      }
+
+      const double expected = GLOBAL_VALUE(src_ii, src_jj);
+      if (h_arr[ii * nx + jj] != expected) {
+        if (nerrors < 10) {
+          printf("Rank %d ghost cell (%d, %d) holds %.0f, expected %.0f.\n",
+                 mesh->rank, jj, ii, h_arr[ii * nx + jj], expected);
+        }
+        nerrors++;
+      }
+    }
+  }
+#undef GLOBAL_VALUE
+
+  deallocate_host_data(h_arr);
+  deallocate_data(arr);
+  return (int)reduce_all_sum((double)nerrors);
+}
+
+// Checks the ghost cells of the local 3d mesh after a halo exchange,
+// returning the number of incorrect ghost values across all ranks
+int validate_halo_exchange_3d(Mesh* mesh) {
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int nz = mesh->local_nz;
+  const int pad = mesh->pad;
+
+  // Every interior cell holds its global index
+#define GLOBAL_VALUE(ii, jj, kk)                                               \
+  (((double)(mesh->z_off + (ii)-pad) * mesh->global_ny +                       \
+    (mesh->y_off + (jj)-pad)) *                                                \
+       mesh->global_nx +                                                       \
+   (mesh->x_off + (kk)-pad))
+
+  double* h_arr;
+  double* arr;
+  allocate_host_data(&h_arr, nx * ny * nz);
+  allocate_data(&arr, nx * ny * nz);
+
+  for (int ii = 0; ii < nz; ++ii) {
+    for (int jj = 0; jj < ny; ++jj) {
+      for (int kk = 0; kk < nx; ++kk) {
+        const int interior = (ii >= pad && ii < nz - pad && jj >= pad &&
+                              jj < ny - pad && kk >= pad && kk < nx - pad);
+        h_arr[(ii * ny + jj) * nx + kk] =
+            interior ? GLOBAL_VALUE(ii, jj, kk) : -1.0;
+      }
+    }
+  }
+
+  copy_buffer(nx * ny * nz, &h_arr, &arr, SEND);
+  handle_boundary_3d(nx, ny, nz, mesh, arr, NO_INVERT, PACK);
+  copy_buffer(nx * ny * nz, &arr, &h_arr, RECV);
+
+  int nerrors = 0;
+  for (int ii = 0; ii < nz; ++ii) {
+    for (int jj = 0; jj < ny; ++jj) {
+      for (int kk = 0; kk < nx; ++kk) {
+        const int in_x = (kk >= pad && kk < nx - pad);
+        const int in_y = (jj >= pad && jj < ny - pad);
+        const int in_z = (ii >= pad && ii < nz - pad);
+
+        // Only the face halos are checked, as the edges and corners are
+        // packed before their neighbours have filled them
+        if (in_x + in_y + in_z != 2) {
+          continue;
+        }
+
+        int src_ii = ii;
+        int src_jj = jj;
+        int src_kk = kk;
+        if (!in_z) {
+          const int dir = (ii < pad) ? FRONT : BACK;
+          if (mesh->neighbours[dir] == EDGE) {
+            src_ii = (dir == FRONT) ? 2 * pad - 1 - ii
+                                    : 2 * (nz - pad) - 1 - ii;
+          }
+        } else if (!in_y) {
+          const int dir = (jj < pad) ? SOUTH : NORTH;
+          if (mesh->neighbours[dir] == EDGE) {
+            src_jj = (dir == SOUTH) ? 2 * pad - 1 - jj
+                                    : 2 * (ny - pad) - 1 - jj;
+          }
+        } else {
+          const int dir = (kk < pad) ? WEST : EAST;
+          if (mesh->neighbours[dir] == EDGE) {
+            src_kk = (dir == WEST) ? 2 * pad - 1 - kk
+                                   : 2 * (nx - pad) - 1 - kk;
+          }
+        }
+
+        const double expected = GLOBAL_VALUE(src_ii, src_jj, src_kk);
+        const double actual = h_arr[(ii * ny + jj) * nx + kk];
+        if (actual != expected) {
+          if (nerrors < 10) {
+            printf("Rank %d ghost cell (%d, %d, %d) holds %.0f, expected "
+                   "%.0f.\n",
+                   mesh->rank, kk, jj, ii, actual, expected);
+          }
+          nerrors++;
+        }
+      }
+    }
+  }
+#undef GLOBAL_VALUE
+
+  deallocate_host_data(h_arr);
+  deallocate_data(arr);
+  return (int)reduce_all_sum((double)nerrors);
+}
+
+// Exchanges the global ids of the halo entries and counts those that differ
+// from the ids of the receiving entries
+static int validate_unstructured_halo(const UnstructuredHalo* halo,
+                                      const int* local_to_global) {
+  int nerrors = 0;
+#ifdef MPI
+  const int nsend = halo->send_offsets[halo->nneighbours];
+  const int nrecv = halo->recv_offsets[halo->nneighbours];
+  int* send_ids = (int*)malloc(sizeof(int) * (nsend + 1));
+  int* recv_ids = (int*)malloc(sizeof(int) * (nrecv + 1));
+  MPI_Request* reqs =
+      (MPI_Request*)malloc(sizeof(MPI_Request) * 2 * (halo->nneighbours + 1));
+  if (!send_ids || !recv_ids || !reqs) {
+    TERMINATE("Failed to allocate the halo validation.\n");
+  }
+  for (int ii = 0; ii < nsend; ++ii) {
+    send_ids[ii] = local_to_global[(halo->send_list[(ii)])];
+  }
+  int nreqs = 0;
+  for (int nb = 0; nb < halo->nneighbours; ++nb) {
+    MPI_Irecv(&recv_ids[halo->recv_offsets[nb]],
+              halo->recv_offsets[nb + 1] - halo->recv_offsets[nb], MPI_INT,
+              halo->neighbour_ranks[nb], TAG_PARTITION, MPI_COMM_WORLD,
+              &reqs[nreqs++]);
+    MPI_Isend(&send_ids[halo->send_offsets[nb]],
+              halo->send_offsets[nb + 1] - halo->send_offsets[nb], MPI_INT,
+              halo->neighbour_ranks[nb], TAG_PARTITION, MPI_COMM_WORLD,
+              &reqs[nreqs++]);
+  }
+  MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+  for (int ii = 0; ii < nrecv; ++ii) {
+    nerrors += (recv_ids[ii] != local_to_global[(halo->recv_list[(ii)])]);
+  }
+  free(send_ids);
+  free(recv_ids);
+  free(reqs);
+#else
+  nerrors += (halo->send_offsets[halo->nneighbours] != 0 ||
+              halo->recv_offsets[halo->nneighbours] != 0);
+#endif
+  return nerrors;
+}
+
+// Checks the ownership, ghost layer and halo lists of a partitioned mesh,
+// returning the number of errors across all ranks
+static int validate_unstructured_decomposition(
+    const int rank, const int nranks, UnstructuredMesh* global_umesh,
+    UnstructuredMesh* umesh, UnstructuredPartition* partition) {
+  int nerrors = 0;
+
+  // Every cell of the local mesh must match the global connectivity
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int gc = partition->local_to_global_cells[(cc)];
+    const int off = umesh->cells_to_nodes_offsets[(cc)];
+    const int goff = global_umesh->cells_to_nodes_offsets[(gc)];
+    const int nnodes_around_cell =
+        umesh->cells_to_nodes_offsets[(cc + 1)] - off;
+    nerrors += (partition->global_to_local_cells[(gc)] != cc);
+    nerrors += (nnodes_around_cell !=
+                global_umesh->cells_to_nodes_offsets[(gc + 1)] - goff);
+
+    int touches_owned = (cc < partition->nowned_cells);
+    for (int nn = 0; nn < nnodes_around_cell; ++nn) {
+      const int node_index = umesh->cells_to_nodes[(off + nn)];
+      nerrors += (partition->local_to_global_nodes[(node_index)] !=
+                  global_umesh->cells_to_nodes[(goff + nn)]);
+
+      // Ghost cells must share a node with an owned cell
+      for (int nc = umesh->nodes_to_cells_offsets[(node_index)];
+           nc < umesh->nodes_to_cells_offsets[(node_index + 1)]; ++nc) {
+        touches_owned |=
+            (umesh->nodes_to_cells[(nc)] < partition->nowned_cells);
+      }
+    }
+    nerrors += !touches_owned;
+  }
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    const int gn = partition->local_to_global_nodes[(nn)];
+    nerrors += (partition->global_to_local_nodes[(gn)] != nn ||
+                umesh->nodes_x0[(nn)] != global_umesh->nodes_x0[(gn)]);
+  }
+
+  // The owned cells and nodes must cover the global mesh exactly once
+  nerrors += validate_unstructured_halo(&partition->cell_halo,
+                                        partition->local_to_global_cells);
+  nerrors += validate_unstructured_halo(&partition->node_halo,
+                                        partition->local_to_global_nodes);
+  const double nowned_cells = reduce_all_sum(partition->nowned_cells);
+  const double nowned_nodes = reduce_all_sum(partition->nowned_nodes);
+  nerrors += (rank == MASTER && (nowned_cells != partition->nglobal_cells ||
+                                 nowned_nodes != partition->nglobal_nodes));
+
+  // The bisection balances the cells to within one per level
+  const double max_cells = -reduce_all_min(-(double)partition->nowned_cells);
+  const double min_cells = reduce_all_min((double)partition->nowned_cells);
+  nerrors += (rank == MASTER && max_cells - min_cells > log2(nranks) + 1.0);
+  return (int)reduce_all_sum((double)nerrors);
+}
+
+// Fills a field with a multiple of the global index of each owned entry,
+// marking the ghosts
+static void fill_exchange_field(const int nlocal, const int nowned,
+                                const int* local_to_global,
+                                const double scale, double* h_field) {
+  for (int ll = 0; ll < nlocal; ++ll) {
+    h_field[ll] = (ll < nowned) ? scale * local_to_global[(ll)] : -1.0;
+  }
+}
+
+// Counts the entries of a field that do not hold the scaled global index
+static int check_exchange_field(const int nlocal, const int* local_to_global,
+                                const double scale, const double* h_field) {
+  int nerrors = 0;
+  for (int ll = 0; ll < nlocal; ++ll) {
+    nerrors += (h_field[ll] != scale * local_to_global[(ll)]);
+  }
+  return nerrors;
+}
+
+// Checks an exchange of cell and node fields over a partitioned mesh,
+// returning the number of errors across all ranks
+static int validate_unstructured_exchange(UnstructuredMesh* umesh,
+                                          UnstructuredPartition* partition) {
+  const int ncell_fields = 2;
+  const double scales[] = {1.0, -0.5};
+  double* h_fields[3];
+  double* fields[3];
+  for (int ff = 0; ff < ncell_fields; ++ff) {
+    allocate_host_data(&h_fields[ff], umesh->ncells);
+    allocate_data(&fields[ff], umesh->ncells);
+    fill_exchange_field(umesh->ncells, partition->nowned_cells,
+                        partition->local_to_global_cells, scales[ff],
+                        h_fields[ff]);
+    copy_buffer(umesh->ncells, &h_fields[ff], &fields[ff], SEND);
+  }
+  allocate_host_data(&h_fields[2], umesh->nnodes);
+  allocate_data(&fields[2], umesh->nnodes);
+  fill_exchange_field(umesh->nnodes, partition->nowned_nodes,
+                      partition->local_to_global_nodes, 1.0, h_fields[2]);
+  copy_buffer(umesh->nnodes, &h_fields[2], &fields[2], SEND);
+
+  // Both exchanges are in flight together, begun in a different order on odd
+  // ranks so that only their tags can match the messages
+  int rank = 0;
+#ifdef MPI
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+#endif
+  UnstructuredExchange cell_exchange;
+  UnstructuredExchange node_exchange;
+  initialise_unstructured_exchange(&partition->cell_halo, ncell_fields,
+                                   TAG_UNSTRUCTURED_HALO, &cell_exchange);
+  initialise_unstructured_exchange(&partition->node_halo, 1,
+                                   TAG_UNSTRUCTURED_HALO + 1, &node_exchange);
+  if (rank % 2) {
+    begin_unstructured_exchange(&node_exchange, 1, &fields[2]);
+    begin_unstructured_exchange(&cell_exchange, ncell_fields, fields);
+  } else {
+    begin_unstructured_exchange(&cell_exchange, ncell_fields, fields);
+    begin_unstructured_exchange(&node_exchange, 1, &fields[2]);
+  }
+  end_unstructured_exchange(&cell_exchange, fields);
+  end_unstructured_exchange(&node_exchange, &fields[2]);
+
+  int nerrors = 0;
+  for (int ff = 0; ff < ncell_fields; ++ff) {
+    copy_buffer(umesh->ncells, &fields[ff], &h_fields[ff], RECV);
+    nerrors += check_exchange_field(umesh->ncells,
+                                    partition->local_to_global_cells,
+                                    scales[ff], h_fields[ff]);
+  }
+  copy_buffer(umesh->nnodes, &fields[2], &h_fields[2], RECV);
+  nerrors += check_exchange_field(umesh->nnodes,
+                                  partition->local_to_global_nodes, 1.0,
+                                  h_fields[2]);
+
+  // The gathers rely on the send lists ascending within each neighbour
+  const UnstructuredHalo* halos[] = {&partition->cell_halo,
+                                     &partition->node_halo};
+  for (int hh = 0; hh < 2; ++hh) {
+    for (int nb = 0; nb < halos[hh]->nneighbours; ++nb) {
+      for (int ii = halos[hh]->send_offsets[nb] + 1;
+           ii < halos[hh]->send_offsets[nb + 1]; ++ii) {
+        nerrors +=
+            (halos[hh]->send_list[(ii)] <= halos[hh]->send_list[(ii - 1)]);
+      }
+    }
+  }
+
+  finalise_unstructured_exchange(&cell_exchange);
+  finalise_unstructured_exchange(&node_exchange);
+  for (int ff = 0; ff < 3; ++ff) {
+    deallocate_host_data(h_fields[ff]);
+    deallocate_data(fields[ff]);
+  }
+  return (int)reduce_all_sum((double)nerrors);
+}
+
+// Converts the whole 3d mesh on every rank and checks its partition into
+// local unstructured meshes, and the exchange of fields over their halos
+int validate_unstructured_decomposition_3d(TestConfig* config,
+                                           int* nexchange_errors) {
+  TestConfig global_config = *config;
+  global_config.rank = MASTER;
+  global_config.nranks = 1;
+  Mesh global_mesh;
+  init_test_mesh(&global_config, &global_mesh, 3);
+
+  UnstructuredMesh global_umesh;
+  UnstructuredMesh umesh;
+  UnstructuredPartition partition;
+  memset(&global_umesh, 0, sizeof(UnstructuredMesh));
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&global_umesh, &global_mesh);
+  decompose_unstructured_mesh(config->rank, config->nranks, &global_umesh,
+                              &umesh, &partition);
+  const int nerrors = validate_unstructured_decomposition(
+      config->rank, config->nranks, &global_umesh, &umesh, &partition);
+  *nexchange_errors = validate_unstructured_exchange(&umesh, &partition);
+
+  finalise_unstructured_partition(&partition);
+  finalise_unstructured_mesh(&umesh);
+  finalise_unstructured_mesh(&global_umesh);
+  finalise_mesh(&global_mesh);
+  return nerrors;
+}
@@ -0,0 +1,416 @@
+#include "tests.h"
+#include "../geometry.h"
+#include "../shared.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks the geometry of a planar quad mesh without faces, built from the
+// bottom of the 3d mesh
+static int validate_polygon_geometry(Mesh* mesh) {
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  umesh.ncells = nx * ny;
+  umesh.nnodes = (nx + 1) * (ny + 1);
+  umesh.nnodes_by_cell = 4;
+  allocate_data(&umesh.nodes_x0, umesh.nnodes);
+  allocate_data(&umesh.nodes_y0, umesh.nnodes);
+  allocate_data(&umesh.nodes_z0, umesh.nnodes);
+  allocate_int_data(&umesh.cells_to_nodes_offsets, umesh.ncells + 1);
+  allocate_int_data(&umesh.cells_to_nodes, umesh.ncells * 4);
+  for (int jj = 0; jj < ny + 1; ++jj) {
+    for (int kk = 0; kk < nx + 1; ++kk) {
+      umesh.nodes_x0[jj * (nx + 1) + kk] = mesh->edgex[kk];
+      umesh.nodes_y0[jj * (nx + 1) + kk] = mesh->edgey[jj];
+    }
+  }
+
+  // Alternate rows run clockwise to check the orientation of the cells
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    const int node_index = (cc / nx) * (nx + 1) + (cc % nx);
+    const int corners[4] = {node_index, node_index + 1, node_index + nx + 2,
+                            node_index + nx + 1};
+    umesh.cells_to_nodes_offsets[cc + 1] = 4 * (cc + 1);
+    for (int nn = 0; nn < 4; ++nn) {
+      umesh.cells_to_nodes[4 * cc + nn] =
+          ((cc / nx) % 2) ? corners[3 - nn] : corners[nn];
+    }
+  }
+  init_umesh_geometry(&umesh);
+
+  int nerrors = 0;
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    const int jj = cc / nx;
+    const int kk = cc % nx;
+    const double area = (mesh->edgex[kk + 1] - mesh->edgex[kk]) *
+                        (mesh->edgey[jj + 1] - mesh->edgey[jj]);
+    nerrors += differs(umesh.cell_volume[cc], area, area);
+    for (int nn = 0; nn < 4; ++nn) {
+      nerrors += differs(umesh.sub_cell_volume[4 * cc + nn], 0.25 * area, area);
+    }
+  }
+
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Checks the geometry of the converted 3d mesh against the structured mesh,
+// that of the implicit mesh against the explicit one, and that an update
+// after moving the interior nodes matches a full recomputation
+int validate_umesh_geometry(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  UnstructuredMesh implicit_umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  memset(&implicit_umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  convert_mesh_to_implicit_umesh_3d(&implicit_umesh, mesh);
+
+  // The converted meshes come with their centroids
+  const double* edges[3] = {mesh->edgex, mesh->edgey, mesh->edgez};
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int nz = mesh->local_nz;
+  int nerrors = 0;
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    const int pos[3] = {cc % nx, (cc / nx) % ny, cc / (nx * ny)};
+    const double* centroids[3] = {umesh.cell_centroids_x,
+                                  umesh.cell_centroids_y,
+                                  umesh.cell_centroids_z};
+    for (int dd = 0; dd < 3; ++dd) {
+      const double* edge = edges[dd];
+      nerrors += differs(centroids[dd][cc],
+                         0.5 * (edge[pos[dd]] + edge[pos[dd] + 1]), 1.0);
+    }
+  }
+  init_umesh_geometry(&umesh);
+  init_umesh_geometry(&implicit_umesh);
+
+  // Every cell is a box split evenly between its nodes
+  double total_volume = 0.0;
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    const int pos[3] = {cc % nx, (cc / nx) % ny, cc / (nx * ny)};
+    double volume = 1.0;
+    for (int dd = 0; dd < 3; ++dd) {
+      volume *= edges[dd][pos[dd] + 1] - edges[dd][pos[dd]];
+    }
+    nerrors += differs(umesh.cell_volume[cc], volume, volume);
+    for (int nn = 0; nn < NNODES_BY_CELL; ++nn) {
+      nerrors += differs(umesh.sub_cell_volume[cc * NNODES_BY_CELL + nn],
+                         0.125 * volume, volume);
+    }
+    total_volume += umesh.cell_volume[cc];
+  }
+  const double domain_volume = (edges[0][nx] - edges[0][0]) *
+                               (edges[1][ny] - edges[1][0]) *
+                               (edges[2][nz] - edges[2][0]);
+  nerrors += differs(total_volume, domain_volume, domain_volume);
+
+  // The faces lie in the planes of the structured mesh, pointing from their
+  // first cell to their second, which is towards the lower indices
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    int pos[3];
+    const int orientation =
+        implicit_face_position(&implicit_umesh, ff, &pos[2], &pos[1], &pos[0]);
+    const int axis = (orientation == IMPLICIT_FACE_XY)
+                         ? 2
+                         : ((orientation == IMPLICIT_FACE_YZ) ? 0 : 1);
+    double area = 1.0;
+    for (int dd = 0; dd < 3; ++dd) {
+      if (dd != axis) {
+        area *= edges[dd][pos[dd] + 1] - edges[dd][pos[dd]];
+      }
+    }
+    const double normal[3] = {umesh.face_normal_x[ff], umesh.face_normal_y[ff],
+                              umesh.face_normal_z[ff]};
+    nerrors += differs(umesh.face_area[ff], area, area);
+    for (int dd = 0; dd < 3; ++dd) {
+      nerrors += differs(normal[dd], (dd == axis) ? -1.0 : 0.0, 1.0);
+    }
+  }
+
+  // The outward area vectors of every cell close
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    double closure[3] = {0.0, 0.0, 0.0};
+    for (int ff = 0; ff < NFACES_BY_CELL; ++ff) {
+      const int face_index = umesh_cell_face(&umesh, cc, ff);
+      const double outwards = (umesh.faces_to_cells0[face_index] == cc)
+                                  ? umesh.face_area[face_index]
+                                  : -umesh.face_area[face_index];
+      closure[0] += outwards * umesh.face_normal_x[face_index];
+      closure[1] += outwards * umesh.face_normal_y[face_index];
+      closure[2] += outwards * umesh.face_normal_z[face_index];
+    }
+    const double scale = umesh.face_area[umesh_cell_face(&umesh, cc, 0)];
+    for (int dd = 0; dd < 3; ++dd) {
+      nerrors += differs(closure[dd], 0.0, scale);
+    }
+  }
+
+  // The implicit mesh computes the same geometry in the same order
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    nerrors += (implicit_umesh.cell_volume[cc] != umesh.cell_volume[cc] ||
+                implicit_umesh.cell_centroids_x[cc] !=
+                    umesh.cell_centroids_x[cc] ||
+                implicit_umesh.cell_centroids_y[cc] !=
+                    umesh.cell_centroids_y[cc] ||
+                implicit_umesh.cell_centroids_z[cc] !=
+                    umesh.cell_centroids_z[cc]);
+  }
+  for (int ii = 0; ii < umesh.ncells * NNODES_BY_CELL; ++ii) {
+    nerrors +=
+        (implicit_umesh.sub_cell_volume[ii] != umesh.sub_cell_volume[ii]);
+  }
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    nerrors += (implicit_umesh.face_area[ff] != umesh.face_area[ff] ||
+                implicit_umesh.face_normal_x[ff] != umesh.face_normal_x[ff] ||
+                implicit_umesh.face_normal_y[ff] != umesh.face_normal_y[ff] ||
+                implicit_umesh.face_normal_z[ff] != umesh.face_normal_z[ff]);
+  }
+
+  // Moving some of the interior nodes keeps the total volume, and only the
+  // geometry around them is recomputed
+  const double shift = 0.1 * (edges[0][1] - edges[0][0]);
+  int nshifted = 0;
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    const int interior = (umesh.boundary_index[nn] == IS_INTERIOR);
+    const int shifted = interior && (nn % 3 == 0);
+    umesh.nodes_x1[nn] = umesh.nodes_x0[nn] + (shifted ? shift : 0.0);
+    umesh.nodes_y1[nn] = umesh.nodes_y0[nn] - (shifted ? 0.5 * shift : 0.0);
+    umesh.nodes_z1[nn] = umesh.nodes_z0[nn] + (shifted ? 0.25 * shift : 0.0);
+    nshifted += shifted;
+  }
+  nerrors += (update_umesh_geometry(&umesh) != nshifted);
+  nerrors += (update_umesh_geometry(&umesh) != 0);
+
+  const int nsub_cells = umesh.ncells * NNODES_BY_CELL;
+  double* updated = (double*)malloc(
+      sizeof(double) * (umesh.ncells + nsub_cells + 4 * umesh.nfaces));
+  if (!updated) {
+    TERMINATE("Could not allocate the updated geometry.\n");
+  }
+  double* updated_sub_cells = updated + umesh.ncells;
+  double* updated_faces = updated_sub_cells + nsub_cells;
+  memcpy(updated, umesh.cell_volume, sizeof(double) * umesh.ncells);
+  memcpy(updated_sub_cells, umesh.sub_cell_volume,
+         sizeof(double) * nsub_cells);
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    updated_faces[4 * ff] = umesh.face_area[ff];
+    updated_faces[4 * ff + 1] = umesh.face_normal_x[ff];
+    updated_faces[4 * ff + 2] = umesh.face_normal_y[ff];
+    updated_faces[4 * ff + 3] = umesh.face_normal_z[ff];
+  }
+  compute_umesh_geometry(&umesh);
+
+  double moved_volume = 0.0;
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    nerrors += (updated[cc] != umesh.cell_volume[cc]);
+    moved_volume += umesh.cell_volume[cc];
+  }
+  nerrors += differs(moved_volume, domain_volume, domain_volume);
+  for (int ii = 0; ii < nsub_cells; ++ii) {
+    nerrors += (updated_sub_cells[ii] != umesh.sub_cell_volume[ii] ||
+                umesh.sub_cell_volume[ii] <= 0.0);
+  }
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    nerrors += (updated_faces[4 * ff] != umesh.face_area[ff] ||
+                updated_faces[4 * ff + 1] != umesh.face_normal_x[ff] ||
+                updated_faces[4 * ff + 2] != umesh.face_normal_y[ff] ||
+                updated_faces[4 * ff + 3] != umesh.face_normal_z[ff]);
+  }
+
+  nerrors += validate_polygon_geometry(mesh);
+
+  free(updated);
+  finalise_unstructured_mesh(&implicit_umesh);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Counts the boundary nodes whose type or normal differ from the converted
+// mesh, where the normals of the converted mesh are first rotated
+int compare_boundary_normals(UnstructuredMesh* umesh,
+                             UnstructuredMesh* reference,
+                             const double rotation[3][3]) {
+  int nerrors = (umesh->nboundary_nodes != reference->nboundary_nodes);
+  for (int nn = 0; nn < umesh->nnodes && !nerrors; ++nn) {
+    const int index = reference->boundary_index[nn];
+    nerrors += (umesh->boundary_index[nn] != index);
+    if (index == IS_INTERIOR || nerrors) {
+      continue;
+    }
+    const double ref[3] = {reference->boundary_normal_x[index],
+                           reference->boundary_normal_y[index],
+                           reference->boundary_normal_z[index]};
+    const double normal[3] = {umesh->boundary_normal_x[index],
+                              umesh->boundary_normal_y[index],
+                              umesh->boundary_normal_z[index]};
+    double expected[3];
+    double dot = 0.0;
+    for (int dd = 0; dd < 3; ++dd) {
+      expected[dd] = rotation[dd][0] * ref[0] + rotation[dd][1] * ref[1] +
+                     rotation[dd][2] * ref[2];
+      dot += expected[dd] * normal[dd];
+    }
+
+    // The edges run either way along the rotated edge
+    const int type = reference->boundary_type[index];
+    nerrors += (umesh->boundary_type[index] != type);
+    if (type == IS_EDGE) {
+      nerrors += differs(fabs(dot), 1.0, 1.0);
+    } else {
+      for (int dd = 0; dd < 3; ++dd) {
+        nerrors += differs(normal[dd], expected[dd], 1.0);
+      }
+    }
+  }
+  return nerrors;
+}
+
+// Clears the boundary data of a mesh before it is found again
+void clear_boundary_normals(UnstructuredMesh* umesh) {
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->boundary_index[nn] = IS_INTERIOR;
+    umesh->boundary_type[nn] = 0;
+    umesh->boundary_normal_x[nn] = 0.0;
+    umesh->boundary_normal_y[nn] = 0.0;
+    umesh->boundary_normal_z[nn] = 0.0;
+  }
+  umesh->nboundary_nodes = 0;
+}
+
+// Checks the boundary faces of the converted mesh, and the boundary normals
+// found from them against its construction, when the faces are found,
+// listed, implicit and rotated, and those found from the edges of a 2d mesh
+int validate_boundary_normals(Mesh* mesh) {
+  const double identity[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
+                                 {0.0, 0.0, 1.0}};
+  UnstructuredMesh reference;
+  UnstructuredMesh umesh;
+  memset(&reference, 0, sizeof(UnstructuredMesh));
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&reference, mesh);
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+
+  clear_boundary_normals(&umesh);
+  find_boundary_normals_3d(&umesh, NULL);
+  int nerrors = compare_boundary_normals(&umesh, &reference, identity);
+
+  // The converted mesh lists the faces with a single cell in order
+  int nboundary_faces = 0;
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    if (umesh.faces_to_cells0[ff] == -1 || umesh.faces_to_cells1[ff] == -1) {
+      nerrors += (nboundary_faces >= umesh.nboundary_faces ||
+                  umesh.boundary_faces[nboundary_faces] != ff);
+      nboundary_faces++;
+    }
+  }
+  nerrors += (nboundary_faces != umesh.nboundary_faces);
+  clear_boundary_normals(&umesh);
+  find_boundary_normals_3d(&umesh, umesh.boundary_faces);
+  nerrors += compare_boundary_normals(&umesh, &reference, identity);
+
+  // The normals of a rotated mesh rotate with it
+  const double a = 0.3;
+  const double b = 0.5;
+  const double c = 0.7;
+  const double rotation[3][3] = {
+      {cos(a) * cos(b), cos(a) * sin(b) * sin(c) - sin(a) * cos(c),
+       cos(a) * sin(b) * cos(c) + sin(a) * sin(c)},
+      {sin(a) * cos(b), sin(a) * sin(b) * sin(c) + cos(a) * cos(c),
+       sin(a) * sin(b) * cos(c) - cos(a) * sin(c)},
+      {-sin(b), cos(b) * sin(c), cos(b) * cos(c)}};
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    const double pos[3] = {umesh.nodes_x0[nn], umesh.nodes_y0[nn],
+                           umesh.nodes_z0[nn]};
+    double* rotated[3] = {&umesh.nodes_x0[nn], &umesh.nodes_y0[nn],
+                          &umesh.nodes_z0[nn]};
+    for (int dd = 0; dd < 3; ++dd) {
+      *rotated[dd] = rotation[dd][0] * pos[0] + rotation[dd][1] * pos[1] +
+                     rotation[dd][2] * pos[2];
+    }
+  }
+  clear_boundary_normals(&umesh);
+  find_boundary_normals_3d(&umesh, NULL);
+  nerrors += compare_boundary_normals(&umesh, &reference, rotation);
+  finalise_unstructured_mesh(&umesh);
+
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_implicit_umesh_3d(&umesh, mesh);
+  nerrors += compare_boundary_normals(&umesh, &reference, identity);
+  for (int bb = 0; bb < reference.nboundary_faces; ++bb) {
+    nerrors += (umesh.boundary_faces[bb] != reference.boundary_faces[bb]);
+  }
+  clear_boundary_normals(&umesh);
+  find_boundary_normals_3d(&umesh, NULL);
+  nerrors += compare_boundary_normals(&umesh, &reference, identity);
+  finalise_unstructured_mesh(&umesh);
+  finalise_unstructured_mesh(&reference);
+
+  // The edges of the bottom of the mesh run clockwise around it
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  umesh.nnodes = (nx + 1) * (ny + 1);
+  umesh.nboundary_nodes = 2 * (nx + ny);
+  allocate_data(&umesh.nodes_x0, umesh.nnodes);
+  allocate_data(&umesh.nodes_y0, umesh.nnodes);
+  allocate_data(&umesh.boundary_normal_x, umesh.nnodes);
+  allocate_data(&umesh.boundary_normal_y, umesh.nnodes);
+  allocate_int_data(&umesh.boundary_index, umesh.nnodes);
+  allocate_int_data(&umesh.boundary_type, umesh.nnodes);
+  int* boundary_edges = (int*)malloc(sizeof(int) * 2 * umesh.nboundary_nodes);
+  if (!boundary_edges) {
+    TERMINATE("Could not allocate the boundary edges.\n");
+  }
+  for (int jj = 0; jj < ny + 1; ++jj) {
+    for (int kk = 0; kk < nx + 1; ++kk) {
+      const int node_index = jj * (nx + 1) + kk;
+      umesh.nodes_x0[node_index] = mesh->edgex[kk];
+      umesh.nodes_y0[node_index] = mesh->edgey[jj];
+      umesh.boundary_type[node_index] =
+          (jj == 0 || jj == ny || kk == 0 || kk == nx);
+    }
+  }
+  enumerate_boundary_nodes(&umesh);
+  const int corners[4] = {0, nx, umesh.nnodes - 1, ny * (nx + 1)};
+  const int steps[4] = {1, nx + 1, -1, -(nx + 1)};
+  const int lengths[4] = {nx, ny, nx, ny};
+  int nedges = 0;
+  for (int side = 0; side < 4; ++side) {
+    for (int ee = 0; ee < lengths[side]; ++ee) {
+      boundary_edges[2 * nedges] = corners[side] + (ee + 1) * steps[side];
+      boundary_edges[2 * nedges + 1] = corners[side] + ee * steps[side];
+      nedges++;
+    }
+  }
+  find_boundary_normals(&umesh, boundary_edges);
+
+  for (int jj = 0; jj < ny + 1; ++jj) {
+    for (int kk = 0; kk < nx + 1; ++kk) {
+      const int index = umesh.boundary_index[jj * (nx + 1) + kk];
+      if (index == IS_INTERIOR) {
+        continue;
+      }
+      // The corners are weighted by the lengths of their two edges
+      const double dx = (kk == 0) ? mesh->edgex[1] - mesh->edgex[0]
+                                  : mesh->edgex[nx] - mesh->edgex[nx - 1];
+      const double dy = (jj == 0) ? mesh->edgey[1] - mesh->edgey[0]
+                                  : mesh->edgey[ny] - mesh->edgey[ny - 1];
+      const double normal[2] = {(kk == 0) ? -dy : ((kk == nx) ? dy : 0.0),
+                                (jj == 0) ? -dx : ((jj == ny) ? dx : 0.0)};
+      const int corner = (normal[0] != 0.0 && normal[1] != 0.0);
+      const double mag = sqrt(normal[0] * normal[0] + normal[1] * normal[1]);
+      nerrors += (umesh.boundary_type[index] !=
+                  (corner ? IS_CORNER : IS_BOUNDARY));
+      nerrors += differs(umesh.boundary_normal_x[index], normal[0] / mag, 1.0);
+      nerrors += differs(umesh.boundary_normal_y[index], normal[1] / mag, 1.0);
+    }
+  }
+
+  free(boundary_edges);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
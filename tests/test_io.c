@@ -0,0 +1,369 @@
+#include "tests.h"
+#include "../checkpoint.h"
+#include "../comms.h"
+#include "../compress.h"
+#include "../params.h"
+#include "../shared.h"
+#include "../shared_data.h"
+#include "../snapshot.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fills the local field with the index of each cell in the padded global
+// mesh, writes it from all ranks and checks the file on the master
+int validate_visit_dump(Mesh* mesh) {
+  const int gnx = mesh->global_nx + 2 * mesh->pad;
+  const int gny = mesh->global_ny + 2 * mesh->pad;
+  const int gnz = (mesh->local_nz > 1) ? mesh->global_nz + 2 * mesh->pad : 1;
+  const int z_off = (mesh->local_nz > 1) ? mesh->z_off : 0;
+
+  // The host buffer is moved onto the device, which then owns it
+  double* h_arr;
+  double* arr = NULL;
+  const size_t local_len =
+      (size_t)mesh->local_nx * mesh->local_ny * mesh->local_nz;
+  allocate_host_data(&h_arr, local_len);
+  for (int ii = 0; ii < mesh->local_nz; ++ii) {
+    for (int jj = 0; jj < mesh->local_ny; ++jj) {
+      for (int kk = 0; kk < mesh->local_nx; ++kk) {
+        h_arr[(ii * mesh->local_ny + jj) * mesh->local_nx + kk] =
+            ((double)(z_off + ii) * gny + (mesh->y_off + jj)) * gnx +
+            (mesh->x_off + kk);
+      }
+    }
+  }
+  move_host_buffer_to_device(local_len, &h_arr, &arr);
+
+  write_all_ranks_to_visit_3d(gnx, gny, gnz, mesh->local_nx, mesh->local_ny,
+                              mesh->local_nz, mesh->pad, mesh->x_off,
+                              mesh->y_off, z_off, mesh->rank, mesh->nranks,
+                              mesh->neighbours, arr, TEST_PREFIX, 0, 0.0);
+  barrier();
+
+  int nerrors = 0;
+  if (mesh->rank == MASTER) {
+    char datname[MAX_STR_LEN];
+    sprintf(datname, "%s0.dat", TEST_PREFIX);
+    const size_t global_len = (size_t)gnx * gny * gnz;
+    double* global_arr = (double*)malloc(sizeof(double) * global_len);
+    FILE* fp = fopen(datname, "rb");
+    if (!global_arr || !fp ||
+        fread(global_arr, sizeof(double), global_len, fp) != global_len) {
+      TERMINATE("Could not read back %s.\n", datname);
+    }
+    fclose(fp);
+    for (size_t ii = 0; ii < global_len; ++ii) {
+      nerrors += (global_arr[ii] != (double)ii);
+    }
+    free(global_arr);
+  }
+  barrier();
+  remove_test_files(mesh->rank);
+  deallocate_data(arr);
+  return nerrors;
+}
+
+// Queues a field for the background writer, overwrites the source straight
+// away and checks that the file holds the field as it was when queued
+int validate_async_snapshot(const int rank) {
+  const int nx = 37;
+  const int ny = 11;
+  const int nz = 5;
+  const size_t len = (size_t)nx * ny * nz;
+  double* field = (double*)malloc(sizeof(double) * len);
+  double* check = (double*)malloc(sizeof(double) * len);
+  if (!field || !check) {
+    TERMINATE("Could not allocate the snapshot validation.\n");
+  }
+
+  char prefix[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", TEST_PREFIX, rank);
+  for (size_t ii = 0; ii < len; ++ii) {
+    field[ii] = (double)ii;
+  }
+  write_to_visit_3d_async(nx, ny, nz, 0, 0, 0, field, prefix, 0, 0.0);
+  for (size_t ii = 0; ii < len; ++ii) {
+    field[ii] = -1.0;
+  }
+  flush_async_snapshots();
+
+  char datname[MAX_STR_LEN];
+  sprintf(datname, "%s_%d_0.dat", TEST_PREFIX, rank);
+  FILE* fp = fopen(datname, "rb");
+  if (!fp || fread(check, sizeof(double), len, fp) != len) {
+    TERMINATE("Could not read back %s.\n", datname);
+  }
+  fclose(fp);
+
+  int nerrors = 0;
+  for (size_t ii = 0; ii < len; ++ii) {
+    nerrors += (check[ii] != (double)ii);
+  }
+  free(field);
+  free(check);
+  remove_test_files(rank);
+  return nerrors;
+}
+
+// Compresses a smooth field with a discontinuity, then checks that the
+// lossless round trip is exact and the lossy one is within its bound,
+// reading back a range of rows that spans several chunks
+int validate_compressed_snapshot(const int rank) {
+  const int nx = 97;
+  const int ny = 1500;
+  const int nz = 3;
+  const double error_bound = 1.0e-6;
+  const size_t len = (size_t)nx * ny * nz;
+  double* field = (double*)malloc(sizeof(double) * len);
+  double* check = (double*)malloc(sizeof(double) * len);
+  if (!field || !check) {
+    TERMINATE("Could not allocate the compression validation.\n");
+  }
+  for (size_t ii = 0; ii < len; ++ii) {
+    field[ii] = ((ii % nx) < nx / 2 ? 1.0 : 0.125) + 1.0e-3 * sin(0.01 * ii);
+  }
+
+  char prefix[MAX_STR_LEN];
+  char filename[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", TEST_PREFIX, rank);
+  sprintf(filename, "%s_%d_0.chz", TEST_PREFIX, rank);
+
+  int nerrors = 0;
+  const int row0 = 17;
+  const int nrows = ny * nz - 2 * row0;
+  for (int lossy = 0; lossy < 2; ++lossy) {
+    const double bound = lossy ? error_bound : 0.0;
+    write_compressed_3d(nx, ny, nz, field, prefix, 0, 0.0, bound);
+    read_compressed_rows(filename, row0, nrows, check);
+    for (size_t ii = 0; ii < (size_t)nrows * nx; ++ii) {
+      nerrors += (fabs(check[ii] - field[row0 * nx + ii]) > bound);
+    }
+  }
+
+  free(field);
+  free(check);
+  remove_test_files(rank);
+  return nerrors;
+}
+
+// Writes several fields into a snapshot container and checks them through
+// the mapped reader
+int validate_snapshot_container(const int rank) {
+  const int nx = 19;
+  const int ny = 7;
+  const int nz = 3;
+  const int nvars = 3;
+  const size_t len = (size_t)nx * ny * nz;
+  const char* var_names[] = {"density", "energy", "temperature"};
+  double* fields[3];
+  for (int vv = 0; vv < nvars; ++vv) {
+    fields[vv] = (double*)malloc(sizeof(double) * len);
+    if (!fields[vv]) {
+      TERMINATE("Could not allocate the snapshot validation.\n");
+    }
+    for (size_t ii = 0; ii < len; ++ii) {
+      fields[vv][ii] = vv * len + ii;
+    }
+  }
+
+  char prefix[MAX_STR_LEN];
+  char filename[MAX_STR_LEN];
+  sprintf(prefix, "%s_%d_", TEST_PREFIX, rank);
+  sprintf(filename, "%s_%d_0.snap", TEST_PREFIX, rank);
+  write_snapshot_3d(nx, ny, nz, 0, 0, 0, nvars, (const double**)fields,
+                    var_names, prefix, 0, 0.5);
+
+  int nerrors = 0;
+  SnapshotFile snapshot;
+  if (!open_snapshot(filename, &snapshot)) {
+    nerrors++;
+  } else {
+    nerrors += (snapshot.header->nx != nx || snapshot.header->ny != ny ||
+                snapshot.header->nz != nz || snapshot.header->time != 0.5 ||
+                snapshot.header->nvars != nvars);
+    nerrors += (get_snapshot_variable(&snapshot, "pressure") != NULL);
+    for (int vv = 0; vv < nvars; ++vv) {
+      const double* field = get_snapshot_variable(&snapshot, var_names[vv]);
+      if (!field) {
+        nerrors++;
+        continue;
+      }
+      nerrors += ((size_t)field % SNAPSHOT_ALIGN != 0);
+      nerrors += memcmp(field, fields[vv], sizeof(double) * len) != 0;
+    }
+    close_snapshot(&snapshot);
+  }
+
+  for (int vv = 0; vv < nvars; ++vv) {
+    free(fields[vv]);
+  }
+  remove_test_files(rank);
+  return nerrors;
+}
+
+// Sets a deterministic initial state for the checkpoint validation
+static void init_checkpoint_state(Mesh* mesh, SharedData* shared_data) {
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  for (int ii = 0; ii < ny; ++ii) {
+    for (int jj = 0; jj < nx; ++jj) {
+      const int gx = mesh->x_off + jj;
+      const int gy = mesh->y_off + ii;
+      shared_data->density[ii * nx + jj] = 1.0 + 0.5 * sin(0.3 * gx + 0.7 * gy);
+      shared_data->energy[ii * nx + jj] = 0.1 * gy;
+    }
+  }
+  mesh->dt = 1.0e-3;
+  mesh->niters = 0;
+}
+
+// Advances the checkpoint validation state by a diffusion step with a halo
+// exchange, and moves the unstructured nodes
+static void step_checkpoint_state(Mesh* mesh, SharedData* shared_data,
+                                  UnstructuredMesh* umesh, const int step) {
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int pad = mesh->pad;
+  double* density = shared_data->density;
+  double* density_old = shared_data->density_old;
+  handle_boundary_2d(nx, ny, mesh, density, NO_INVERT, PACK);
+
+#pragma omp parallel for
+  for (int ii = pad; ii < ny - pad; ++ii) {
+    for (int jj = pad; jj < nx - pad; ++jj) {
+      const int ind = ii * nx + jj;
+      density_old[ind] =
+          density[ind] + 0.1 * (density[ind - 1] + density[ind + 1] +
+                                density[ind - nx] + density[ind + nx] -
+                                4.0 * density[ind]);
+    }
+  }
+#pragma omp parallel for
+  for (int ii = pad; ii < ny - pad; ++ii) {
+    for (int jj = pad; jj < nx - pad; ++jj) {
+      density[ii * nx + jj] = density_old[ii * nx + jj];
+      shared_data->energy[ii * nx + jj] += mesh->dt * density[ii * nx + jj];
+    }
+  }
+
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->nodes_x1[nn] = umesh->nodes_x0[nn] + 1.0e-3 * sin(step + nn);
+    umesh->nodes_y1[nn] = umesh->nodes_y0[nn] + mesh->dt * umesh->nodes_x1[nn];
+  }
+  mesh->dt *= 1.01;
+  mesh->niters++;
+}
+
+// Runs the validation state to completion both uninterrupted and through a
+// checkpoint, restarting into freshly initialised state, and checks that
+// the results are bitwise identical
+int validate_checkpoint_restart(Mesh* mesh_2d, Mesh* mesh_3d) {
+  const int nsteps = 12;
+  const int checkpoint_step = 5;
+  const int nx = mesh_2d->local_nx;
+  const int ny = mesh_2d->local_ny;
+
+  // A shallow copy keeps the restored scalars out of the test mesh
+  Mesh mesh = *mesh_2d;
+  SharedData shared_data;
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh_3d);
+  memset(&shared_data, 0, sizeof(SharedData));
+  allocate_data(&shared_data.density, nx * ny);
+  allocate_data(&shared_data.energy, nx * ny);
+  allocate_data(&shared_data.density_old, nx * ny);
+  init_checkpoint_state(&mesh, &shared_data);
+  for (int step = 0; step < nsteps; ++step) {
+    if (step == checkpoint_step) {
+      write_checkpoint(TEST_CHECKPOINT, step, step * 0.5, &mesh,
+                       &shared_data, &umesh);
+    }
+    step_checkpoint_state(&mesh, &shared_data, &umesh, step);
+  }
+
+  const size_t ncells = (size_t)nx * ny;
+  double* density = (double*)malloc(sizeof(double) * ncells);
+  double* energy = (double*)malloc(sizeof(double) * ncells);
+  double* nodes_y1 = (double*)malloc(sizeof(double) * umesh.nnodes);
+  if (!density || !energy || !nodes_y1) {
+    TERMINATE("Could not allocate the checkpoint validation.\n");
+  }
+  memcpy(density, shared_data.density, sizeof(double) * ncells);
+  memcpy(energy, shared_data.energy, sizeof(double) * ncells);
+  memcpy(nodes_y1, umesh.nodes_y1, sizeof(double) * umesh.nnodes);
+  const double dt = mesh.dt;
+
+  // Scramble the state so that only the checkpoint can restore it
+  init_checkpoint_state(&mesh, &shared_data);
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    umesh.nodes_x1[nn] = umesh.nodes_y1[nn] = -1.0;
+  }
+  mesh.dt = 0.0;
+
+  int step;
+  double time;
+  read_checkpoint(TEST_CHECKPOINT, &mesh, &shared_data, &umesh, &step,
+                  &time);
+  int nerrors = (step != checkpoint_step || time != checkpoint_step * 0.5 ||
+                 mesh.niters != checkpoint_step);
+  for (; step < nsteps; ++step) {
+    step_checkpoint_state(&mesh, &shared_data, &umesh, step);
+  }
+
+  nerrors += (mesh.dt != dt);
+  nerrors += memcmp(density, shared_data.density, sizeof(double) * ncells) != 0;
+  nerrors += memcmp(energy, shared_data.energy, sizeof(double) * ncells) != 0;
+  nerrors +=
+      memcmp(nodes_y1, umesh.nodes_y1, sizeof(double) * umesh.nnodes) != 0;
+
+  char filename[MAX_STR_LEN];
+  sprintf(filename, "%s.%d.ckpt", TEST_CHECKPOINT, mesh.rank);
+  remove(filename);
+  free(density);
+  free(energy);
+  free(nodes_y1);
+  deallocate_data(shared_data.density);
+  deallocate_data(shared_data.energy);
+  deallocate_data(shared_data.density_old);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Loads a parameter file collectively and then removes it, so the lookups can
+// only succeed from the store, including those made by the master alone,
+// returning the number of errors across all ranks
+int validate_parameter_file(const int rank) {
+  if (rank == MASTER) {
+    FILE* fp = fopen(TEST_PARAMS, "w");
+    if (!fp) {
+      TERMINATE("Could not open %s.\n", TEST_PARAMS);
+    }
+    fprintf(fp, "nx 123\nproblem_1 density=0.5 energy=2.0\n");
+    fclose(fp);
+  }
+  barrier();
+  load_parameter_file(TEST_PARAMS);
+  barrier();
+  if (rank == MASTER) {
+    remove(TEST_PARAMS);
+  }
+  barrier();
+
+  char keys[MAX_KEYS * MAX_STR_LEN];
+  double values[MAX_KEYS];
+  int nkeys = 0;
+  int nerrors = 0;
+  if (rank == MASTER) {
+    nerrors += (get_int_parameter("nx", TEST_PARAMS) != 123);
+  }
+  nerrors += !get_key_value_parameter("problem_1", TEST_PARAMS, keys, values,
+                                      &nkeys);
+  nerrors += (nkeys != 2 || values[1] != 2.0);
+  nerrors += (get_double_parameter("nx", TEST_PARAMS) != 123.0);
+  finalise_parameters();
+  return (int)reduce_all_sum((double)nerrors);
+}
@@ -0,0 +1,536 @@
+#include "tests.h"
+#include "../geometry.h"
+#include "../shared.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks that the faces to cells and cells to faces connectivity agree,
+// returning the number of errors found
+static int validate_umesh_connectivity_3d(UnstructuredMesh* umesh) {
+  int nerrors = 0;
+
+  // Every face of a cell must name that cell on one of its sides
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    for (int ff = umesh->cells_to_faces_offsets[(cc)];
+         ff < umesh->cells_to_faces_offsets[(cc + 1)]; ++ff) {
+      const int face_index = umesh->cells_to_faces[(ff)];
+      if (face_index < 0 || face_index >= umesh->nfaces) {
+        printf("Cell %d has invalid face %d.\n", cc, face_index);
+        nerrors++;
+      } else if (umesh->faces_to_cells0[(face_index)] != cc &&
+                 umesh->faces_to_cells1[(face_index)] != cc) {
+        printf("Face %d of cell %d does not border the cell.\n", face_index,
+               cc);
+        nerrors++;
+      }
+    }
+  }
+
+  // Every cell bordering a face must list that face
+  for (int ff = 0; ff < umesh->nfaces; ++ff) {
+    const int cell0 = umesh->faces_to_cells0[(ff)];
+    const int cell1 = umesh->faces_to_cells1[(ff)];
+    if ((cell0 == -1 && cell1 == -1) || cell0 == cell1) {
+      printf("Face %d borders cells %d and %d.\n", ff, cell0, cell1);
+      nerrors++;
+      continue;
+    }
+
+    for (int ss = 0; ss < 2; ++ss) {
+      const int cell_index = (ss == 0) ? cell0 : cell1;
+      if (cell_index == -1) {
+        continue;
+      }
+      if (cell_index < -1 || cell_index >= umesh->ncells) {
+        printf("Face %d borders invalid cell %d.\n", ff, cell_index);
+        nerrors++;
+        continue;
+      }
+
+      int found = 0;
+      for (int cf = umesh->cells_to_faces_offsets[(cell_index)];
+           cf < umesh->cells_to_faces_offsets[(cell_index + 1)]; ++cf) {
+        found |= (umesh->cells_to_faces[(cf)] == ff);
+      }
+      if (!found) {
+        printf("Face %d is missing from the faces of cell %d.\n", ff,
+               cell_index);
+        nerrors++;
+      }
+    }
+  }
+
+  return nerrors;
+}
+
+// Checks that the faces to cells and cells to faces connectivity of the
+// converted 3d mesh agree
+int validate_converted_connectivity(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  const int nerrors = validate_umesh_connectivity_3d(&umesh);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// The number of positions within one of an index along an axis of length n
+static int count_axis_neighbours(const int ii, const int n) {
+  return 1 + (ii > 0) + (ii < n - 1);
+}
+
+// Checks the maps built by transposing and composing the connectivity of the
+// converted 3d mesh against the structure of the original mesh
+int validate_csr_transposes(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  fill_cells_to_cells(&umesh);
+
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int nz = mesh->local_nz;
+  int nerrors = (umesh.nodes_to_cells_offsets[umesh.nnodes] !=
+                 umesh.ncells * NNODES_BY_CELL);
+  nerrors += (umesh.nodes_to_faces_offsets[umesh.nnodes] !=
+              umesh.nfaces * NNODES_BY_FACE);
+
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    const int kk = nn % (nx + 1);
+    const int jj = (nn / (nx + 1)) % (ny + 1);
+    const int ii = nn / ((nx + 1) * (ny + 1));
+
+    // Every cell and face listed by a node must list the node in turn
+    const int ncells = umesh.nodes_to_cells_offsets[nn + 1] -
+                       umesh.nodes_to_cells_offsets[nn];
+    nerrors += (ncells != (1 + (ii > 0 && ii < nz)) *
+                              (1 + (jj > 0 && jj < ny)) *
+                              (1 + (kk > 0 && kk < nx)));
+    nerrors += validate_sorted_list(
+        umesh.nodes_to_cells, umesh.nodes_to_cells_offsets[nn],
+        umesh.nodes_to_cells_offsets[nn + 1], umesh.ncells);
+    for (int cc = umesh.nodes_to_cells_offsets[nn];
+         cc < umesh.nodes_to_cells_offsets[nn + 1] && !nerrors; ++cc) {
+      const int cell_index = umesh.nodes_to_cells[cc];
+      int found = 0;
+      for (int vv = 0; vv < NNODES_BY_CELL; ++vv) {
+        found |= (umesh.cells_to_nodes[cell_index * NNODES_BY_CELL + vv] == nn);
+      }
+      nerrors += !found;
+    }
+    nerrors += validate_sorted_list(
+        umesh.nodes_to_faces, umesh.nodes_to_faces_offsets[nn],
+        umesh.nodes_to_faces_offsets[nn + 1], umesh.nfaces);
+    for (int ff = umesh.nodes_to_faces_offsets[nn];
+         ff < umesh.nodes_to_faces_offsets[nn + 1] && !nerrors; ++ff) {
+      const int face_index = umesh.nodes_to_faces[ff];
+      int found = 0;
+      for (int vv = 0; vv < NNODES_BY_FACE; ++vv) {
+        found |= (umesh.faces_to_nodes[face_index * NNODES_BY_FACE + vv] == nn);
+      }
+      nerrors += !found;
+    }
+
+    // The neighbouring nodes are one step along exactly one axis
+    const int nneighbours = umesh.nodes_to_nodes_offsets[nn + 1] -
+                            umesh.nodes_to_nodes_offsets[nn];
+    nerrors += (nneighbours != count_axis_neighbours(ii, nz + 1) +
+                                   count_axis_neighbours(jj, ny + 1) +
+                                   count_axis_neighbours(kk, nx + 1) - 3);
+    nerrors += validate_sorted_list(
+        umesh.nodes_to_nodes, umesh.nodes_to_nodes_offsets[nn],
+        umesh.nodes_to_nodes_offsets[nn + 1], umesh.nnodes);
+    for (int ll = umesh.nodes_to_nodes_offsets[nn];
+         ll < umesh.nodes_to_nodes_offsets[nn + 1] && !nerrors; ++ll) {
+      const int node_index = umesh.nodes_to_nodes[ll];
+      const int dist = abs(node_index % (nx + 1) - kk) +
+                       abs((node_index / (nx + 1)) % (ny + 1) - jj) +
+                       abs(node_index / ((nx + 1) * (ny + 1)) - ii);
+      nerrors += (dist != 1);
+    }
+  }
+
+  // The neighbouring cells are all of those within one step on every axis
+  for (int cc = 0; cc < umesh.ncells && !nerrors; ++cc) {
+    const int kk = cc % nx;
+    const int jj = (cc / nx) % ny;
+    const int ii = cc / (nx * ny);
+    nerrors += (umesh.cells_to_cells_offsets[cc + 1] -
+                    umesh.cells_to_cells_offsets[cc] !=
+                count_axis_neighbours(ii, nz) * count_axis_neighbours(jj, ny) *
+                        count_axis_neighbours(kk, nx) -
+                    1);
+    nerrors += validate_sorted_list(
+        umesh.cells_to_cells, umesh.cells_to_cells_offsets[cc],
+        umesh.cells_to_cells_offsets[cc + 1], umesh.ncells);
+    for (int ll = umesh.cells_to_cells_offsets[cc];
+         ll < umesh.cells_to_cells_offsets[cc + 1]; ++ll) {
+      const int cell_index = umesh.cells_to_cells[ll];
+      nerrors += (cell_index == cc || abs(cell_index % nx - kk) > 1 ||
+                  abs((cell_index / nx) % ny - jj) > 1 ||
+                  abs(cell_index / (nx * ny) - ii) > 1);
+    }
+  }
+
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Counts the differences between two CSR maps
+static int compare_csr(const int n, const int* offsets, const int* list,
+                       const int* other_offsets, const int* other_list) {
+  int nerrors = 0;
+  for (int ii = 0; ii < n + 1; ++ii) {
+    nerrors += (offsets[ii] != other_offsets[ii]);
+  }
+  for (int ii = 0; ii < offsets[n] && !nerrors; ++ii) {
+    nerrors += (list[ii] != other_list[ii]);
+  }
+  return nerrors;
+}
+
+// Checks that the accessors of an implicit mesh give the connectivity stored
+// by the converted mesh, and that materialising it reproduces the arrays
+int validate_implicit_connectivity(Mesh* mesh) {
+  UnstructuredMesh umesh;
+  UnstructuredMesh implicit_umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  memset(&implicit_umesh, 0, sizeof(UnstructuredMesh));
+  const size_t explicit_bytes = convert_mesh_to_umesh_3d(&umesh, mesh);
+  const size_t implicit_bytes =
+      convert_mesh_to_implicit_umesh_3d(&implicit_umesh, mesh);
+  int nerrors = (implicit_bytes * 2 > explicit_bytes);
+
+  for (int cc = 0; cc < umesh.ncells && !nerrors; ++cc) {
+    nerrors += (umesh_cell_nnodes(&implicit_umesh, cc) != NNODES_BY_CELL ||
+                umesh_cell_nfaces(&implicit_umesh, cc) != NFACES_BY_CELL);
+    for (int nn = 0; nn < NNODES_BY_CELL; ++nn) {
+      nerrors += (umesh_cell_node(&implicit_umesh, cc, nn) !=
+                  umesh_cell_node(&umesh, cc, nn));
+    }
+    for (int ff = 0; ff < NFACES_BY_CELL; ++ff) {
+      nerrors += (umesh_cell_face(&implicit_umesh, cc, ff) !=
+                  umesh_cell_face(&umesh, cc, ff));
+    }
+  }
+  for (int nn = 0; nn < umesh.nnodes && !nerrors; ++nn) {
+    nerrors += (umesh_node_ncells(&implicit_umesh, nn) !=
+                    umesh_node_ncells(&umesh, nn) ||
+                umesh_node_nnodes(&implicit_umesh, nn) !=
+                    umesh_node_nnodes(&umesh, nn));
+    for (int cc = 0; cc < umesh_node_ncells(&umesh, nn); ++cc) {
+      nerrors += (umesh_node_cell(&implicit_umesh, nn, cc) !=
+                  umesh_node_cell(&umesh, nn, cc));
+    }
+    for (int ll = 0; ll < umesh_node_nnodes(&umesh, nn); ++ll) {
+      nerrors += (umesh_node_node(&implicit_umesh, nn, ll) !=
+                  umesh_node_node(&umesh, nn, ll));
+    }
+  }
+  for (int ff = 0; ff < umesh.nfaces && !nerrors; ++ff) {
+    nerrors += (umesh_face_nnodes(&implicit_umesh, ff) != NNODES_BY_FACE);
+    for (int nn = 0; nn < NNODES_BY_FACE; ++nn) {
+      nerrors += (umesh_face_node(&implicit_umesh, ff, nn) !=
+                  umesh_face_node(&umesh, ff, nn));
+    }
+    for (int side = 0; side < 2; ++side) {
+      nerrors += (umesh_face_cell(&implicit_umesh, ff, side) !=
+                  umesh_face_cell(&umesh, ff, side));
+    }
+  }
+
+  materialise_umesh_connectivity(&implicit_umesh);
+  nerrors += validate_umesh_connectivity_3d(&implicit_umesh);
+  nerrors += compare_csr(umesh.ncells, umesh.cells_to_nodes_offsets,
+                         umesh.cells_to_nodes,
+                         implicit_umesh.cells_to_nodes_offsets,
+                         implicit_umesh.cells_to_nodes);
+  nerrors += compare_csr(umesh.ncells, umesh.cells_to_faces_offsets,
+                         umesh.cells_to_faces,
+                         implicit_umesh.cells_to_faces_offsets,
+                         implicit_umesh.cells_to_faces);
+  nerrors += compare_csr(umesh.nnodes, umesh.nodes_to_cells_offsets,
+                         umesh.nodes_to_cells,
+                         implicit_umesh.nodes_to_cells_offsets,
+                         implicit_umesh.nodes_to_cells);
+  nerrors += compare_csr(umesh.nnodes, umesh.nodes_to_nodes_offsets,
+                         umesh.nodes_to_nodes,
+                         implicit_umesh.nodes_to_nodes_offsets,
+                         implicit_umesh.nodes_to_nodes);
+  nerrors += compare_csr(umesh.nnodes, umesh.nodes_to_faces_offsets,
+                         umesh.nodes_to_faces,
+                         implicit_umesh.nodes_to_faces_offsets,
+                         implicit_umesh.nodes_to_faces);
+  nerrors += compare_csr(umesh.nfaces, umesh.faces_to_nodes_offsets,
+                         umesh.faces_to_nodes,
+                         implicit_umesh.faces_to_nodes_offsets,
+                         implicit_umesh.faces_to_nodes);
+  for (int ff = 0; ff < umesh.nfaces; ++ff) {
+    nerrors += (implicit_umesh.faces_cclockwise_cell[ff] !=
+                umesh.faces_cclockwise_cell[ff]);
+  }
+  for (int nn = 0; nn < umesh.nnodes; ++nn) {
+    nerrors += (implicit_umesh.boundary_index[nn] != umesh.boundary_index[nn]);
+  }
+
+  finalise_unstructured_mesh(&implicit_umesh);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Writes the nodes of the converted 3d mesh and the given elements out as
+// node and element files, numbered from one, where each element holds a
+// quarter of its index as a regional variable
+static void write_mesh_definition(UnstructuredMesh* umesh,
+                                  const char* node_filename,
+                                  const char* ele_filename, const int ncells,
+                                  const int nnodes_by_cell,
+                                  const int* cells_to_nodes) {
+  FILE* node_fp = fopen(node_filename, "w");
+  FILE* ele_fp = fopen(ele_filename, "w");
+  if (!node_fp || !ele_fp) {
+    TERMINATE("Could not open the unstructured mesh files.\n");
+  }
+  fprintf(node_fp, "# Converted from the benchmark mesh\n%d 3 0 1\n",
+          umesh->nnodes);
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    fprintf(node_fp, "%d %.17g %.17g %.17g %d\n", nn + 1, umesh->nodes_x0[nn],
+            umesh->nodes_y0[nn], umesh->nodes_z0[nn],
+            umesh->boundary_index[nn] != IS_INTERIOR);
+  }
+  fprintf(ele_fp, "%d %d 1\n", ncells, nnodes_by_cell);
+  for (int cc = 0; cc < ncells; ++cc) {
+    fprintf(ele_fp, "%d", cc + 1);
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      fprintf(ele_fp, " %d", cells_to_nodes[cc * nnodes_by_cell + nn] + 1);
+    }
+    fprintf(ele_fp, " %.17g\n", 0.25 * cc);
+  }
+  fclose(node_fp);
+  fclose(ele_fp);
+}
+
+// Checks that the loader reproduces the converted 3d mesh, with the faces
+// found from its elements giving the same neighbours, geometry and boundary
+// normals, and that the same holds for its split into tetrahedra
+int validate_read_unstructured_mesh(Mesh* mesh) {
+  const double identity[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0},
+                                 {0.0, 0.0, 1.0}};
+  UnstructuredMesh umesh;
+  memset(&umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&umesh, mesh);
+  init_umesh_geometry(&umesh);
+
+  char node_filename[MAX_STR_LEN];
+  char ele_filename[MAX_STR_LEN];
+  sprintf(node_filename, "%s_%d.node", TEST_PREFIX, mesh->rank);
+  sprintf(ele_filename, "%s_%d.ele", TEST_PREFIX, mesh->rank);
+  write_mesh_definition(&umesh, node_filename, ele_filename, umesh.ncells,
+                        NNODES_BY_CELL, umesh.cells_to_nodes);
+
+  UnstructuredMesh loaded;
+  memset(&loaded, 0, sizeof(UnstructuredMesh));
+  loaded.node_filename = node_filename;
+  loaded.ele_filename = ele_filename;
+  double** variables;
+  read_unstructured_mesh(&loaded, &variables, 1);
+
+  int nerrors =
+      (loaded.nnodes != umesh.nnodes || loaded.ncells != umesh.ncells ||
+       loaded.nnodes_by_cell != NNODES_BY_CELL);
+  int nboundary_nodes = 0;
+  for (int nn = 0; nn < umesh.nnodes && !nerrors; ++nn) {
+    nboundary_nodes += (umesh.boundary_index[nn] != IS_INTERIOR);
+    nerrors += (loaded.nodes_x0[nn] != umesh.nodes_x0[nn] ||
+                loaded.nodes_y0[nn] != umesh.nodes_y0[nn] ||
+                loaded.nodes_z0[nn] != umesh.nodes_z0[nn] ||
+                loaded.boundary_index[nn] != umesh.boundary_index[nn]);
+
+    // Both meshes hold every node's cells in ascending order
+    nerrors += (loaded.nodes_to_cells_offsets[nn + 1] !=
+                umesh.nodes_to_cells_offsets[nn + 1]);
+    for (int ii = umesh.nodes_to_cells_offsets[nn];
+         ii < umesh.nodes_to_cells_offsets[nn + 1] && !nerrors; ++ii) {
+      nerrors += (loaded.nodes_to_cells[ii] != umesh.nodes_to_cells[ii]);
+    }
+  }
+  nerrors += (loaded.nboundary_nodes != nboundary_nodes);
+  for (int cc = 0; cc < umesh.ncells && !nerrors; ++cc) {
+    nerrors += (variables[0][cc] != 0.25 * cc);
+    nerrors += (loaded.cells_to_nodes_offsets[cc] != cc * NNODES_BY_CELL);
+    for (int nn = 0; nn < NNODES_BY_CELL; ++nn) {
+      nerrors += (loaded.cells_to_nodes[cc * NNODES_BY_CELL + nn] !=
+                  umesh.cells_to_nodes[cc * NNODES_BY_CELL + nn]);
+    }
+  }
+
+  // The faces of each cell are found in the order of the converted mesh, so
+  // each leads to the same neighbour
+  nerrors += (loaded.nfaces != umesh.nfaces ||
+              loaded.nboundary_faces != umesh.nboundary_faces);
+  nerrors += (!nerrors && validate_umesh_connectivity_3d(&loaded));
+  for (int cc = 0; cc < umesh.ncells && !nerrors; ++cc) {
+    nerrors += (umesh_cell_nfaces(&loaded, cc) != NFACES_BY_CELL);
+    for (int ff = 0; ff < NFACES_BY_CELL && !nerrors; ++ff) {
+      const int face = umesh_cell_face(&loaded, cc, ff);
+      const int reference_face = umesh_cell_face(&umesh, cc, ff);
+      nerrors += (loaded.faces_to_cells0[face] +
+                      loaded.faces_to_cells1[face] !=
+                  umesh.faces_to_cells0[reference_face] +
+                      umesh.faces_to_cells1[reference_face]);
+    }
+  }
+  if (!nerrors) {
+    init_umesh_geometry(&loaded);
+    for (int cc = 0; cc < umesh.ncells; ++cc) {
+      nerrors += differs(loaded.cell_volume[cc], umesh.cell_volume[cc],
+                         umesh.cell_volume[cc]);
+    }
+    clear_boundary_normals(&loaded);
+    find_boundary_normals_3d(&loaded, loaded.boundary_faces);
+    nerrors += compare_boundary_normals(&loaded, &umesh, identity);
+  }
+  deallocate_data(variables[0]);
+  free(variables);
+  finalise_unstructured_mesh(&loaded);
+
+  // Each box is split into six tetrahedra around its diagonal, taking the
+  // axes in every order, which split the faces between boxes the same way
+  const int paths[6][2] = {{1, 2}, {1, 5}, {3, 2}, {3, 7}, {4, 5}, {4, 7}};
+  const int ntets = 6 * umesh.ncells;
+  int* tets = (int*)malloc(sizeof(int) * 4 * ntets);
+  if (!tets) {
+    TERMINATE("Could not allocate the tetrahedra.\n");
+  }
+  for (int cc = 0; cc < umesh.ncells; ++cc) {
+    const int* nodes = &umesh.cells_to_nodes[cc * NNODES_BY_CELL];
+    for (int tt = 0; tt < 6; ++tt) {
+      int* tet = &tets[4 * (6 * cc + tt)];
+      tet[0] = nodes[0];
+      tet[1] = nodes[paths[tt][0]];
+      tet[2] = nodes[paths[tt][1]];
+      tet[3] = nodes[6];
+    }
+  }
+  write_mesh_definition(&umesh, node_filename, ele_filename, ntets, 4, tets);
+  free(tets);
+
+  memset(&loaded, 0, sizeof(UnstructuredMesh));
+  loaded.node_filename = node_filename;
+  loaded.ele_filename = ele_filename;
+  read_unstructured_mesh(&loaded, &variables, 0);
+  free(variables);
+
+  // Each square on the boundary is split into two triangles
+  nerrors += (loaded.ncells != ntets ||
+              loaded.nboundary_faces != 2 * umesh.nboundary_faces);
+  nerrors += (!nerrors && validate_umesh_connectivity_3d(&loaded));
+  if (!nerrors) {
+    init_umesh_geometry(&loaded);
+    for (int cc = 0; cc < umesh.ncells; ++cc) {
+      double volume = 0.0;
+      for (int tt = 0; tt < 6; ++tt) {
+        volume += loaded.cell_volume[6 * cc + tt];
+      }
+      nerrors += differs(volume, umesh.cell_volume[cc], umesh.cell_volume[cc]);
+    }
+    clear_boundary_normals(&loaded);
+    find_boundary_normals_3d(&loaded, NULL);
+    nerrors += compare_boundary_normals(&loaded, &umesh, identity);
+  }
+  finalise_unstructured_mesh(&loaded);
+
+  remove(node_filename);
+  remove(ele_filename);
+  finalise_unstructured_mesh(&umesh);
+  return nerrors;
+}
+
+// Shuffles and then renumbers the converted 3d mesh, checking that the
+// renumbered mesh describes the same cells as the original
+int validate_renumber_unstructured_mesh(Mesh* mesh) {
+  UnstructuredMesh reference;
+  memset(&reference, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(&reference, mesh);
+
+  const int ncells = reference.ncells;
+  const int nnodes = reference.nnodes;
+  int* shuffled_cells = (int*)malloc(sizeof(int) * ncells);
+  int* shuffled_nodes = (int*)malloc(sizeof(int) * nnodes);
+  int* renumbered_cells = (int*)malloc(sizeof(int) * ncells);
+  int* renumbered_nodes = (int*)malloc(sizeof(int) * nnodes);
+  if (!shuffled_cells || !shuffled_nodes || !renumbered_cells ||
+      !renumbered_nodes) {
+    TERMINATE("Could not allocate the mesh permutations.\n");
+  }
+
+  UnstructuredMesh umesh;
+  init_shuffled_umesh_3d(mesh, &umesh, shuffled_cells, shuffled_nodes);
+  init_umesh_geometry(&umesh);
+  renumber_unstructured_mesh(&umesh, renumbered_cells, renumbered_nodes);
+  init_umesh_geometry(&reference);
+
+  int nerrors = validate_umesh_connectivity_3d(&umesh);
+  for (int nn = 0; nn < nnodes; ++nn) {
+    const int node_index = renumbered_nodes[shuffled_nodes[nn]];
+    nerrors += (umesh.nodes_x0[node_index] != reference.nodes_x0[nn] ||
+                umesh.nodes_y0[node_index] != reference.nodes_y0[nn] ||
+                umesh.nodes_z0[node_index] != reference.nodes_z0[nn]);
+  }
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int cell_index = renumbered_cells[shuffled_cells[cc]];
+    const int off = umesh.cells_to_nodes_offsets[cell_index];
+    nerrors += (umesh.cells_to_nodes_offsets[cell_index + 1] - off !=
+                NNODES_BY_CELL);
+    nerrors += differs(umesh.cell_volume[cell_index], reference.cell_volume[cc],
+                       reference.cell_volume[cc]);
+    for (int nn = 0; nn < NNODES_BY_CELL && !nerrors; ++nn) {
+      const int node_index =
+          reference.cells_to_nodes[cc * NNODES_BY_CELL + nn];
+      nerrors += (umesh.cells_to_nodes[off + nn] !=
+                  renumbered_nodes[shuffled_nodes[node_index]]);
+      nerrors += differs(umesh.sub_cell_volume[off + nn],
+                         reference.sub_cell_volume[cc * NNODES_BY_CELL + nn],
+                         reference.cell_volume[cc]);
+    }
+  }
+  for (int ff = 0; ff < reference.nfaces * NNODES_BY_FACE; ++ff) {
+    nerrors += (umesh.faces_to_nodes[ff] !=
+                renumbered_nodes[shuffled_nodes[reference.faces_to_nodes[ff]]]);
+  }
+
+  // The permuted maps built by transposing keep their rows ascending
+  for (int nn = 0; nn < nnodes; ++nn) {
+    nerrors += validate_sorted_list(umesh.nodes_to_cells,
+                                    umesh.nodes_to_cells_offsets[nn],
+                                    umesh.nodes_to_cells_offsets[nn + 1],
+                                    ncells);
+    nerrors += validate_sorted_list(umesh.nodes_to_nodes,
+                                    umesh.nodes_to_nodes_offsets[nn],
+                                    umesh.nodes_to_nodes_offsets[nn + 1],
+                                    nnodes);
+  }
+
+  // Neighbouring cells should sit closer together than in the shuffled order
+  long long spread = 0;
+  long long shuffled_spread = 0;
+  for (int ff = 0; ff < reference.nfaces; ++ff) {
+    const int cell0 = reference.faces_to_cells0[ff];
+    const int cell1 = reference.faces_to_cells1[ff];
+    if (cell0 != -1 && cell1 != -1) {
+      spread += abs(umesh.faces_to_cells0[ff] - umesh.faces_to_cells1[ff]);
+      shuffled_spread += abs(shuffled_cells[cell0] - shuffled_cells[cell1]);
+    }
+  }
+  nerrors += (spread >= shuffled_spread && ncells > 2);
+
+  free(shuffled_cells);
+  free(shuffled_nodes);
+  free(renumbered_cells);
+  free(renumbered_nodes);
+  finalise_unstructured_mesh(&umesh);
+  finalise_unstructured_mesh(&reference);
+  return nerrors;
+}
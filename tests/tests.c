@@ -0,0 +1,254 @@
+#include "tests.h"
+#include "../comms.h"
+#include "../params.h"
+#include "../shared.h"
+#include "../snapshot.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Removes the files written by the snapshot tests
+void remove_test_files(const int rank) {
+  char filename[MAX_STR_LEN];
+  sprintf(filename, "%s_%d_0.bov", TEST_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.dat", TEST_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.chz", TEST_PREFIX, rank);
+  remove(filename);
+  sprintf(filename, "%s_%d_0.snap", TEST_PREFIX, rank);
+  remove(filename);
+  if (rank == MASTER) {
+    sprintf(filename, "%s0.bov", TEST_PREFIX);
+    remove(filename);
+    sprintf(filename, "%s0.dat", TEST_PREFIX);
+    remove(filename);
+  }
+}
+
+// Fills a random permutation of n entries
+static void random_permutation(const int n, uint64_t* seed, int* perm) {
+  for (int ii = 0; ii < n; ++ii) {
+    perm[ii] = ii;
+  }
+  for (int ii = n - 1; ii > 0; --ii) {
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+    const int jj = (int)(*seed % (uint64_t)(ii + 1));
+    const int tmp = perm[ii];
+    perm[ii] = perm[jj];
+    perm[jj] = tmp;
+  }
+}
+
+// Converts the 3d mesh and numbers its cells and nodes randomly, as a mesh
+// generator without any locality might, returning the permutations if asked
+void init_shuffled_umesh_3d(Mesh* mesh, UnstructuredMesh* umesh,
+                            int* cells_old_to_new, int* nodes_old_to_new) {
+  memset(umesh, 0, sizeof(UnstructuredMesh));
+  convert_mesh_to_umesh_3d(umesh, mesh);
+  int* cell_perm = (int*)malloc(sizeof(int) * umesh->ncells);
+  int* node_perm = (int*)malloc(sizeof(int) * umesh->nnodes);
+  if (!cell_perm || !node_perm) {
+    TERMINATE("Could not allocate the mesh shuffle.\n");
+  }
+  uint64_t seed = SHUFFLE_SEED + mesh->rank;
+  random_permutation(umesh->ncells, &seed, cell_perm);
+  random_permutation(umesh->nnodes, &seed, node_perm);
+  permute_unstructured_mesh(umesh, cell_perm, node_perm);
+  if (cells_old_to_new) {
+    memcpy(cells_old_to_new, cell_perm, sizeof(int) * umesh->ncells);
+  }
+  if (nodes_old_to_new) {
+    memcpy(nodes_old_to_new, node_perm, sizeof(int) * umesh->nnodes);
+  }
+  free(cell_perm);
+  free(node_perm);
+}
+
+// Decomposes and initialises a mesh in the same manner as initialise_comms
+void init_test_mesh(TestConfig* config, Mesh* mesh, const int ndims) {
+  memset(mesh, 0, sizeof(Mesh));
+  mesh->global_nx = config->nx;
+  mesh->global_ny = config->ny;
+  mesh->global_nz = (ndims == 3) ? config->nz : 1;
+  mesh->pad = config->pad;
+  mesh->width = 1.0;
+  mesh->height = 1.0;
+  mesh->depth = 1.0;
+  mesh->rank = config->rank;
+  mesh->nranks = config->nranks;
+  mesh->ndims = ndims;
+
+  for (int ii = 0; ii < NNEIGHBOURS; ++ii) {
+    mesh->neighbours[ii] = EDGE;
+  }
+
+  if (ndims == 3) {
+    decompose_3d_cartesian(mesh->rank, mesh->nranks, mesh->global_nx,
+                           mesh->global_ny, mesh->global_nz, mesh->neighbours,
+                           &mesh->local_nx, &mesh->local_ny, &mesh->local_nz,
+                           &mesh->ranks_x, &mesh->ranks_y, &mesh->ranks_z,
+                           &mesh->x_off, &mesh->y_off, &mesh->z_off);
+    mesh->local_nx += 2 * mesh->pad;
+    mesh->local_ny += 2 * mesh->pad;
+    mesh->local_nz += 2 * mesh->pad;
+    initialise_mesh_3d(mesh);
+  } else {
+    decompose_2d_cartesian(mesh->rank, mesh->nranks, mesh->global_nx,
+                           mesh->global_ny, mesh->neighbours, &mesh->local_nx,
+                           &mesh->local_ny, &mesh->ranks_x, &mesh->ranks_y,
+                           &mesh->x_off, &mesh->y_off);
+    mesh->local_nx += 2 * mesh->pad;
+    mesh->local_ny += 2 * mesh->pad;
+    mesh->local_nz = 1;
+    initialise_mesh_2d(mesh);
+  }
+}
+
+// Whether a computed quantity differs from the expected value, relative to
+// the scale of the quantity
+int differs(const double val, const double expected, const double scale) {
+  return fabs(val - expected) > GEOMETRY_TOL * scale;
+}
+
+// Checks that a list is in strictly ascending order and within range
+int validate_sorted_list(const int* list, const int start, const int end,
+                         const int n) {
+  int nerrors = 0;
+  for (int ii = start; ii < end; ++ii) {
+    nerrors += (list[ii] < 0 || list[ii] >= n ||
+                (ii > start && list[ii] <= list[ii - 1]));
+  }
+  return nerrors;
+}
+
+// Parses the command line, falling back on defaults
+static void parse_args(TestConfig* config, int argc, char** argv) {
+  config->nx = TEST_NX;
+  config->ny = TEST_NY;
+  config->nz = TEST_NZ;
+  config->pad = TEST_PAD;
+
+  for (int ii = 1; ii < argc; ++ii) {
+    if (strmatch(argv[ii], "-n") && ii + 3 < argc) {
+      config->nx = atoi(argv[++ii]);
+      config->ny = atoi(argv[++ii]);
+      config->nz = atoi(argv[++ii]);
+    } else if (strmatch(argv[ii], "-p") && ii + 1 < argc) {
+      config->pad = atoi(argv[++ii]);
+    } else {
+      TERMINATE("Usage: %s [-n nx ny nz] [-p pad]\n", argv[0]);
+    }
+  }
+}
+
+// Reports the errors of a test on the master, returning them
+static int report(TestConfig* config, const char* name, const int nerrors) {
+  if (config->rank == MASTER) {
+    printf("%-40s%s\n", name, nerrors ? "FAILED" : "passed");
+  }
+  return nerrors;
+}
+
+// Runs every test, returning the number of errors
+static int run_tests(TestConfig* config, Mesh* mesh_2d, Mesh* mesh_3d) {
+  int nerrors = 0;
+
+  // The decompositions are checked on the master for all virtual rank counts
+  if (config->rank == MASTER) {
+    int ndecomp_errors = 0;
+    for (int nranks = 1; nranks <= TEST_MAX_RANKS; ++nranks) {
+      ndecomp_errors += validate_decomposition(2, nranks, 4 * TEST_MAX_RANKS,
+                                               4 * TEST_MAX_RANKS, 1);
+      ndecomp_errors += validate_decomposition(3, nranks, TEST_MAX_RANKS,
+                                               TEST_MAX_RANKS, TEST_MAX_RANKS);
+    }
+    nerrors += report(config, "decompose_2d/3d_cartesian", ndecomp_errors);
+  }
+
+  nerrors += report(
+      config, "convert_mesh_to_umesh_3d",
+      (int)reduce_all_sum((double)validate_converted_connectivity(mesh_3d)));
+  nerrors += report(
+      config, "read_unstructured_mesh",
+      (int)reduce_all_sum((double)validate_read_unstructured_mesh(mesh_3d)));
+  nerrors += report(
+      config, "build_csr_transpose",
+      (int)reduce_all_sum((double)validate_csr_transposes(mesh_3d)));
+  nerrors += report(
+      config, "implicit_connectivity",
+      (int)reduce_all_sum((double)validate_implicit_connectivity(mesh_3d)));
+  nerrors += report(
+      config, "umesh_geometry",
+      (int)reduce_all_sum((double)validate_umesh_geometry(mesh_3d)));
+  nerrors += report(
+      config, "find_boundary_normals",
+      (int)reduce_all_sum((double)validate_boundary_normals(mesh_3d)));
+  nerrors += report(
+      config, "colour_unstructured_mesh",
+      (int)reduce_all_sum((double)validate_unstructured_colouring(mesh_3d)));
+  nerrors += report(
+      config, "init_umesh_tiling",
+      (int)reduce_all_sum((double)validate_umesh_tiling(mesh_3d)));
+  nerrors += report(config, "renumber_unstructured_mesh",
+                    (int)reduce_all_sum(
+                        (double)validate_renumber_unstructured_mesh(mesh_3d)));
+
+  int nexchange_errors;
+  nerrors +=
+      report(config, "decompose_unstructured_mesh",
+             validate_unstructured_decomposition_3d(config, &nexchange_errors));
+  nerrors += report(config, "handle_unstructured_halo", nexchange_errors);
+
+  nerrors += report(config, "load_parameter_file",
+                    validate_parameter_file(config->rank));
+  nerrors += report(config, "handle_boundary_2d",
+                    validate_halo_exchange_2d(mesh_2d));
+  nerrors += report(config, "handle_boundary_3d",
+                    validate_halo_exchange_3d(mesh_3d));
+  nerrors +=
+      report(config, "write_all_ranks_to_visit_3d",
+             validate_visit_dump(mesh_2d) + validate_visit_dump(mesh_3d));
+  nerrors += report(
+      config, "write_to_visit_3d_async",
+      (int)reduce_all_sum((double)validate_async_snapshot(config->rank)));
+  nerrors += report(
+      config, "write_compressed_3d",
+      (int)reduce_all_sum((double)validate_compressed_snapshot(config->rank)));
+  nerrors += report(
+      config, "write_snapshot_3d",
+      (int)reduce_all_sum((double)validate_snapshot_container(config->rank)));
+  nerrors += report(config, "write/read_checkpoint",
+                    (int)reduce_all_sum(
+                        (double)validate_checkpoint_restart(mesh_2d, mesh_3d)));
+  return nerrors;
+}
+
+int main(int argc, char** argv) {
+  TestConfig config;
+  config.rank = MASTER;
+  config.nranks = 1;
+  initialise_mpi(argc, argv, &config.rank, &config.nranks);
+  parse_args(&config, argc, argv);
+  initialise_devices(config.rank);
+
+  Mesh mesh_2d;
+  Mesh mesh_3d;
+  init_test_mesh(&config, &mesh_2d, 2);
+  init_test_mesh(&config, &mesh_3d, 3);
+
+  if (config.rank == MASTER) {
+    printf("Testing %dx%dx%d mesh, pad %d, on %d ranks.\n\n", config.nx,
+           config.ny, config.nz, config.pad, config.nranks);
+  }
+  const int nerrors = run_tests(&config, &mesh_2d, &mesh_3d);
+
+  finalise_async_snapshots();
+  finalise_mesh(&mesh_2d);
+  finalise_mesh(&mesh_3d);
+  finalise_comms();
+  return nerrors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#ifndef __TESTSHDR
+#define __TESTSHDR
+
+#include "../mesh.h"
+#include "../umesh.h"
+#include <stdint.h>
+
+/*
+ *    TESTS OF THE ARCHITECTURAL PRIMITIVES
+ *    Each test checks a group of primitives on the local part of a small
+ *    decomposed mesh and returns the number of errors it found, which the
+ *    driver sums over the ranks and reports as passed or failed.
+ */
+
+#define TEST_NX 32 // Default mesh tested when -n is not given
+#define TEST_NY 24
+#define TEST_NZ 16
+#define TEST_PAD 2
+#define TEST_MAX_RANKS 1024 // Largest virtual rank count decomposed
+#define TEST_PREFIX "arch_tests_visit"      // Temporary snapshot files
+#define TEST_PARAMS "arch_tests.params"     // Temporary parameter file
+#define TEST_CHECKPOINT "arch_tests_restart" // Temporary checkpoint
+#define SHUFFLE_SEED 88172645463325252ULL   // Seeds the mesh shuffles
+#define GEOMETRY_TOL 1.0e-12 // Relative error allowed in the mesh geometry
+
+// The configuration of a test run
+typedef struct {
+  int nx;
+  int ny;
+  int nz;
+  int pad;
+
+  int rank;
+  int nranks;
+} TestConfig;
+
+/*
+ * SHARED HELPERS, tests.c
+ */
+
+// Decomposes and initialises a mesh in the same manner as initialise_comms
+void init_test_mesh(TestConfig* config, Mesh* mesh, const int ndims);
+
+// Converts the 3d mesh and numbers its cells and nodes randomly, as a mesh
+// generator without any locality might, returning the permutations if asked
+void init_shuffled_umesh_3d(Mesh* mesh, UnstructuredMesh* umesh,
+                            int* cells_old_to_new, int* nodes_old_to_new);
+
+// Removes the files written by the snapshot tests
+void remove_test_files(const int rank);
+
+// Whether a value differs from that expected, relative to a scale
+int differs(const double val, const double expected, const double scale);
+
+// Checks that a list is in strictly ascending order and within range
+int validate_sorted_list(const int* list, const int start, const int end,
+                         const int n);
+
+/*
+ * DECOMPOSITIONS AND HALOS, test_comms.c
+ */
+
+// Checks the neighbours and coverage of a decomposition over virtual ranks
+int validate_decomposition(const int ndims, const int nranks,
+                           const int global_nx, const int global_ny,
+                           const int global_nz);
+
+// Checks the ghost cells of the local mesh after a halo exchange
+int validate_halo_exchange_2d(Mesh* mesh);
+
+// Checks the ghost cells of the local 3d mesh after a halo exchange
+int validate_halo_exchange_3d(Mesh* mesh);
+
+// Converts the whole 3d mesh on every rank and checks its partition into
+// local unstructured meshes, and the exchange of fields over their halos
+int validate_unstructured_decomposition_3d(TestConfig* config,
+                                           int* nexchange_errors);
+
+/*
+ * UNSTRUCTURED CONNECTIVITY, test_umesh.c
+ */
+
+// Checks that the faces to cells and cells to faces connectivity of the
+// converted 3d mesh agree
+int validate_converted_connectivity(Mesh* mesh);
+
+// Checks the maps built by transposing and composing the connectivity of the
+// converted 3d mesh against the structure of the original mesh
+int validate_csr_transposes(Mesh* mesh);
+
+// Checks the implicit connectivity against the converted mesh
+int validate_implicit_connectivity(Mesh* mesh);
+
+// Checks that the loader reproduces the converted 3d mesh
+int validate_read_unstructured_mesh(Mesh* mesh);
+
+// Checks the renumbering of a shuffled mesh
+int validate_renumber_unstructured_mesh(Mesh* mesh);
+
+/*
+ * GEOMETRY AND BOUNDARY NORMALS, test_geometry.c
+ */
+
+// Checks the geometry of the converted and planar meshes
+int validate_umesh_geometry(Mesh* mesh);
+
+// Checks the boundary faces and normals of the converted mesh
+int validate_boundary_normals(Mesh* mesh);
+
+// Counts the boundary nodes whose type or normal differ from the converted
+// mesh, where the normals of the converted mesh are first rotated
+int compare_boundary_normals(UnstructuredMesh* umesh,
+                             UnstructuredMesh* reference,
+                             const double rotation[3][3]);
+
+// Clears the boundary data of a mesh before it is found again
+void clear_boundary_normals(UnstructuredMesh* umesh);
+
+/*
+ * COLOURING AND TILING, test_colour.c
+ */
+
+// Checks the colourings of the cells and faces of the converted mesh
+int validate_unstructured_colouring(Mesh* mesh);
+
+// Checks the tiles of the converted mesh
+int validate_umesh_tiling(Mesh* mesh);
+
+/*
+ * FILES, test_io.c
+ */
+
+// Writes a field from all ranks and checks the file on the master
+int validate_visit_dump(Mesh* mesh);
+
+// Checks that a queued snapshot holds the field as it was when queued
+int validate_async_snapshot(const int rank);
+
+// Checks the round trips of the compressed snapshots
+int validate_compressed_snapshot(const int rank);
+
+// Checks the fields of a snapshot container
+int validate_snapshot_container(const int rank);
+
+// Checks that a run restarted from a checkpoint matches an uninterrupted run
+int validate_checkpoint_restart(Mesh* mesh_2d, Mesh* mesh_3d);
+
+// Checks that the lookups of a loaded parameter file are served from the
+// store
+int validate_parameter_file(const int rank);
+
+#endif
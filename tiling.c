@@ -0,0 +1,157 @@
+#include "tiling.h"
+#include "shared.h"
+
+// Orders node indices in ascending order
+static int compare_nodes(const void* a, const void* b) {
+  const int na = *(const int*)a;
+  const int nb = *(const int*)b;
+  return (na > nb) - (na < nb);
+}
+
+// Finds the position of a node among the ascending nodes of a tile
+static inline int find_local_node(const int* nodes, const int nnodes,
+                                  const int node_index) {
+  int lo = 0;
+  int hi = nnodes - 1;
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if (nodes[(mid)] < node_index) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Lists the distinct nodes of the cells of a tile in ascending order and
+// numbers the nodes of each cell among them, using scratch space that holds
+// every node of every cell of the tile
+static void fill_tile_nodes(const UnstructuredMesh* umesh, const int tt,
+                            UnstructuredTiling* tiling, int* scratch) {
+  const int cell_start = tiling->tiles_to_cells_offsets[(tt)];
+  const int cell_end = tiling->tiles_to_cells_offsets[(tt + 1)];
+  int nentries = 0;
+  for (int cc = cell_start; cc < cell_end; ++cc) {
+    for (int nn = 0; nn < umesh_cell_nnodes(umesh, cc); ++nn) {
+      scratch[(nentries++)] = umesh_cell_node(umesh, cc, nn);
+    }
+  }
+  qsort(scratch, nentries, sizeof(int), compare_nodes);
+
+  int* nodes = &tiling->tiles_to_nodes[(tiling->tiles_to_nodes_offsets[(tt)])];
+  int nnodes = 0;
+  for (int ii = 0; ii < nentries; ++ii) {
+    if (ii == 0 || scratch[(ii)] != scratch[(ii - 1)]) {
+      nodes[(nnodes++)] = scratch[(ii)];
+    }
+  }
+
+  for (int cc = cell_start; cc < cell_end; ++cc) {
+    const int cell_off = umesh_cell_node_offset(umesh, cc);
+    for (int nn = 0; nn < umesh_cell_nnodes(umesh, cc); ++nn) {
+      tiling->cells_to_local_nodes[(cell_off + nn)] =
+          find_local_node(nodes, nnodes, umesh_cell_node(umesh, cc, nn));
+    }
+  }
+}
+
+// Groups the cells into tiles of at most cache_bytes / bytes_per_node nodes,
+// unless a single cell has more, returning the bytes allocated
+size_t init_umesh_tiling(const UnstructuredMesh* umesh,
+                         UnstructuredTiling* tiling, const size_t cache_bytes,
+                         const size_t bytes_per_node) {
+  REQUIRE_HOST_DATA();
+
+  if (bytes_per_node == 0) {
+    TERMINATE("Tiling needs the bytes held for each node.\n");
+  }
+  const size_t max_nnodes = cache_bytes / bytes_per_node;
+  const int ncells = umesh->ncells;
+
+  // Each tile is grown from where the last one ended until the next cell
+  // would bring in too many new nodes, so the tiles are found serially
+  int* last_tile;
+  int* cell_starts;
+  int* tile_nnodes;
+  allocate_int_data(&last_tile, umesh->nnodes);
+  allocate_int_data(&cell_starts, ncells + 1);
+  allocate_int_data(&tile_nnodes, ncells + 1);
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    last_tile[(nn)] = -1;
+  }
+
+  int ntiles = 0;
+  int nnodes = 0;
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int nnodes_by_cell = umesh_cell_nnodes(umesh, cc);
+    int nnew = 0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      nnew += (last_tile[(umesh_cell_node(umesh, cc, nn))] != ntiles - 1);
+    }
+    if (ntiles == 0 || (cc > cell_starts[(ntiles - 1)] &&
+                        (size_t)(nnodes + nnew) > max_nnodes)) {
+      if (ntiles > 0) {
+        tile_nnodes[(ntiles - 1)] = nnodes;
+      }
+      cell_starts[(ntiles++)] = cc;
+      nnodes = 0;
+      nnew = nnodes_by_cell;
+    }
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      last_tile[(umesh_cell_node(umesh, cc, nn))] = ntiles - 1;
+    }
+    nnodes += nnew;
+  }
+  if (ntiles > 0) {
+    tile_nnodes[(ntiles - 1)] = nnodes;
+  }
+  cell_starts[(ntiles)] = ncells;
+
+  tiling->ntiles = ntiles;
+  size_t allocated =
+      allocate_int_data(&tiling->tiles_to_cells_offsets, ntiles + 1);
+  allocated += allocate_int_data(&tiling->tiles_to_nodes_offsets, ntiles + 1);
+  tiling->max_tile_nnodes = 0;
+  int max_nentries = 0;
+  for (int tt = 0; tt < ntiles + 1; ++tt) {
+    tiling->tiles_to_cells_offsets[(tt)] = cell_starts[(tt)];
+  }
+  for (int tt = 0; tt < ntiles; ++tt) {
+    tiling->tiles_to_nodes_offsets[(tt + 1)] =
+        tiling->tiles_to_nodes_offsets[(tt)] + tile_nnodes[(tt)];
+    tiling->max_tile_nnodes = max(tiling->max_tile_nnodes, tile_nnodes[(tt)]);
+    max_nentries =
+        max(max_nentries, umesh_cell_node_offset(umesh, cell_starts[(tt + 1)]) -
+                              umesh_cell_node_offset(umesh, cell_starts[(tt)]));
+  }
+  allocated += allocate_int_data(&tiling->tiles_to_nodes,
+                                 tiling->tiles_to_nodes_offsets[(ntiles)]);
+  allocated += allocate_int_data(&tiling->cells_to_local_nodes,
+                                 umesh_cell_node_offset(umesh, ncells));
+
+#pragma omp parallel
+  {
+    int* scratch;
+    allocate_int_data(&scratch, max_nentries);
+#pragma omp for
+    for (int tt = 0; tt < ntiles; ++tt) {
+      fill_tile_nodes(umesh, tt, tiling, scratch);
+    }
+    deallocate_int_data(scratch);
+  }
+
+  deallocate_int_data(last_tile);
+  deallocate_int_data(cell_starts);
+  deallocate_int_data(tile_nnodes);
+  return allocated;
+}
+
+// Deallocates the tiling
+void finalise_umesh_tiling(UnstructuredTiling* tiling) {
+  deallocate_int_data(tiling->tiles_to_cells_offsets);
+  deallocate_int_data(tiling->tiles_to_nodes_offsets);
+  deallocate_int_data(tiling->tiles_to_nodes);
+  deallocate_int_data(tiling->cells_to_local_nodes);
+}
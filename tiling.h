@@ -0,0 +1,47 @@
+#ifndef __TILINGHDR
+#define __TILINGHDR
+
+#include "umesh.h"
+#include <stdlib.h>
+
+/*
+ *    UNSTRUCTURED MESH TILING
+ *    Splits the cells into tiles of consecutive cells whose nodes fit in a
+ *    cache, so a sweep can gather the nodes of a tile into a small buffer
+ *    once, compute over its cells and scatter the buffer back. Tiles follow
+ *    the cell numbering, so they are only as compact as the numbering, and
+ *    the local connectivity is laid out like cells_to_nodes so it is indexed
+ *    through the same offsets.
+ */
+
+#define TILING_L2_BYTES (256 * 1024) // The cache that a tile should fit in
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The cells of a mesh grouped into tiles, with the nodes of each tile
+typedef struct {
+  int ntiles;
+  int max_tile_nnodes;         // The most nodes in any tile
+  int* tiles_to_cells_offsets; // The range of consecutive cells in each tile
+  int* tiles_to_nodes_offsets; // Offsets into the nodes by tile
+  int* tiles_to_nodes;         // The nodes of each tile in ascending order
+  int* cells_to_local_nodes;   // The position of each node of each cell among
+                               // the nodes of its tile
+} UnstructuredTiling;
+
+// Groups the cells into tiles of at most cache_bytes / bytes_per_node nodes,
+// unless a single cell has more, returning the bytes allocated
+size_t init_umesh_tiling(const UnstructuredMesh* umesh,
+                         UnstructuredTiling* tiling, const size_t cache_bytes,
+                         const size_t bytes_per_node);
+
+// Deallocates the tiling
+void finalise_umesh_tiling(UnstructuredTiling* tiling);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
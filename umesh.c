@@ -1,8 +1,66 @@
 #include "umesh.h"
+#include "geometry.h"
 #include "params.h"
 #include "shared.h"
 #include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define UMESH_CHUNKS_PER_THREAD 4 // Parse chunks given to each thread
+#define UMESH_MAX_TOKEN 64        // Longest number accepted in a mesh file
+#define MORTON_MAX 2097151.0      // Largest coordinate of a 21-bit Morton key
+#define MORTON_RADIX_BITS 8       // Bits sorted per pass of the radix sort
+
+// A mesh definition file mapped into memory
+typedef struct {
+  const char* filename;
+  char* map;
+  size_t len;
+  const char* body; // The first line after the header
+} MappedMeshFile;
+
+// The nodes of each face of a tetrahedron and a hexahedron, running
+// counter-clockwise as seen from inside a positively orientated cell. The
+// faces of a hexahedron follow the order of umesh_cell_face.
+static const int tet_face_nodes[4][3] = {
+    {0, 1, 2}, {0, 3, 1}, {0, 2, 3}, {1, 3, 2}};
+static const int hex_face_nodes[NFACES_BY_CELL][NNODES_BY_FACE] = {
+    {0, 1, 2, 3}, {0, 3, 7, 4}, {0, 4, 5, 1},
+    {1, 5, 6, 2}, {3, 2, 6, 7}, {4, 7, 6, 5}};
+
+// The number of faces of a cell with the given number of nodes, or 0 when
+// the cell is neither a tetrahedron nor a hexahedron
+static inline int cell_nfaces_by_nodes(const int nnodes_by_cell) {
+  return (nnodes_by_cell == 4) ? 4
+                               : ((nnodes_by_cell == 8) ? NFACES_BY_CELL : 0);
+}
+
+// Writes the nodes of a face of a tetrahedron or hexahedron, returning how
+// many there are
+static inline int cell_face_nodes(const UnstructuredMesh* umesh, const int cc,
+                                  const int ff, int* nodes) {
+  const int off = umesh->cells_to_nodes_offsets[(cc)];
+  if (umesh->cells_to_nodes_offsets[(cc + 1)] - off == 4) {
+    for (int nn = 0; nn < 3; ++nn) {
+      nodes[nn] = umesh->cells_to_nodes[(off + tet_face_nodes[ff][nn])];
+    }
+    return 3;
+  }
+  for (int nn = 0; nn < NNODES_BY_FACE; ++nn) {
+    nodes[nn] = umesh->cells_to_nodes[(off + hex_face_nodes[ff][nn])];
+  }
+  return NNODES_BY_FACE;
+}
 
 // Converts an ordinary structured mesh into an unstructured equivalent
 size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
@@ -11,13 +69,22 @@ size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
   const int nz = mesh->local_nz;
   umesh->nnodes_by_cell = NNODES_BY_CELL;
   umesh->nnodes_by_node = NNODES_BY_NODE;
+  umesh->implicit = 0;
+  umesh->implicit_nx = nx;
+  umesh->implicit_ny = ny;
+  umesh->implicit_nz = nz;
 
-  umesh->nboundary_nodes =
-      2 * (nx + 1) * (ny + 1) + 2 * (ny-1) * (nz) + 2 * (nz-1) * (nx);
+  umesh->nboundary_nodes = converted_nboundary_nodes(nx, ny, nz);
   umesh->nnodes = (nx + 1) * (ny + 1) * (nz + 1);
   umesh->ncells = (nx * ny * nz);
   umesh->nfaces = nx * ny * (nz + 1) + (nx * (ny + 1) + (nx + 1) * ny) * nz;
 
+  // The lists of cells, faces and nodes around the nodes are sized by the
+  // builders that fill them
+  umesh->nodes_to_cells = NULL;
+  umesh->nodes_to_faces = NULL;
+  umesh->nodes_to_nodes = NULL;
+
   // Allocate the data structures that we now know the sizes of
   size_t allocated = allocate_data(&umesh->cell_centroids_x, umesh->ncells);
   allocated += allocate_data(&umesh->cell_centroids_y, umesh->ncells);
@@ -30,10 +97,6 @@ size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
       allocate_int_data(&umesh->nodes_to_nodes_offsets, umesh->nnodes + 1);
   allocated += allocate_int_data(&umesh->cells_to_nodes,
                                  umesh->ncells * NNODES_BY_CELL);
-  allocated += allocate_int_data(&umesh->nodes_to_nodes,
-                                 umesh->nnodes * NNODES_BY_NODE);
-  allocated += allocate_int_data(&umesh->nodes_to_cells,
-                                 umesh->nnodes * NCELLS_BY_NODE);
   allocated += allocate_data(&umesh->nodes_x0, umesh->nnodes);
   allocated += allocate_data(&umesh->nodes_y0, umesh->nnodes);
   allocated += allocate_data(&umesh->nodes_z0, umesh->nnodes);
@@ -49,8 +112,6 @@ size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
       allocate_int_data(&umesh->cells_to_faces_offsets, umesh->ncells + 1);
   allocated += allocate_int_data(&umesh->cells_to_faces,
                                  umesh->ncells * NFACES_BY_CELL);
-  allocated +=
-      allocate_int_data(&umesh->nodes_to_faces, umesh->nnodes * NFACES_BY_NODE);
   allocated +=
       allocate_int_data(&umesh->nodes_to_faces_offsets, umesh->nnodes + 1);
   allocated += allocate_int_data(&umesh->faces_to_cells0, umesh->nfaces);
@@ -61,12 +122,14 @@ size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
   allocated += allocate_data(&umesh->boundary_normal_z, umesh->nnodes);
   allocated += allocate_int_data(&umesh->boundary_index, umesh->nnodes);
   allocated += allocate_int_data(&umesh->boundary_type, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_faces,
+                                 2 * (nx * ny + ny * nz + nx * nz));
 
-  // Initialises the list of nodes to cells
-  init_nodes_to_cells_3d(nx, ny, nz, mesh, umesh);
+  // Initialises the cells to nodes connectivity
+  init_cells_to_nodes_3d(nx, ny, nz, umesh);
 
-  // Initialises the list of nodes to nodes
-  init_nodes_to_nodes_3d(nx, ny, nz, umesh);
+  // Initialises the list of nodes to cells
+  allocated += init_nodes_to_cells_3d(nx, ny, nz, mesh, umesh);
 
   // Initialises the offsets between faces and nodes
   init_faces_to_nodes_offsets_3d(umesh);
@@ -84,16 +147,1412 @@ size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
   init_nodes_to_faces_offsets_3d(umesh);
 
   // Initialises the connectivity between nodes and faces
-  init_nodes_to_faces_3d(nx, ny, nz, umesh);
+  allocated += init_nodes_to_faces_3d(umesh);
 
   // Initialises the connectivity between faces and cells
   init_faces_to_cells_3d(nx, ny, nz, umesh);
 
-  // Initialises the cells to nodes connectivity
-  init_cells_to_nodes_3d(nx, ny, nz, umesh);
+  // Initialises the list of nodes to nodes
+  allocated += init_nodes_to_nodes_3d(umesh);
+
+  // Initialises the boundary normals
+  init_boundary_normals_3d(nx, ny, nz, umesh);
+
+  // Initialises the centroids of the cells
+  init_cell_centroids_3d(nx, ny, nz, mesh, umesh);
+
+  return allocated;
+}
+
+// Maps a mesh definition file into memory
+static void map_mesh_file(const char* filename, MappedMeshFile* file) {
+  file->filename = filename;
+  const int fd = open(filename, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) || st.st_size == 0) {
+    TERMINATE("Could not open the mesh file %s\n", filename);
+  }
+  file->len = st.st_size;
+  file->map = (char*)mmap(NULL, file->len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (file->map == MAP_FAILED) {
+    TERMINATE("Could not map the mesh file %s\n", filename);
+  }
+
+  // The whole file is parsed once, in order within each chunk
+  madvise(file->map, file->len, MADV_SEQUENTIAL);
+}
+
+// Skips spaces within a line
+static inline const char* skip_spaces(const char* ptr, const char* end) {
+  while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r')) {
+    ptr++;
+  }
+  return ptr;
+}
+
+// Skips to the start of the next line
+static inline const char* skip_line(const char* ptr, const char* end) {
+  const char* eol = (const char*)memchr(ptr, '\n', end - ptr);
+  return eol ? eol + 1 : end;
+}
+
+// Reads an integer, which must be complete before the end of the mapping
+static inline int parse_int(const char** ptr, const char* end, int* val) {
+  const char* pp = skip_spaces(*ptr, end);
+  const int negative = (pp < end && *pp == '-');
+  pp += negative;
+  if (pp >= end || *pp < '0' || *pp > '9') {
+    return 0;
+  }
+  long long result = 0;
+  while (pp < end && *pp >= '0' && *pp <= '9' && result <= INT_MAX) {
+    result = result * 10 + (*pp++ - '0');
+  }
+  if (result > INT_MAX) {
+    return 0;
+  }
+  *val = negative ? -(int)result : (int)result;
+  *ptr = pp;
+  return 1;
+}
+
+// Reads a double, copying the token out as the mapping is not terminated
+static inline int parse_double(const char** ptr, const char* end,
+                               double* val) {
+  const char* pp = skip_spaces(*ptr, end);
+  char token[UMESH_MAX_TOKEN];
+  int len = 0;
+  while (pp + len < end && len < UMESH_MAX_TOKEN - 1 && pp[len] != ' ' &&
+         pp[len] != '\t' && pp[len] != '\r' && pp[len] != '\n' &&
+         pp[len] != '#') {
+    token[len] = pp[len];
+    len++;
+  }
+  token[len] = '\0';
+  char* token_end;
+  *val = strtod(token, &token_end);
+  if (len == 0 || token_end != token + len) {
+    return 0;
+  }
+  *ptr = pp + len;
+  return 1;
+}
+
+// Checks whether a line holds nothing but whitespace or a comment
+static inline int is_empty_line(const char* ptr, const char* end) {
+  ptr = skip_spaces(ptr, end);
+  return ptr >= end || *ptr == '\n' || *ptr == '#';
+}
+
+// Reads the header line of a mesh file into up to nvals integers, returning
+// the number read
+static int parse_mesh_header(MappedMeshFile* file, int* vals,
+                             const int nvals) {
+  const char* end = file->map + file->len;
+  const char* ptr = file->map;
+  while (ptr < end && is_empty_line(ptr, end)) {
+    ptr = skip_line(ptr, end);
+  }
+  int nread = 0;
+  const char* pp = ptr;
+  while (nread < nvals && parse_int(&pp, end, &vals[nread])) {
+    nread++;
+  }
+  file->body = skip_line(ptr, end);
+  return nread;
+}
+
+// Finds the index of the first entry, which sets the numbering base
+static int find_index_base(const MappedMeshFile* file) {
+  const char* end = file->map + file->len;
+  const char* ptr = file->body;
+  while (ptr < end && is_empty_line(ptr, end)) {
+    ptr = skip_line(ptr, end);
+  }
+  int base;
+  if (!parse_int(&ptr, end, &base) || (base != 0 && base != 1)) {
+    TERMINATE("The entries of %s must be numbered from 0 or 1.\n",
+              file->filename);
+  }
+  return base;
+}
+
+// Finds the start of a parse chunk, which is always the start of a line
+static const char* find_chunk_start(const MappedMeshFile* file,
+                                    const int chunk, const int nchunks) {
+  const char* end = file->map + file->len;
+  const size_t body_len = end - file->body;
+  if (chunk == nchunks) {
+    return end;
+  }
+  const char* ptr = file->body + body_len * chunk / nchunks;
+  return (ptr == file->body || ptr[-1] == '\n') ? ptr : skip_line(ptr, end);
+}
+
+// The number of chunks that a file is parsed in
+static int get_nparse_chunks() {
+#ifdef _OPENMP
+  return UMESH_CHUNKS_PER_THREAD * omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Replaces the values with their prefix sum, computed in parallel blocks,
+// and returns the total
+int prefix_sum(const int n, int* vals, const int inclusive) {
+  int nblocks = 1;
+#ifdef _OPENMP
+  nblocks = omp_get_max_threads();
+#endif
+  int* block_sums = (int*)calloc(nblocks + 1, sizeof(int));
+  if (!block_sums) {
+    TERMINATE("Failed to allocate the prefix sum.\n");
+  }
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nblocks; ++bb) {
+    int sum = 0;
+    for (int ii = (long long)n * bb / nblocks;
+         ii < (long long)n * (bb + 1) / nblocks; ++ii) {
+      sum += vals[ii];
+    }
+    block_sums[bb + 1] = sum;
+  }
+  for (int bb = 0; bb < nblocks; ++bb) {
+    block_sums[bb + 1] += block_sums[bb];
+  }
+
+#pragma omp parallel for
+  for (int bb = 0; bb < nblocks; ++bb) {
+    int sum = block_sums[bb];
+    for (int ii = (long long)n * bb / nblocks;
+         ii < (long long)n * (bb + 1) / nblocks; ++ii) {
+      const int val = vals[ii];
+      sum += val;
+      vals[ii] = inclusive ? sum : sum - val;
+    }
+  }
+
+  const int total = block_sums[nblocks];
+  free(block_sums);
+  return total;
+}
+
+// Numbers the nodes flagged in boundary_type in order of their index,
+// returning the number of boundary nodes
+int enumerate_boundary_nodes(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->boundary_index[(nn)] = umesh->boundary_type[(nn)];
+  }
+  const int nboundary_nodes =
+      prefix_sum(umesh->nnodes, umesh->boundary_index, 0);
+
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    if (!umesh->boundary_type[(nn)]) {
+      umesh->boundary_index[(nn)] = IS_INTERIOR;
+    }
+  }
+
+  // The types are indexed by boundary node, so the flags are replaced
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    umesh->boundary_type[(nn)] = IS_INTERIOR;
+  }
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    const int index = umesh->boundary_index[(nn)];
+    if (index != IS_INTERIOR) {
+      umesh->boundary_type[(index)] = IS_BOUNDARY;
+    }
+  }
+  return nboundary_nodes;
+}
+
+// Initialises the unstructured mesh variables
+size_t init_unstructured_mesh(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  size_t allocated = allocate_data(&umesh->nodes_x0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_y0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_z0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_x1, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_y1, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_z1, umesh->nnodes);
+  allocated += allocate_data(&umesh->cell_centroids_x, umesh->ncells);
+  allocated += allocate_data(&umesh->cell_centroids_y, umesh->ncells);
+  allocated += allocate_data(&umesh->cell_centroids_z, umesh->ncells);
+  allocated += allocate_int_data(&umesh->cells_to_nodes,
+                                 (size_t)umesh->ncells * umesh->nnodes_by_cell);
+  allocated +=
+      allocate_int_data(&umesh->cells_to_nodes_offsets, umesh->ncells + 1);
+  allocated +=
+      allocate_int_data(&umesh->nodes_to_cells_offsets, umesh->nnodes + 1);
+  allocated += allocate_data(&umesh->boundary_normal_x, umesh->nnodes);
+  allocated += allocate_data(&umesh->boundary_normal_y, umesh->nnodes);
+  allocated += allocate_data(&umesh->boundary_normal_z, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_index, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_type, umesh->nnodes);
+  return allocated;
+}
+
+// Claims an entry for the line that holds it, returning whether another
+// line already claimed it
+static inline int claim_entry(const int index, int* seen) {
+  int claimed;
+#pragma omp atomic capture
+  {
+    claimed = seen[(index)];
+    seen[(index)] = 1;
+  }
+  return claimed;
+}
+
+// Parses a line of the node file, returning 0 for an empty line, -1 if the
+// line is malformed and -2 if another line holds the same node
+static inline int parse_node_line(const char** ptr, const char* end,
+                                  const int base, const int ndims,
+                                  const int nattributes, const int nmarkers,
+                                  int* seen, UnstructuredMesh* umesh) {
+  const char* pp = *ptr;
+  *ptr = skip_line(pp, end);
+  if (is_empty_line(pp, end)) {
+    return 0;
+  }
+
+  int index;
+  double coords[3] = {0.0, 0.0, 0.0};
+  if (!parse_int(&pp, end, &index) || index - base < 0 ||
+      index - base >= umesh->nnodes) {
+    return -1;
+  }
+  for (int dd = 0; dd < ndims; ++dd) {
+    if (!parse_double(&pp, end, &coords[dd])) {
+      return -1;
+    }
+  }
+  for (int aa = 0; aa < nattributes; ++aa) {
+    double attribute;
+    if (!parse_double(&pp, end, &attribute)) {
+      return -1;
+    }
+  }
+  int marker = 0;
+  if (nmarkers && !parse_int(&pp, end, &marker)) {
+    return -1;
+  }
+
+  const int nn = index - base;
+  if (claim_entry(nn, seen)) {
+    return -2;
+  }
+  umesh->nodes_x0[(nn)] = coords[0];
+  umesh->nodes_y0[(nn)] = coords[1];
+  umesh->nodes_z0[(nn)] = coords[2];
+  umesh->nodes_x1[(nn)] = coords[0];
+  umesh->nodes_y1[(nn)] = coords[1];
+  umesh->nodes_z1[(nn)] = coords[2];
+
+  // Holds the marker until the boundary nodes are enumerated
+  umesh->boundary_type[(nn)] = (marker != 0);
+  return 1;
+}
+
+// Parses a line of the element file, returning 0 for an empty line, -1 if
+// the line is malformed and -2 if another line holds the same element
+static inline int parse_element_line(const char** ptr, const char* end,
+                                     const int base, const int nattributes,
+                                     int* seen, UnstructuredMesh* umesh,
+                                     double** variables, const int nvars) {
+  const char* pp = *ptr;
+  *ptr = skip_line(pp, end);
+  if (is_empty_line(pp, end)) {
+    return 0;
+  }
+
+  int index;
+  if (!parse_int(&pp, end, &index) || index - base < 0 ||
+      index - base >= umesh->ncells) {
+    return -1;
+  }
+  const int cc = index - base;
+  if (claim_entry(cc, seen)) {
+    return -2;
+  }
+  const size_t off = (size_t)cc * umesh->nnodes_by_cell;
+  for (int nn = 0; nn < umesh->nnodes_by_cell; ++nn) {
+    int node_index;
+    if (!parse_int(&pp, end, &node_index) || node_index - base < 0 ||
+        node_index - base >= umesh->nnodes) {
+      return -1;
+    }
+    umesh->cells_to_nodes[(off + nn)] = node_index - base;
+  }
+  for (int aa = 0; aa < nattributes; ++aa) {
+    double attribute;
+    if (!parse_double(&pp, end, &attribute)) {
+      return -1;
+    }
+    if (aa < nvars) {
+      variables[aa][(cc)] = attribute;
+    }
+  }
+  return 1;
+}
+
+// Reads the element data from the unstructured mesh definition
+size_t read_unstructured_mesh(UnstructuredMesh* umesh, double*** variables,
+                              int nvars) {
+  REQUIRE_HOST_DATA();
+
+  MappedMeshFile node_file;
+  MappedMeshFile ele_file;
+  map_mesh_file(umesh->node_filename, &node_file);
+  map_mesh_file(umesh->ele_filename, &ele_file);
+
+  // <# nodes> <dimensions> <# attributes> <# boundary markers>
+  int node_header[4] = {0, 0, 0, 0};
+  if (parse_mesh_header(&node_file, node_header, 4) < 2 ||
+      node_header[0] <= 0 || node_header[1] < 2 || node_header[1] > 3) {
+    TERMINATE("Could not read the header of %s\n", umesh->node_filename);
+  }
+  const int ndims = node_header[1];
+  const int nnode_attributes = node_header[2];
+  const int nmarkers = node_header[3];
+
+  // <# elements> <nodes per element> <# attributes>
+  int ele_header[3] = {0, 0, 0};
+  if (parse_mesh_header(&ele_file, ele_header, 3) < 2 || ele_header[0] <= 0 ||
+      ele_header[1] <= 0) {
+    TERMINATE("Could not read the header of %s\n", umesh->ele_filename);
+  }
+  if (ele_header[2] < nvars) {
+    TERMINATE("%s has %d regional variables but %d were requested.\n",
+              umesh->ele_filename, ele_header[2], nvars);
+  }
+
+  // The offsets into the element list are ints
+  if ((long long)ele_header[0] * ele_header[1] > INT_MAX) {
+    TERMINATE("%s lists %lld element nodes, more than can be offset.\n",
+              umesh->ele_filename, (long long)ele_header[0] * ele_header[1]);
+  }
+
+  umesh->nnodes = node_header[0];
+  umesh->ncells = ele_header[0];
+  umesh->nnodes_by_cell = ele_header[1];
+  umesh->nregional_variables = ele_header[2];
+  size_t allocated = init_unstructured_mesh(umesh);
+
+  *variables = (double**)malloc(sizeof(double*) * nvars);
+  if (nvars && !*variables) {
+    TERMINATE("Failed to allocate the regional variables.\n");
+  }
+  for (int vv = 0; vv < nvars; ++vv) {
+    allocated += allocate_data(&(*variables)[vv], umesh->ncells);
+  }
+
+  // Every line is numbered, so each chunk of lines is parsed independently.
+  // Each entry is claimed by the first line to reach it, so that repeated
+  // entries are caught rather than racing, and since the claimed entries are
+  // distinct a full count means none were left unfilled.
+  int* seen;
+  allocate_int_data(&seen, max(umesh->nnodes, umesh->ncells));
+  const int nchunks = get_nparse_chunks();
+  const char* node_end = node_file.map + node_file.len;
+  const int node_base = find_index_base(&node_file);
+  int nnodes_read = 0;
+  int nnode_errors = 0;
+  int nnode_repeats = 0;
+#pragma omp parallel for schedule(dynamic) \
+    reduction(+ : nnodes_read, nnode_errors, nnode_repeats)
+  for (int ch = 0; ch < nchunks; ++ch) {
+    const char* chunk_end = find_chunk_start(&node_file, ch + 1, nchunks);
+    const char* ptr = find_chunk_start(&node_file, ch, nchunks);
+    while (ptr < chunk_end) {
+      const int result =
+          parse_node_line(&ptr, node_end, node_base, ndims, nnode_attributes,
+                          nmarkers, seen, umesh);
+      nnodes_read += (result > 0);
+      nnode_errors += (result == -1);
+      nnode_repeats += (result == -2);
+    }
+  }
+  if (nnode_errors || nnode_repeats || nnodes_read != umesh->nnodes) {
+    TERMINATE("%s holds %d distinct nodes of %d, with %d malformed and %d "
+              "repeated lines.\n",
+              umesh->node_filename, nnodes_read, umesh->nnodes, nnode_errors,
+              nnode_repeats);
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    seen[(cc)] = 0;
+  }
+
+  const char* ele_end = ele_file.map + ele_file.len;
+  const int ele_base = find_index_base(&ele_file);
+  int ncells_read = 0;
+  int ncell_errors = 0;
+  int ncell_repeats = 0;
+#pragma omp parallel for schedule(dynamic) \
+    reduction(+ : ncells_read, ncell_errors, ncell_repeats)
+  for (int ch = 0; ch < nchunks; ++ch) {
+    const char* chunk_end = find_chunk_start(&ele_file, ch + 1, nchunks);
+    const char* ptr = find_chunk_start(&ele_file, ch, nchunks);
+    while (ptr < chunk_end) {
+      const int result =
+          parse_element_line(&ptr, ele_end, ele_base,
+                             umesh->nregional_variables, seen, umesh,
+                             *variables, nvars);
+      ncells_read += (result > 0);
+      ncell_errors += (result == -1);
+      ncell_repeats += (result == -2);
+    }
+  }
+  if (ncell_errors || ncell_repeats || ncells_read != umesh->ncells) {
+    TERMINATE("%s holds %d distinct elements of %d, with %d malformed and %d "
+              "repeated lines.\n",
+              umesh->ele_filename, ncells_read, umesh->ncells, ncell_errors,
+              ncell_repeats);
+  }
+  deallocate_int_data(seen);
+
+  munmap(node_file.map, node_file.len);
+  munmap(ele_file.map, ele_file.len);
+
+  // Enumerate the marked boundary nodes in order of their index
+  umesh->nboundary_nodes = enumerate_boundary_nodes(umesh);
+
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells + 1; ++cc) {
+    umesh->cells_to_nodes_offsets[(cc)] =
+        (int)((long long)cc * umesh->nnodes_by_cell);
+  }
+
+  // The cells surrounding each node are the transpose of the element list
+  allocated += fill_nodes_to_cells(umesh);
+
+  // The faces of tetrahedra and hexahedra are found from their nodes, while
+  // other cells are left without faces
+  if (ndims == 3 && cell_nfaces_by_nodes(umesh->nnodes_by_cell)) {
+    allocated += build_umesh_faces(umesh);
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int off = umesh->cells_to_nodes_offsets[(cc)];
+    const int nnodes_by_cell = umesh->cells_to_nodes_offsets[(cc + 1)] - off;
+    double cx = 0.0;
+    double cy = 0.0;
+    double cz = 0.0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      const int node_index = umesh->cells_to_nodes[(off + nn)];
+      cx += umesh->nodes_x0[(node_index)];
+      cy += umesh->nodes_y0[(node_index)];
+      cz += umesh->nodes_z0[(node_index)];
+    }
+    umesh->cell_centroids_x[(cc)] = cx / nnodes_by_cell;
+    umesh->cell_centroids_y[(cc)] = cy / nnodes_by_cell;
+    umesh->cell_centroids_z[(cc)] = cz / nnodes_by_cell;
+  }
+
+  return allocated;
+}
+
+// Converts the lists of cell counts to a list of offsets
+void convert_cell_counts_to_offsets(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  umesh->nodes_to_cells_offsets[(0)] = 0;
+  prefix_sum(umesh->nnodes + 1, umesh->nodes_to_cells_offsets, 1);
+}
+
+// Sorts a short list in place
+static inline void sort_short_list(const int len, int* list) {
+  for (int ii = 1; ii < len; ++ii) {
+    const int val = list[ii];
+    int jj = ii - 1;
+    for (; jj >= 0 && list[jj] > val; --jj) {
+      list[jj + 1] = list[jj];
+    }
+    list[jj + 1] = val;
+  }
+}
+
+// Builds the transpose of a CSR map, in which each of the ncols columns
+// lists the rows that name it in ascending order. Entries of -1 are skipped.
+// The transposed offsets must hold ncols + 1 entries and any existing
+// transposed list is replaced, returning the bytes allocated.
+size_t build_csr_transpose(const int nrows, const int* offsets,
+                           const int* list, const int ncols,
+                           int* transpose_offsets, int** transpose_list) {
+  REQUIRE_HOST_DATA();
+
+#pragma omp parallel for
+  for (int cc = 0; cc < ncols + 1; ++cc) {
+    transpose_offsets[(cc)] = 0;
+  }
+
+  // Rows mostly name columns that no other thread is touching, so the
+  // atomics are rarely contended
+#pragma omp parallel for
+  for (int rr = 0; rr < nrows; ++rr) {
+    for (int ii = offsets[(rr)]; ii < offsets[(rr + 1)]; ++ii) {
+      if (list[(ii)] >= 0) {
+#pragma omp atomic update
+        transpose_offsets[(list[(ii)] + 1)]++;
+      }
+    }
+  }
+  const int nentries = prefix_sum(ncols + 1, transpose_offsets, 1);
+
+  if (*transpose_list) {
+    deallocate_int_data(*transpose_list);
+  }
+  size_t allocated = allocate_int_data(transpose_list, nentries);
+  int* cursor;
+  allocate_int_data(&cursor, ncols);
+
+#pragma omp parallel for
+  for (int rr = 0; rr < nrows; ++rr) {
+    for (int ii = offsets[(rr)]; ii < offsets[(rr + 1)]; ++ii) {
+      const int col = list[(ii)];
+      if (col < 0) {
+        continue;
+      }
+      int slot;
+#pragma omp atomic capture
+      slot = cursor[(col)]++;
+      (*transpose_list)[(transpose_offsets[(col)] + slot)] = rr;
+    }
+  }
+
+  // The lists are short so sorting them restores a deterministic order
+#pragma omp parallel for
+  for (int cc = 0; cc < ncols; ++cc) {
+    sort_short_list(cursor[(cc)],
+                    &(*transpose_list)[(transpose_offsets[(cc)])]);
+  }
+
+  deallocate_int_data(cursor);
+  return allocated;
+}
+
+// Fill in the list of cells surrounding nodes
+size_t fill_nodes_to_cells(UnstructuredMesh* umesh) {
+  return build_csr_transpose(umesh->ncells, umesh->cells_to_nodes_offsets,
+                             umesh->cells_to_nodes, umesh->nnodes,
+                             umesh->nodes_to_cells_offsets,
+                             &umesh->nodes_to_cells);
+}
+
+// Adds an entry to a sorted list of distinct entries, unless it is present
+static inline void insert_distinct(const int val, int* list, int* len) {
+  int pos = *len;
+  while (pos > 0 && list[pos - 1] > val) {
+    pos--;
+  }
+  if (pos > 0 && list[pos - 1] == val) {
+    return;
+  }
+  for (int ii = *len; ii > pos; --ii) {
+    list[ii] = list[ii - 1];
+  }
+  list[pos] = val;
+  (*len)++;
+}
+
+// Gathers the distinct neighbours of an entry, reached through each of its
+// intermediates, into the scratch list in ascending order, returning how
+// many there are
+static int gather_neighbours(const int index, const int* offsets,
+                             const int* list, const int* via_offsets,
+                             const int* via_list, const int adjacent_only,
+                             int* scratch) {
+  int len = 0;
+  for (int ii = offsets[(index)]; ii < offsets[(index + 1)]; ++ii) {
+    const int via = list[(ii)];
+    if (via < 0) {
+      continue;
+    }
+    const int* via_entries = &via_list[(via_offsets[(via)])];
+    const int nvia = via_offsets[(via + 1)] - via_offsets[(via)];
+
+    // Only the entries either side of this one in a cyclic list are adjacent
+    // to it, such as the nodes along the edges of a face
+    if (adjacent_only) {
+      int pos = 0;
+      while (pos < nvia && via_entries[pos] != index) {
+        pos++;
+      }
+      if (pos < nvia) {
+        insert_distinct(via_entries[(pos + 1 < nvia) ? pos + 1 : 0], scratch,
+                        &len);
+        insert_distinct(via_entries[(pos > 0) ? pos - 1 : nvia - 1], scratch,
+                        &len);
+      }
+      continue;
+    }
+    for (int jj = 0; jj < nvia; ++jj) {
+      if (via_entries[jj] >= 0 && via_entries[jj] != index) {
+        insert_distinct(via_entries[jj], scratch, &len);
+      }
+    }
+  }
+  return len;
+}
+
+// Builds a map from each entry to the distinct entries that share one of
+// its intermediates, allocating the offsets if they are missing and
+// replacing any existing list, returning the bytes allocated
+static size_t build_neighbour_csr(const int n, const int* offsets,
+                                  const int* list, const int* via_offsets,
+                                  const int* via_list,
+                                  const int adjacent_only,
+                                  int** neighbour_offsets,
+                                  int** neighbour_list) {
+  size_t allocated = 0;
+  if (!*neighbour_offsets) {
+    allocated += allocate_int_data(neighbour_offsets, n + 1);
+  }
+
+  // The scratch list must hold every neighbour before duplicates are removed
+  int max_len = 0;
+#pragma omp parallel for reduction(max : max_len)
+  for (int ii = 0; ii < n; ++ii) {
+    int len = 0;
+    for (int jj = offsets[(ii)]; jj < offsets[(ii + 1)]; ++jj) {
+      if (list[(jj)] >= 0) {
+        len += via_offsets[(list[(jj)] + 1)] - via_offsets[(list[(jj)])];
+      }
+    }
+    max_len = max(max_len, len);
+  }
+
+  (*neighbour_offsets)[(0)] = 0;
+#pragma omp parallel
+  {
+    int* scratch = (int*)malloc(sizeof(int) * (max_len + 1));
+    if (!scratch) {
+      TERMINATE("Failed to allocate the neighbour list.\n");
+    }
+#pragma omp for
+    for (int ii = 0; ii < n; ++ii) {
+      (*neighbour_offsets)[(ii + 1)] =
+          gather_neighbours(ii, offsets, list, via_offsets, via_list,
+                            adjacent_only, scratch);
+    }
+    free(scratch);
+  }
+  const int nentries = prefix_sum(n + 1, *neighbour_offsets, 1);
+
+  if (*neighbour_list) {
+    deallocate_int_data(*neighbour_list);
+  }
+  allocated += allocate_int_data(neighbour_list, nentries);
+
+  // The neighbours are gathered again straight into their place in the list
+#pragma omp parallel
+  {
+    int* scratch = (int*)malloc(sizeof(int) * (max_len + 1));
+    if (!scratch) {
+      TERMINATE("Failed to allocate the neighbour list.\n");
+    }
+#pragma omp for
+    for (int ii = 0; ii < n; ++ii) {
+      const int len = gather_neighbours(ii, offsets, list, via_offsets,
+                                        via_list, adjacent_only, scratch);
+      memcpy(&(*neighbour_list)[((*neighbour_offsets)[(ii)])], scratch,
+             sizeof(int) * len);
+    }
+    free(scratch);
+  }
+
+  return allocated;
+}
+
+// Determine the cells that neighbour other cells, sharing at least one node
+size_t fill_cells_to_cells(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  return build_neighbour_csr(
+      umesh->ncells, umesh->cells_to_nodes_offsets, umesh->cells_to_nodes,
+      umesh->nodes_to_cells_offsets, umesh->nodes_to_cells, 0,
+      &umesh->cells_to_cells_offsets, &umesh->cells_to_cells);
+}
+
+// Determine the nodes that surround other nodes, along the edges of the faces
+// where there are faces and otherwise through the cells
+size_t fill_nodes_to_nodes(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  if (umesh->nodes_to_faces && umesh->faces_to_nodes) {
+    return build_neighbour_csr(
+        umesh->nnodes, umesh->nodes_to_faces_offsets, umesh->nodes_to_faces,
+        umesh->faces_to_nodes_offsets, umesh->faces_to_nodes, 1,
+        &umesh->nodes_to_nodes_offsets, &umesh->nodes_to_nodes);
+  }
+  return build_neighbour_csr(
+      umesh->nnodes, umesh->nodes_to_cells_offsets, umesh->nodes_to_cells,
+      umesh->cells_to_nodes_offsets, umesh->cells_to_nodes, 0,
+      &umesh->nodes_to_nodes_offsets, &umesh->nodes_to_nodes);
+}
+
+// Writes the distinct nodes of a face in ascending order, returning how many
+// there are
+static inline int cell_face_key(const UnstructuredMesh* umesh, const int cc,
+                                const int ff, int* key) {
+  int nodes[NNODES_BY_FACE];
+  const int nnodes_by_face = cell_face_nodes(umesh, cc, ff, nodes);
+  int len = 0;
+  for (int nn = 0; nn < nnodes_by_face; ++nn) {
+    insert_distinct(nodes[nn], key, &len);
+  }
+  return len;
+}
+
+// The entry of cells_to_faces holding the same face in another cell, found
+// among the cells around its lowest node, or -1 when the face is on the
+// boundary. Counts the other cells holding the face into nmatches.
+static int find_matching_face(const UnstructuredMesh* umesh, const int cc,
+                              const int ff, int* nmatches) {
+  int key[NNODES_BY_FACE];
+  const int nkey = cell_face_key(umesh, cc, ff, key);
+
+  int match = -1;
+  for (int ii = umesh->nodes_to_cells_offsets[(key[0])];
+       ii < umesh->nodes_to_cells_offsets[(key[0] + 1)]; ++ii) {
+    const int neighbour = umesh->nodes_to_cells[(ii)];
+    if (neighbour == cc) {
+      continue;
+    }
+    const int off = umesh->cells_to_faces_offsets[(neighbour)];
+    for (int gg = 0; gg < umesh->cells_to_faces_offsets[(neighbour + 1)] - off;
+         ++gg) {
+      int other[NNODES_BY_FACE];
+      if (cell_face_key(umesh, neighbour, gg, other) == nkey &&
+          memcmp(key, other, sizeof(int) * nkey) == 0) {
+        match = off + gg;
+        (*nmatches)++;
+      }
+    }
+  }
+  return match;
+}
+
+// Builds the faces of a mesh of tetrahedra and hexahedra from the nodes of
+// its cells, returning the bytes allocated
+size_t build_umesh_faces(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  int nunknown = 0;
+#pragma omp parallel for reduction(+ : nunknown)
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    nunknown += !cell_nfaces_by_nodes(umesh_cell_nnodes(umesh, cc));
+  }
+  if (nunknown) {
+    TERMINATE("%d cells are neither tetrahedra nor hexahedra.\n", nunknown);
+  }
+  if (!umesh->nodes_to_cells) {
+    TERMINATE("The faces are matched through the cells around the nodes.\n");
+  }
+
+  size_t allocated =
+      allocate_int_data(&umesh->cells_to_faces_offsets, umesh->ncells + 1);
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    umesh->cells_to_faces_offsets[(cc + 1)] =
+        cell_nfaces_by_nodes(umesh_cell_nnodes(umesh, cc));
+  }
+  const int nentries =
+      prefix_sum(umesh->ncells + 1, umesh->cells_to_faces_offsets, 1);
+
+  // Each face is held by the first of its cells, and the faces are numbered
+  // in the order of the cells that hold them
+  int* matches;
+  int* face_index;
+  allocate_int_data(&matches, nentries);
+  allocate_int_data(&face_index, nentries);
+  int nshared = 0;
+#pragma omp parallel for reduction(+ : nshared)
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int off = umesh->cells_to_faces_offsets[(cc)];
+    for (int ff = 0; ff < umesh->cells_to_faces_offsets[(cc + 1)] - off;
+         ++ff) {
+      int nmatches = 0;
+      matches[(off + ff)] = find_matching_face(umesh, cc, ff, &nmatches);
+      face_index[(off + ff)] =
+          (matches[(off + ff)] == -1 || off + ff < matches[(off + ff)]);
+      nshared += (nmatches > 1);
+    }
+  }
+  if (nshared) {
+    TERMINATE("%d faces are shared by more than two cells.\n", nshared);
+  }
+  umesh->nfaces = prefix_sum(nentries, face_index, 0);
+
+  allocated += allocate_int_data(&umesh->cells_to_faces, nentries);
+  allocated += allocate_int_data(&umesh->faces_to_cells0, umesh->nfaces);
+  allocated += allocate_int_data(&umesh->faces_to_cells1, umesh->nfaces);
+  allocated += allocate_int_data(&umesh->faces_cclockwise_cell, umesh->nfaces);
+  allocated +=
+      allocate_int_data(&umesh->faces_to_nodes_offsets, umesh->nfaces + 1);
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int off = umesh->cells_to_faces_offsets[(cc)];
+    for (int ff = 0; ff < umesh->cells_to_faces_offsets[(cc + 1)] - off;
+         ++ff) {
+      const int match = matches[(off + ff)];
+      if (match == -1 || off + ff < match) {
+        const int face = face_index[(off + ff)];
+        int nodes[NNODES_BY_FACE];
+        umesh->cells_to_faces[(off + ff)] = face;
+        umesh->faces_to_cells0[(face)] = cc;
+        umesh->faces_cclockwise_cell[(face)] = cc;
+        umesh->faces_to_nodes_offsets[(face + 1)] =
+            cell_face_nodes(umesh, cc, ff, nodes);
+        if (match == -1) {
+          umesh->faces_to_cells1[(face)] = -1;
+        }
+      } else {
+        const int face = face_index[(match)];
+        umesh->cells_to_faces[(off + ff)] = face;
+        umesh->faces_to_cells1[(face)] = cc;
+      }
+    }
+  }
+  const int nface_nodes =
+      prefix_sum(umesh->nfaces + 1, umesh->faces_to_nodes_offsets, 1);
+
+  // The nodes of each face are those of its first cell
+  allocated += allocate_int_data(&umesh->faces_to_nodes, nface_nodes);
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    const int off = umesh->cells_to_faces_offsets[(cc)];
+    for (int ff = 0; ff < umesh->cells_to_faces_offsets[(cc + 1)] - off;
+         ++ff) {
+      const int match = matches[(off + ff)];
+      if (match == -1 || off + ff < match) {
+        const int face = face_index[(off + ff)];
+        cell_face_nodes(
+            umesh, cc, ff,
+            &umesh->faces_to_nodes[(umesh->faces_to_nodes_offsets[(face)])]);
+      }
+    }
+  }
+  deallocate_int_data(matches);
+
+  allocated +=
+      allocate_int_data(&umesh->nodes_to_faces_offsets, umesh->nnodes + 1);
+  allocated += build_csr_transpose(
+      umesh->nfaces, umesh->faces_to_nodes_offsets, umesh->faces_to_nodes,
+      umesh->nnodes, umesh->nodes_to_faces_offsets, &umesh->nodes_to_faces);
+
+  // The faces with a single cell are listed in ascending order
+  int* boundary_position = face_index;
+#pragma omp parallel for
+  for (int ff = 0; ff < umesh->nfaces; ++ff) {
+    boundary_position[(ff)] = (umesh->faces_to_cells1[(ff)] == -1);
+  }
+  umesh->nboundary_faces = prefix_sum(umesh->nfaces, boundary_position, 0);
+  allocated +=
+      allocate_int_data(&umesh->boundary_faces, umesh->nboundary_faces);
+#pragma omp parallel for
+  for (int ff = 0; ff < umesh->nfaces; ++ff) {
+    if (umesh->faces_to_cells1[(ff)] == -1) {
+      umesh->boundary_faces[(boundary_position[(ff)])] = ff;
+    }
+  }
+  deallocate_int_data(face_index);
+
+  return allocated;
+}
+
+// Converts an ordinary structured mesh into an unstructured equivalent whose
+// connectivity is implicit, so only the node and boundary data is allocated
+size_t convert_mesh_to_implicit_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh) {
+  REQUIRE_HOST_DATA();
+
+  const int nx = mesh->local_nx;
+  const int ny = mesh->local_ny;
+  const int nz = mesh->local_nz;
+  umesh->nnodes_by_cell = NNODES_BY_CELL;
+  umesh->nnodes_by_node = NNODES_BY_NODE;
+  umesh->implicit = 1;
+  umesh->implicit_nx = nx;
+  umesh->implicit_ny = ny;
+  umesh->implicit_nz = nz;
+
+  umesh->nboundary_nodes = converted_nboundary_nodes(nx, ny, nz);
+  umesh->nnodes = (nx + 1) * (ny + 1) * (nz + 1);
+  umesh->ncells = (nx * ny * nz);
+  umesh->nfaces = nx * ny * (nz + 1) + (nx * (ny + 1) + (nx + 1) * ny) * nz;
+
+  size_t allocated = allocate_data(&umesh->cell_centroids_x, umesh->ncells);
+  allocated += allocate_data(&umesh->cell_centroids_y, umesh->ncells);
+  allocated += allocate_data(&umesh->cell_centroids_z, umesh->ncells);
+  allocated += allocate_data(&umesh->nodes_x0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_y0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_z0, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_x1, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_y1, umesh->nnodes);
+  allocated += allocate_data(&umesh->nodes_z1, umesh->nnodes);
+  allocated += allocate_data(&umesh->boundary_normal_x, umesh->nnodes);
+  allocated += allocate_data(&umesh->boundary_normal_y, umesh->nnodes);
+  allocated += allocate_data(&umesh->boundary_normal_z, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_index, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_type, umesh->nnodes);
+  allocated += allocate_int_data(&umesh->boundary_faces,
+                                 2 * (nx * ny + ny * nz + nx * nz));
+
+#pragma omp parallel for
+  for (int ii = 0; ii < (nz + 1); ++ii) {
+    for (int jj = 0; jj < (ny + 1); ++jj) {
+      for (int kk = 0; kk < (nx + 1); ++kk) {
+        const int node_index = implicit_node_index(umesh, ii, jj, kk);
+        umesh->nodes_z0[(node_index)] = mesh->edgez[(ii)];
+        umesh->nodes_y0[(node_index)] = mesh->edgey[(jj)];
+        umesh->nodes_x0[(node_index)] = mesh->edgex[(kk)];
+      }
+    }
+  }
 
   // Initialises the boundary normals
   init_boundary_normals_3d(nx, ny, nz, umesh);
 
+  // Initialises the centroids of the cells
+  init_cell_centroids_3d(nx, ny, nz, mesh, umesh);
+
   return allocated;
 }
+
+// Fills a CSR map through its accessors
+static size_t materialise_map(UnstructuredMesh* umesh, const int n,
+                              int (*count)(const UnstructuredMesh*, const int),
+                              int (*entry)(const UnstructuredMesh*, const int,
+                                           const int),
+                              int** offsets, int** list) {
+  size_t allocated = allocate_int_data(offsets, n + 1);
+#pragma omp parallel for
+  for (int ii = 0; ii < n; ++ii) {
+    (*offsets)[(ii + 1)] = count(umesh, ii);
+  }
+  const int nentries = prefix_sum(n + 1, *offsets, 1);
+
+  allocated += allocate_int_data(list, nentries);
+#pragma omp parallel for
+  for (int ii = 0; ii < n; ++ii) {
+    const int off = (*offsets)[(ii)];
+    for (int jj = 0; jj < (*offsets)[(ii + 1)] - off; ++jj) {
+      (*list)[(off + jj)] = entry(umesh, ii, jj);
+    }
+  }
+  return allocated;
+}
+
+// Allocates and fills the connectivity arrays of a mesh with implicit
+// connectivity, after which the mesh is explicit
+size_t materialise_umesh_connectivity(UnstructuredMesh* umesh) {
+  REQUIRE_HOST_DATA();
+
+  if (!umesh->implicit) {
+    return 0;
+  }
+
+  size_t allocated = materialise_map(
+      umesh, umesh->ncells, umesh_cell_nnodes, umesh_cell_node,
+      &umesh->cells_to_nodes_offsets, &umesh->cells_to_nodes);
+  allocated += materialise_map(umesh, umesh->ncells, umesh_cell_nfaces,
+                               umesh_cell_face, &umesh->cells_to_faces_offsets,
+                               &umesh->cells_to_faces);
+  allocated += materialise_map(umesh, umesh->nnodes, umesh_node_ncells,
+                               umesh_node_cell, &umesh->nodes_to_cells_offsets,
+                               &umesh->nodes_to_cells);
+  allocated += materialise_map(umesh, umesh->nnodes, umesh_node_nnodes,
+                               umesh_node_node, &umesh->nodes_to_nodes_offsets,
+                               &umesh->nodes_to_nodes);
+  allocated += materialise_map(umesh, umesh->nfaces, umesh_face_nnodes,
+                               umesh_face_node, &umesh->faces_to_nodes_offsets,
+                               &umesh->faces_to_nodes);
+
+  allocated += allocate_int_data(&umesh->faces_to_cells0, umesh->nfaces);
+  allocated += allocate_int_data(&umesh->faces_to_cells1, umesh->nfaces);
+  allocated += allocate_int_data(&umesh->faces_cclockwise_cell, umesh->nfaces);
+#pragma omp parallel for
+  for (int ff = 0; ff < umesh->nfaces; ++ff) {
+    umesh->faces_to_cells0[(ff)] = umesh_face_cell(umesh, ff, 0);
+    umesh->faces_to_cells1[(ff)] = umesh_face_cell(umesh, ff, 1);
+
+    // The face nodes run counter-clockwise as seen from the first cell
+    umesh->faces_cclockwise_cell[(ff)] = umesh->faces_to_cells0[(ff)];
+  }
+
+  // There is no closed form for the faces of a node in ascending order
+  allocated += allocate_int_data(&umesh->nodes_to_faces_offsets,
+                                 umesh->nnodes + 1);
+  allocated += build_csr_transpose(
+      umesh->nfaces, umesh->faces_to_nodes_offsets, umesh->faces_to_nodes,
+      umesh->nnodes, umesh->nodes_to_faces_offsets, &umesh->nodes_to_faces);
+
+  umesh->implicit = 0;
+  return allocated;
+}
+
+// Moves each entry of a field to its new index, replacing the buffer
+void permute_data(const int n, const int* old_to_new, double** data) {
+  REQUIRE_HOST_DATA();
+
+  if (!*data) {
+    return;
+  }
+  double* permuted;
+  allocate_data(&permuted, n);
+#pragma omp parallel for
+  for (int ii = 0; ii < n; ++ii) {
+    permuted[(old_to_new[(ii)])] = (*data)[(ii)];
+  }
+  deallocate_data(*data);
+  *data = permuted;
+}
+
+// Moves each entry of an integer array to its new index
+static void permute_int_data(const int n, const int* old_to_new, int** data) {
+  if (!*data) {
+    return;
+  }
+  int* permuted;
+  allocate_int_data(&permuted, n);
+#pragma omp parallel for
+  for (int ii = 0; ii < n; ++ii) {
+    permuted[(old_to_new[(ii)])] = (*data)[(ii)];
+  }
+  deallocate_int_data(*data);
+  *data = permuted;
+}
+
+// Renumbers the entries of a list, leaving the missing entries marked -1
+static void renumber_list(const size_t len, const int* old_to_new, int* list) {
+  if (!list) {
+    return;
+  }
+#pragma omp parallel for
+  for (size_t ii = 0; ii < len; ++ii) {
+    if (list[(ii)] >= 0) {
+      list[(ii)] = old_to_new[(list[(ii)])];
+    }
+  }
+}
+
+// Reorders the rows of a CSR map into their new order, renumbering the
+// entries when a map for them is given and sorting the renumbered rows of
+// the maps that list their entries in ascending order
+static void permute_csr(const int nrows, const int* new_to_old,
+                        const int* value_old_to_new, const int sort_rows,
+                        int** offsets, int** list) {
+  if (!*offsets || !*list) {
+    return;
+  }
+
+  int* new_offsets;
+  allocate_int_data(&new_offsets, nrows + 1);
+#pragma omp parallel for
+  for (int rr = 0; rr < nrows; ++rr) {
+    const int old_row = new_to_old[(rr)];
+    new_offsets[(rr + 1)] =
+        (*offsets)[(old_row + 1)] - (*offsets)[(old_row)];
+  }
+  prefix_sum(nrows + 1, new_offsets, 1);
+
+  int* new_list;
+  allocate_int_data(&new_list, new_offsets[(nrows)]);
+#pragma omp parallel for
+  for (int rr = 0; rr < nrows; ++rr) {
+    const int old_off = (*offsets)[(new_to_old[(rr)])];
+    for (int ii = new_offsets[(rr)]; ii < new_offsets[(rr + 1)]; ++ii) {
+      const int val = (*list)[(old_off + ii - new_offsets[(rr)])];
+      new_list[(ii)] =
+          (value_old_to_new && val >= 0) ? value_old_to_new[(val)] : val;
+    }
+    if (sort_rows) {
+      sort_short_list(new_offsets[(rr + 1)] - new_offsets[(rr)],
+                      &new_list[(new_offsets[(rr)])]);
+    }
+  }
+
+  deallocate_int_data(*offsets);
+  deallocate_int_data(*list);
+  *offsets = new_offsets;
+  *list = new_list;
+}
+
+// Reorders the cells and nodes, rewriting all of the connectivity, where the
+// permutations give the new index of each cell and node
+void permute_unstructured_mesh(UnstructuredMesh* umesh,
+                               const int* cells_old_to_new,
+                               const int* nodes_old_to_new) {
+  REQUIRE_HOST_DATA();
+
+  if (umesh->implicit) {
+    TERMINATE("The connectivity of an implicit mesh cannot be permuted.\n");
+  }
+
+  int* cells_new_to_old = (int*)malloc(sizeof(int) * umesh->ncells);
+  int* nodes_new_to_old = (int*)malloc(sizeof(int) * umesh->nnodes);
+  if (!cells_new_to_old || !nodes_new_to_old) {
+    TERMINATE("Failed to allocate the mesh permutation.\n");
+  }
+#pragma omp parallel for
+  for (int cc = 0; cc < umesh->ncells; ++cc) {
+    cells_new_to_old[(cells_old_to_new[(cc)])] = cc;
+  }
+#pragma omp parallel for
+  for (int nn = 0; nn < umesh->nnodes; ++nn) {
+    nodes_new_to_old[(nodes_old_to_new[(nn)])] = nn;
+  }
+
+  // The rows of the maps move with their cells and nodes, and the nodes of
+  // each cell keep their winding while the built maps stay ascending
+  permute_csr(umesh->ncells, cells_new_to_old, nodes_old_to_new, 0,
+              &umesh->cells_to_nodes_offsets, &umesh->cells_to_nodes);
+  permute_csr(umesh->ncells, cells_new_to_old, NULL, 0,
+              &umesh->cells_to_faces_offsets, &umesh->cells_to_faces);
+  permute_csr(umesh->nnodes, nodes_new_to_old, cells_old_to_new, 1,
+              &umesh->nodes_to_cells_offsets, &umesh->nodes_to_cells);
+  permute_csr(umesh->nnodes, nodes_new_to_old, nodes_old_to_new, 1,
+              &umesh->nodes_to_nodes_offsets, &umesh->nodes_to_nodes);
+  permute_csr(umesh->nnodes, nodes_new_to_old, NULL, 0,
+              &umesh->nodes_to_faces_offsets, &umesh->nodes_to_faces);
+  permute_csr(umesh->ncells, cells_new_to_old, cells_old_to_new, 1,
+              &umesh->cells_to_cells_offsets, &umesh->cells_to_cells);
+
+  // The faces keep their order but refer to the new cells and nodes
+  if (umesh->faces_to_nodes_offsets) {
+    renumber_list(umesh->faces_to_nodes_offsets[(umesh->nfaces)],
+                  nodes_old_to_new, umesh->faces_to_nodes);
+  }
+  renumber_list(umesh->nfaces, cells_old_to_new, umesh->faces_to_cells0);
+  renumber_list(umesh->nfaces, cells_old_to_new, umesh->faces_to_cells1);
+  renumber_list(umesh->nfaces, cells_old_to_new,
+                umesh->faces_cclockwise_cell);
+
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_x0);
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_y0);
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_z0);
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_x1);
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_y1);
+  permute_data(umesh->nnodes, nodes_old_to_new, &umesh->nodes_z1);
+  permute_data(umesh->ncells, cells_old_to_new, &umesh->cell_centroids_x);
+  permute_data(umesh->ncells, cells_old_to_new, &umesh->cell_centroids_y);
+  permute_data(umesh->ncells, cells_old_to_new, &umesh->cell_centroids_z);
+
+  // The boundary data is listed by boundary index, which is unchanged
+  permute_int_data(umesh->nnodes, nodes_old_to_new, &umesh->boundary_index);
+
+  // The sub-cell volumes are listed by the rows of the cells to nodes, so
+  // the geometry is recomputed rather than moved
+  if (umesh->cell_volume) {
+    permute_data(umesh->nnodes, nodes_old_to_new, &umesh->geometry_nodes_x);
+    permute_data(umesh->nnodes, nodes_old_to_new, &umesh->geometry_nodes_y);
+    permute_data(umesh->nnodes, nodes_old_to_new, &umesh->geometry_nodes_z);
+    compute_umesh_geometry(umesh);
+  }
+
+  free(cells_new_to_old);
+  free(nodes_new_to_old);
+}
+
+// Spreads the low 21 bits of a value so that two zero bits follow each
+static inline uint64_t spread_bits(uint64_t val) {
+  val &= 0x1fffff;
+  val = (val | val << 32) & 0x1f00000000ffffULL;
+  val = (val | val << 16) & 0x1f0000ff0000ffULL;
+  val = (val | val << 8) & 0x100f00f00f00f00fULL;
+  val = (val | val << 4) & 0x10c30c30c30c30c3ULL;
+  val = (val | val << 2) & 0x1249249249249249ULL;
+  return val;
+}
+
+// Quantises a coordinate within its bounds onto 21 bits
+static inline uint64_t quantise_coord(const double val, const double lo,
+                                      const double range) {
+  return (range > 0.0) ? (uint64_t)((val - lo) / range * MORTON_MAX) : 0;
+}
+
+// Renumbers the cells in Morton order of their centroids and the nodes in
+// the order that the renumbered cells first use them, returning the new
+// index of each original cell and node
+void renumber_unstructured_mesh(UnstructuredMesh* umesh, int* cells_old_to_new,
+                                int* nodes_old_to_new) {
+  REQUIRE_HOST_DATA();
+
+  const int ncells = umesh->ncells;
+  const int nnodes = umesh->nnodes;
+  uint64_t* keys = (uint64_t*)malloc(sizeof(uint64_t) * ncells);
+  uint64_t* sorted_keys = (uint64_t*)malloc(sizeof(uint64_t) * ncells);
+  int* order = (int*)malloc(sizeof(int) * ncells);
+  int* sorted_order = (int*)malloc(sizeof(int) * ncells);
+  double* centroids[3];
+  for (int dd = 0; dd < 3; ++dd) {
+    centroids[dd] = (double*)malloc(sizeof(double) * ncells);
+  }
+  if (!keys || !sorted_keys || !order || !sorted_order || !centroids[0] ||
+      !centroids[1] || !centroids[2]) {
+    TERMINATE("Failed to allocate the mesh renumbering.\n");
+  }
+
+  // The centroids are recomputed as not every mesh source provides them
+  double lo[3] = {INFINITY, INFINITY, INFINITY};
+  double hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+#pragma omp parallel for
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int off = umesh->cells_to_nodes_offsets[(cc)];
+    const int nnodes_by_cell = umesh->cells_to_nodes_offsets[(cc + 1)] - off;
+    double cx = 0.0;
+    double cy = 0.0;
+    double cz = 0.0;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      const int node_index = umesh->cells_to_nodes[(off + nn)];
+      cx += umesh->nodes_x0[(node_index)];
+      cy += umesh->nodes_y0[(node_index)];
+      cz += umesh->nodes_z0[(node_index)];
+    }
+    centroids[0][cc] = cx / nnodes_by_cell;
+    centroids[1][cc] = cy / nnodes_by_cell;
+    centroids[2][cc] = cz / nnodes_by_cell;
+  }
+  for (int dd = 0; dd < 3; ++dd) {
+    double dlo = INFINITY;
+    double dhi = -INFINITY;
+#pragma omp parallel for reduction(min : dlo) reduction(max : dhi)
+    for (int cc = 0; cc < ncells; ++cc) {
+      dlo = min(dlo, centroids[dd][cc]);
+      dhi = max(dhi, centroids[dd][cc]);
+    }
+    lo[dd] = dlo;
+    hi[dd] = dhi;
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < ncells; ++cc) {
+    keys[cc] =
+        spread_bits(quantise_coord(centroids[0][cc], lo[0], hi[0] - lo[0])) |
+        spread_bits(quantise_coord(centroids[1][cc], lo[1], hi[1] - lo[1]))
+            << 1 |
+        spread_bits(quantise_coord(centroids[2][cc], lo[2], hi[2] - lo[2]))
+            << 2;
+    order[cc] = cc;
+  }
+
+  // A stable radix sort keeps cells with equal keys in their original order
+  for (int shift = 0; shift < 64; shift += MORTON_RADIX_BITS) {
+    int counts[(1 << MORTON_RADIX_BITS) + 1];
+    memset(counts, 0, sizeof(counts));
+    for (int cc = 0; cc < ncells; ++cc) {
+      counts[((keys[cc] >> shift) & ((1 << MORTON_RADIX_BITS) - 1)) + 1]++;
+    }
+    if (counts[1] == ncells) {
+      continue;
+    }
+    for (int bb = 0; bb < (1 << MORTON_RADIX_BITS); ++bb) {
+      counts[bb + 1] += counts[bb];
+    }
+    for (int cc = 0; cc < ncells; ++cc) {
+      const int pos =
+          counts[(keys[cc] >> shift) & ((1 << MORTON_RADIX_BITS) - 1)]++;
+      sorted_keys[pos] = keys[cc];
+      sorted_order[pos] = order[cc];
+    }
+    uint64_t* tmp_keys = keys;
+    keys = sorted_keys;
+    sorted_keys = tmp_keys;
+    int* tmp_order = order;
+    order = sorted_order;
+    sorted_order = tmp_order;
+  }
+
+#pragma omp parallel for
+  for (int cc = 0; cc < ncells; ++cc) {
+    cells_old_to_new[(order[cc])] = cc;
+  }
+
+  // Nodes are numbered as they are first met, any unused nodes come last
+  for (int nn = 0; nn < nnodes; ++nn) {
+    nodes_old_to_new[nn] = -1;
+  }
+  int nnumbered = 0;
+  for (int cc = 0; cc < ncells; ++cc) {
+    const int old_cell = order[cc];
+    for (int nn = umesh->cells_to_nodes_offsets[(old_cell)];
+         nn < umesh->cells_to_nodes_offsets[(old_cell + 1)]; ++nn) {
+      const int node_index = umesh->cells_to_nodes[(nn)];
+      if (nodes_old_to_new[node_index] == -1) {
+        nodes_old_to_new[node_index] = nnumbered++;
+      }
+    }
+  }
+  for (int nn = 0; nn < nnodes; ++nn) {
+    if (nodes_old_to_new[nn] == -1) {
+      nodes_old_to_new[nn] = nnumbered++;
+    }
+  }
+
+  permute_unstructured_mesh(umesh, cells_old_to_new, nodes_old_to_new);
+
+  for (int dd = 0; dd < 3; ++dd) {
+    free(centroids[dd]);
+  }
+  free(keys);
+  free(sorted_keys);
+  free(order);
+  free(sorted_order);
+}
+
+// Deallocates all of the unstructured mesh memory
+void finalise_unstructured_mesh(UnstructuredMesh* umesh) {
+  deallocate_data(umesh->cell_centroids_x);
+  deallocate_data(umesh->cell_centroids_y);
+  deallocate_data(umesh->cell_centroids_z);
+  deallocate_int_data(umesh->nodes_to_cells_offsets);
+  deallocate_int_data(umesh->cells_to_nodes_offsets);
+  deallocate_int_data(umesh->nodes_to_nodes_offsets);
+  deallocate_int_data(umesh->cells_to_cells_offsets);
+  deallocate_int_data(umesh->cells_to_cells);
+  deallocate_int_data(umesh->cells_to_nodes);
+  deallocate_int_data(umesh->nodes_to_nodes);
+  deallocate_int_data(umesh->nodes_to_cells);
+  deallocate_data(umesh->nodes_x0);
+  deallocate_data(umesh->nodes_y0);
+  deallocate_data(umesh->nodes_z0);
+  deallocate_data(umesh->nodes_x1);
+  deallocate_data(umesh->nodes_y1);
+  deallocate_data(umesh->nodes_z1);
+  deallocate_int_data(umesh->faces_to_nodes_offsets);
+  deallocate_int_data(umesh->faces_to_nodes);
+  deallocate_int_data(umesh->faces_cclockwise_cell);
+  deallocate_int_data(umesh->cells_to_faces_offsets);
+  deallocate_int_data(umesh->cells_to_faces);
+  deallocate_int_data(umesh->nodes_to_faces);
+  deallocate_int_data(umesh->nodes_to_faces_offsets);
+  deallocate_int_data(umesh->faces_to_cells0);
+  deallocate_int_data(umesh->faces_to_cells1);
+  deallocate_data(umesh->boundary_normal_x);
+  deallocate_data(umesh->boundary_normal_y);
+  deallocate_data(umesh->boundary_normal_z);
+  deallocate_int_data(umesh->boundary_index);
+  deallocate_int_data(umesh->boundary_type);
+  deallocate_int_data(umesh->boundary_faces);
+  deallocate_data(umesh->sub_cell_volume);
+  deallocate_data(umesh->cell_volume);
+  deallocate_data(umesh->face_area);
+  deallocate_data(umesh->face_normal_x);
+  deallocate_data(umesh->face_normal_y);
+  deallocate_data(umesh->face_normal_z);
+  deallocate_data(umesh->geometry_nodes_x);
+  deallocate_data(umesh->geometry_nodes_y);
+  deallocate_data(umesh->geometry_nodes_z);
+}
@@ -10,6 +10,10 @@
 #define IS_EDGE -3
 #define IS_CORNER -4
 
+// The cosine of the largest angle between the normals of the faces around a
+// boundary node that still lie on the same smooth part of the boundary
+#define BOUNDARY_CREASE_COS 0.7071
+
 // Constants for defining cartesian mesh in fully unstructured manner
 #define NNODES_BY_CELL 8
 #define NNODES_BY_NODE 6
@@ -18,6 +22,11 @@
 #define NFACES_BY_CELL 6
 #define NCELLS_BY_NODE 8
 
+// The orientations of the faces of a converted mesh, by the plane they lie in
+#define IMPLICIT_FACE_XY 0
+#define IMPLICIT_FACE_YZ 1
+#define IMPLICIT_FACE_XZ 2
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -34,10 +43,19 @@ typedef struct {
   int nnodes_by_node;
   int nregional_variables;
   int nboundary_nodes;
+  int nboundary_faces;
   int nfaces;
 
+  // The dimensions of the structured mesh that this mesh was converted from,
+  // with implicit set when the connectivity is computed from them
+  int implicit;
+  int implicit_nx;
+  int implicit_ny;
+  int implicit_nz;
+
   int* boundary_index;
   int* boundary_type;
+  int* boundary_faces; // The faces with a single cell, in ascending order
 
   // CURRENTLY 2D
   int* nodes_to_cells;
@@ -57,6 +75,8 @@ typedef struct {
   int* cells_to_faces_offsets;
   int* nodes_to_faces_offsets;
   int* nodes_to_nodes_offsets;
+  int* cells_to_cells;
+  int* cells_to_cells_offsets;
 
   double* nodes_x0;
   double* nodes_y0;
@@ -70,13 +90,412 @@ typedef struct {
   double* boundary_normal_x;
   double* boundary_normal_y;
   double* boundary_normal_z;
-  double* sub_cell_volume;
+  double* sub_cell_volume; // By cell node, at umesh_cell_node_offset
+
+  // The geometry computed by init_umesh_geometry, at the node positions it
+  // was last computed at. The face normals are unit vectors pointing out of
+  // faces_to_cells0 and into faces_to_cells1.
+  double* cell_volume;
+  double* face_area;
+  double* face_normal_x;
+  double* face_normal_y;
+  double* face_normal_z;
+  double* geometry_nodes_x;
+  double* geometry_nodes_y;
+  double* geometry_nodes_z;
 
   char* node_filename;
   char* ele_filename;
 
 } UnstructuredMesh;
 
+// The number of boundary nodes of a mesh converted from an nx by ny by nz
+// structured mesh, being the bottom and top layers and the rings around the
+// layers between them
+static inline int converted_nboundary_nodes(const int nx, const int ny,
+                                            const int nz) {
+  return 2 * (nx + 1) * (ny + 1) + (nz - 1) * (2 * (nx + 1) + 2 * (ny - 1));
+}
+
+/*
+ * IMPLICIT CONNECTIVITY
+ * A mesh converted from a structured mesh can leave its connectivity
+ * implicit, in which case the accessors compute each entry from the
+ * structured indices and the connectivity arrays are not allocated. The
+ * accessors read the arrays of an explicit mesh, so kernels written against
+ * them work on both.
+ */
+
+// The number of faces in each layer of cells, before the top faces
+#define IMPLICIT_LAYER_NFACES(nx, ny) (3 * (nx) * (ny) + (nx) + (ny))
+
+// The index of a node of the structured mesh
+static inline int implicit_node_index(const UnstructuredMesh* umesh,
+                                      const int ii, const int jj,
+                                      const int kk) {
+  return (ii * (umesh->implicit_nx + 1) * (umesh->implicit_ny + 1)) +
+         (jj * (umesh->implicit_nx + 1)) + kk;
+}
+
+// The index of a cell of the structured mesh
+static inline int implicit_cell_index(const UnstructuredMesh* umesh,
+                                      const int ii, const int jj,
+                                      const int kk) {
+  return (ii * umesh->implicit_nx * umesh->implicit_ny) +
+         (jj * umesh->implicit_nx) + kk;
+}
+
+// The indices of the faces normal to z, x and y at a node position
+static inline int implicit_xy_face_index(const UnstructuredMesh* umesh,
+                                         const int ii, const int jj,
+                                         const int kk) {
+  const int nx = umesh->implicit_nx;
+  return (ii * IMPLICIT_LAYER_NFACES(nx, umesh->implicit_ny)) + (jj * nx) +
+         kk;
+}
+static inline int implicit_yz_face_index(const UnstructuredMesh* umesh,
+                                         const int ii, const int jj,
+                                         const int kk) {
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  return (ii * IMPLICIT_LAYER_NFACES(nx, ny)) + (nx * ny) +
+         (jj * (2 * nx + 1)) + (2 * kk);
+}
+static inline int implicit_xz_face_index(const UnstructuredMesh* umesh,
+                                         const int ii, const int jj,
+                                         const int kk) {
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  return (ii * IMPLICIT_LAYER_NFACES(nx, ny)) + (nx * ny) +
+         (jj * (2 * nx + 1)) + ((jj < ny) ? (2 * kk + 1) : kk);
+}
+
+// Decodes a face index into its orientation, IMPLICIT_FACE_XY, _YZ or _XZ,
+// and the position of its lowest node
+static inline int implicit_face_position(const UnstructuredMesh* umesh,
+                                         const int face_index, int* ii,
+                                         int* jj, int* kk) {
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  *ii = face_index / IMPLICIT_LAYER_NFACES(nx, ny);
+  int rem = face_index - *ii * IMPLICIT_LAYER_NFACES(nx, ny);
+  if (rem < nx * ny) {
+    *jj = rem / nx;
+    *kk = rem - *jj * nx;
+    return IMPLICIT_FACE_XY;
+  }
+  rem -= nx * ny;
+  *jj = rem / (2 * nx + 1);
+  rem -= *jj * (2 * nx + 1);
+  if (*jj == ny || rem % 2) {
+    *kk = (*jj == ny) ? rem : rem / 2;
+    return IMPLICIT_FACE_XZ;
+  }
+  *kk = rem / 2;
+  return IMPLICIT_FACE_YZ;
+}
+
+// The number of nodes of a cell
+static inline int umesh_cell_nnodes(const UnstructuredMesh* umesh,
+                                    const int cc) {
+  return umesh->implicit ? NNODES_BY_CELL
+                         : umesh->cells_to_nodes_offsets[(cc + 1)] -
+                               umesh->cells_to_nodes_offsets[(cc)];
+}
+
+// A node of a cell, ordered counter-clockwise around the bottom then the top
+static inline int umesh_cell_node(const UnstructuredMesh* umesh, const int cc,
+                                  const int nn) {
+  if (!umesh->implicit) {
+    return umesh->cells_to_nodes[(umesh->cells_to_nodes_offsets[(cc)] + nn)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int ii = cc / (nx * ny) + (nn >> 2);
+  const int jj = (cc / nx) % ny + ((nn & 3) >> 1);
+  const int kk = cc % nx + (((nn & 3) == 1) || ((nn & 3) == 2));
+  return implicit_node_index(umesh, ii, jj, kk);
+}
+
+// Writes all of the nodes of a cell, in the order of umesh_cell_node, to a
+// list that can hold the largest cell, returning how many there are. The
+// structured indices of an implicit cell are only decoded once.
+static inline int umesh_cell_nodes(const UnstructuredMesh* umesh,
+                                   const int cc, int* nodes) {
+  if (!umesh->implicit) {
+    const int off = umesh->cells_to_nodes_offsets[(cc)];
+    const int nnodes_by_cell = umesh->cells_to_nodes_offsets[(cc + 1)] - off;
+    for (int nn = 0; nn < nnodes_by_cell; ++nn) {
+      nodes[nn] = umesh->cells_to_nodes[(off + nn)];
+    }
+    return nnodes_by_cell;
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int ii = cc / (nx * ny);
+  const int jj = (cc - ii * nx * ny) / nx;
+  const int kk = cc - ii * nx * ny - jj * nx;
+  const int plane = (nx + 1) * (ny + 1);
+  nodes[0] = implicit_node_index(umesh, ii, jj, kk);
+  nodes[1] = nodes[0] + 1;
+  nodes[2] = nodes[0] + nx + 2;
+  nodes[3] = nodes[0] + nx + 1;
+  for (int nn = 0; nn < 4; ++nn) {
+    nodes[nn + 4] = nodes[nn] + plane;
+  }
+  return NNODES_BY_CELL;
+}
+
+// The position of the first node of a cell in a list holding an entry for
+// every node of every cell, such as the sub-cell volumes
+static inline int umesh_cell_node_offset(const UnstructuredMesh* umesh,
+                                         const int cc) {
+  return umesh->implicit ? cc * NNODES_BY_CELL
+                         : umesh->cells_to_nodes_offsets[(cc)];
+}
+
+// The number of faces of a cell
+static inline int umesh_cell_nfaces(const UnstructuredMesh* umesh,
+                                    const int cc) {
+  return umesh->implicit ? NFACES_BY_CELL
+                         : umesh->cells_to_faces_offsets[(cc + 1)] -
+                               umesh->cells_to_faces_offsets[(cc)];
+}
+
+// A face of a cell, ordered front, left, bottom, right, top then back
+static inline int umesh_cell_face(const UnstructuredMesh* umesh, const int cc,
+                                  const int ff) {
+  if (!umesh->implicit) {
+    return umesh->cells_to_faces[(umesh->cells_to_faces_offsets[(cc)] + ff)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int ii = cc / (nx * ny);
+  const int jj = (cc / nx) % ny;
+  const int kk = cc % nx;
+  switch (ff) {
+    case 0:
+      return implicit_xy_face_index(umesh, ii, jj, kk);
+    case 1:
+      return implicit_yz_face_index(umesh, ii, jj, kk);
+    case 2:
+      return implicit_xz_face_index(umesh, ii, jj, kk);
+    case 3:
+      return implicit_yz_face_index(umesh, ii, jj, kk + 1);
+    case 4:
+      return implicit_xz_face_index(umesh, ii, jj + 1, kk);
+    default:
+      return implicit_xy_face_index(umesh, ii + 1, jj, kk);
+  }
+}
+
+// The number of cells surrounding a node
+static inline int umesh_node_ncells(const UnstructuredMesh* umesh,
+                                    const int nn) {
+  if (!umesh->implicit) {
+    return umesh->nodes_to_cells_offsets[(nn + 1)] -
+           umesh->nodes_to_cells_offsets[(nn)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+  const int ii = nn / ((nx + 1) * (ny + 1));
+  const int jj = (nn / (nx + 1)) % (ny + 1);
+  const int kk = nn % (nx + 1);
+  return ((ii > 0) + (ii < nz)) * ((jj > 0) + (jj < ny)) *
+         ((kk > 0) + (kk < nx));
+}
+
+// A cell surrounding a node, in ascending order
+static inline int umesh_node_cell(const UnstructuredMesh* umesh, const int nn,
+                                  const int cc) {
+  if (!umesh->implicit) {
+    return umesh->nodes_to_cells[(umesh->nodes_to_cells_offsets[(nn)] + cc)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int ii = nn / ((nx + 1) * (ny + 1));
+  const int jj = (nn / (nx + 1)) % (ny + 1);
+  const int kk = nn % (nx + 1);
+
+  // Each axis contributes the cells below and above the node that exist
+  const int nj = (jj > 0) + (jj < ny);
+  const int nk = (kk > 0) + (kk < nx);
+  const int ci = ii - (ii > 0) + cc / (nj * nk);
+  const int cj = jj - (jj > 0) + (cc / nk) % nj;
+  const int ck = kk - (kk > 0) + cc % nk;
+  return implicit_cell_index(umesh, ci, cj, ck);
+}
+
+// The number of nodes sharing an edge with a node
+static inline int umesh_node_nnodes(const UnstructuredMesh* umesh,
+                                    const int nn) {
+  if (!umesh->implicit) {
+    return umesh->nodes_to_nodes_offsets[(nn + 1)] -
+           umesh->nodes_to_nodes_offsets[(nn)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+  const int ii = nn / ((nx + 1) * (ny + 1));
+  const int jj = (nn / (nx + 1)) % (ny + 1);
+  const int kk = nn % (nx + 1);
+  return (ii > 0) + (ii < nz) + (jj > 0) + (jj < ny) + (kk > 0) + (kk < nx);
+}
+
+// A node sharing an edge with a node, in ascending order
+static inline int umesh_node_node(const UnstructuredMesh* umesh, const int nn,
+                                  const int ll) {
+  if (!umesh->implicit) {
+    return umesh->nodes_to_nodes[(umesh->nodes_to_nodes_offsets[(nn)] + ll)];
+  }
+  const int nx = umesh->implicit_nx;
+  const int ny = umesh->implicit_ny;
+  const int nz = umesh->implicit_nz;
+  const int ii = nn / ((nx + 1) * (ny + 1));
+  const int jj = (nn / (nx + 1)) % (ny + 1);
+  const int kk = nn % (nx + 1);
+  const int strides[3] = {(nx + 1) * (ny + 1), nx + 1, 1};
+  const int below[3] = {ii > 0, jj > 0, kk > 0};
+  const int above[3] = {ii < nz, jj < ny, kk < nx};
+
+  // The neighbours below come first, furthest first, then those above
+  int remaining = ll;
+  for (int dd = 0; dd < 3; ++dd) {
+    if (below[dd] && remaining-- == 0) {
+      return nn - strides[dd];
+    }
+  }
+  for (int dd = 2; dd >= 0; --dd) {
+    if (above[dd] && remaining-- == 0) {
+      return nn + strides[dd];
+    }
+  }
+  return -1;
+}
+
+// The number of nodes of a face
+static inline int umesh_face_nnodes(const UnstructuredMesh* umesh,
+                                    const int ff) {
+  return umesh->implicit ? NNODES_BY_FACE
+                         : umesh->faces_to_nodes_offsets[(ff + 1)] -
+                               umesh->faces_to_nodes_offsets[(ff)];
+}
+
+// A node of a face, ordered counter-clockwise around the face
+static inline int umesh_face_node(const UnstructuredMesh* umesh, const int ff,
+                                  const int nn) {
+  if (!umesh->implicit) {
+    return umesh->faces_to_nodes[(umesh->faces_to_nodes_offsets[(ff)] + nn)];
+  }
+  int ii;
+  int jj;
+  int kk;
+  const int orientation = implicit_face_position(umesh, ff, &ii, &jj, &kk);
+
+  // The offsets of the second and third nodes along the two face axes
+  const int first = ((nn == 1) || (nn == 2));
+  const int second = ((nn == 2) || (nn == 3));
+  switch (orientation) {
+    case IMPLICIT_FACE_XY:
+      return implicit_node_index(umesh, ii, jj + second, kk + first);
+    case IMPLICIT_FACE_YZ:
+      return implicit_node_index(umesh, ii + second, jj + first, kk);
+    default:
+      return implicit_node_index(umesh, ii + first, jj, kk + second);
+  }
+}
+
+// Writes all of the nodes of a face, in the order of umesh_face_node, to a
+// list that can hold the largest face, returning how many there are
+static inline int umesh_face_nodes(const UnstructuredMesh* umesh, const int ff,
+                                   int* nodes) {
+  if (!umesh->implicit) {
+    const int off = umesh->faces_to_nodes_offsets[(ff)];
+    const int nnodes_by_face = umesh->faces_to_nodes_offsets[(ff + 1)] - off;
+    for (int nn = 0; nn < nnodes_by_face; ++nn) {
+      nodes[nn] = umesh->faces_to_nodes[(off + nn)];
+    }
+    return nnodes_by_face;
+  }
+  int ii;
+  int jj;
+  int kk;
+  const int orientation = implicit_face_position(umesh, ff, &ii, &jj, &kk);
+
+  // The strides of the structured mesh along the two face axes
+  const int plane = (umesh->implicit_nx + 1) * (umesh->implicit_ny + 1);
+  const int row = umesh->implicit_nx + 1;
+  const int first = (orientation == IMPLICIT_FACE_XY)
+                        ? 1
+                        : ((orientation == IMPLICIT_FACE_YZ) ? row : plane);
+  const int second = (orientation == IMPLICIT_FACE_XY)
+                         ? row
+                         : ((orientation == IMPLICIT_FACE_YZ) ? plane : 1);
+  nodes[0] = implicit_node_index(umesh, ii, jj, kk);
+  nodes[1] = nodes[0] + first;
+  nodes[2] = nodes[0] + first + second;
+  nodes[3] = nodes[0] + second;
+  return NNODES_BY_FACE;
+}
+
+// The cells either side of a face, -1 when the face is on the boundary
+static inline int umesh_face_cell(const UnstructuredMesh* umesh, const int ff,
+                                  const int side) {
+  if (!umesh->implicit) {
+    return side ? umesh->faces_to_cells1[(ff)] : umesh->faces_to_cells0[(ff)];
+  }
+  int ii;
+  int jj;
+  int kk;
+  const int orientation = implicit_face_position(umesh, ff, &ii, &jj, &kk);
+  switch (orientation) {
+    case IMPLICIT_FACE_XY:
+      ii -= side;
+      return (ii >= 0 && ii < umesh->implicit_nz)
+                 ? implicit_cell_index(umesh, ii, jj, kk)
+                 : -1;
+    case IMPLICIT_FACE_YZ:
+      kk -= side;
+      return (kk >= 0 && kk < umesh->implicit_nx)
+                 ? implicit_cell_index(umesh, ii, jj, kk)
+                 : -1;
+    default:
+      jj -= side;
+      return (jj >= 0 && jj < umesh->implicit_ny)
+                 ? implicit_cell_index(umesh, ii, jj, kk)
+                 : -1;
+  }
+}
+
+// The cells or nodes exchanged with each neighbouring rank, as local indices
+// listed in the same order on both sides of the exchange
+typedef struct {
+  int nneighbours;
+  int* neighbour_ranks;
+  int* send_offsets; // Offsets into the send list by neighbour
+  int* send_list;
+  int* recv_offsets; // Offsets into the receive list by neighbour
+  int* recv_list;
+} UnstructuredHalo;
+
+// Relates the local unstructured mesh of a rank to the global mesh. Owned
+// cells and nodes are numbered first, followed by the ghosts.
+typedef struct {
+  int nglobal_cells;
+  int nglobal_nodes;
+  int nowned_cells;
+  int nowned_nodes;
+
+  int* local_to_global_cells;
+  int* local_to_global_nodes;
+  int* global_to_local_cells; // -1 where the cell is not held by this rank
+  int* global_to_local_nodes; // -1 where the node is not held by this rank
+
+  UnstructuredHalo cell_halo;
+  UnstructuredHalo node_halo;
+} UnstructuredPartition;
+
 // Initialises the unstructured mesh variables
 size_t init_unstructured_mesh(UnstructuredMesh* umesh);
 
@@ -84,7 +503,15 @@ size_t init_unstructured_mesh(UnstructuredMesh* umesh);
 size_t read_unstructured_mesh(UnstructuredMesh* umesh, double*** variables,
                               int nvars);
 
-// Finds the normals for all boundary cells
+// Numbers the nodes flagged in boundary_type in order of their index,
+// returning the number of boundary nodes
+int enumerate_boundary_nodes(UnstructuredMesh* umesh);
+
+// Finds the normals and types of the boundary nodes from the area weighted
+// normals of the boundary faces around them. In 2d the list holds a pair of
+// nodes for each of the nboundary_nodes edges, with the domain on their
+// right. In 3d the list holds nboundary_faces faces, or is NULL to use every
+// face with a single cell, and the boundary nodes are renumbered.
 void find_boundary_normals(UnstructuredMesh* umesh, int* boundary_face_list);
 void find_boundary_normals_3d(UnstructuredMesh* umesh, int* boundary_face_list);
 
@@ -94,25 +521,70 @@ size_t convert_mesh_to_umesh(UnstructuredMesh* umesh, Mesh* mesh);
 // Converts an ordinary structured mesh into an unstructured equivalent
 size_t convert_mesh_to_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh);
 
+// Converts an ordinary structured mesh into an unstructured equivalent whose
+// connectivity is implicit, so only the node and boundary data is allocated
+size_t convert_mesh_to_implicit_umesh_3d(UnstructuredMesh* umesh, Mesh* mesh);
+
+// Allocates and fills the connectivity arrays of a mesh with implicit
+// connectivity, after which the mesh is explicit
+size_t materialise_umesh_connectivity(UnstructuredMesh* umesh);
+
+// Reorders the cells and nodes, rewriting all of the connectivity, where the
+// permutations give the new index of each cell and node
+void permute_unstructured_mesh(UnstructuredMesh* umesh,
+                               const int* cells_old_to_new,
+                               const int* nodes_old_to_new);
+
+// Renumbers the cells in Morton order of their centroids and the nodes in
+// the order that the renumbered cells first use them, returning the new
+// index of each original cell and node
+void renumber_unstructured_mesh(UnstructuredMesh* umesh, int* cells_old_to_new,
+                                int* nodes_old_to_new);
+
+// Moves each entry of a field to its new index, replacing the buffer
+void permute_data(const int n, const int* old_to_new, double** data);
+
+// Deallocates all of the unstructured mesh memory
+void finalise_unstructured_mesh(UnstructuredMesh* umesh);
+
 // Converts the lists of cell counts to a list of offsets
 void convert_cell_counts_to_offsets(UnstructuredMesh* umesh);
 
+// Replaces the values with their prefix sum, computed in parallel blocks,
+// and returns the total
+int prefix_sum(const int n, int* vals, const int inclusive);
+
+// Builds the transpose of a CSR map, in which each of the ncols columns
+// lists the rows that name it in ascending order. Entries of -1 are skipped.
+// The transposed offsets must hold ncols + 1 entries and any existing
+// transposed list is replaced, returning the bytes allocated.
+size_t build_csr_transpose(const int nrows, const int* offsets,
+                           const int* list, const int ncols,
+                           int* transpose_offsets, int** transpose_list);
+
 // Fill in the list of cells surrounding nodes
-void fill_nodes_to_cells(UnstructuredMesh* umesh);
+size_t fill_nodes_to_cells(UnstructuredMesh* umesh);
 
-// Determine the cells that neighbour other cells
-void fill_cells_to_cells(UnstructuredMesh* umesh);
+// Determine the cells that neighbour other cells, sharing at least one node
+size_t fill_cells_to_cells(UnstructuredMesh* umesh);
 
-// Determine the nodes that surround other nodes
-void fill_nodes_to_nodes(UnstructuredMesh* umesh);
+// Determine the nodes that surround other nodes, along the edges of the faces
+// where there are faces and otherwise through the cells
+size_t fill_nodes_to_nodes(UnstructuredMesh* umesh);
 
-// Initialises the list of nodes to cells
-void init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
-                            Mesh* mesh, UnstructuredMesh* umesh);
+// Builds the faces of a mesh of tetrahedra and hexahedra from the nodes of
+// its cells, matching the faces shared by two cells through nodes_to_cells.
+// The faces are numbered in the order of their first cell, which is their
+// faces_to_cells0, and those with a single cell are listed as the boundary
+// faces. Returns the bytes allocated.
+size_t build_umesh_faces(UnstructuredMesh* umesh);
 
-// Initialises the list of nodes to nodes
-void init_nodes_to_nodes_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh);
+// Initialises the list of nodes to cells, returning the bytes allocated
+size_t init_nodes_to_cells_3d(const int nx, const int ny, const int nz,
+                              Mesh* mesh, UnstructuredMesh* umesh);
+
+// Initialises the list of nodes to nodes, returning the bytes allocated
+size_t init_nodes_to_nodes_3d(UnstructuredMesh* umesh);
 
 // Initialises the connectivity between faces and nodes
 void init_faces_to_nodes_3d(const int nx, const int ny, const int nz,
@@ -131,9 +603,9 @@ void init_cells_to_faces_3d(const int nx, const int ny, const int nz,
 // Initialises the offsets between nodes and faces
 void init_nodes_to_faces_offsets_3d(UnstructuredMesh* umesh);
 
-// Initialises the connectivity between nodes and faces
-void init_nodes_to_faces_3d(const int nx, const int ny, const int nz,
-                            UnstructuredMesh* umesh);
+// Initialises the connectivity between nodes and faces, returning the bytes
+// allocated
+size_t init_nodes_to_faces_3d(UnstructuredMesh* umesh);
 
 // Initialises the connectivity between faces and cells
 void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
@@ -143,6 +615,10 @@ void init_faces_to_cells_3d(const int nx, const int ny, const int nz,
 void init_cells_to_nodes_3d(const int nx, const int ny, const int nz,
                             UnstructuredMesh* umesh);
 
+// Initialises the centroids of the cells
+void init_cell_centroids_3d(const int nx, const int ny, const int nz,
+                            Mesh* mesh, UnstructuredMesh* umesh);
+
 // Initialises the boundary normals
 void init_boundary_normals_3d(const int nx, const int ny, const int nz,
                               UnstructuredMesh* umesh);